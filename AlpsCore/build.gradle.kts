@@ -33,6 +33,7 @@ android {
             cmake {
                 arguments("-DANDROID_STL=c++_shared")
                 cppFlags("-std=c++14")
+                targets("alpsnative")
             }
         }
         ndk {
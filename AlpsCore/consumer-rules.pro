@@ -0,0 +1,42 @@
+# Classes and members resolved by name from native code. JNI_OnLoad fails if any of them is
+# renamed or removed.
+
+# Classes with native methods registered in JNI_OnLoad
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeInfo { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.DefaultAlpsNative { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeBufferPool { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeContextPool { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeProcessingQueue { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeBatchProcessor { native <methods>; }
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeTrace { native <methods>; }
+
+# Java methods called from native code
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeLogger {
+    native <methods>;
+    public static void log(int, java.lang.String);
+}
+-keep class com.dolby.android.alps.alpsnative.AlpsNativeProcessingRequest {
+    public void onProcessed(int, java.lang.Throwable);
+}
+-keep interface com.dolby.android.alps.PresentationsChangedCallback {
+    void onPresentationsChanged();
+    void onPresentationsChanged(long);
+}
+-keepclassmembers class * implements com.dolby.android.alps.PresentationsChangedCallback {
+    void onPresentationsChanged();
+    void onPresentationsChanged(long);
+}
+
+# Objects created by native code
+-keep class com.dolby.android.alps.models.Presentation {
+    <init>(int, java.lang.String, java.lang.String);
+}
+-keep class com.dolby.android.alps.AlpsSegmentPatch {
+    <init>(int, int[], int[], byte[]);
+}
+-keep class com.dolby.android.alps.utils.AlpsException$JNI {
+    <init>(java.lang.String);
+}
+-keep class com.dolby.android.alps.utils.AlpsException$Native$* {
+    <init>();
+}
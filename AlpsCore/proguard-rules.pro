@@ -2,6 +2,9 @@
 # You can control the set of applied configuration files using the
 # proguardFiles setting in build.gradle.
 #
+# Rules required by native code are shared with consumers of the library
+-include consumer-rules.pro
+#
 # For more details, see
 #   http://developer.android.com/guide/developing/tools/proguard.html
 
@@ -0,0 +1,202 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+/**
+ * alpsbatch - processes directories of ISO BMFF segments with ALPS.
+ *
+ * Every input directory is a single stream: an init segment (file name containing "init") and
+ * media segments (.m4s files) processed in natural file name order. Streams are processed in
+ * parallel.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "batch_processor.h"
+#include "native_logger.h"
+
+static void printUsage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-j threads] [-p presentation_id] [-o output_dir] input_dir...\n"
+            "  -j  number of streams processed in parallel, number of cores by default\n"
+            "  -p  presentation ID set after the init segment is processed, -1 by default\n"
+            "  -o  output directory, files are processed in place if not set. With multiple input\n"
+            "      directories, output of each is written to a subdirectory named after it\n",
+            name);
+}
+
+// Compares digit runs by value, so that segment-9.m4s precedes segment-10.m4s
+static bool naturalLess(const std::string &a, const std::string &b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t aEnd = i, bEnd = j;
+            while (aEnd < a.size() && isdigit((unsigned char)a[aEnd])) aEnd++;
+            while (bEnd < b.size() && isdigit((unsigned char)b[bEnd])) bEnd++;
+            unsigned long long aValue = strtoull(a.substr(i, aEnd - i).c_str(), nullptr, 10);
+            unsigned long long bValue = strtoull(b.substr(j, bEnd - j).c_str(), nullptr, 10);
+            if (aValue != bValue) {
+                return aValue < bValue;
+            }
+            i = aEnd;
+            j = bEnd;
+        } else {
+            if (a[i] != b[j]) {
+                return a[i] < b[j];
+            }
+            i++;
+            j++;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+static bool endsWith(const std::string &value, const char *suffix) {
+    size_t suffixLength = strlen(suffix);
+    return value.size() >= suffixLength &&
+           value.compare(value.size() - suffixLength, suffixLength, suffix) == 0;
+}
+
+static std::string baseName(std::string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool prepareJob(const std::string &inputDir, const std::string &outputDir,
+                       int presentationId, BatchJob *job) {
+    DIR *dir = opendir(inputDir.c_str());
+    if (dir == nullptr) {
+        fprintf(stderr, "Failed to open %s: %s\n", inputDir.c_str(), strerror(errno));
+        return false;
+    }
+    std::string initName;
+    std::vector<std::string> segmentNames;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.find("init") != std::string::npos) {
+            initName = name;
+        } else if (endsWith(name, ".m4s")) {
+            segmentNames.push_back(name);
+        }
+    }
+    closedir(dir);
+
+    if (initName.empty()) {
+        fprintf(stderr, "Input directory %s must contain init file\n", inputDir.c_str());
+        return false;
+    }
+    if (mkdir(outputDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create %s: %s\n", outputDir.c_str(), strerror(errno));
+        return false;
+    }
+    std::sort(segmentNames.begin(), segmentNames.end(), naturalLess);
+
+    job->presentationId = presentationId;
+    job->files.push_back({inputDir + "/" + initName, outputDir + "/" + initName});
+    for (const auto &name : segmentNames) {
+        job->files.push_back({inputDir + "/" + name, outputDir + "/" + name});
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t threadCount = 0;
+    int presentationId = -1;
+    const char *outputDir = nullptr;
+
+    int option;
+    while ((option = getopt(argc, argv, "j:p:o:h")) != -1) {
+        switch (option) {
+            case 'j':
+                threadCount = (size_t)strtoul(optarg, nullptr, 10);
+                break;
+            case 'p':
+                presentationId = atoi(optarg);
+                break;
+            case 'o':
+                outputDir = optarg;
+                break;
+            default:
+                printUsage(argv[0]);
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int inputCount = argc - optind;
+    if (outputDir != nullptr && inputCount > 1 &&
+        mkdir(outputDir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create %s: %s\n", outputDir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    std::vector<BatchJob> jobs;
+    for (int i = optind; i < argc; i++) {
+        std::string inputDir = argv[i];
+        std::string jobOutputDir = inputDir;
+        if (outputDir != nullptr) {
+            jobOutputDir = inputCount > 1
+                    ? std::string(outputDir) + "/" + baseName(inputDir)
+                    : std::string(outputDir);
+        }
+        BatchJob job;
+        if (!prepareJob(inputDir, jobOutputDir, presentationId, &job)) {
+            return EXIT_FAILURE;
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    BatchStatistics statistics;
+    bool success = BatchProcessor(threadCount).run(jobs, &statistics);
+    // Warnings about individual files are written before the summary
+    NativeLogger::shared().flush();
+
+    double seconds = (double)statistics.elapsedNs / 1e9;
+    double megabytes = (double)statistics.bytes / (1024.0 * 1024.0);
+    printf("Streams: %zu, files: %llu, failed: %llu, written as is: %llu\n",
+           jobs.size(),
+           (unsigned long long)statistics.fileCount,
+           (unsigned long long)statistics.failedFileCount,
+           (unsigned long long)statistics.unprocessedFileCount);
+    printf("Processed %.1f MiB in %.3f s (%.1f MiB/s)\n",
+           megabytes, seconds, seconds > 0 ? megabytes / seconds : 0.0);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
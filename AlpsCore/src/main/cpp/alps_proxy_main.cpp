@@ -0,0 +1,138 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+/**
+ * alpsproxy - HTTP proxy rewriting AC-4 segments with ALPS for clients that can't embed the
+ * library.
+ *
+ * Segment URLs are requested through the proxy with alps_presentation (and optionally
+ * alps_session) query parameters added, e.g.
+ * http://proxy:8080/audio/segment-1.m4s?alps_presentation=2
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "native_logger.h"
+#include "proxy_server.h"
+
+static void printUsage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-l address:port] [-j threads] [-b buffer_kib] [-t timeout_s] "
+            "origin_host[:port]\n"
+            "  -l  address and port to listen on, 127.0.0.1:8080 by default\n"
+            "  -j  number of event loop threads, number of cores by default\n"
+            "  -b  size of I/O buffers of a single request in KiB, 64 by default\n"
+            "  -t  seconds after which unused sessions are closed, 60 by default\n",
+            name);
+}
+
+// Splits host:port, keeping the port unchanged if it's not specified
+static bool parseAddress(const char *value, std::string *host, uint16_t *port) {
+    std::string address = value;
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        *host = address;
+        return !host->empty();
+    }
+    char *end;
+    unsigned long parsed = strtoul(address.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || parsed > 65535) {
+        return false;
+    }
+    *host = address.substr(0, colon);
+    *port = (uint16_t)parsed;
+    return !host->empty();
+}
+
+int main(int argc, char **argv) {
+    ProxyConfig config;
+
+    int option;
+    while ((option = getopt(argc, argv, "l:j:b:t:h")) != -1) {
+        switch (option) {
+            case 'l':
+                if (!parseAddress(optarg, &config.listenAddress, &config.listenPort)) {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'j':
+                config.threadCount = (size_t)strtoul(optarg, nullptr, 10);
+                break;
+            case 'b':
+                config.ioBufferSize = (size_t)strtoul(optarg, nullptr, 10) * 1024;
+                break;
+            case 't':
+                config.sessionIdleTimeoutMs = (uint32_t)strtoul(optarg, nullptr, 10) * 1000;
+                break;
+            default:
+                printUsage(argv[0]);
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 ||
+        !parseAddress(argv[optind], &config.upstreamHost, &config.upstreamPort)) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Blocked before event loop threads are started, so that only the main thread receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ProxyServer server(config);
+    if (!server.start()) {
+        NativeLogger::shared().flush();
+        return EXIT_FAILURE;
+    }
+    printf("Listening on %s:%u, forwarding to %s:%u\n", config.listenAddress.c_str(),
+           (unsigned)server.port(), config.upstreamHost.c_str(), (unsigned)config.upstreamPort);
+    fflush(stdout);
+
+    int received;
+    sigwait(&signals, &received);
+    server.stop();
+    NativeLogger::shared().flush();
+
+    ProxyStatistics statistics = server.statistics();
+    printf("Connections: %llu, requests: %llu, processed: %llu, forwarded as is: %llu, "
+           "origin errors: %llu\n",
+           (unsigned long long)statistics.acceptedConnections,
+           (unsigned long long)statistics.requests,
+           (unsigned long long)statistics.processedResponses,
+           (unsigned long long)statistics.passthroughResponses,
+           (unsigned long long)statistics.upstreamErrors);
+    printf("Written %.1f MiB\n", (double)statistics.responseBytes / (1024.0 * 1024.0));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,426 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "alps_session.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "context_pool.h"
+#include "log.h"
+#include "segment_scanner.h"
+#include "trace.h"
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+static std::atomic<uint32_t> nextRecordingId{1};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    auto bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *string) {
+    if (string == nullptr) {
+        string = "";
+    }
+    // Terminating zero is included, so that ("ab", "c") and ("a", "bc") differ
+    return fnv1a(hash, string, strlen(string) + 1);
+}
+
+void AlpsSessionCounters::reset() {
+    processCount.store(0);
+    skipCount.store(0);
+    processErrorCount.store(0);
+    processedBytes.store(0);
+    presentationsChangedCount.store(0);
+    for (auto &errorCount : errorCounts) {
+        errorCount.store(0);
+    }
+    processingTime.reset();
+    callbackLatency.reset();
+    presentationsChangedTimeNs.store(0);
+}
+
+AlpsSession *AlpsSession::create(presentations_changed_cb presentationsChangedCallback,
+                                 alps_ret *error) {
+    size_t memorySize;
+    alps_ret ret = alps_query_mem(&memorySize);
+    if (ret != ALPS_RET_OK) {
+        ALOGE("alps_query_mem failed, error: %d", ret);
+        if (error != nullptr) *error = ret;
+        return nullptr;
+    }
+    ALOGI("alps_query_mem successful, size: %zu", memorySize);
+
+    void *memory = malloc(memorySize);
+    if (memory == nullptr) {
+        ALOGE("Failed to allocate memory");
+        if (error != nullptr) *error = ALPS_RET_E_UNDEFINED;
+        return nullptr;
+    }
+
+    alps_ctx *alps = nullptr;
+    ret = alps_init(&alps, memory);
+    if (ret != ALPS_RET_OK) {
+        ALOGE("alps_init failed, error: %d", ret);
+        free(memory);
+        if (error != nullptr) *error = ret;
+        return nullptr;
+    }
+    ALOGI("alps_init successful");
+
+    auto *session = new (std::nothrow) AlpsSession(memory, alps);
+    if (session == nullptr) {
+        ALOGE("Failed to allocate session");
+        alps_destroy(alps);
+        free(memory);
+        if (error != nullptr) *error = ALPS_RET_E_UNDEFINED;
+        return nullptr;
+    }
+    session->presentationsChangedCallback = presentationsChangedCallback;
+    alps_set_presentations_changed_callback(alps, presentationsChangedCallback, session);
+    session->publishPresentationSnapshot();
+    return session;
+}
+
+AlpsSession::AlpsSession(void *memory, alps_ctx *alps)
+    : pendingPresentationId(ALPS_INVALID_PRES_ID),
+      callbackRef(nullptr), dispatchNext(nullptr), dispatchedGeneration(0),
+      queuedJobsHead(nullptr), queuedJobsTail(nullptr), processingScheduled(false),
+      processingNext(nullptr),
+      trackType(TrackType::UNKNOWN), presentationsFingerprint(FNV_OFFSET_BASIS),
+      hasSelectionPolicy(false), recordingId(nextRecordingId.fetch_add(1)),
+      memory(memory), alps(alps),
+      presentationsChangedCallback(nullptr), pool(nullptr) {
+}
+
+AlpsSession::~AlpsSession() {
+    if (alps != nullptr) {
+        alps_destroy(alps);
+    }
+    // Context lives inside the memory block, but not necessarily at its beginning
+    free(memory);
+}
+
+void AlpsSession::retain() {
+    refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AlpsSession::release() {
+    if (refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        CallRecorder *recorder = CallRecorder::active();
+        if (recorder != nullptr) {
+            recorder->recordSessionEnd(recordingId);
+        }
+        if (pool != nullptr) {
+            pool->recycle(this);
+        } else {
+            delete this;
+        }
+    }
+}
+
+bool AlpsSession::reinitialize() {
+    alps_destroy(alps);
+    alps = nullptr;
+    alps_ret ret = alps_init(&alps, memory);
+    if (ret != ALPS_RET_OK) {
+        ALOGE("alps_init failed, error: %d", ret);
+        alps = nullptr;
+        return false;
+    }
+    alps_set_presentations_changed_callback(alps, presentationsChangedCallback, this);
+
+    callbackRef = nullptr;
+    pendingPresentationId = ALPS_INVALID_PRES_ID;
+    trackType = TrackType::UNKNOWN;
+    presentationsFingerprint = FNV_OFFSET_BASIS;
+    clearSelectionPolicy();
+    recordingId = nextRecordingId.fetch_add(1);
+    presentationsListGeneration.store(0);
+    publishPresentationSnapshot();
+    counters.reset();
+    presentationsGeneration.store(0);
+    asyncCallbackDispatch.store(false);
+    callbackQueued.store(false);
+    dispatchNext = nullptr;
+    dispatchedGeneration = 0;
+    refCount.store(1);
+    return true;
+}
+
+ProcessingStatus AlpsSession::process(uint8_t *segment, size_t size, alps_ret *error) {
+    uint32_t flags = 0;
+    ProcessingStatus status = prepare(segment, size, &flags);
+    if (status != ProcessingStatus::PROCESSED) {
+        return status;
+    }
+    return processPrepared(segment, size, flags, error);
+}
+
+ProcessingStatus AlpsSession::prepare(const uint8_t *segment, size_t size, uint32_t *flags) {
+    CallRecorder *recorder = CallRecorder::active();
+    uint64_t startNs = recorder != nullptr ? monotonicTimeNs() : 0;
+    *flags = scanSegment(segment, size);
+    ProcessingStatus skipStatus = ProcessingStatus::PROCESSED;
+
+    // Malformed segments are left to ALPS to report the error
+    if ((*flags & SEGMENT_MALFORMED) == 0) {
+        if (*flags & SEGMENT_HAS_MOVIE) {
+            trackType = (*flags & SEGMENT_HAS_AC4_TRACK) ? TrackType::AC4 : TrackType::OTHER;
+            ALOGI("Init segment, AC-4 track: %d, preselections: %d",
+                  (*flags & SEGMENT_HAS_AC4_TRACK) != 0, (*flags & SEGMENT_HAS_PRESELECTIONS) != 0);
+        }
+
+        int activePresentationId = ALPS_INVALID_PRES_ID;
+        if ((*flags & (SEGMENT_HAS_MOVIE | SEGMENT_HAS_FRAGMENT)) == 0) {
+            skipStatus = ProcessingStatus::SKIPPED_NO_MOVIE_NOR_FRAGMENT;
+        } else if (trackType == TrackType::OTHER) {
+            skipStatus = ProcessingStatus::SKIPPED_NO_AC4_TRACK;
+        } else if ((*flags & SEGMENT_HAS_MOVIE) == 0 && trackType == TrackType::AC4 &&
+                   alps_get_active_presentation_id(alps, &activePresentationId) == ALPS_RET_OK &&
+                   activePresentationId == ALPS_INVALID_PRES_ID) {
+            skipStatus = ProcessingStatus::SKIPPED_NO_ACTIVE_PRESENTATION;
+        }
+    }
+    if (skipStatus != ProcessingStatus::PROCESSED) {
+        counters.skipCount.fetch_add(1, std::memory_order_relaxed);
+        if (recorder != nullptr) {
+            recorder->recordProcess(recordingId, startNs, monotonicTimeNs() - startNs, *flags,
+                                    (uint8_t)skipStatus, ALPS_RET_OK,
+                                    recordingHash(segment, size),
+                                    recorder->recordsPayloads() ? segment : nullptr, size);
+        }
+    }
+    return skipStatus;
+}
+
+ProcessingStatus AlpsSession::processPrepared(uint8_t *segment, size_t size, uint32_t flags,
+                                              alps_ret *error) {
+    CallRecorder *recorder = CallRecorder::active();
+    uint64_t inputHash = 0;
+    const uint8_t *input = nullptr;
+    if (recorder != nullptr) {
+        // Segment is processed in place, recorded bytes are taken before
+        inputHash = recordingHash(segment, size);
+        input = recorder->capturePayload(segment, size);
+    }
+
+    alps_ret ret;
+    uint64_t startNs = monotonicTimeNs();
+    uint64_t durationNs;
+    {
+        ScopedTrace trace("alps_process_isobmff_segment");
+        ret = alps_process_isobmff_segment(alps, segment, size);
+        durationNs = monotonicTimeNs() - startNs;
+        counters.processingTime.record(durationNs);
+    }
+    if (recorder != nullptr) {
+        recorder->recordProcess(recordingId, startNs, durationNs, flags,
+                                (uint8_t)(ret == ALPS_RET_OK ? ProcessingStatus::PROCESSED
+                                                             : ProcessingStatus::FAILED),
+                                ret, inputHash, input, size);
+    }
+    counters.processCount.fetch_add(1, std::memory_order_relaxed);
+    counters.processedBytes.fetch_add(size, std::memory_order_relaxed);
+    bool presentationsChanged = updatePresentationsFingerprint();
+    if (ret != ALPS_RET_OK) {
+        counters.processErrorCount.fetch_add(1, std::memory_order_relaxed);
+        if (ret > ALPS_RET_OK && ret < ALPS_RET_COUNT) {
+            counters.errorCounts[ret].fetch_add(1, std::memory_order_relaxed);
+        }
+        if (error != nullptr) *error = ret;
+        publishPresentationSnapshot();
+        return ProcessingStatus::FAILED;
+    }
+    bool pendingActivated = (flags & SEGMENT_HAS_MOVIE) &&
+                            pendingPresentationId != ALPS_INVALID_PRES_ID &&
+                            activatePendingPresentation();
+    if (presentationsChanged && hasSelectionPolicy && !pendingActivated) {
+        applySelectionPolicy();
+    }
+    publishPresentationSnapshot();
+    return ProcessingStatus::PROCESSED;
+}
+
+alps_ret AlpsSession::seedActivePresentationId(int presentationId) {
+    alps_ret ret = alps_set_active_presentation_id(alps, presentationId);
+    if (ret == ALPS_RET_E_PRES_ID_NOT_FOUND) {
+        ALOGI("Presentation %d not listed yet, activated after the next init segment",
+              presentationId);
+        pendingPresentationId = presentationId;
+        ret = ALPS_RET_OK;
+    } else {
+        pendingPresentationId = ALPS_INVALID_PRES_ID;
+        publishPresentationSnapshot();
+    }
+    recordPresentationCall(CallType::SEED_ACTIVE, presentationId, ret);
+    return ret;
+}
+
+alps_ret AlpsSession::setActivePresentationId(int presentationId) {
+    alps_ret ret = alps_set_active_presentation_id(alps, presentationId);
+    if (ret == ALPS_RET_OK) {
+        // Explicit selection overrides the seeded one
+        pendingPresentationId = ALPS_INVALID_PRES_ID;
+        publishPresentationSnapshot();
+    }
+    recordPresentationCall(CallType::SET_ACTIVE, presentationId, ret);
+    return ret;
+}
+
+void AlpsSession::recordPresentationCall(CallType type, int presentationId, alps_ret ret) const {
+    CallRecorder *recorder = CallRecorder::active();
+    if (recorder != nullptr) {
+        recorder->recordPresentation(recordingId, type, presentationId, ret);
+    }
+}
+
+bool AlpsSession::activatePendingPresentation() {
+    alps_ret ret = alps_set_active_presentation_id(alps, pendingPresentationId);
+    if (ret == ALPS_RET_OK) {
+        ALOGI("Pending presentation %d activated", pendingPresentationId);
+    } else {
+        // Seeded from stale metadata, the selection policy or the binding layer selects
+        // presentation from the new list
+        ALOGW("Pending presentation %d not found in init segment, error: %d",
+              pendingPresentationId, ret);
+    }
+    pendingPresentationId = ALPS_INVALID_PRES_ID;
+    return ret == ALPS_RET_OK;
+}
+
+alps_ret AlpsSession::setSelectionPolicy(const SelectionPolicy &policy) {
+    selectionPolicy = policy;
+    hasSelectionPolicy = true;
+    alps_ret ret = applySelectionPolicy();
+    publishPresentationSnapshot();
+    return ret;
+}
+
+void AlpsSession::clearSelectionPolicy() {
+    selectionPolicy = SelectionPolicy();
+    hasSelectionPolicy = false;
+}
+
+alps_ret AlpsSession::applySelectionPolicy() {
+    alps_presentation *presentations = nullptr;
+    size_t presentationsCount = 0;
+    alps_ret ret = alps_get_presentations(alps, &presentations, &presentationsCount);
+    if (ret != ALPS_RET_OK || presentationsCount == 0) {
+        return ret;
+    }
+    int presentationId = selectionPolicy.select(presentations, presentationsCount);
+    ret = alps_set_active_presentation_id(alps, presentationId);
+    if (ret == ALPS_RET_OK) {
+        ALOGI("Presentation %d selected by policy", presentationId);
+    } else {
+        ALOGE("Setting presentation %d selected by policy failed, error: %d", presentationId, ret);
+    }
+    // Replayed sessions don't have the policy, they get its selection
+    recordPresentationCall(CallType::SET_ACTIVE, presentationId, ret);
+    return ret;
+}
+
+void AlpsSession::publishPresentationSnapshot() {
+    int activePresentationId = ALPS_INVALID_PRES_ID;
+    alps_ret activeStatus = alps_get_active_presentation_id(alps, &activePresentationId);
+    uint64_t generation = presentationsListGeneration.load(std::memory_order_relaxed);
+    const PresentationSnapshot &current = presentationSnapshots.current();
+    if (current.generation == generation && current.activePresentationStatus == activeStatus &&
+        current.activePresentationId == activePresentationId) {
+        presentationSnapshots.reclaim();
+        return;
+    }
+
+    auto *snapshot = new (std::nothrow) PresentationSnapshot();
+    if (snapshot == nullptr) {
+        ALOGE("Failed to allocate presentation snapshot");
+        return;
+    }
+    snapshot->activePresentationStatus = activeStatus;
+    snapshot->activePresentationId = activePresentationId;
+    snapshot->generation = generation;
+    alps_presentation *presentations = nullptr;
+    size_t presentationsCount = 0;
+    snapshot->presentationsStatus = alps_get_presentations(alps, &presentations,
+                                                           &presentationsCount);
+    if (snapshot->presentationsStatus == ALPS_RET_OK) {
+        snapshot->presentations.resize(presentationsCount);
+        for (size_t i = 0; i < presentationsCount; i++) {
+            SnapshotPresentation &presentation = snapshot->presentations[i];
+            presentation.presentationId = presentations[i].presentation_id;
+            presentation.label = presentations[i].label != nullptr ? presentations[i].label : "";
+            presentation.language =
+                    presentations[i].language != nullptr ? presentations[i].language : "";
+        }
+    }
+    presentationSnapshots.publish(snapshot);
+}
+
+bool AlpsSession::updatePresentationsFingerprint() {
+    alps_presentation *presentations = nullptr;
+    size_t presentationsCount = 0;
+    if (alps_get_presentations(alps, &presentations, &presentationsCount) != ALPS_RET_OK) {
+        return false;
+    }
+
+    uint64_t fingerprint = fnv1a(FNV_OFFSET_BASIS, &presentationsCount, sizeof(presentationsCount));
+    for (size_t i = 0; i < presentationsCount; i++) {
+        const alps_presentation &presentation = presentations[i];
+        fingerprint = fnv1a(fingerprint, &presentation.presentation_id,
+                            sizeof(presentation.presentation_id));
+        fingerprint = fnv1a(fingerprint, presentation.label);
+        fingerprint = fnv1a(fingerprint, presentation.language);
+    }
+    if (presentationsCount == 0) {
+        // Empty list matches the initial generation
+        fingerprint = FNV_OFFSET_BASIS;
+    }
+
+    if (fingerprint == presentationsFingerprint) {
+        return false;
+    }
+    presentationsFingerprint = fingerprint;
+    uint64_t generation = presentationsListGeneration.fetch_add(1, std::memory_order_release) + 1;
+    CallRecorder *recorder = CallRecorder::active();
+    if (recorder != nullptr) {
+        recorder->recordListChanged(recordingId, generation);
+    }
+    return true;
+}
+
+alps_ret AlpsSession::processSegment(uint8_t *segment, size_t size) {
+    alps_ret ret = ALPS_RET_OK;
+    process(segment, size, &ret);
+    return ret;
+}
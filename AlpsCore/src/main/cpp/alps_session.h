@@ -0,0 +1,273 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SESSION_H_
+#define _ALPS_SESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#include "call_recorder.h"
+#include "metrics.h"
+#include "presentation_snapshot.h"
+#include "selection_policy.h"
+
+extern "C"
+{
+    #include "dlb_alps_native.h"
+}
+
+#define ALPS_RET_COUNT (ALPS_RET_E_PRES_ID_NOT_FOUND + 1)
+
+class ContextPool;
+struct ProcessingJob;
+
+enum class ProcessingStatus {
+    PROCESSED = 0,
+    // neither moov nor moof box found
+    SKIPPED_NO_MOVIE_NOR_FRAGMENT = 1,
+    // init segment of the session has no AC-4 track
+    SKIPPED_NO_AC4_TRACK = 2,
+    // media segment while active presentation is not set, ALPS would pass it through
+    SKIPPED_NO_ACTIVE_PRESENTATION = 3,
+    FAILED = 4,
+};
+
+struct AlpsSessionCounters {
+    // number of alps_process_isobmff_segment calls
+    std::atomic<uint64_t> processCount{0};
+    // number of segments not passed to ALPS, because processing would not change them
+    std::atomic<uint64_t> skipCount{0};
+    // number of alps_process_isobmff_segment calls that returned an error
+    std::atomic<uint64_t> processErrorCount{0};
+    // bytes passed to alps_process_isobmff_segment
+    std::atomic<uint64_t> processedBytes{0};
+    // number of presentations changed notifications received from ALPS
+    std::atomic<uint64_t> presentationsChangedCount{0};
+    // alps_process_isobmff_segment errors, indexed by alps_ret
+    std::atomic<uint64_t> errorCounts[ALPS_RET_COUNT] = {};
+    // duration of alps_process_isobmff_segment calls
+    LatencyHistogram processingTime;
+    // time from ALPS reporting presentations list change until the binding layer callback returns
+    LatencyHistogram callbackLatency;
+    // monotonicTimeNs of the last presentations list change reported by ALPS
+    std::atomic<uint64_t> presentationsChangedTimeNs{0};
+
+    void reset();
+};
+
+/**
+ * Single ALPS instance: owns the context memory, the context itself and the state attached to it
+ * by the binding layer.
+ *
+ * Sessions don't share any locks, so independent instances (e.g. one per period or per player)
+ * can be used concurrently from different threads. A single session must not be used from
+ * multiple threads at the same time, except for the callback state guarded by callbackMutex, the
+ * callback dispatch state and the processing queue state. Binding layer serializes its own calls
+ * with processing queue workers using contextMutex.
+ *
+ * Sessions are reference counted, so that asynchronous callback dispatch can outlive the binding
+ * layer handle. Session is created with a single reference. Sessions acquired from a ContextPool
+ * are returned to it when the last reference is dropped.
+ */
+class AlpsSession {
+public:
+    /**
+     * Allocates context memory and initializes ALPS context in it.
+     *
+     * @param presentationsChangedCallback called from processSegment with the session as
+     * callback context
+     * @param error set to the ALPS error on failure, may be nullptr
+     * @return new session or nullptr on failure
+     */
+    static AlpsSession *create(presentations_changed_cb presentationsChangedCallback,
+                               alps_ret *error);
+
+    AlpsSession(const AlpsSession&) = delete;
+    AlpsSession& operator=(const AlpsSession&) = delete;
+
+    void retain();
+    /**
+     * Drops a reference, session is destroyed when the last one is dropped.
+     */
+    void release();
+
+    alps_ctx *context() const { return alps; }
+
+    /**
+     * Processes segment in place. Segment is pre-scanned first and ALPS is not called when it
+     * would not modify the segment nor the presentations list.
+     *
+     * @param error set to the ALPS error if processing failed, may be nullptr
+     */
+    ProcessingStatus process(uint8_t *segment, size_t size, alps_ret *error);
+
+    /**
+     * First step of process: pre-scans segment without modifying it and updates the track type
+     * when it's an init segment.
+     *
+     * @param flags set to the scanSegment flags, passed to processPrepared
+     * @return PROCESSED if the segment has to be passed to processPrepared, skip status otherwise
+     */
+    ProcessingStatus prepare(const uint8_t *segment, size_t size, uint32_t *flags);
+
+    /**
+     * Second step of process: processes segment in place, segment may be a copy of the one passed
+     * to prepare.
+     *
+     * @param error set to the ALPS error if processing failed, may be nullptr
+     */
+    ProcessingStatus processPrepared(uint8_t *segment, size_t size, uint32_t flags,
+                                     alps_ret *error);
+
+    /**
+     * Same as process, skipped segments are reported as ALPS_RET_OK.
+     */
+    alps_ret processSegment(uint8_t *segment, size_t size);
+
+    /**
+     * Sets active presentation if the presentations list contains it. Otherwise the ID is kept
+     * pending and activated right after the next init segment is processed, so that media
+     * segments following it are processed for the presentation without waiting for the
+     * presentations changed callback.
+     *
+     * @return ALPS_RET_OK if the presentation was activated or kept pending
+     */
+    alps_ret seedActivePresentationId(int presentationId);
+
+    /**
+     * Sets active presentation, clearing the pending one on success.
+     */
+    alps_ret setActivePresentationId(int presentationId);
+
+    /**
+     * Sets policy selecting active presentation whenever the presentations list changes, and
+     * applies it to the current list right away if it's not empty. A pending presentation takes
+     * precedence over the policy when the init segment lists it.
+     *
+     * @return result of setting the selected presentation active
+     */
+    alps_ret setSelectionPolicy(const SelectionPolicy &policy);
+    void clearSelectionPolicy();
+
+    // Presentation activated after the next init segment, ALPS_INVALID_PRES_ID if none. Guarded
+    // by contextMutex, cleared when active presentation is set explicitly.
+    int pendingPresentationId;
+
+    // Serializes access to the ALPS context between the binding layer and processing queue
+    // workers. Presentations changed callbacks must not be delivered while it's held.
+    std::mutex contextMutex;
+
+    // Guards callbackRef. Callbacks are delivered without holding it, the binding layer takes its
+    // own reference to the callback object under the lock.
+    std::mutex callbackMutex;
+    // Presentations changed callback object of the binding layer (e.g. JNI global reference),
+    // owned by the binding layer
+    void *callbackRef;
+
+    AlpsSessionCounters counters;
+
+    // Incremented whenever presentations list content changes, checked by fingerprinting the
+    // list after every ALPS processing call. Starts at 0 with an empty list.
+    std::atomic<uint64_t> presentationsListGeneration{0};
+
+    // Presentations list and active presentation ID published after every call changing them,
+    // read by the binding layer getters without locking contextMutex. Written under contextMutex.
+    SnapshotPublisher presentationSnapshots;
+
+    // Incremented whenever ALPS reports presentations list change, passed to asynchronous
+    // callbacks. Differs from presentationsListGeneration - reports don't always change the list.
+    std::atomic<uint64_t> presentationsGeneration{0};
+    // Presentations changed callbacks are delivered on the dispatcher thread instead of the
+    // processing thread
+    std::atomic<bool> asyncCallbackDispatch{false};
+    // Set while the session waits in the dispatcher queue, changes reported in the meantime are
+    // coalesced into a single callback
+    std::atomic<bool> callbackQueued{false};
+    // Dispatcher queue link, owned by the dispatcher
+    AlpsSession *dispatchNext;
+    // Last generation delivered by the dispatcher, accessed only by the dispatcher thread
+    uint64_t dispatchedGeneration;
+
+    // Processing queue state, guarded by the queue lock. Jobs of the session are queued in FIFO
+    // order, session is scheduled while it's in the ready list or being processed.
+    ProcessingJob *queuedJobsHead;
+    ProcessingJob *queuedJobsTail;
+    bool processingScheduled;
+    // Ready list link, owned by the processing queue
+    AlpsSession *processingNext;
+
+private:
+    AlpsSession(void *memory, alps_ctx *alps);
+    ~AlpsSession();
+
+    friend class ContextPool;
+
+    /**
+     * Destroys the context and initializes a new one in the same memory block, dropping all
+     * state attached to the session.
+     *
+     * @return false if the context couldn't be initialized, session can only be deleted then
+     */
+    bool reinitialize();
+
+    // Returns true if the list content changed
+    bool updatePresentationsFingerprint();
+    void recordPresentationCall(CallType type, int presentationId, alps_ret ret) const;
+    // Returns true if the pending presentation was activated
+    bool activatePendingPresentation();
+    alps_ret applySelectionPolicy();
+    // Publishes a new snapshot if the list generation or the active presentation changed
+    void publishPresentationSnapshot();
+
+    enum class TrackType {
+        UNKNOWN,
+        AC4,
+        OTHER,
+    };
+
+    // Type of the track of the last init segment
+    TrackType trackType;
+    // Fingerprint of the presentations list at presentationsListGeneration
+    uint64_t presentationsFingerprint;
+    // Active presentation selection policy, guarded by contextMutex
+    SelectionPolicy selectionPolicy;
+    bool hasSelectionPolicy;
+    // Identifies calls of the session in call recordings, new one is assigned when the session
+    // is reused from the pool
+    uint32_t recordingId;
+
+    void *memory;
+    alps_ctx *alps;
+    presentations_changed_cb presentationsChangedCallback;
+    // Pool the session is returned to, nullptr if not pooled
+    ContextPool *pool;
+    std::atomic<int> refCount{1};
+};
+
+#endif //_ALPS_SESSION_H_
@@ -25,207 +25,762 @@
  **************************************************************************************************/
 
 #include <jni.h>
+#include <climits>
+#include <new>
 #include <string>
+#include <vector>
 #include <mutex>
 
+#include "alps_session.h"
+#include "batch_processor.h"
+#include "buffer_pool.h"
+#include "call_recorder.h"
+#include "callback_dispatcher.h"
+#include "context_pool.h"
+#include "jni_utils.h"
 #include "log.h"
+#include "metrics.h"
+#include "native_logger.h"
+#include "processing_queue.h"
+#include "segment_backup.h"
+#include "segment_patch.h"
+#include "segment_slices.h"
+#include "segment_stream.h"
+#include "trace.h"
 
 extern "C"
 {
     #include "dlb_alps_native.h"
 }
 
-static std::mutex mtx;
-static JavaVM *globalJavaVM = nullptr;
+// Classes and methods used on hot paths are resolved once, in JNI_OnLoad
+static struct {
+    jclass arrayListClass;
+    jmethodID arrayListConstructor;
+    jmethodID arrayListAdd;
+    jclass presentationClass;
+    jmethodID presentationConstructor;
+    jclass segmentPatchClass;
+    jmethodID segmentPatchConstructor;
+    jmethodID onPresentationsChanged;
+    jmethodID onPresentationsChangedGeneration;
+    jclass jniExceptionClass;
+    // indexed by alps_ret
+    jclass nativeExceptionClasses[ALPS_RET_E_PRES_ID_NOT_FOUND + 1];
+    jmethodID nativeExceptionConstructors[ALPS_RET_E_PRES_ID_NOT_FOUND + 1];
+    jmethodID jniExceptionConstructor;
+    jclass nativeLoggerClass;
+    jmethodID nativeLoggerLog;
+    jmethodID processingRequestOnProcessed;
+} jniCache;
 
-jint JNI_OnLoad(JavaVM* vm, void*) {
-    globalJavaVM = vm;
-    return JNI_VERSION_1_6;
+// Java can't be called while the session context is locked (other threads may wait for it while
+// holding Java locks) nor while primitive array critical region is held. Presentations changed
+// callback triggered during such processing is postponed until the context is unlocked. Async
+// dispatch is postponed too, so the dispatcher never sees presentations before selection policy
+// and presentation snapshot of the processed segment are applied.
+static thread_local bool postponeCallbacks = false;
+static thread_local AlpsSession *postponedCallbackSession = nullptr;
+
+// Started when asynchronous dispatch is enabled for the first time
+static std::atomic<CallbackDispatcher*> callbackDispatcher{nullptr};
+static std::once_flag callbackDispatcherStarted;
+
+// Created in JNI_OnLoad, never destroyed - pooled sessions keep a pointer to it
+static ContextPool *contextPool = nullptr;
+
+// Started when the first segment is submitted for asynchronous processing
+static std::atomic<ProcessingQueue*> processingQueue{nullptr};
+static std::once_flag processingQueueStarted;
+// Requests of workers that couldn't attach to the JVM, failed by the next submit
+static std::mutex orphanedRequestsMutex;
+static std::vector<jobject> orphanedRequests;
+
+static void presentationChangedCallback(void *callbackCtx);
+static void deliverPresentationsChanged(AlpsSession *session);
+
+static void dispatchPostponedCallback() {
+    if (postponedCallbackSession != nullptr) {
+        AlpsSession *session = postponedCallbackSession;
+        postponedCallbackSession = nullptr;
+        if (session->asyncCallbackDispatch.load()) {
+            callbackDispatcher.load()->post(session);
+        } else {
+            deliverPresentationsChanged(session);
+        }
+    }
 }
 
-static void throwJniException(JNIEnv* env, const std::string& message) {
-    jclass exceptionClass = env->FindClass("com/dolby/android/alps/utils/AlpsException$JNI");
-    if (exceptionClass != nullptr) {
-        env->ThrowNew(exceptionClass, message.c_str());
+// Locks session context for the scope of a binding layer call, postponed presentations changed
+// callback is delivered when the context is unlocked
+class ContextAccess {
+public:
+    explicit ContextAccess(AlpsSession *session) : guard(session->contextMutex) {
+        postponeCallbacks = true;
+    }
+
+    ~ContextAccess() {
+        unlock();
     }
+
+    ContextAccess(const ContextAccess&) = delete;
+    ContextAccess& operator=(const ContextAccess&) = delete;
+
+    void unlock() {
+        if (guard.owns_lock()) {
+            guard.unlock();
+            postponeCallbacks = false;
+            dispatchPostponedCallback();
+        }
+    }
+
+private:
+    std::unique_lock<std::mutex> guard;
+};
+
+static void throwJniException(JNIEnv* env, const char *message) {
+    env->ThrowNew(jniCache.jniExceptionClass, message);
 }
 
 static void handleNativeError(JNIEnv* env, alps_ret error) {
     if (error == ALPS_RET_OK) return;
 
-    std::string exceptionClassPath = "com/dolby/android/alps/utils/AlpsException$Native$";
-    std::string exceptionClassName;
+    if (error > ALPS_RET_OK && error <= ALPS_RET_E_PRES_ID_NOT_FOUND) {
+        env->ThrowNew(jniCache.nativeExceptionClasses[error], nullptr);
+    }
+}
 
-    switch(error) {
-        case ALPS_RET_E_UNDEFINED:
-            exceptionClassName = "Undefined";
-            break;
-        case ALPS_RET_E_INVALID_ARG:
-            exceptionClassName = "InvalidArg";
-            break;
-        case ALPS_RET_E_BUFF_TOO_SMALL:
-            exceptionClassName = "BuffTooSmall";
-            break;
-        case ALPS_RET_E_PARSE:
-            exceptionClassName = "ParseFailed";
-            break;
-        case ALPS_RET_E_NEXT_SEGMENT:
-            exceptionClassName = "NextSegment";
-            break;
-        case ALPS_RET_E_NO_MOVIE_INFO:
-            exceptionClassName = "NoMovieInfo";
+static jstring nativeInfoGetVersion(JNIEnv *env, jobject thiz) {
+    jstring version = env->NewStringUTF(alps_version());
+    return version;
+}
+
+static jlong alpsCreate(JNIEnv *env, jobject thiz) {
+    alps_ret ret = ALPS_RET_OK;
+    AlpsSession *session = AlpsSession::create(presentationChangedCallback, &ret);
+    if (session == nullptr) {
+        if (ret == ALPS_RET_OK || ret == ALPS_RET_E_UNDEFINED) {
+            throwJniException(env, "Native object creation failed");
+        } else {
+            handleNativeError(env, ret);
+        }
+        return 0;
+    }
+    return (jlong)(uintptr_t)session;
+}
+
+static jlong alpsCreatePooled(JNIEnv *env, jobject thiz) {
+    alps_ret ret = ALPS_RET_OK;
+    AlpsSession *session = contextPool->acquire(&ret);
+    if (session == nullptr) {
+        if (ret == ALPS_RET_OK || ret == ALPS_RET_E_UNDEFINED) {
+            throwJniException(env, "Native object creation failed");
+        } else {
+            handleNativeError(env, ret);
+        }
+        return 0;
+    }
+    return (jlong)(uintptr_t)session;
+}
+
+static void alpsDestroy(JNIEnv *env,
+                        jobject thiz,
+                        jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    if (session == nullptr) {
+        return;
+    }
+
+    {
+        // Dispatcher may still hold a reference to the session, but can't reach the callback.
+        // Delivery that already took the callback may complete after the session is destroyed.
+        std::lock_guard<std::mutex> lock(session->callbackMutex);
+        if (session->callbackRef != nullptr) {
+            env->DeleteGlobalRef((jobject)session->callbackRef);
+            session->callbackRef = nullptr;
+        }
+    }
+    session->release();
+    ALOGI("Alps destroyed");
+}
+
+static bool isValidArrayRange(JNIEnv *env, jbyteArray array, jint offset, jint length) {
+    jsize arrayLength = env->GetArrayLength(array);
+    if (offset < 0 || length < 0 || offset > arrayLength - length) {
+        throwJniException(env, "Array range out of bounds");
+        return false;
+    }
+    return true;
+}
+
+static jint toJavaSize(size_t size) {
+    return size > INT_MAX ? INT_MAX : (jint)size;
+}
+
+// Clears exception thrown by Java code called from native code, which has no Java caller to
+// propagate it to (worker threads) or must not continue with a pending exception
+static void clearJavaException(JNIEnv *env, const char *message) {
+    if (env->ExceptionCheck()) {
+        ALOGE("%s", message);
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+}
+
+static void logProcessingStatus(ProcessingStatus status, alps_ret error) {
+    switch (status) {
+        case ProcessingStatus::PROCESSED:
+            ALOGI("alps_process_isobmff_segment successful");
             break;
-        case ALPS_RET_E_PRES_ID_NOT_FOUND:
-            exceptionClassName = "PresIdNotFound";
+        case ProcessingStatus::FAILED:
+            ALOGE("alps_process_isobmff_segment failed, error: %d", error);
             break;
         default:
-            return;
+            ALOGI("alps_process_isobmff_segment skipped, status: %d", (int)status);
+            break;
     }
+}
 
-    exceptionClassPath += exceptionClassName;
+// Throws and returns nullptr if buffer is not direct or range is out of its bounds
+static uint8_t *getDirectSegment(JNIEnv *env, jobject buffer, jint offset, jint length) {
+    auto bufferPtr = reinterpret_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
+    auto bufferCapacity = env->GetDirectBufferCapacity(buffer);
 
-    jclass exceptionClass = env->FindClass(exceptionClassPath.c_str());
-    if (exceptionClass != nullptr) {
-        env->ThrowNew(exceptionClass, nullptr);
-    } else {
-        throwJniException(env, "AlpsNative returned unknown error");
+    if (bufferPtr == nullptr || bufferCapacity < 0) {
+        throwJniException(env, "Segment buffer is not direct");
+        return nullptr;
     }
+    if (offset < 0 || length < 0 || offset > bufferCapacity - length) {
+        throwJniException(env, "Segment buffer range out of bounds");
+        return nullptr;
+    }
+    return bufferPtr + offset;
 }
 
-extern "C"
-JNIEXPORT jstring JNICALL
-Java_com_dolby_android_alps_alpsnative_AlpsNativeInfo_getVersion(JNIEnv *env, jobject thiz) {
-    jstring version = env->NewStringUTF(alps_version());
-    return version;
+// Throws on error, returns ProcessingStatus as jint
+static jint processDirectSegment(JNIEnv *env,
+                                 AlpsSession *session,
+                                 jobject buffer,
+                                 jint offset,
+                                 jint length) {
+    uint8_t *segmentPtr = getDirectSegment(env, buffer, offset, length);
+    if (segmentPtr == nullptr) {
+        return (jint)ProcessingStatus::FAILED;
+    }
+
+    alps_ret error = ALPS_RET_OK;
+    ContextAccess access(session);
+    ProcessingStatus status = session->process(segmentPtr, (size_t)length, &error);
+    access.unlock();
+    logProcessingStatus(status, error);
+    if (status == ProcessingStatus::FAILED) {
+        handleNativeError(env, error);
+    }
+    return (jint)status;
 }
 
-extern "C"
-JNIEXPORT jlong JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_create(JNIEnv *env, jobject thiz) {
-    void *memory = nullptr;
-    alps_ctx *alps;
-    size_t memorySize;
-    alps_ret ret = alps_query_mem(&memorySize);
-    if (ret == ALPS_RET_OK) {
-        ALOGI("alps_query_mem successful, size: %zu", memorySize);
-        memory = malloc(memorySize);
-        if (memory == nullptr) {
-            ALOGE("Failed to allocate memory");
-            throwJniException(env, "Failed to allocate memory");
+// Bytes of the last array segment processed on the thread, reused so that saving doesn't allocate
+static thread_local SegmentBackup segmentBackup;
+
+// Throws on error, returns ProcessingStatus as jint. Failed segment is left unmodified.
+static jint processArraySegment(JNIEnv *env,
+                                AlpsSession *session,
+                                jbyteArray segment,
+                                jint offset,
+                                jint length) {
+    if (!isValidArrayRange(env, segment, offset, length)) {
+        return (jint)ProcessingStatus::FAILED;
+    }
+
+    // Locked before entering the critical region, so that GC is not blocked while waiting for
+    // processing queue workers
+    ContextAccess access(session);
+    auto *segmentPtr = (uint8_t*)env->GetPrimitiveArrayCritical(segment, nullptr);
+    if (segmentPtr == nullptr) {
+        throwJniException(env, "Failed to access segment data");
+        return (jint)ProcessingStatus::FAILED;
+    }
+
+    alps_ret error = ALPS_RET_OK;
+    segmentBackup.clear();
+    segmentBackup.save(segmentPtr + offset, (size_t)length);
+    ProcessingStatus status = session->process(segmentPtr + offset, (size_t)length, &error);
+    if (status == ProcessingStatus::FAILED) {
+        // Runtime may pin the array instead of copying it, partial changes are undone so that
+        // failed segment is left unmodified
+        segmentBackup.restore(segmentPtr + offset, 0, (size_t)length);
+    }
+    // Only processed segments are copied back
+    bool processed = status == ProcessingStatus::PROCESSED;
+    env->ReleasePrimitiveArrayCritical(segment, segmentPtr, processed ? 0 : JNI_ABORT);
+    access.unlock();
+
+    logProcessingStatus(status, error);
+    if (status == ProcessingStatus::FAILED && !env->ExceptionCheck()) {
+        handleNativeError(env, error);
+    }
+    return (jint)status;
+}
+
+static void alpsProcessIsobmffSegment(JNIEnv *env,
+                                      jobject thiz,
+                                      jlong alpsHandle,
+                                      jobject buffer,
+                                      jint offset,
+                                      jint length) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    processDirectSegment(env, session, buffer, offset, length);
+}
+
+static void alpsProcessIsobmffSegmentArray(JNIEnv *env,
+                                           jobject thiz,
+                                           jlong alpsHandle,
+                                           jbyteArray segment,
+                                           jint offset,
+                                           jint length) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    processArraySegment(env, session, segment, offset, length);
+}
+
+static jint alpsTryProcessIsobmffSegment(JNIEnv *env,
+                                         jobject thiz,
+                                         jlong alpsHandle,
+                                         jobject buffer,
+                                         jint offset,
+                                         jint length) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    return processDirectSegment(env, session, buffer, offset, length);
+}
+
+static jint alpsTryProcessIsobmffSegmentArray(JNIEnv *env,
+                                              jobject thiz,
+                                              jlong alpsHandle,
+                                              jbyteArray segment,
+                                              jint offset,
+                                              jint length) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    return processArraySegment(env, session, segment, offset, length);
+}
+
+// Throws and returns false if the arrays don't describe sliceCount valid slices
+static bool getSliceRanges(JNIEnv *env,
+                           jsize sliceCount,
+                           jintArray offsets,
+                           jintArray lengths,
+                           std::vector<jint> *sliceOffsets,
+                           std::vector<jint> *sliceLengths) {
+    if (env->GetArrayLength(offsets) != sliceCount || env->GetArrayLength(lengths) != sliceCount) {
+        throwJniException(env, "Slice arrays sizes don't match");
+        return false;
+    }
+    sliceOffsets->resize((size_t)sliceCount);
+    sliceLengths->resize((size_t)sliceCount);
+    env->GetIntArrayRegion(offsets, 0, sliceCount, sliceOffsets->data());
+    env->GetIntArrayRegion(lengths, 0, sliceCount, sliceLengths->data());
+    return true;
+}
+
+static void logSlicesProcessingStatus(ProcessingStatus status,
+                                      alps_ret error,
+                                      const SliceProcessingStatistics &stats) {
+    logProcessingStatus(status, error);
+    ALOGI("Segment slices processed, units in place: %llu, staged: %llu, staged bytes: %llu",
+          (unsigned long long)stats.inPlaceUnits, (unsigned long long)stats.stagedUnits,
+          (unsigned long long)stats.stagedBytes);
+}
+
+static jint alpsTryProcessIsobmffSegmentSlices(JNIEnv *env,
+                                               jobject thiz,
+                                               jlong alpsHandle,
+                                               jobjectArray buffers,
+                                               jintArray offsets,
+                                               jintArray lengths) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    jsize sliceCount = env->GetArrayLength(buffers);
+    std::vector<jint> sliceOffsets;
+    std::vector<jint> sliceLengths;
+    if (!getSliceRanges(env, sliceCount, offsets, lengths, &sliceOffsets, &sliceLengths)) {
+        return (jint)ProcessingStatus::FAILED;
+    }
+
+    std::vector<SegmentSlice> slices((size_t)sliceCount);
+    for (jsize i = 0; i < sliceCount; i++) {
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        uint8_t *slicePtr = buffer != nullptr
+                ? getDirectSegment(env, buffer, sliceOffsets[i], sliceLengths[i])
+                : nullptr;
+        env->DeleteLocalRef(buffer);
+        if (slicePtr == nullptr) {
+            if (!env->ExceptionCheck()) {
+                throwJniException(env, "Segment slice is null");
+            }
+            return (jint)ProcessingStatus::FAILED;
         }
+        slices[i] = {slicePtr, (size_t)sliceLengths[i]};
+    }
 
-        ret = alps_init(&alps, memory);
-        if (ret == ALPS_RET_OK) {
-            ALOGI("alps_init successful");
-            return (jlong)(uintptr_t)alps;
-        } else {
-            ALOGE("alps_init failed, error: %d", ret);
-            handleNativeError(env, ret);
+    alps_ret error = ALPS_RET_OK;
+    SliceProcessingStatistics stats = {};
+    ContextAccess access(session);
+    ProcessingStatus status = processSegmentSlices(session, slices.data(), slices.size(), &error,
+                                                   &stats);
+    access.unlock();
+    logSlicesProcessingStatus(status, error, stats);
+    if (status == ProcessingStatus::FAILED) {
+        handleNativeError(env, error);
+    }
+    return (jint)status;
+}
+
+static jint alpsTryProcessIsobmffSegmentArraySlices(JNIEnv *env,
+                                                    jobject thiz,
+                                                    jlong alpsHandle,
+                                                    jobjectArray arrays,
+                                                    jintArray offsets,
+                                                    jintArray lengths) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    jsize sliceCount = env->GetArrayLength(arrays);
+    std::vector<jint> sliceOffsets;
+    std::vector<jint> sliceLengths;
+    if (!getSliceRanges(env, sliceCount, offsets, lengths, &sliceOffsets, &sliceLengths)) {
+        return (jint)ProcessingStatus::FAILED;
+    }
+    // Every slice array is referenced until its critical region is released
+    if (env->PushLocalFrame(sliceCount + 1) != JNI_OK) {
+        return (jint)ProcessingStatus::FAILED;
+    }
+
+    std::vector<jbyteArray> sliceArrays((size_t)sliceCount);
+    for (jsize i = 0; i < sliceCount; i++) {
+        sliceArrays[i] = (jbyteArray)env->GetObjectArrayElement(arrays, i);
+        if (sliceArrays[i] == nullptr) {
+            throwJniException(env, "Segment slice is null");
+        }
+        if (sliceArrays[i] == nullptr ||
+            !isValidArrayRange(env, sliceArrays[i], sliceOffsets[i], sliceLengths[i])) {
+            env->PopLocalFrame(nullptr);
+            return (jint)ProcessingStatus::FAILED;
         }
+    }
+
+    // Same order as processArraySegment: context is locked before entering critical regions
+    ContextAccess access(session);
+    std::vector<SegmentSlice> slices((size_t)sliceCount);
+    std::vector<uint8_t*> arrayPointers((size_t)sliceCount, nullptr);
+    bool accessible = true;
+    for (jsize i = 0; i < sliceCount && accessible; i++) {
+        arrayPointers[i] = (uint8_t*)env->GetPrimitiveArrayCritical(sliceArrays[i], nullptr);
+        accessible = arrayPointers[i] != nullptr;
+        if (accessible) {
+            slices[i] = {arrayPointers[i] + sliceOffsets[i], (size_t)sliceLengths[i]};
+        }
+    }
+
+    alps_ret error = ALPS_RET_OK;
+    SliceProcessingStatistics stats = {};
+    ProcessingStatus status = ProcessingStatus::FAILED;
+    if (accessible) {
+        status = processSegmentSlices(session, slices.data(), slices.size(), &error, &stats);
+    }
+    // Same as processArraySegment: only processed segments are copied back
+    bool processed = status == ProcessingStatus::PROCESSED;
+    for (jsize i = sliceCount; i > 0; i--) {
+        if (arrayPointers[i - 1] != nullptr) {
+            env->ReleasePrimitiveArrayCritical(sliceArrays[i - 1], arrayPointers[i - 1],
+                                               processed ? 0 : JNI_ABORT);
+        }
+    }
+    access.unlock();
+    env->PopLocalFrame(nullptr);
+
+    if (!accessible) {
+        throwJniException(env, "Failed to access segment data");
+        return (jint)ProcessingStatus::FAILED;
+    }
+    logSlicesProcessingStatus(status, error, stats);
+    if (status == ProcessingStatus::FAILED && !env->ExceptionCheck()) {
+        handleNativeError(env, error);
+    }
+    return (jint)status;
+}
+
+// Patch of the last segment processed on the thread, reused so that edits don't allocate
+static thread_local SegmentPatch segmentPatch;
+
+static jobject newSegmentPatch(JNIEnv *env, ProcessingStatus status, const SegmentPatch &patch) {
+    auto editCount = (jsize)patch.editCount();
+    jintArray offsets = env->NewIntArray(editCount);
+    jintArray lengths = env->NewIntArray(editCount);
+    jbyteArray values = env->NewByteArray((jsize)patch.values.size());
+    if (offsets == nullptr || lengths == nullptr || values == nullptr) {
+        return nullptr;
+    }
+    // Offsets and lengths are within a Java array, they fit in jint
+    env->SetIntArrayRegion(offsets, 0, editCount, (const jint*)patch.offsets.data());
+    env->SetIntArrayRegion(lengths, 0, editCount, (const jint*)patch.lengths.data());
+    env->SetByteArrayRegion(values, 0, (jsize)patch.values.size(),
+                            (const jbyte*)patch.values.data());
+    jobject segmentPatch = env->NewObject(jniCache.segmentPatchClass,
+                                          jniCache.segmentPatchConstructor,
+                                          (jint)status, offsets, lengths, values);
+    env->DeleteLocalRef(offsets);
+    env->DeleteLocalRef(lengths);
+    env->DeleteLocalRef(values);
+    return segmentPatch;
+}
+
+static jobject alpsProcessIsobmffSegmentPatch(JNIEnv *env,
+                                              jobject thiz,
+                                              jlong alpsHandle,
+                                              jbyteArray segment,
+                                              jint offset,
+                                              jint length) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    if (!isValidArrayRange(env, segment, offset, length)) {
+        return nullptr;
+    }
+
+    // Same order as processArraySegment: context is locked before entering the critical region
+    ContextAccess access(session);
+    auto *segmentPtr = (uint8_t*)env->GetPrimitiveArrayCritical(segment, nullptr);
+    if (segmentPtr == nullptr) {
+        throwJniException(env, "Failed to access segment data");
+        return nullptr;
+    }
+
+    alps_ret error = ALPS_RET_OK;
+    ProcessingStatus status = processSegmentPatch(session, segmentPtr + offset, (size_t)length,
+                                                  &segmentPatch, &error);
+    // Segment is restored by processing, changes of a copy made by the runtime are discarded too
+    env->ReleasePrimitiveArrayCritical(segment, segmentPtr, JNI_ABORT);
+    access.unlock();
+
+    logProcessingStatus(status, error);
+    if (status == ProcessingStatus::FAILED) {
+        if (!env->ExceptionCheck()) {
+            handleNativeError(env, error);
+        }
+        return nullptr;
+    }
+    ALOGI("Segment patch created, edits: %zu, bytes: %zu", segmentPatch.editCount(),
+          segmentPatch.values.size());
+    return newSegmentPatch(env, status, segmentPatch);
+}
+
+// Exception matching the error, or nullptr if it couldn't be created
+static jthrowable newProcessingException(JNIEnv *env, alps_ret error) {
+    jthrowable exception;
+    if (error > ALPS_RET_OK && error <= ALPS_RET_E_PRES_ID_NOT_FOUND) {
+        exception = (jthrowable)env->NewObject(jniCache.nativeExceptionClasses[error],
+                                               jniCache.nativeExceptionConstructors[error]);
     } else {
-        ALOGE("alps_query_mem failed, error: %d", ret);
-        handleNativeError(env, ret);
+        jstring message = env->NewStringUTF("Segment processing failed");
+        exception = (jthrowable)env->NewObject(jniCache.jniExceptionClass,
+                                               jniCache.jniExceptionConstructor,
+                                               message);
+        env->DeleteLocalRef(message);
     }
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        return nullptr;
+    }
+    return exception;
+}
 
-    return -1;
+// Called by processing queue workers
+static void processQueuedSegment(ProcessingJob *job) {
+    ScopedTrace trace("processQueuedSegment");
+    job->error = ALPS_RET_OK;
+    ContextAccess access(job->session);
+    job->status = job->session->process(job->segment, job->size, &job->error);
+    // Presentations changed callback is delivered before the request is completed, its
+    // exceptions are cleared by deliverPresentationsChanged
+    access.unlock();
+    logProcessingStatus(job->status, job->error);
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_destroy(JNIEnv *env,
-                                                                 jobject thiz,
-                                                                 jlong alpsHandle) {
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
+// Completes the request and deletes its global reference
+static void completeProcessingRequest(JNIEnv *env,
+                                      jobject request,
+                                      ProcessingStatus status,
+                                      jthrowable exception) {
+    env->CallVoidMethod(request, jniCache.processingRequestOnProcessed, (jint)status, exception);
+    clearJavaException(env, "Processing request completion threw an exception");
+    env->DeleteGlobalRef(request);
+}
 
-    auto callback = (jobject)alps_get_presentations_changed_callback_context(alps);
-    if (callback != nullptr) {
-        env->DeleteGlobalRef(callback);
+// Called by processing queue workers
+static void completeQueuedSegment(ProcessingJob *job) {
+    auto request = (jobject)job->completionRef;
+    JNIEnv *env = getJNIEnv();
+    if (env == nullptr) {
+        // Without JNIEnv the request can't be completed nor released on this thread
+        ALOGE("completeQueuedSegment failed. Couldn't get JNIEnv.");
+        std::lock_guard<std::mutex> lock(orphanedRequestsMutex);
+        orphanedRequests.push_back(request);
+        return;
     }
 
-    alps_destroy(alps);
-    if (alps != nullptr) {
-        free(alps);
-        alps = nullptr;
+    jthrowable exception = job->status == ProcessingStatus::FAILED
+            ? newProcessingException(env, job->error)
+            : nullptr;
+    completeProcessingRequest(env, request, job->status, exception);
+    if (exception != nullptr) {
+        env->DeleteLocalRef(exception);
     }
-    ALOGI("Alps destroyed");
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_processIsobmffSegment(JNIEnv *env,
-                                                                               jobject thiz,
-                                                                               jlong alpsHandle,
-                                                                               jobject buffer) {
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
-    auto bufferPtr = reinterpret_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
-    auto bufferSize = (int32_t)env->GetDirectBufferCapacity(buffer);
+// Fails requests orphaned by workers that couldn't attach to the JVM. Called on a Java thread.
+static void failOrphanedRequests(JNIEnv *env) {
+    std::vector<jobject> requests;
+    {
+        std::lock_guard<std::mutex> lock(orphanedRequestsMutex);
+        if (orphanedRequests.empty()) {
+            return;
+        }
+        requests.swap(orphanedRequests);
+    }
+    jstring message = env->NewStringUTF("Processing thread couldn't attach to JVM");
+    auto exception = (jthrowable)env->NewObject(jniCache.jniExceptionClass,
+                                                jniCache.jniExceptionConstructor,
+                                                message);
+    clearJavaException(env, "Failed to create processing request exception");
+    for (jobject request : requests) {
+        completeProcessingRequest(env, request, ProcessingStatus::FAILED, exception);
+    }
+    env->DeleteLocalRef(exception);
+    env->DeleteLocalRef(message);
+}
 
-    alps_ret ret = alps_process_isobmff_segment(alps, bufferPtr, bufferSize);
+static ProcessingQueue *getProcessingQueue(JNIEnv *env) {
+    std::call_once(processingQueueStarted, [] {
+        processingQueue.store(ProcessingQueue::start(processQueuedSegment, completeQueuedSegment));
+    });
+    ProcessingQueue *queue = processingQueue.load();
+    if (queue == nullptr) {
+        throwJniException(env, "Failed to start processing queue");
+    }
+    return queue;
+}
 
-    if (ret == ALPS_RET_OK) {
-        ALOGI("alps_process_isobmff_segment successful");
-    } else {
-        ALOGE("alps_process_isobmff_segment failed, error: %d", ret);
-        handleNativeError(env, ret);
+static void alpsSubmitIsobmffSegment(JNIEnv *env,
+                                     jobject thiz,
+                                     jlong alpsHandle,
+                                     jobject buffer,
+                                     jint offset,
+                                     jint length,
+                                     jobject request) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    failOrphanedRequests(env);
+    uint8_t *segmentPtr = getDirectSegment(env, buffer, offset, length);
+    ProcessingQueue *queue = segmentPtr != nullptr ? getProcessingQueue(env) : nullptr;
+    if (queue == nullptr) {
+        return;
+    }
+
+    // Request keeps the buffer reachable until it's completed
+    jobject requestRef = env->NewGlobalRef(request);
+    if (requestRef == nullptr ||
+        !queue->submit(session, segmentPtr, (size_t)length, requestRef)) {
+        if (requestRef != nullptr) {
+            env->DeleteGlobalRef(requestRef);
+        }
+        throwJniException(env, "Failed to submit segment");
     }
 }
 
-extern "C"
-JNIEXPORT jobject JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_getPresentations(JNIEnv *env,
-                                                                          jobject thiz,
-                                                                          jlong alpsHandle) {
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
+// Presentation getters read the snapshot published by the session, they don't wait for
+// processing running on another thread
+static jobject alpsGetPresentations(JNIEnv *env,
+                                    jobject thiz,
+                                    jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
 
-    alps_presentation *nativePresentationsList = nullptr;
-    size_t presentationsCount;
+    SnapshotPublisher::Reader reader(session->presentationSnapshots);
+    const PresentationSnapshot &snapshot = reader.snapshot();
+    if (snapshot.presentationsStatus == ALPS_RET_OK) {
+        ALOGI("alps_get_presentations successful. Presentations count: %zu",
+              snapshot.presentations.size());
+        jobject presentationsList = env->NewObject(jniCache.arrayListClass,
+                                                   jniCache.arrayListConstructor,
+                                                   toJavaSize(snapshot.presentations.size()));
 
-    alps_ret ret = alps_get_presentations(alps, &nativePresentationsList, &presentationsCount);
-    if (ret == ALPS_RET_OK) {
-        ALOGI("alps_get_presentations successful. Presentations count: %zu", presentationsCount);
-        jclass arrayListClass = env->FindClass("java/util/ArrayList");
-        jmethodID arrayListConstructor = env->GetMethodID(arrayListClass, "<init>", "()V");
-        jobject presentationsList = env->NewObject(arrayListClass, arrayListConstructor);
-
-        jmethodID arrayListAdd = env->GetMethodID(arrayListClass, "add", "(Ljava/lang/Object;)Z");
-
-        jclass presentationClz = env->FindClass("com/dolby/android/alps/models/Presentation");
-        jmethodID presentationMid = env->GetMethodID(
-                presentationClz,
-                "<init>", "(ILjava/lang/String;Ljava/lang/String;)V"
-        );
-        for (int i = 0; i < presentationsCount; i++) {
-            alps_presentation nativePresentation = nativePresentationsList[i];
-            jstring label = env->NewStringUTF(nativePresentation.label);
-            jstring extendedLanguage = env->NewStringUTF(nativePresentation.language);
-            jobject presentation = env->NewObject(presentationClz, presentationMid,
-                                                  nativePresentation.presentation_id,
+        for (const SnapshotPresentation &nativePresentation : snapshot.presentations) {
+            jstring label = env->NewStringUTF(nativePresentation.label.c_str());
+            jstring extendedLanguage = env->NewStringUTF(nativePresentation.language.c_str());
+            jobject presentation = env->NewObject(jniCache.presentationClass,
+                                                  jniCache.presentationConstructor,
+                                                  nativePresentation.presentationId,
                                                   label,
                                                   extendedLanguage);
 
-            env->CallBooleanMethod(presentationsList, arrayListAdd, presentation);
+            env->CallBooleanMethod(presentationsList, jniCache.arrayListAdd, presentation);
             env->DeleteLocalRef(presentation);
+            env->DeleteLocalRef(label);
+            env->DeleteLocalRef(extendedLanguage);
         }
         return presentationsList;
     } else {
-        ALOGE("alps_get_presentations failed, error: %d", ret);
-        handleNativeError(env, ret);
+        ALOGE("alps_get_presentations failed, error: %d", snapshot.presentationsStatus);
+        handleNativeError(env, snapshot.presentationsStatus);
         return nullptr;
     }
 }
 
-extern "C"
-JNIEXPORT jint JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_getActivePresentationId(JNIEnv *env,
-                                                                                 jobject thiz,
-                                                                                 jlong alpsHandle) {
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
-    jint activeIndex;
-
-    alps_ret ret = alps_get_active_presentation_id(alps, &activeIndex);
+static jlong alpsGetPresentationsListGeneration(JNIEnv *env,
+                                            jobject thiz,
+                                            jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    // Generation of the published list, so that it's never ahead of getPresentations
+    SnapshotPublisher::Reader reader(session->presentationSnapshots);
+    return (jlong)reader.snapshot().generation;
+}
+
+static void appendHistogram(std::vector<jlong> *values, const LatencyHistogram &histogram) {
+    uint64_t buckets[LatencyHistogram::BUCKET_COUNT];
+    histogram.snapshot(buckets);
+    values->push_back((jlong)histogram.total());
+    values->insert(values->end(), buckets, buckets + LatencyHistogram::BUCKET_COUNT);
+}
+
+// Layout must match AlpsMetrics.fromNative
+static jlongArray alpsGetMetrics(JNIEnv *env,
+                                 jobject thiz,
+                                 jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    const AlpsSessionCounters &counters = session->counters;
+    std::vector<jlong> values = {
+            (jlong)counters.processCount.load(std::memory_order_relaxed),
+            (jlong)counters.skipCount.load(std::memory_order_relaxed),
+            (jlong)counters.processErrorCount.load(std::memory_order_relaxed),
+            (jlong)counters.processedBytes.load(std::memory_order_relaxed),
+            (jlong)counters.presentationsChangedCount.load(std::memory_order_relaxed),
+            (jlong)session->presentationsListGeneration.load(std::memory_order_relaxed),
+    };
+    for (const auto &errorCount : counters.errorCounts) {
+        values.push_back((jlong)errorCount.load(std::memory_order_relaxed));
+    }
+    appendHistogram(&values, counters.processingTime);
+    appendHistogram(&values, counters.callbackLatency);
+
+    auto count = (jsize)values.size();
+    jlongArray result = env->NewLongArray(count);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, count, values.data());
+    }
+    return result;
+}
+
+static jint alpsGetActivePresentationId(JNIEnv *env,
+                                        jobject thiz,
+                                        jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+
+    SnapshotPublisher::Reader reader(session->presentationSnapshots);
+    alps_ret ret = reader.snapshot().activePresentationStatus;
     if (ret == ALPS_RET_OK) {
         ALOGI("alps_get_active_presentation_id successful");
-        return activeIndex;
+        return reader.snapshot().activePresentationId;
     } else {
         ALOGE("alps_get_active_presentation_id failed, error: %d", ret);
         handleNativeError(env, ret);
@@ -233,13 +788,29 @@ Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_getActivePresentationId
     }
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_setActivePresentationId(JNIEnv *env, jobject thiz,
-                                                                                 jlong alpsHandle,
-                                                                                 jint id) {
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
-    alps_ret ret = alps_set_active_presentation_id(alps, id);
+static bool getStringElement(JNIEnv *env, jobjectArray array, jsize index, std::string *value) {
+    auto element = (jstring)env->GetObjectArrayElement(array, index);
+    if (element == nullptr) {
+        return false;
+    }
+    const char *chars = env->GetStringUTFChars(element, nullptr);
+    if (chars == nullptr) {
+        env->DeleteLocalRef(element);
+        return false;
+    }
+    value->assign(chars);
+    env->ReleaseStringUTFChars(element, chars);
+    env->DeleteLocalRef(element);
+    return true;
+}
+
+static void alpsSetActivePresentationId(JNIEnv *env, jobject thiz,
+                                        jlong alpsHandle,
+                                        jint id) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    ContextAccess access(session);
+    alps_ret ret = session->setActivePresentationId(id);
+    access.unlock();
     if (ret == ALPS_RET_OK) {
         ALOGI("alps_set_active_presentation_id successful");
     } else {
@@ -248,54 +819,733 @@ Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_setActivePresentationId
     }
 }
 
-JNIEnv* getJNIEnv() {
-    JNIEnv* env = nullptr;
-    jint result = globalJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6);
+static void alpsSeedActivePresentationId(JNIEnv *env, jobject thiz,
+                                         jlong alpsHandle,
+                                         jint id) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    ContextAccess access(session);
+    alps_ret ret = session->seedActivePresentationId(id);
+    access.unlock();
+    if (ret != ALPS_RET_OK) {
+        ALOGE("Seeding active presentation ID failed, error: %d", ret);
+        handleNativeError(env, ret);
+    }
+}
 
-    if (result == JNI_OK) {
-        return env;
-    } else if (result == JNI_EDETACHED) {
-        if (globalJavaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
-            return nullptr;
+// Throws and returns false if the arrays don't describe valid preferences
+static bool getSelectionPreferences(JNIEnv *env,
+                                    jintArray criteria,
+                                    jobjectArray values,
+                                    jintArray presentationIds,
+                                    std::vector<SelectionPreference> *preferences) {
+    jsize count = env->GetArrayLength(criteria);
+    if (values == nullptr || presentationIds == nullptr ||
+        env->GetArrayLength(values) != count || env->GetArrayLength(presentationIds) != count) {
+        throwJniException(env, "Selection preference arrays length mismatch");
+        return false;
+    }
+    std::vector<jint> criterionValues((size_t)count);
+    std::vector<jint> ids((size_t)count);
+    env->GetIntArrayRegion(criteria, 0, count, criterionValues.data());
+    env->GetIntArrayRegion(presentationIds, 0, count, ids.data());
+
+    preferences->resize((size_t)count);
+    for (jsize i = 0; i < count; i++) {
+        SelectionPreference &preference = (*preferences)[i];
+        if (criterionValues[i] < (jint)SelectionCriterion::LANGUAGE ||
+            criterionValues[i] > (jint)SelectionCriterion::PRESENTATION_ID) {
+            throwJniException(env, "Unknown selection criterion");
+            return false;
+        }
+        preference.criterion = (SelectionCriterion)criterionValues[i];
+        preference.presentationId = ids[i];
+        if (!getStringElement(env, values, i, &preference.value)) {
+            if (!env->ExceptionCheck()) {
+                throwJniException(env, "Selection preference value is null");
+            }
+            return false;
         }
-        return env;
-    } else {
-        return nullptr;
     }
+    return true;
 }
 
+static void alpsSetSelectionPolicy(JNIEnv *env, jobject thiz,
+                                   jlong alpsHandle,
+                                   jintArray criteria,
+                                   jobjectArray values,
+                                   jintArray presentationIds,
+                                   jint fallbackPresentationId) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    if (criteria == nullptr) {
+        ContextAccess access(session);
+        session->clearSelectionPolicy();
+        return;
+    }
 
-void presentationChangedCallback(void *callbackCtx) {
-    std::lock_guard<std::mutex> lock(mtx);
+    SelectionPolicy policy;
+    policy.fallbackPresentationId = fallbackPresentationId;
+    if (!getSelectionPreferences(env, criteria, values, presentationIds, &policy.preferences)) {
+        return;
+    }
+    ContextAccess access(session);
+    alps_ret ret = session->setSelectionPolicy(policy);
+    access.unlock();
+    if (ret != ALPS_RET_OK) {
+        handleNativeError(env, ret);
+    }
+}
 
-    auto callback = (jobject)callbackCtx;
+static void recordCallbackLatency(AlpsSession *session) {
+    uint64_t changedTimeNs = session->counters.presentationsChangedTimeNs.load(
+            std::memory_order_relaxed);
+    session->counters.callbackLatency.record(monotonicTimeNs() - changedTimeNs);
+}
+
+// Callback is called without holding callbackMutex: it may call into the binding layer, which
+// takes locks held by threads waiting for callbackMutex (e.g. destroying the session). The local
+// reference keeps the callback alive if it's replaced in the meantime.
+static jobject getCallbackLocalRef(JNIEnv *env, AlpsSession *session) {
+    std::lock_guard<std::mutex> lock(session->callbackMutex);
+    auto callbackRef = (jobject)session->callbackRef;
+    return callbackRef != nullptr ? env->NewLocalRef(callbackRef) : nullptr;
+}
+
+static void deliverPresentationsChanged(AlpsSession *session) {
+    ScopedTrace trace("onPresentationsChanged");
     JNIEnv *env = getJNIEnv();
 
     if (env == nullptr) {
         ALOGE("presentationChangedCallback failed. Couldn't get JNIEnv.");
         return;
     }
+    jobject callback = getCallbackLocalRef(env, session);
+    if (callback == nullptr) {
+        return;
+    }
+
+    env->CallVoidMethod(callback, jniCache.onPresentationsChanged);
+    recordCallbackLatency(session);
+    env->DeleteLocalRef(callback);
+    // Callback is delivered on worker threads or before further JNI calls of the caller
+    clearJavaException(env, "Presentations changed callback threw an exception");
+}
 
-    if (callback != nullptr) {
-        jclass clazz = env->GetObjectClass(callback);
-        jmethodID methodId = env->GetMethodID(clazz, "onPresentationsChanged", "()V");
+// Called by the dispatcher thread
+static void deliverPresentationsChangedAsync(AlpsSession *session, uint64_t generation) {
+    ScopedTrace trace("onPresentationsChanged");
+    JNIEnv *env = getJNIEnv();
 
-        env->CallVoidMethod(callback, methodId);
+    if (env == nullptr) {
+        ALOGE("deliverPresentationsChangedAsync failed. Couldn't get JNIEnv.");
+        return;
     }
+    jobject callback = getCallbackLocalRef(env, session);
+    if (callback == nullptr) {
+        return;
+    }
+
+    env->CallVoidMethod(callback, jniCache.onPresentationsChangedGeneration, (jlong)generation);
+    recordCallbackLatency(session);
+    // Dispatcher thread has no Java frame releasing local references
+    env->DeleteLocalRef(callback);
+    // There is no caller to propagate the exception to
+    clearJavaException(env, "Presentations changed callback threw an exception");
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_dolby_android_alps_alpsnative_DefaultAlpsNative_setPresentationsChangedCallback(JNIEnv *env,
-                                                                                         jobject thiz,
-                                                                                         jlong alpsHandle,
-                                                                                         jobject callback) {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto *alps = (alps_ctx*)(uintptr_t)alpsHandle;
-
-    alps_set_presentations_changed_callback(
-            alps,
-            presentationChangedCallback,
-            env->NewGlobalRef(callback)
+static void presentationChangedCallback(void *callbackCtx) {
+    auto *session = (AlpsSession*)callbackCtx;
+    session->counters.presentationsChangedCount.fetch_add(1, std::memory_order_relaxed);
+    session->counters.presentationsChangedTimeNs.store(monotonicTimeNs(),
+                                                       std::memory_order_relaxed);
+    session->presentationsGeneration.fetch_add(1);
+
+    if (postponeCallbacks) {
+        postponedCallbackSession = session;
+    } else if (session->asyncCallbackDispatch.load()) {
+        callbackDispatcher.load()->post(session);
+    } else {
+        deliverPresentationsChanged(session);
+    }
+}
+
+static void alpsSetAsyncPresentationsChangedDispatch(JNIEnv *env,
+                                                     jobject thiz,
+                                                     jlong alpsHandle,
+                                                     jboolean async) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    if (async) {
+        std::call_once(callbackDispatcherStarted, [] {
+            callbackDispatcher.store(CallbackDispatcher::start(deliverPresentationsChangedAsync));
+        });
+        if (callbackDispatcher.load() == nullptr) {
+            throwJniException(env, "Failed to start callback dispatcher");
+            return;
+        }
+    }
+    session->asyncCallbackDispatch.store(async);
+}
+
+static void alpsSetPresentationsChangedCallback(JNIEnv *env,
+                                                jobject thiz,
+                                                jlong alpsHandle,
+                                                jobject callback) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    jobject callbackRef = callback != nullptr ? env->NewGlobalRef(callback) : nullptr;
+
+    std::lock_guard<std::mutex> lock(session->callbackMutex);
+    if (session->callbackRef != nullptr) {
+        env->DeleteGlobalRef((jobject)session->callbackRef);
+    }
+    session->callbackRef = callbackRef;
+}
+
+static jlong alpsCreateSegmentStream(JNIEnv *env,
+                                     jobject thiz,
+                                     jlong alpsHandle) {
+    auto *session = (AlpsSession*)(uintptr_t)alpsHandle;
+    auto *stream = new (std::nothrow) SegmentStream(session);
+    if (stream == nullptr) {
+        ALOGE("Failed to allocate segment stream");
+        throwJniException(env, "Failed to allocate segment stream");
+        return 0;
+    }
+    return (jlong)(uintptr_t)stream;
+}
+
+static void alpsDestroySegmentStream(JNIEnv *env,
+                                     jobject thiz,
+                                     jlong streamHandle) {
+    delete (SegmentStream*)(uintptr_t)streamHandle;
+}
+
+static void alpsResetSegmentStream(JNIEnv *env,
+                                   jobject thiz,
+                                   jlong streamHandle) {
+    auto *stream = (SegmentStream*)(uintptr_t)streamHandle;
+    stream->reset();
+}
+
+static jint alpsFeedSegmentStream(JNIEnv *env,
+                                  jobject thiz,
+                                  jlong streamHandle,
+                                  jbyteArray data,
+                                  jint offset,
+                                  jint length) {
+    auto *stream = (SegmentStream*)(uintptr_t)streamHandle;
+    if (!isValidArrayRange(env, data, offset, length)) {
+        return 0;
+    }
+
+    // Only copy inside the critical region - processing may call back into Java
+    auto *dataPtr = (uint8_t*)env->GetPrimitiveArrayCritical(data, nullptr);
+    if (dataPtr == nullptr) {
+        throwJniException(env, "Failed to access segment data");
+        return 0;
+    }
+    bool appended = stream->append(dataPtr + offset, (size_t)length);
+    env->ReleasePrimitiveArrayCritical(data, dataPtr, JNI_ABORT);
+    if (!appended) {
+        throwJniException(env, "Segment stream already finished");
+        return 0;
+    }
+
+    ContextAccess access(stream->owner());
+    alps_ret ret = stream->processCompleteChunks();
+    access.unlock();
+    if (ret != ALPS_RET_OK) {
+        handleNativeError(env, ret);
+    }
+    return toJavaSize(stream->readyBytes());
+}
+
+static jint alpsFinishSegmentStream(JNIEnv *env,
+                                    jobject thiz,
+                                    jlong streamHandle) {
+    auto *stream = (SegmentStream*)(uintptr_t)streamHandle;
+
+    ContextAccess access(stream->owner());
+    alps_ret ret = stream->finish();
+    access.unlock();
+    if (ret != ALPS_RET_OK) {
+        handleNativeError(env, ret);
+    }
+    return toJavaSize(stream->readyBytes());
+}
+
+static jint alpsReadSegmentStream(JNIEnv *env,
+                                  jobject thiz,
+                                  jlong streamHandle,
+                                  jbyteArray buffer,
+                                  jint offset,
+                                  jint length) {
+    auto *stream = (SegmentStream*)(uintptr_t)streamHandle;
+    if (!isValidArrayRange(env, buffer, offset, length) || stream->readyBytes() == 0) {
+        return 0;
+    }
+
+    auto *bufferPtr = (uint8_t*)env->GetPrimitiveArrayCritical(buffer, nullptr);
+    if (bufferPtr == nullptr) {
+        throwJniException(env, "Failed to access output buffer");
+        return 0;
+    }
+    size_t read = stream->read(bufferPtr + offset, (size_t)length);
+    env->ReleasePrimitiveArrayCritical(buffer, bufferPtr, 0);
+    return (jint)read;
+}
+
+static jobject bufferPoolAcquire(JNIEnv *env,
+                                 jobject thiz,
+                                 jint size) {
+    if (size < 0) {
+        throwJniException(env, "Negative buffer size");
+        return nullptr;
+    }
+    void *block = BufferPool::shared().acquire((size_t)size);
+    if (block == nullptr) {
+        throwJniException(env, "Failed to allocate memory");
+        return nullptr;
+    }
+
+    jobject buffer = env->NewDirectByteBuffer(block, size);
+    if (buffer == nullptr) {
+        BufferPool::shared().release(block);
+    }
+    return buffer;
+}
+
+static void bufferPoolRelease(JNIEnv *env,
+                              jobject thiz,
+                              jobject buffer) {
+    if (!BufferPool::shared().release(env->GetDirectBufferAddress(buffer))) {
+        throwJniException(env, "Buffer was not leased from the pool");
+    }
+}
+
+static void bufferPoolTrim(JNIEnv *env, jobject thiz) {
+    BufferPool::shared().trim();
+}
+
+static void bufferPoolSetMaxPooledBytes(JNIEnv *env,
+                                        jobject thiz,
+                                        jlong maxPooledBytes) {
+    BufferPool::shared().setMaxPooledBytes(maxPooledBytes < 0 ? 0 : (size_t)maxPooledBytes);
+}
+
+static jlongArray bufferPoolGetStatistics(JNIEnv *env,
+                                          jobject thiz) {
+    BufferPoolStatistics stats = BufferPool::shared().statistics();
+    jlong values[] = {
+            (jlong)stats.acquireCount,
+            (jlong)stats.reuseCount,
+            (jlong)stats.allocationCount,
+            (jlong)stats.freeCount,
+            (jlong)stats.leasedBytes,
+            (jlong)stats.pooledBytes,
+            (jlong)stats.peakLeasedBytes,
+    };
+    jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
+
+static void traceDisable(JNIEnv *env,
+                         jobject thiz) {
+    setTraceSink(nullptr);
+    FileTraceSink::shared().close();
+}
+
+static jboolean traceEnableSystemTrace(JNIEnv *env,
+                                       jobject thiz) {
+    TraceSink *sink = systemTraceSink();
+    if (sink == nullptr) {
+        return JNI_FALSE;
+    }
+    setTraceSink(sink);
+    FileTraceSink::shared().close();
+    return JNI_TRUE;
+}
+
+static jboolean traceEnableFileTrace(JNIEnv *env,
+                                     jobject thiz,
+                                     jstring path) {
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    if (pathChars == nullptr) {
+        return JNI_FALSE;
+    }
+    bool opened = FileTraceSink::shared().open(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+
+    setTraceSink(opened ? &FileTraceSink::shared() : nullptr);
+    return opened ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean traceStartCallRecording(JNIEnv *env,
+                                        jobject thiz,
+                                        jstring path,
+                                        jboolean recordPayloads) {
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    if (pathChars == nullptr) {
+        return JNI_FALSE;
+    }
+    bool started = CallRecorder::shared().start(pathChars, recordPayloads == JNI_TRUE);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return started ? JNI_TRUE : JNI_FALSE;
+}
+
+static void traceStopCallRecording(JNIEnv *env,
+                                   jobject thiz) {
+    CallRecorder::shared().stop();
+}
+
+// Called on the logger thread
+static void forwardLogToJava(int level, const char *tag, const char *message) {
+    JNIEnv *env = getJNIEnv();
+    if (env == nullptr) {
+        return;
+    }
+    // Logger truncates long messages at a UTF-8 sequence boundary
+    jstring javaMessage = env->NewStringUTF(message);
+    if (javaMessage != nullptr) {
+        env->CallStaticVoidMethod(jniCache.nativeLoggerClass, jniCache.nativeLoggerLog,
+                                  (jint)level, javaMessage);
+        env->DeleteLocalRef(javaMessage);
+    }
+    if (env->ExceptionCheck()) {
+        // Logging must not fail, e.g. because of the application logger
+        env->ExceptionClear();
+    }
+}
+
+static void nativeLoggerSetLevel(JNIEnv *env,
+                                 jobject thiz,
+                                 jint level) {
+    setNativeLogLevel(level);
+}
+
+static void nativeLoggerFlush(JNIEnv *env,
+                              jobject thiz) {
+    NativeLogger::shared().flush();
+}
+
+static jlong nativeLoggerGetDroppedCount(JNIEnv *env,
+                                         jobject thiz) {
+    return (jlong)NativeLogger::shared().droppedCount();
+}
+
+static void processingQueueWaitForCapacity(JNIEnv *env,
+                                           jobject thiz,
+                                           jint size) {
+    ProcessingQueue *queue = getProcessingQueue(env);
+    if (queue != nullptr) {
+        queue->waitForCapacity(size < 0 ? 0 : (size_t)size);
+    }
+}
+
+static void processingQueueSetLimits(JNIEnv *env,
+                                     jobject thiz,
+                                     jint maxQueuedSegments,
+                                     jlong maxQueuedBytes) {
+    ProcessingQueue *queue = getProcessingQueue(env);
+    if (queue != nullptr) {
+        queue->setLimits(maxQueuedSegments < 0 ? 0 : (size_t)maxQueuedSegments,
+                         maxQueuedBytes < 0 ? 0 : (size_t)maxQueuedBytes);
+    }
+}
+
+static jlongArray processingQueueGetStatistics(JNIEnv *env,
+                                               jobject thiz) {
+    ProcessingQueue *queue = getProcessingQueue(env);
+    if (queue == nullptr) {
+        return nullptr;
+    }
+    ProcessingQueueStatistics stats = queue->statistics();
+    jlong values[] = {
+            (jlong)stats.queuedJobs,
+            (jlong)stats.queuedBytes,
+            (jlong)stats.completedJobs,
+            (jlong)stats.capacityWaits,
+    };
+    jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
+
+static jint contextPoolPrewarm(JNIEnv *env,
+                               jobject thiz,
+                               jint count) {
+    return (jint)contextPool->prewarm(count < 0 ? 0 : (size_t)count);
+}
+
+static void contextPoolSetMaxIdleContexts(JNIEnv *env,
+                                          jobject thiz,
+                                          jint maxIdleContexts) {
+    contextPool->setMaxIdleContexts(maxIdleContexts < 0 ? 0 : (size_t)maxIdleContexts);
+}
+
+static void contextPoolTrim(JNIEnv *env, jobject thiz) {
+    contextPool->trim();
+}
+
+static jint contextPoolGetIdleContextCount(JNIEnv *env, jobject thiz) {
+    return (jint)contextPool->idleCount();
+}
+
+static jlongArray batchProcessorProcess(JNIEnv *env,
+                                        jobject thiz,
+                                        jobjectArray inputPaths,
+                                        jobjectArray outputPaths,
+                                        jintArray jobFileCounts,
+                                        jintArray presentationIds,
+                                        jint threadCount) {
+    jsize fileCount = env->GetArrayLength(inputPaths);
+    jsize jobCount = env->GetArrayLength(jobFileCounts);
+    if (env->GetArrayLength(outputPaths) != fileCount ||
+        env->GetArrayLength(presentationIds) != jobCount) {
+        throwJniException(env, "Batch arrays sizes don't match");
+        return nullptr;
+    }
+    std::vector<jint> fileCounts((size_t)jobCount);
+    std::vector<jint> presentations((size_t)jobCount);
+    env->GetIntArrayRegion(jobFileCounts, 0, jobCount, fileCounts.data());
+    env->GetIntArrayRegion(presentationIds, 0, jobCount, presentations.data());
+
+    std::vector<BatchJob> jobs((size_t)jobCount);
+    jsize file = 0;
+    for (jsize job = 0; job < jobCount; job++) {
+        if (fileCounts[job] < 0 || fileCounts[job] > fileCount - file) {
+            throwJniException(env, "Batch job file counts out of bounds");
+            return nullptr;
+        }
+        jobs[job].presentationId = presentations[job];
+        jobs[job].files.resize((size_t)fileCounts[job]);
+        for (BatchFile &batchFile : jobs[job].files) {
+            if (!getStringElement(env, inputPaths, file, &batchFile.inputPath) ||
+                !getStringElement(env, outputPaths, file, &batchFile.outputPath)) {
+                if (!env->ExceptionCheck()) {
+                    throwJniException(env, "Batch file path is null");
+                }
+                return nullptr;
+            }
+            file++;
+        }
+    }
+
+    BatchStatistics stats;
+    BatchProcessor(threadCount < 0 ? 0 : (size_t)threadCount).run(jobs, &stats);
+
+    jlong values[] = {
+            (jlong)stats.fileCount,
+            (jlong)stats.failedFileCount,
+            (jlong)stats.unprocessedFileCount,
+            (jlong)stats.bytes,
+            (jlong)stats.elapsedNs,
+    };
+    jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
+
+static const JNINativeMethod nativeInfoMethods[] = {
+        {"getVersion", "()Ljava/lang/String;", (void*)nativeInfoGetVersion},
+};
+
+static const JNINativeMethod alpsMethods[] = {
+        {"create", "()J", (void*)alpsCreate},
+        {"createPooled", "()J", (void*)alpsCreatePooled},
+        {"destroy", "(J)V", (void*)alpsDestroy},
+        {"setPresentationsChangedCallback",
+         "(JLcom/dolby/android/alps/PresentationsChangedCallback;)V",
+         (void*)alpsSetPresentationsChangedCallback},
+        {"setAsyncPresentationsChangedDispatch", "(JZ)V",
+         (void*)alpsSetAsyncPresentationsChangedDispatch},
+        {"processIsobmffSegment", "(JLjava/nio/ByteBuffer;II)V", (void*)alpsProcessIsobmffSegment},
+        {"processIsobmffSegmentArray", "(J[BII)V", (void*)alpsProcessIsobmffSegmentArray},
+        {"tryProcessIsobmffSegment", "(JLjava/nio/ByteBuffer;II)I",
+                (void*)alpsTryProcessIsobmffSegment},
+        {"tryProcessIsobmffSegmentArray", "(J[BII)I", (void*)alpsTryProcessIsobmffSegmentArray},
+        {"tryProcessIsobmffSegmentSlices", "(J[Ljava/nio/ByteBuffer;[I[I)I",
+                (void*)alpsTryProcessIsobmffSegmentSlices},
+        {"tryProcessIsobmffSegmentArraySlices", "(J[[B[I[I)I",
+                (void*)alpsTryProcessIsobmffSegmentArraySlices},
+        {"processIsobmffSegmentPatch", "(J[BII)Lcom/dolby/android/alps/AlpsSegmentPatch;",
+                (void*)alpsProcessIsobmffSegmentPatch},
+        {"submitIsobmffSegment",
+         "(JLjava/nio/ByteBuffer;IILcom/dolby/android/alps/alpsnative/AlpsNativeProcessingRequest;)V",
+         (void*)alpsSubmitIsobmffSegment},
+        {"getPresentations", "(J)Ljava/util/List;", (void*)alpsGetPresentations},
+        {"getPresentationsListGeneration", "(J)J", (void*)alpsGetPresentationsListGeneration},
+        {"getMetrics", "(J)[J", (void*)alpsGetMetrics},
+        {"getActivePresentationId", "(J)I", (void*)alpsGetActivePresentationId},
+        {"setActivePresentationId", "(JI)V", (void*)alpsSetActivePresentationId},
+        {"seedActivePresentationId", "(JI)V", (void*)alpsSeedActivePresentationId},
+        {"setSelectionPolicy", "(J[I[Ljava/lang/String;[II)V", (void*)alpsSetSelectionPolicy},
+        {"createSegmentStream", "(J)J", (void*)alpsCreateSegmentStream},
+        {"destroySegmentStream", "(J)V", (void*)alpsDestroySegmentStream},
+        {"resetSegmentStream", "(J)V", (void*)alpsResetSegmentStream},
+        {"feedSegmentStream", "(J[BII)I", (void*)alpsFeedSegmentStream},
+        {"finishSegmentStream", "(J)I", (void*)alpsFinishSegmentStream},
+        {"readSegmentStream", "(J[BII)I", (void*)alpsReadSegmentStream},
+};
+
+static const JNINativeMethod bufferPoolMethods[] = {
+        {"acquire", "(I)Ljava/nio/ByteBuffer;", (void*)bufferPoolAcquire},
+        {"release", "(Ljava/nio/ByteBuffer;)V", (void*)bufferPoolRelease},
+        {"trim", "()V", (void*)bufferPoolTrim},
+        {"setMaxPooledBytes", "(J)V", (void*)bufferPoolSetMaxPooledBytes},
+        {"getStatistics", "()[J", (void*)bufferPoolGetStatistics},
+};
+
+static const JNINativeMethod traceMethods[] = {
+        {"disable", "()V", (void*)traceDisable},
+        {"enableSystemTrace", "()Z", (void*)traceEnableSystemTrace},
+        {"enableFileTrace", "(Ljava/lang/String;)Z", (void*)traceEnableFileTrace},
+        {"startCallRecording", "(Ljava/lang/String;Z)Z", (void*)traceStartCallRecording},
+        {"stopCallRecording", "()V", (void*)traceStopCallRecording},
+};
+
+static const JNINativeMethod nativeLoggerMethods[] = {
+        {"setLevel", "(I)V", (void*)nativeLoggerSetLevel},
+        {"flush", "()V", (void*)nativeLoggerFlush},
+        {"getDroppedCount", "()J", (void*)nativeLoggerGetDroppedCount},
+};
+
+static const JNINativeMethod contextPoolMethods[] = {
+        {"prewarm", "(I)I", (void*)contextPoolPrewarm},
+        {"setMaxIdleContexts", "(I)V", (void*)contextPoolSetMaxIdleContexts},
+        {"trim", "()V", (void*)contextPoolTrim},
+        {"getIdleContextCount", "()I", (void*)contextPoolGetIdleContextCount},
+};
+
+static const JNINativeMethod processingQueueMethods[] = {
+        {"waitForCapacity", "(I)V", (void*)processingQueueWaitForCapacity},
+        {"setLimits", "(IJ)V", (void*)processingQueueSetLimits},
+        {"getStatistics", "()[J", (void*)processingQueueGetStatistics},
+};
+
+static const JNINativeMethod batchProcessorMethods[] = {
+        {"process", "([Ljava/lang/String;[Ljava/lang/String;[I[II)[J", (void*)batchProcessorProcess},
+};
+
+#define NATIVE_METHODS_COUNT(methods) ((int)(sizeof(methods) / sizeof((methods)[0])))
+
+static bool initJniCache(JNIEnv *env) {
+    jniCache.arrayListClass = findGlobalClass(env, "java/util/ArrayList");
+    jniCache.presentationClass = findGlobalClass(env, "com/dolby/android/alps/models/Presentation");
+    jniCache.segmentPatchClass = findGlobalClass(env, "com/dolby/android/alps/AlpsSegmentPatch");
+    jniCache.jniExceptionClass = findGlobalClass(env, "com/dolby/android/alps/utils/AlpsException$JNI");
+    jniCache.nativeLoggerClass = findGlobalClass(env,
+                                                 "com/dolby/android/alps/alpsnative/AlpsNativeLogger");
+    jclass callbackClass = env->FindClass("com/dolby/android/alps/PresentationsChangedCallback");
+    jclass processingRequestClass = env->FindClass(
+            "com/dolby/android/alps/alpsnative/AlpsNativeProcessingRequest");
+    if (jniCache.arrayListClass == nullptr || jniCache.presentationClass == nullptr ||
+        jniCache.segmentPatchClass == nullptr || jniCache.jniExceptionClass == nullptr || jniCache.nativeLoggerClass == nullptr ||
+        callbackClass == nullptr || processingRequestClass == nullptr) {
+        return false;
+    }
+
+    jniCache.arrayListConstructor = env->GetMethodID(jniCache.arrayListClass, "<init>", "(I)V");
+    jniCache.arrayListAdd = env->GetMethodID(jniCache.arrayListClass, "add", "(Ljava/lang/Object;)Z");
+    jniCache.presentationConstructor = env->GetMethodID(
+            jniCache.presentationClass,
+            "<init>", "(ILjava/lang/String;Ljava/lang/String;)V"
     );
+    jniCache.segmentPatchConstructor = env->GetMethodID(jniCache.segmentPatchClass,
+                                                        "<init>", "(I[I[I[B)V");
+    jniCache.onPresentationsChanged = env->GetMethodID(callbackClass, "onPresentationsChanged", "()V");
+    jniCache.onPresentationsChangedGeneration = env->GetMethodID(callbackClass,
+                                                                 "onPresentationsChanged", "(J)V");
+    env->DeleteLocalRef(callbackClass);
+    jniCache.processingRequestOnProcessed = env->GetMethodID(processingRequestClass, "onProcessed",
+                                                             "(ILjava/lang/Throwable;)V");
+    env->DeleteLocalRef(processingRequestClass);
+    jniCache.nativeLoggerLog = env->GetStaticMethodID(jniCache.nativeLoggerClass,
+                                                      "log", "(ILjava/lang/String;)V");
+    jniCache.jniExceptionConstructor = env->GetMethodID(jniCache.jniExceptionClass,
+                                                        "<init>", "(Ljava/lang/String;)V");
+    if (jniCache.arrayListConstructor == nullptr || jniCache.arrayListAdd == nullptr ||
+        jniCache.presentationConstructor == nullptr || jniCache.segmentPatchConstructor == nullptr ||
+        jniCache.onPresentationsChanged == nullptr ||
+        jniCache.onPresentationsChangedGeneration == nullptr || jniCache.nativeLoggerLog == nullptr ||
+        jniCache.processingRequestOnProcessed == nullptr ||
+        jniCache.jniExceptionConstructor == nullptr) {
+        return false;
+    }
+
+    static const struct {
+        alps_ret error;
+        const char *className;
+    } nativeExceptions[] = {
+            {ALPS_RET_E_UNDEFINED, "com/dolby/android/alps/utils/AlpsException$Native$Undefined"},
+            {ALPS_RET_E_INVALID_ARG, "com/dolby/android/alps/utils/AlpsException$Native$InvalidArg"},
+            {ALPS_RET_E_BUFF_TOO_SMALL, "com/dolby/android/alps/utils/AlpsException$Native$BuffTooSmall"},
+            {ALPS_RET_E_PARSE, "com/dolby/android/alps/utils/AlpsException$Native$ParseFailed"},
+            {ALPS_RET_E_NEXT_SEGMENT, "com/dolby/android/alps/utils/AlpsException$Native$NextSegment"},
+            {ALPS_RET_E_NO_MOVIE_INFO, "com/dolby/android/alps/utils/AlpsException$Native$NoMovieInfo"},
+            {ALPS_RET_E_PRES_ID_NOT_FOUND, "com/dolby/android/alps/utils/AlpsException$Native$PresIdNotFound"},
+    };
+    for (const auto &nativeException : nativeExceptions) {
+        jclass exceptionClass = findGlobalClass(env, nativeException.className);
+        if (exceptionClass == nullptr) {
+            return false;
+        }
+        jmethodID exceptionConstructor = env->GetMethodID(exceptionClass, "<init>", "()V");
+        if (exceptionConstructor == nullptr) {
+            return false;
+        }
+        jniCache.nativeExceptionClasses[nativeException.error] = exceptionClass;
+        jniCache.nativeExceptionConstructors[nativeException.error] = exceptionConstructor;
+    }
+    return true;
+}
+
+jint JNI_OnLoad(JavaVM* vm, void*) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK || !initJavaVM(vm)) {
+        return JNI_ERR;
+    }
+
+    if (!initJniCache(env)) {
+        ALOGE("Failed to resolve JNI classes and methods");
+        return JNI_ERR;
+    }
+
+    if (!registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeInfo",
+                               nativeInfoMethods, NATIVE_METHODS_COUNT(nativeInfoMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/DefaultAlpsNative",
+                               alpsMethods, NATIVE_METHODS_COUNT(alpsMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeBufferPool",
+                               bufferPoolMethods, NATIVE_METHODS_COUNT(bufferPoolMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeContextPool",
+                               contextPoolMethods, NATIVE_METHODS_COUNT(contextPoolMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeProcessingQueue",
+                               processingQueueMethods, NATIVE_METHODS_COUNT(processingQueueMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeBatchProcessor",
+                               batchProcessorMethods, NATIVE_METHODS_COUNT(batchProcessorMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeTrace",
+                               traceMethods, NATIVE_METHODS_COUNT(traceMethods)) ||
+        !registerNativeMethods(env, "com/dolby/android/alps/alpsnative/AlpsNativeLogger",
+                               nativeLoggerMethods, NATIVE_METHODS_COUNT(nativeLoggerMethods))) {
+        return JNI_ERR;
+    }
+
+    contextPool = new (std::nothrow) ContextPool(presentationChangedCallback);
+    if (contextPool == nullptr) {
+        ALOGE("Failed to allocate context pool");
+        return JNI_ERR;
+    }
+    NativeLogger::shared().setSink(forwardLogToJava);
+    return JNI_VERSION_1_6;
 }
\ No newline at end of file
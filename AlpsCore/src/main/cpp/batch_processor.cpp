@@ -0,0 +1,233 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "batch_processor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "alps_session.h"
+#include "log.h"
+#include "segment_backup.h"
+#include "trace.h"
+
+namespace {
+
+struct MappedFile {
+    int fd = -1;
+    uint8_t *data = nullptr;
+    size_t size = 0;
+    bool inPlace = false;
+};
+
+void unmapFile(MappedFile *file) {
+    if (file->data != nullptr) {
+        munmap(file->data, file->size);
+        file->data = nullptr;
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
+
+bool mapFile(const BatchFile &batchFile, MappedFile *file) {
+    ScopedTrace trace("BatchProcessor::mapFile");
+    file->inPlace = batchFile.inputPath == batchFile.outputPath;
+    file->fd = open(batchFile.inputPath.c_str(), file->inPlace ? O_RDWR : O_RDONLY);
+    if (file->fd < 0) {
+        ALOGE("Failed to open %s: %s", batchFile.inputPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(file->fd, &fileStat) != 0) {
+        ALOGE("Failed to stat %s: %s", batchFile.inputPath.c_str(), strerror(errno));
+        unmapFile(file);
+        return false;
+    }
+    file->size = (size_t)fileStat.st_size;
+    if (file->size == 0) {
+        return true;
+    }
+
+    // Private mapping is copy-on-write: pages not modified by ALPS are never copied
+    void *data = mmap(nullptr, file->size, PROT_READ | PROT_WRITE,
+                      file->inPlace ? MAP_SHARED : MAP_PRIVATE, file->fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map %s: %s", batchFile.inputPath.c_str(), strerror(errno));
+        unmapFile(file);
+        return false;
+    }
+    file->data = (uint8_t*)data;
+    madvise(file->data, file->size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool writeFile(const std::string &path, const uint8_t *data, size_t size) {
+    ScopedTrace trace("BatchProcessor::writeFile");
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ALOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            ALOGE("Failed to write %s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            return false;
+        }
+        written += (size_t)ret;
+    }
+    return close(fd) == 0;
+}
+
+void noPresentationsChangedCallback(void *) {
+}
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct JobStatistics {
+    std::atomic<uint64_t> fileCount{0};
+    std::atomic<uint64_t> failedFileCount{0};
+    std::atomic<uint64_t> unprocessedFileCount{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+void runJob(const BatchJob &job, JobStatistics *statistics) {
+    AlpsSession *session = AlpsSession::create(noPresentationsChangedCallback, nullptr);
+    if (session == nullptr) {
+        statistics->failedFileCount.fetch_add(job.files.size());
+        return;
+    }
+
+    // Bytes of the current file processing may change, written back if it fails
+    SegmentBackup backup;
+    MappedFile next;
+    bool nextMapped = !job.files.empty() && mapFile(job.files[0], &next);
+    for (size_t i = 0; i < job.files.size(); i++) {
+        MappedFile current = next;
+        bool currentMapped = nextMapped;
+        next = MappedFile();
+        nextMapped = false;
+        if (i + 1 < job.files.size()) {
+            nextMapped = mapFile(job.files[i + 1], &next);
+            if (nextMapped && next.data != nullptr) {
+                // Starts asynchronous read-ahead while the current file is processed
+                madvise(next.data, next.size, MADV_WILLNEED);
+            }
+        }
+
+        statistics->fileCount.fetch_add(1, std::memory_order_relaxed);
+        if (!currentMapped) {
+            statistics->failedFileCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const BatchFile &file = job.files[i];
+        if (current.size > 0) {
+            backup.clear();
+            backup.save(current.data, current.size);
+            alps_ret ret = session->processSegment(current.data, current.size);
+            if (ret != ALPS_RET_OK) {
+                ALOGW("Processing %s failed, error: %d. File will be written as is.",
+                      file.inputPath.c_str(), ret);
+                statistics->unprocessedFileCount.fetch_add(1, std::memory_order_relaxed);
+                backup.restore(current.data, 0, current.size);
+            }
+        }
+        if (i == 0) {
+            alps_ret ret = alps_set_active_presentation_id(session->context(), job.presentationId);
+            if (ret != ALPS_RET_OK) {
+                ALOGE("Setting active presentation ID %d failed, error: %d",
+                      job.presentationId, ret);
+            }
+        }
+
+        if (!current.inPlace && !writeFile(file.outputPath, current.data, current.size)) {
+            statistics->failedFileCount.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            statistics->bytes.fetch_add(current.size, std::memory_order_relaxed);
+        }
+        unmapFile(&current);
+    }
+    unmapFile(&next);
+    session->release();
+}
+
+} // namespace
+
+BatchProcessor::BatchProcessor(size_t threadCount) : threadCount(threadCount) {
+    if (this->threadCount == 0) {
+        this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool BatchProcessor::run(const std::vector<BatchJob> &jobs, BatchStatistics *statistics) {
+    uint64_t start = nowNs();
+    JobStatistics jobStatistics;
+    std::atomic<size_t> nextJob{0};
+
+    auto worker = [&jobs, &jobStatistics, &nextJob] {
+        for (size_t job = nextJob.fetch_add(1); job < jobs.size(); job = nextJob.fetch_add(1)) {
+            runJob(jobs[job], &jobStatistics);
+        }
+    };
+
+    size_t workerCount = std::min(threadCount, jobs.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; i++) {
+        workers.emplace_back(worker);
+    }
+    // Calling thread is a worker too
+    worker();
+    for (auto &thread : workers) {
+        thread.join();
+    }
+
+    if (statistics != nullptr) {
+        statistics->fileCount = jobStatistics.fileCount.load();
+        statistics->failedFileCount = jobStatistics.failedFileCount.load();
+        statistics->unprocessedFileCount = jobStatistics.unprocessedFileCount.load();
+        statistics->bytes = jobStatistics.bytes.load();
+        statistics->elapsedNs = nowNs() - start;
+    }
+    return jobStatistics.failedFileCount.load() == 0;
+}
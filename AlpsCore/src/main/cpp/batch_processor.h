@@ -0,0 +1,90 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_BATCH_PROCESSOR_H_
+#define _ALPS_BATCH_PROCESSOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BatchFile {
+    std::string inputPath;
+    // Same as inputPath to process the file in place
+    std::string outputPath;
+};
+
+/**
+ * Files of a single stream (representation), processed in order by a single ALPS context.
+ * First file is expected to be the init segment.
+ */
+struct BatchJob {
+    std::vector<BatchFile> files;
+    // Set after the first file is processed
+    int presentationId;
+};
+
+struct BatchStatistics {
+    uint64_t fileCount;
+    // files that couldn't be read or written
+    uint64_t failedFileCount;
+    // files written as is because ALPS processing failed
+    uint64_t unprocessedFileCount;
+    uint64_t bytes;
+    uint64_t elapsedNs;
+};
+
+/**
+ * Processes files of multiple streams in parallel, one ALPS context per stream.
+ *
+ * Files are memory mapped. Files processed in place are mapped shared and patched directly. Other
+ * files are mapped privately, so only pages modified by ALPS are copied, and written to the output
+ * file from the mapping. Read-ahead of the next file of the stream is requested before the
+ * current one is processed, so reading, processing and writing overlap.
+ *
+ * Files that ALPS failed to process are written unmodified, bytes changed by failed processing are
+ * restored from SegmentBackup.
+ */
+class BatchProcessor {
+public:
+    /**
+     * @param threadCount number of streams processed concurrently, 0 for number of cores
+     */
+    explicit BatchProcessor(size_t threadCount);
+
+    /**
+     * Processes all jobs, blocking until done.
+     *
+     * @return false if any file couldn't be read or written
+     */
+    bool run(const std::vector<BatchJob> &jobs, BatchStatistics *statistics);
+
+private:
+    size_t threadCount;
+};
+
+#endif //_ALPS_BATCH_PROCESSOR_H_
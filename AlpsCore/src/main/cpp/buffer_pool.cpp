@@ -0,0 +1,169 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "buffer_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "log.h"
+
+// Header placed in front of every block, keeps blocks cache line aligned
+static const size_t BLOCK_HEADER_SIZE = 64;
+static const uint32_t OVERSIZED_CLASS = BufferPool::SIZE_CLASS_COUNT;
+
+struct BufferPool::BlockHeader {
+    size_t capacity;
+    uint32_t sizeClass;
+};
+
+static inline void *blockData(void *header) {
+    return (uint8_t*)header + BLOCK_HEADER_SIZE;
+}
+
+BufferPool::BufferPool(size_t maxPooledBytes) : maxPooledBytes(maxPooledBytes) {
+    static_assert(sizeof(BlockHeader) <= BLOCK_HEADER_SIZE, "Block header too big");
+    memset(&stats, 0, sizeof(stats));
+}
+
+BufferPool::~BufferPool() {
+    for (auto &blocks : freeBlocks) {
+        for (auto *header : blocks) {
+            free(header);
+        }
+    }
+}
+
+BufferPool& BufferPool::shared() {
+    static BufferPool pool;
+    return pool;
+}
+
+size_t BufferPool::sizeClassOf(size_t size) {
+    size_t sizeClass = 0;
+    while (sizeClass < SIZE_CLASS_COUNT && sizeClassCapacity(sizeClass) < size) {
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+size_t BufferPool::sizeClassCapacity(size_t sizeClass) {
+    return (size_t)1 << (MIN_SIZE_CLASS_SHIFT + sizeClass);
+}
+
+void *BufferPool::acquire(size_t size, size_t *capacity) {
+    size_t sizeClass = sizeClassOf(size);
+    std::unique_lock<std::mutex> guard(lock);
+    stats.acquireCount++;
+
+    BlockHeader *header = nullptr;
+    if (sizeClass < SIZE_CLASS_COUNT && !freeBlocks[sizeClass].empty()) {
+        header = freeBlocks[sizeClass].back();
+        freeBlocks[sizeClass].pop_back();
+        stats.reuseCount++;
+        stats.pooledBytes -= header->capacity;
+    } else {
+        guard.unlock();
+        size_t blockCapacity = sizeClass < SIZE_CLASS_COUNT ? sizeClassCapacity(sizeClass) : size;
+        void *memory = nullptr;
+        if (blockCapacity > SIZE_MAX - BLOCK_HEADER_SIZE ||
+            posix_memalign(&memory, BLOCK_HEADER_SIZE, BLOCK_HEADER_SIZE + blockCapacity) != 0) {
+            ALOGE("Failed to allocate buffer of size %zu", size);
+            return nullptr;
+        }
+        header = (BlockHeader*)memory;
+        header->capacity = blockCapacity;
+        header->sizeClass = (uint32_t)sizeClass;
+        guard.lock();
+        stats.allocationCount++;
+    }
+
+    leasedBlocks.push_back(blockData(header));
+    stats.leasedBytes += header->capacity;
+    if (stats.leasedBytes > stats.peakLeasedBytes) {
+        stats.peakLeasedBytes = stats.leasedBytes;
+    }
+
+    if (capacity != nullptr) {
+        *capacity = header->capacity;
+    }
+    return blockData(header);
+}
+
+bool BufferPool::release(void *block) {
+    std::lock_guard<std::mutex> guard(lock);
+    // Any address may come from Java (e.g. slice of a leased buffer), it's not dereferenced until
+    // it's found among the leased blocks
+    auto leased = std::find(leasedBlocks.begin(), leasedBlocks.end(), block);
+    if (block == nullptr || leased == leasedBlocks.end()) {
+        ALOGE("Released buffer doesn't belong to the pool or was already released");
+        return false;
+    }
+    *leased = leasedBlocks.back();
+    leasedBlocks.pop_back();
+    auto *header = (BlockHeader*)((uint8_t*)block - BLOCK_HEADER_SIZE);
+    stats.leasedBytes -= header->capacity;
+
+    if (header->sizeClass == OVERSIZED_CLASS ||
+        stats.pooledBytes + header->capacity > maxPooledBytes) {
+        freeBlock(header);
+    } else {
+        freeBlocks[header->sizeClass].push_back(header);
+        stats.pooledBytes += header->capacity;
+    }
+    return true;
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> guard(lock);
+    // Free blocks needed to get back to the high-water mark are kept, biggest blocks go first
+    uint64_t keptBytes = stats.peakLeasedBytes - stats.leasedBytes;
+    for (size_t sizeClass = SIZE_CLASS_COUNT; sizeClass-- > 0;) {
+        auto &blocks = freeBlocks[sizeClass];
+        while (!blocks.empty() && stats.pooledBytes > keptBytes) {
+            stats.pooledBytes -= blocks.back()->capacity;
+            freeBlock(blocks.back());
+            blocks.pop_back();
+        }
+    }
+    stats.peakLeasedBytes = stats.leasedBytes;
+}
+
+void BufferPool::setMaxPooledBytes(size_t maxPooledBytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->maxPooledBytes = maxPooledBytes;
+}
+
+BufferPoolStatistics BufferPool::statistics() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+void BufferPool::freeBlock(BlockHeader *header) {
+    free(header);
+    stats.freeCount++;
+}
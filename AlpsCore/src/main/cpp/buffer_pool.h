@@ -0,0 +1,120 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_BUFFER_POOL_H_
+#define _ALPS_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+struct BufferPoolStatistics {
+    // number of acquire calls
+    uint64_t acquireCount;
+    // number of acquire calls served with a pooled block
+    uint64_t reuseCount;
+    // number of blocks allocated from the system
+    uint64_t allocationCount;
+    // number of blocks returned to the system
+    uint64_t freeCount;
+    // bytes currently leased
+    uint64_t leasedBytes;
+    // bytes kept in the pool, ready for reuse
+    uint64_t pooledBytes;
+    // highest leasedBytes value since the last trim
+    uint64_t peakLeasedBytes;
+};
+
+/**
+ * Size-classed pool of memory blocks used for segment I/O.
+ *
+ * Requested sizes are rounded up to power of two size classes (4 KiB - 64 MiB), released blocks
+ * are kept for reuse, so in steady state acquiring a block doesn't allocate. Blocks larger than
+ * the biggest size class are allocated and freed directly.
+ *
+ * Pool never keeps more than maxPooledBytes of free blocks. [trim] additionally returns to the
+ * system all free blocks that were not needed to serve the leased bytes high-water mark since the
+ * previous trim.
+ */
+class BufferPool {
+public:
+    static const size_t MIN_SIZE_CLASS_SHIFT = 12;
+    static const size_t SIZE_CLASS_COUNT = 15;
+    static const size_t DEFAULT_MAX_POOLED_BYTES = 64 * 1024 * 1024;
+
+    explicit BufferPool(size_t maxPooledBytes = DEFAULT_MAX_POOLED_BYTES);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * Process wide pool instance.
+     */
+    static BufferPool& shared();
+
+    /**
+     * Leases block of at least size bytes.
+     *
+     * @param[out] capacity usable size of the block, may be null
+     * @return block or nullptr if allocation failed
+     */
+    void *acquire(size_t size, size_t *capacity = nullptr);
+
+    /**
+     * Returns leased block to the pool.
+     *
+     * @return false if block was not leased from this pool or was already released
+     */
+    bool release(void *block);
+
+    /**
+     * Frees pooled blocks exceeding the leased bytes high-water mark and resets the mark.
+     */
+    void trim();
+
+    void setMaxPooledBytes(size_t maxPooledBytes);
+
+    BufferPoolStatistics statistics();
+
+private:
+    struct BlockHeader;
+
+    static size_t sizeClassOf(size_t size);
+    static size_t sizeClassCapacity(size_t sizeClass);
+    void freeBlock(BlockHeader *header);
+
+    std::mutex lock;
+    std::vector<BlockHeader*> freeBlocks[SIZE_CLASS_COUNT];
+    // Data of blocks currently leased, only few blocks are leased at a time, so it's searched
+    // linearly and doesn't allocate in steady state
+    std::vector<void*> leasedBlocks;
+    size_t maxPooledBytes;
+    BufferPoolStatistics stats;
+};
+
+#endif //_ALPS_BUFFER_POOL_H_
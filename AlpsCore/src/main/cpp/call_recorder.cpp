@@ -0,0 +1,285 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "call_recorder.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "metrics.h"
+
+static const char RECORDING_MAGIC[4] = {'A', 'L', 'P', 'R'};
+static const uint32_t RECORDING_VERSION = 1;
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+static std::atomic<CallRecorder*> activeRecorder{nullptr};
+
+// Offset of the time field, it's filled in when the record is written
+static const size_t RECORD_TIME_OFFSET = 5;
+
+static void appendLittleEndian(std::vector<uint8_t> *out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        out->push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void beginRecord(std::vector<uint8_t> *record, CallType type, uint32_t sessionId) {
+    record->push_back((uint8_t)type);
+    appendLittleEndian(record, sessionId, 4);
+    appendLittleEndian(record, 0, 8);
+}
+
+uint64_t recordingHash(const uint8_t *data, size_t size) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+CallRecorder::~CallRecorder() {
+    stop();
+}
+
+bool CallRecorder::start(const char *path, bool payloads) {
+    stop();
+    std::lock_guard<std::mutex> lock(mutex);
+    file = fopen(path, "wb");
+    if (file == nullptr) {
+        ALOGE("Failed to open call recording %s", path);
+        return false;
+    }
+    std::vector<uint8_t> header(RECORDING_MAGIC, RECORDING_MAGIC + sizeof(RECORDING_MAGIC));
+    appendLittleEndian(&header, RECORDING_VERSION, 4);
+    fwrite(header.data(), 1, header.size(), file);
+    recordPayloads.store(payloads, std::memory_order_relaxed);
+    startNs = monotonicTimeNs();
+    activeRecorder.store(this, std::memory_order_release);
+    return true;
+}
+
+void CallRecorder::stop() {
+    CallRecorder *expected = this;
+    activeRecorder.compare_exchange_strong(expected, nullptr);
+    // Calls that loaded the recorder before it was cleared find the file closed
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+CallRecorder *CallRecorder::active() {
+    return activeRecorder.load(std::memory_order_relaxed);
+}
+
+CallRecorder& CallRecorder::shared() {
+    static CallRecorder recorder;
+    return recorder;
+}
+
+const uint8_t *CallRecorder::capturePayload(const uint8_t *segment, size_t size) {
+    if (!recordsPayloads()) {
+        return nullptr;
+    }
+    static thread_local std::vector<uint8_t> payload;
+    payload.assign(segment, segment + size);
+    return payload.data();
+}
+
+void CallRecorder::recordProcess(uint32_t sessionId, uint64_t callStartNs, uint64_t durationNs,
+                                 uint32_t flags, uint8_t status, int32_t ret, uint64_t hash,
+                                 const uint8_t *payload, size_t size) {
+    std::vector<uint8_t> record;
+    record.reserve(48);
+    beginRecord(&record, CallType::PROCESS, sessionId);
+    appendLittleEndian(&record, flags, 4);
+    record.push_back(status);
+    appendLittleEndian(&record, (uint32_t)ret, 4);
+    appendLittleEndian(&record, size, 8);
+    appendLittleEndian(&record, hash, 8);
+    appendLittleEndian(&record, durationNs, 8);
+    record.push_back(payload != nullptr ? 1 : 0);
+    write(&record, callStartNs, payload, payload != nullptr ? size : 0);
+}
+
+void CallRecorder::recordPresentation(uint32_t sessionId, CallType type, int32_t presentationId,
+                                      int32_t ret) {
+    std::vector<uint8_t> record;
+    record.reserve(24);
+    beginRecord(&record, type, sessionId);
+    appendLittleEndian(&record, (uint32_t)presentationId, 4);
+    appendLittleEndian(&record, (uint32_t)ret, 4);
+    write(&record, monotonicTimeNs(), nullptr, 0);
+}
+
+void CallRecorder::recordListChanged(uint32_t sessionId, uint64_t generation) {
+    std::vector<uint8_t> record;
+    record.reserve(24);
+    beginRecord(&record, CallType::LIST_CHANGED, sessionId);
+    appendLittleEndian(&record, generation, 8);
+    write(&record, monotonicTimeNs(), nullptr, 0);
+}
+
+void CallRecorder::recordSessionEnd(uint32_t sessionId) {
+    std::vector<uint8_t> record;
+    record.reserve(16);
+    beginRecord(&record, CallType::SESSION_END, sessionId);
+    write(&record, monotonicTimeNs(), nullptr, 0);
+}
+
+void CallRecorder::write(std::vector<uint8_t> *record, uint64_t callStartNs,
+                         const uint8_t *payload, size_t payloadSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return;
+    }
+    // Calls started before the recording are recorded at its beginning
+    uint64_t timeNs = callStartNs > startNs ? callStartNs - startNs : 0;
+    for (size_t i = 0; i < 8; i++) {
+        (*record)[RECORD_TIME_OFFSET + i] = (uint8_t)(timeNs >> (8 * i));
+    }
+    fwrite(record->data(), 1, record->size(), file);
+    if (payloadSize > 0) {
+        fwrite(payload, 1, payloadSize, file);
+    }
+}
+
+// Sequential little endian reader of a recording file
+class RecordingInput {
+public:
+    explicit RecordingInput(FILE *file) : file(file) {}
+
+    bool read(uint64_t *value, size_t size) {
+        uint8_t bytes[8];
+        if (fread(bytes, 1, size, file) != size) {
+            return false;
+        }
+        *value = 0;
+        for (size_t i = 0; i < size; i++) {
+            *value |= (uint64_t)bytes[i] << (8 * i);
+        }
+        return true;
+    }
+
+    bool read(uint32_t *value) {
+        uint64_t wide;
+        if (!read(&wide, 4)) {
+            return false;
+        }
+        *value = (uint32_t)wide;
+        return true;
+    }
+
+    bool read(int32_t *value) {
+        uint32_t bits;
+        if (!read(&bits)) {
+            return false;
+        }
+        *value = (int32_t)bits;
+        return true;
+    }
+
+    bool read(uint8_t *value) {
+        uint64_t wide;
+        if (!read(&wide, 1)) {
+            return false;
+        }
+        *value = (uint8_t)wide;
+        return true;
+    }
+
+    bool read(uint64_t *value) {
+        return read(value, 8);
+    }
+
+    bool readBytes(std::vector<uint8_t> *bytes, uint64_t size) {
+        bytes->resize(size);
+        return size == 0 || fread(bytes->data(), 1, size, file) == size;
+    }
+
+private:
+    FILE *file;
+};
+
+static bool readRecord(RecordingInput *input, CallRecord *record) {
+    uint8_t type;
+    if (!input->read(&type) || !input->read(&record->sessionId) || !input->read(&record->timeNs)) {
+        return false;
+    }
+    record->type = (CallType)type;
+    switch (record->type) {
+        case CallType::PROCESS: {
+            uint8_t hasPayload;
+            return input->read(&record->flags) && input->read(&record->status) &&
+                   input->read(&record->ret) && input->read(&record->size) &&
+                   input->read(&record->hash) && input->read(&record->durationNs) &&
+                   input->read(&hasPayload) &&
+                   input->readBytes(&record->payload, hasPayload ? record->size : 0);
+        }
+        case CallType::SET_ACTIVE:
+        case CallType::SEED_ACTIVE:
+            return input->read(&record->presentationId) && input->read(&record->ret);
+        case CallType::LIST_CHANGED:
+            return input->read(&record->generation);
+        case CallType::SESSION_END:
+            return true;
+    }
+    ALOGE("Unknown call recording record type %u", type);
+    return false;
+}
+
+bool readCallRecording(const char *path, std::vector<CallRecord> *records) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        ALOGE("Failed to open call recording %s", path);
+        return false;
+    }
+    char magic[sizeof(RECORDING_MAGIC)];
+    uint32_t version = 0;
+    RecordingInput input(file);
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 ||
+        !input.read(&version) || version != RECORDING_VERSION) {
+        ALOGE("%s is not a call recording of version %u", path, RECORDING_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    records->clear();
+    CallRecord record;
+    while (readRecord(&input, &record)) {
+        records->push_back(std::move(record));
+        record = CallRecord();
+    }
+    if (!feof(file)) {
+        ALOGW("Call recording %s has invalid record after %zu records", path, records->size());
+    }
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,167 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_CALL_RECORDER_H_
+#define _ALPS_CALL_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**
+ * Recording of session calls, replayed by host/alps_replay.cpp to reproduce production
+ * workloads.
+ *
+ * File starts with "ALPR" magic and uint32 version, followed by records until the end of file.
+ * Values are little endian. Every record starts with uint8 type, uint32 session ID and uint64
+ * time of the call in ns since the recording started, followed by:
+ * - PROCESS: uint32 scan flags, uint8 ProcessingStatus, int32 alps_ret, uint64 segment size,
+ *   uint64 FNV-1a hash of the segment before processing, uint64 call duration in ns, uint8 1 if
+ *   the segment bytes before processing follow, 0 otherwise
+ * - SET_ACTIVE, SEED_ACTIVE: int32 presentation ID, int32 alps_ret
+ * - LIST_CHANGED: uint64 presentations list generation
+ * - SESSION_END: nothing
+ */
+enum class CallType : uint8_t {
+    // segment passed to the session, including segments skipped by the pre-scan
+    PROCESS = 1,
+    // active presentation set by the binding layer or by the selection policy
+    SET_ACTIVE = 2,
+    // active presentation seeded by the binding layer
+    SEED_ACTIVE = 3,
+    // presentations list content changed
+    LIST_CHANGED = 4,
+    // session released or returned to the context pool
+    SESSION_END = 5,
+};
+
+struct CallRecord {
+    CallType type = CallType::PROCESS;
+    uint32_t sessionId = 0;
+    uint64_t timeNs = 0;
+
+    // PROCESS
+    uint32_t flags = 0;
+    uint8_t status = 0;
+    // PROCESS, SET_ACTIVE, SEED_ACTIVE
+    int32_t ret = 0;
+    uint64_t size = 0;
+    uint64_t hash = 0;
+    uint64_t durationNs = 0;
+    // segment bytes before processing, empty if not recorded
+    std::vector<uint8_t> payload;
+
+    // SET_ACTIVE, SEED_ACTIVE
+    int32_t presentationId = 0;
+
+    // LIST_CHANGED
+    uint64_t generation = 0;
+};
+
+/**
+ * Writes session calls of all sessions to a single recording file. When not recording the cost
+ * of a call site is a single relaxed atomic load, see active().
+ */
+class CallRecorder {
+public:
+    CallRecorder() = default;
+    ~CallRecorder();
+
+    CallRecorder(const CallRecorder&) = delete;
+    CallRecorder& operator=(const CallRecorder&) = delete;
+
+    /**
+     * Starts recording to a new file, stopping the previous recording.
+     *
+     * @param recordPayloads record segment bytes, otherwise only their size and hash are recorded
+     * @return false if file couldn't be created
+     */
+    bool start(const char *path, bool recordPayloads);
+
+    /**
+     * Flushes and closes the recording, following calls are not recorded.
+     */
+    void stop();
+
+    /**
+     * Recorder receiving calls of all sessions, nullptr when not recording.
+     */
+    static CallRecorder *active();
+
+    /**
+     * Process wide instance used by the binding layer.
+     */
+    static CallRecorder& shared();
+
+    bool recordsPayloads() const { return recordPayloads.load(std::memory_order_relaxed); }
+
+    /**
+     * Copies segment bytes before in place processing, if payloads are recorded.
+     *
+     * @return copy owned by the calling thread, valid until the next call, nullptr if payloads
+     * are not recorded
+     */
+    const uint8_t *capturePayload(const uint8_t *segment, size_t size);
+
+    /**
+     * @param startNs monotonicTimeNs at the beginning of the call
+     * @param payload segment bytes before processing, may be nullptr
+     */
+    void recordProcess(uint32_t sessionId, uint64_t startNs, uint64_t durationNs, uint32_t flags,
+                       uint8_t status, int32_t ret, uint64_t hash, const uint8_t *payload,
+                       size_t size);
+    void recordPresentation(uint32_t sessionId, CallType type, int32_t presentationId,
+                            int32_t ret);
+    void recordListChanged(uint32_t sessionId, uint64_t generation);
+    void recordSessionEnd(uint32_t sessionId);
+
+private:
+    void write(std::vector<uint8_t> *record, uint64_t callStartNs, const uint8_t *payload,
+               size_t payloadSize);
+
+    // Guards file and startNs
+    std::mutex mutex;
+    FILE *file = nullptr;
+    uint64_t startNs = 0;
+    std::atomic<bool> recordPayloads{false};
+};
+
+/**
+ * FNV-1a hash of recorded segments.
+ */
+uint64_t recordingHash(const uint8_t *data, size_t size);
+
+/**
+ * Reads all records of a recording. Truncated last record, e.g. of a killed process, is dropped.
+ *
+ * @return false if the file couldn't be read or isn't a recording
+ */
+bool readCallRecording(const char *path, std::vector<CallRecord> *records);
+
+#endif //_ALPS_CALL_RECORDER_H_
@@ -0,0 +1,106 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "callback_dispatcher.h"
+
+#include <new>
+#include <thread>
+
+#include "log.h"
+
+CallbackDispatcher *CallbackDispatcher::start(DeliverFunction deliver) {
+    auto *dispatcher = new (std::nothrow) CallbackDispatcher(deliver);
+    if (dispatcher == nullptr) {
+        ALOGE("Failed to allocate callback dispatcher");
+        return nullptr;
+    }
+    std::thread(&CallbackDispatcher::run, dispatcher).detach();
+    return dispatcher;
+}
+
+CallbackDispatcher::CallbackDispatcher(DeliverFunction deliver) : deliver(deliver) {
+}
+
+void CallbackDispatcher::post(AlpsSession *session) {
+    if (session->callbackQueued.exchange(true)) {
+        // Pending delivery will pick up the latest generation
+        return;
+    }
+    session->retain();
+
+    AlpsSession *first = head.load(std::memory_order_relaxed);
+    do {
+        session->dispatchNext = first;
+    } while (!head.compare_exchange_weak(first, session));
+
+    // Pairs with the queue check in run(): either the dispatcher sees the session or this thread
+    // sees that the dispatcher sleeps
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_one();
+    }
+}
+
+AlpsSession *CallbackDispatcher::takeAll() {
+    AlpsSession *reversed = head.exchange(nullptr);
+    AlpsSession *ordered = nullptr;
+    while (reversed != nullptr) {
+        AlpsSession *next = reversed->dispatchNext;
+        reversed->dispatchNext = ordered;
+        ordered = reversed;
+        reversed = next;
+    }
+    return ordered;
+}
+
+void CallbackDispatcher::run() {
+    ALOGI("Callback dispatcher started");
+    for (;;) {
+        AlpsSession *session = takeAll();
+        if (session == nullptr) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            sleeping.store(true);
+            wakeCondition.wait(lock, [this] { return head.load() != nullptr; });
+            sleeping.store(false);
+            continue;
+        }
+
+        while (session != nullptr) {
+            AlpsSession *next = session->dispatchNext;
+            session->dispatchNext = nullptr;
+            // Changes reported from now on queue another delivery
+            session->callbackQueued.store(false);
+
+            uint64_t generation = session->presentationsGeneration.load();
+            if (generation != session->dispatchedGeneration) {
+                session->dispatchedGeneration = generation;
+                deliver(session, generation);
+            }
+            session->release();
+            session = next;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_CALLBACK_DISPATCHER_H_
+#define _ALPS_CALLBACK_DISPATCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "alps_session.h"
+
+/**
+ * Delivers presentations changed callbacks on a dedicated thread, so that segment processing
+ * doesn't wait for the application's callback.
+ *
+ * Sessions are posted to a lock-free queue. A session that is already queued is not queued again,
+ * so a burst of changes results in a single delivery of the latest presentations generation.
+ */
+class CallbackDispatcher {
+public:
+    typedef void (*DeliverFunction)(AlpsSession *session, uint64_t generation);
+
+    /**
+     * Starts the dispatcher thread. Dispatcher is never destroyed, the thread runs until the
+     * process exits.
+     */
+    static CallbackDispatcher *start(DeliverFunction deliver);
+
+    CallbackDispatcher(const CallbackDispatcher&) = delete;
+    CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+
+    /**
+     * Queues delivery of the session's current presentations generation, unless delivery is
+     * already queued. Lock-free, safe to call from the processing thread.
+     */
+    void post(AlpsSession *session);
+
+private:
+    explicit CallbackDispatcher(DeliverFunction deliver);
+
+    void run();
+    AlpsSession *takeAll();
+
+    DeliverFunction deliver;
+    // LIFO list of queued sessions, reversed by the dispatcher thread to keep posting order
+    std::atomic<AlpsSession*> head{nullptr};
+    std::atomic<bool> sleeping{false};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+};
+
+#endif //_ALPS_CALLBACK_DISPATCHER_H_
@@ -0,0 +1,127 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "context_pool.h"
+
+#include "log.h"
+
+ContextPool::ContextPool(presentations_changed_cb presentationsChangedCallback,
+                         size_t maxIdleContexts)
+    : presentationsChangedCallback(presentationsChangedCallback),
+      maxIdleContexts(maxIdleContexts) {
+}
+
+ContextPool::~ContextPool() {
+    trim();
+}
+
+AlpsSession *ContextPool::acquire(alps_ret *error) {
+    AlpsSession *session = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idleSessions.empty()) {
+            session = idleSessions.back();
+            idleSessions.pop_back();
+        }
+    }
+
+    if (session == nullptr) {
+        ALOGI("Context pool empty, creating new session");
+        session = AlpsSession::create(presentationsChangedCallback, error);
+        if (session == nullptr) {
+            return nullptr;
+        }
+        session->pool = this;
+    }
+    return session;
+}
+
+size_t ContextPool::prewarm(size_t count) {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t target = count < maxIdleContexts ? count : maxIdleContexts;
+            if (idleSessions.size() >= target) {
+                return idleSessions.size();
+            }
+        }
+
+        // Initialization is slow, so it's done without holding the lock
+        AlpsSession *session = AlpsSession::create(presentationsChangedCallback, nullptr);
+        if (session == nullptr) {
+            return idleCount();
+        }
+        session->pool = this;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        idleSessions.push_back(session);
+    }
+}
+
+void ContextPool::setMaxIdleContexts(size_t maxIdleContexts) {
+    std::vector<AlpsSession*> excess;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->maxIdleContexts = maxIdleContexts;
+        while (idleSessions.size() > maxIdleContexts) {
+            excess.push_back(idleSessions.back());
+            idleSessions.pop_back();
+        }
+    }
+    deleteSessions(excess);
+}
+
+void ContextPool::trim() {
+    std::vector<AlpsSession*> sessions;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sessions.swap(idleSessions);
+    }
+    deleteSessions(sessions);
+}
+
+size_t ContextPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return idleSessions.size();
+}
+
+void ContextPool::recycle(AlpsSession *session) {
+    if (session->reinitialize()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idleSessions.size() < maxIdleContexts) {
+            idleSessions.push_back(session);
+            return;
+        }
+    }
+    delete session;
+}
+
+void ContextPool::deleteSessions(std::vector<AlpsSession*> &sessions) {
+    for (AlpsSession *session : sessions) {
+        delete session;
+    }
+    sessions.clear();
+}
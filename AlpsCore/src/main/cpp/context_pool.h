@@ -0,0 +1,98 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_CONTEXT_POOL_H_
+#define _ALPS_CONTEXT_POOL_H_
+
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+#include "alps_session.h"
+
+/**
+ * Pool of initialized ALPS sessions.
+ *
+ * Sessions can be initialized ahead of time with prewarm, so that acquiring one on a period
+ * boundary doesn't allocate nor initialize ALPS context. When the last reference to an acquired
+ * session is dropped, its context is destroyed and initialized again in the same memory block, and
+ * the session is kept for reuse, up to maxIdleContexts sessions.
+ */
+class ContextPool {
+public:
+    static const size_t DEFAULT_MAX_IDLE_CONTEXTS = 2;
+
+    /**
+     * @param presentationsChangedCallback passed to every session created by the pool
+     */
+    explicit ContextPool(presentations_changed_cb presentationsChangedCallback,
+                         size_t maxIdleContexts = DEFAULT_MAX_IDLE_CONTEXTS);
+    ~ContextPool();
+
+    ContextPool(const ContextPool&) = delete;
+    ContextPool& operator=(const ContextPool&) = delete;
+
+    /**
+     * Takes an idle session or creates a new one if pool is empty.
+     *
+     * @param error set to the ALPS error on failure, may be nullptr
+     * @return session with a single reference or nullptr on failure
+     */
+    AlpsSession *acquire(alps_ret *error);
+
+    /**
+     * Creates sessions until at least count sessions are idle. Count is limited to
+     * maxIdleContexts.
+     *
+     * @return number of idle sessions
+     */
+    size_t prewarm(size_t count);
+
+    /**
+     * Sets maximum number of idle sessions, deleting idle sessions above the limit.
+     */
+    void setMaxIdleContexts(size_t maxIdleContexts);
+
+    /**
+     * Deletes all idle sessions.
+     */
+    void trim();
+
+    size_t idleCount() const;
+
+private:
+    friend class AlpsSession;
+
+    void recycle(AlpsSession *session);
+    static void deleteSessions(std::vector<AlpsSession*> &sessions);
+
+    presentations_changed_cb presentationsChangedCallback;
+    mutable std::mutex mutex;
+    std::vector<AlpsSession*> idleSessions;
+    size_t maxIdleContexts;
+};
+
+#endif //_ALPS_CONTEXT_POOL_H_
@@ -0,0 +1,1307 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+/**
+ * alpsbench - host benchmark of the native wrapper against the stub ALPS backend.
+ *
+ * Reports throughput, latency percentiles and heap allocations per operation of the segment copy
+ * paths, presentations marshaling and presentations changed callback dispatch. With --smoke only a
+ * few iterations are run and results are verified, so that it can be used as a test.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alps_session.h"
+#include "buffer_pool.h"
+#include "call_recorder.h"
+#include "callback_dispatcher.h"
+#include "file_origin.h"
+#include "log.h"
+#include "native_logger.h"
+#include "processing_queue.h"
+#include "proxy_server.h"
+#include "segment_backup.h"
+#include "segment_generator.h"
+#include "segment_patch.h"
+#include "segment_slices.h"
+#include "segment_stream.h"
+#include "selection_policy.h"
+#include "trace.h"
+
+static std::atomic<uint64_t> allocationCount{0};
+
+// All replaceable forms are replaced together and kept out of line, so every new pairs with the
+// matching delete and inlined frees aren't matched against operator new
+__attribute__((noinline)) static void *countedAllocate(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) static void countedFree(void *pointer) noexcept {
+    free(pointer);
+}
+
+void *operator new(size_t size) {
+    void *pointer = countedAllocate(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    countedFree(pointer);
+}
+
+namespace {
+
+struct Options {
+    SyntheticStreamConfig stream;
+    size_t iterations = 2000;
+    size_t feedSize = 16 * 1024;
+    bool smoke = false;
+};
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double fraction) {
+    size_t index = (size_t)(fraction * (double)(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void printHeader() {
+    printf("%-28s %10s %10s %10s %10s %10s %12s %10s\n",
+           "benchmark", "ops/s", "MiB/s", "p50 us", "p90 us", "p99 us", "max us", "allocs/op");
+}
+
+/**
+ * Runs operation iterations times after a short warm up and prints statistics.
+ *
+ * @param bytesPerOperation bytes processed by a single operation, 0 if throughput in bytes
+ * doesn't apply
+ */
+void runBenchmark(const char *name, const Options &options, size_t bytesPerOperation,
+                  const std::function<void()> &operation) {
+    size_t warmUp = std::max<size_t>(1, options.iterations / 10);
+    for (size_t i = 0; i < warmUp; i++) {
+        operation();
+    }
+
+    std::vector<uint64_t> latencies(options.iterations);
+    uint64_t allocationsBefore = allocationCount.load();
+    uint64_t start = nowNs();
+    for (size_t i = 0; i < options.iterations; i++) {
+        uint64_t operationStart = nowNs();
+        operation();
+        latencies[i] = nowNs() - operationStart;
+    }
+    uint64_t elapsed = nowNs() - start;
+    // latencies vector is allocated before the measurement, sorting doesn't allocate
+    uint64_t allocations = allocationCount.load() - allocationsBefore;
+    std::sort(latencies.begin(), latencies.end());
+
+    double seconds = (double)elapsed / 1e9;
+    double operationsPerSecond = (double)options.iterations / seconds;
+    double megabytesPerSecond = (double)bytesPerOperation * operationsPerSecond / (1024.0 * 1024.0);
+    printf("%-28s %10.0f %10.1f %10.2f %10.2f %10.2f %12.2f %10.2f\n",
+           name, operationsPerSecond, megabytesPerSecond,
+           (double)percentile(latencies, 0.5) / 1e3,
+           (double)percentile(latencies, 0.9) / 1e3,
+           (double)percentile(latencies, 0.99) / 1e3,
+           (double)latencies.back() / 1e3,
+           (double)allocations / (double)options.iterations);
+}
+
+struct HostPresentation {
+    int id;
+    std::string label;
+    std::string language;
+};
+
+// Host counterpart of the JNI presentations list conversion
+void marshalPresentations(AlpsSession *session, std::vector<HostPresentation> *out) {
+    alps_presentation *presentations = nullptr;
+    size_t count = 0;
+    alps_get_presentations(session->context(), &presentations, &count);
+    out->clear();
+    out->reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        out->push_back({presentations[i].presentation_id,
+                        presentations[i].label,
+                        presentations[i].language});
+    }
+}
+
+std::atomic<uint64_t> deliveredGeneration{0};
+
+void countPresentationsChanged(void *callbackCtx) {
+    auto *session = (AlpsSession*)callbackCtx;
+    session->counters.presentationsChangedCount.fetch_add(1, std::memory_order_relaxed);
+    session->presentationsGeneration.fetch_add(1);
+}
+
+void deliverToBenchmark(AlpsSession *, uint64_t generation) {
+    deliveredGeneration.store(generation, std::memory_order_release);
+}
+
+size_t processChunked(SegmentStream *stream, const std::vector<uint8_t> &segment,
+                      size_t feedSize, std::vector<uint8_t> *out) {
+    stream->reset();
+    size_t written = 0;
+    for (size_t offset = 0; offset < segment.size(); offset += feedSize) {
+        size_t size = std::min(feedSize, segment.size() - offset);
+        stream->feed(segment.data() + offset, size);
+        written += stream->read(out->data() + written, out->size() - written);
+    }
+    stream->finish();
+    written += stream->read(out->data() + written, out->size() - written);
+    return written;
+}
+
+// Completion object of processing queue jobs
+struct HostRequest {
+    int sequence = 0;
+    // sequences of completed requests of the session, in completion order
+    std::vector<int> *completed = nullptr;
+    std::atomic<bool> done{false};
+};
+
+// Host counterpart of the JNI processing queue job
+void processHostJob(ProcessingJob *job) {
+    std::lock_guard<std::mutex> lock(job->session->contextMutex);
+    job->session->processSegment(job->segment, job->size);
+}
+
+void completeHostJob(ProcessingJob *job) {
+    auto *request = (HostRequest*)job->completionRef;
+    if (request->completed != nullptr) {
+        request->completed->push_back(request->sequence);
+    }
+    request->done.store(true, std::memory_order_release);
+}
+
+ProcessingQueue *hostProcessingQueue() {
+    static ProcessingQueue *queue = ProcessingQueue::start(processHostJob, completeHostJob);
+    return queue;
+}
+
+void waitForRequests(const std::vector<HostRequest> &requests) {
+    for (const HostRequest &request : requests) {
+        while (!request.done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+AlpsSession *createActiveSession(const SyntheticStreamConfig &config) {
+    AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+    if (session != nullptr) {
+        std::vector<uint8_t> init = generateInitSegment(config);
+        session->processSegment(init.data(), init.size());
+        alps_set_active_presentation_id(session->context(), 0);
+    }
+    return session;
+}
+
+// Splits segment into slices of sliceSize bytes (the last one may be shorter)
+std::vector<SegmentSlice> sliceSegment(std::vector<uint8_t> *segment, size_t sliceSize) {
+    std::vector<SegmentSlice> slices;
+    for (size_t offset = 0; offset < segment->size(); offset += sliceSize) {
+        slices.push_back({segment->data() + offset, std::min(sliceSize, segment->size() - offset)});
+    }
+    return slices;
+}
+
+// Directory served by FileOrigin: init segment and media segments of a synthetic stream in /audio
+struct SegmentDirectory {
+    SegmentDirectory(const SyntheticStreamConfig &config, size_t segmentCount) {
+        char path[] = "/tmp/alpsbench-origin-XXXXXX";
+        if (mkdtemp(path) == nullptr || mkdir((std::string(path) + "/audio").c_str(), 0755) != 0) {
+            return;
+        }
+        root = path;
+        add("/audio/init.mp4", generateInitSegment(config));
+        for (size_t i = 0; i < segmentCount; i++) {
+            add("/audio/segment-" + std::to_string(i) + ".m4s",
+                generateMediaSegment(config, (uint32_t)i));
+        }
+    }
+
+    ~SegmentDirectory() {
+        for (const std::string &file : files) {
+            unlink((root + file).c_str());
+        }
+        if (!root.empty()) {
+            rmdir((root + "/audio").c_str());
+            rmdir(root.c_str());
+        }
+    }
+
+    void add(const std::string &name, const std::vector<uint8_t> &data) {
+        FILE *file = fopen((root + name).c_str(), "wb");
+        if (file != nullptr) {
+            fwrite(data.data(), 1, data.size(), file);
+            fclose(file);
+            files.push_back(name);
+        }
+    }
+
+    std::string root;
+    std::vector<std::string> files;
+};
+
+// Blocking HTTP/1.1 client keeping a single connection to the proxy alive
+struct ProxyClient {
+    explicit ProxyClient(uint16_t port) {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        if (fd >= 0 && connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    ~ProxyClient() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool sendRequest(const std::string &target) {
+        std::string request = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        return fd >= 0 && send(fd, request.data(), request.size(), MSG_NOSIGNAL) ==
+                          (ssize_t)request.size();
+    }
+
+    /**
+     * @return response status, 0 if the connection failed
+     */
+    int receiveResponse(std::vector<uint8_t> *body) {
+        size_t headerEnd;
+        while ((headerEnd = buffered.find("\r\n\r\n")) == std::string::npos) {
+            if (!receive()) {
+                return 0;
+            }
+        }
+        int status = atoi(buffered.c_str() + 9);
+        std::string header = buffered.substr(0, headerEnd + 2);
+        const char *lengthHeader = strcasestr(header.c_str(), "\r\nContent-Length:");
+        size_t length = lengthHeader == nullptr ? 0 : strtoul(lengthHeader + 17, nullptr, 10);
+        buffered.erase(0, headerEnd + 4);
+        while (buffered.size() < length) {
+            if (!receive()) {
+                return 0;
+            }
+        }
+        body->assign(buffered.begin(), buffered.begin() + (ptrdiff_t)length);
+        buffered.erase(0, length);
+        return status;
+    }
+
+    int get(const std::string &target, std::vector<uint8_t> *body) {
+        return sendRequest(target) ? receiveResponse(body) : 0;
+    }
+
+    bool receive() {
+        char data[16 * 1024];
+        ssize_t count = fd >= 0 ? recv(fd, data, sizeof(data), 0) : -1;
+        if (count <= 0) {
+            return false;
+        }
+        buffered.append(data, (size_t)count);
+        return true;
+    }
+
+    int fd;
+    std::string buffered;
+};
+
+std::string proxyQuery(int presentationId, size_t sessionIndex) {
+    return "?alps_presentation=" + std::to_string(presentationId) + "&alps_session=client-" +
+           std::to_string(sessionIndex);
+}
+
+ProxyConfig hostProxyConfig(uint16_t originPort, size_t threadCount) {
+    ProxyConfig config;
+    config.listenPort = 0;
+    config.upstreamPort = originPort;
+    config.threadCount = threadCount;
+    return config;
+}
+
+bool check(bool condition, const char *message) {
+    if (!condition) {
+        fprintf(stderr, "Smoke check failed: %s\n", message);
+    }
+    return condition;
+}
+
+std::atomic<uint64_t> loggedCount{0};
+std::atomic<uint64_t> suppressionReportCount{0};
+
+void countLogRecord(int, const char *, const char *message) {
+    loggedCount.fetch_add(1);
+    if (strstr(message, "similar messages suppressed") != nullptr) {
+        suppressionReportCount.fetch_add(1);
+    }
+}
+
+std::string lastLogMessage;
+
+void storeLastLogMessage(int, const char *, const char *message) {
+    lastLogMessage = message;
+}
+
+bool checkLogger() {
+    NativeLogger &logger = NativeLogger::shared();
+    logger.flush();
+    logger.setSink(countLogRecord);
+
+    LogRateLimiter limiter;
+    for (uint32_t i = 0; i < NativeLogger::RATE_LIMIT_PER_SECOND * 2; i++) {
+        logger.log(&limiter, ALPS_LOG_LEVEL_VERBOSE, "alpsbench", "Hot path message %u", i);
+    }
+    // Starts a new rate limiting window
+    limiter.windowStartNs.store(0);
+    logger.log(&limiter, ALPS_LOG_LEVEL_VERBOSE, "alpsbench", "Hot path message");
+    logger.flush();
+
+    bool passed = check(loggedCount.load() == NativeLogger::RATE_LIMIT_PER_SECOND + 1,
+                        "repeated messages rate limited");
+    passed &= check(suppressionReportCount.load() == 1, "suppressed messages reported");
+
+    // Two byte sequences, truncation to MESSAGE_SIZE - 1 bytes falls inside one of them
+    std::string accented;
+    while (accented.size() < NativeLogger::MESSAGE_SIZE) {
+        accented += "\xc3\xa9";
+    }
+    logger.setSink(storeLastLogMessage);
+    logger.log(nullptr, ALPS_LOG_LEVEL_WARN, "alpsbench", "%s", accented.c_str());
+    logger.flush();
+    passed &= check(lastLogMessage.size() == NativeLogger::MESSAGE_SIZE - 2 &&
+                    accented.compare(0, lastLogMessage.size(), lastLogMessage) == 0,
+                    "long message truncated at UTF-8 sequence boundary");
+
+    logger.setSink(countLogRecord);
+    loggedCount.store(0);
+    LogRateLimiter errorLimiter;
+    for (uint32_t i = 0; i < NativeLogger::RATE_LIMIT_PER_SECOND * 2; i++) {
+        logger.log(&errorLimiter, ALPS_LOG_LEVEL_ERROR, "alpsbench", "Hot path error %u", i);
+    }
+    logger.flush();
+    logger.setSink(nullptr);
+    passed &= check(loggedCount.load() == NativeLogger::RATE_LIMIT_PER_SECOND * 2,
+                    "errors not rate limited");
+    return passed;
+}
+
+bool checkBufferPool() {
+    BufferPool pool;
+    auto *block = (uint8_t*)pool.acquire(1000);
+    if (!check(block != nullptr, "buffer pool block acquired")) {
+        return false;
+    }
+    bool passed = check(!pool.release(block + 16) && pool.statistics().leasedBytes > 0,
+                        "release of an address inside a block rejected");
+    passed &= check(pool.release(block) && pool.statistics().leasedBytes == 0, "block released");
+    passed &= check(!pool.release(block), "second release rejected");
+    return passed;
+}
+
+// Session with an active presentation, segment fails at its last sample
+bool checkFailedProcessingRestored(AlpsSession *session, const Options &options) {
+    SyntheticStreamConfig config = options.stream;
+    config.chunkCount = 4;
+    std::vector<uint8_t> broken = generateMediaSegment(config, 0);
+    broken[broken.size() - config.sampleSize] ^= 0xFF;
+
+    SegmentBackup backup;
+    backup.save(broken.data(), broken.size());
+    bool passed = check(backup.savedBytes() < broken.size() / 4, "only TOC bytes of samples saved");
+    std::vector<uint8_t> restored = broken;
+    passed &= check(session->process(restored.data(), restored.size(), nullptr) ==
+                    ProcessingStatus::FAILED && restored != broken,
+                    "failed processing changes preceding samples");
+    backup.restore(restored.data(), 0, restored.size());
+    passed &= check(restored == broken, "failed processing undone");
+
+    // Preceding chunks are processed in place or staged and copied back before the failure
+    for (size_t sliceSize : {broken.size(), (size_t)1000}) {
+        std::vector<uint8_t> sliced = broken;
+        std::vector<SegmentSlice> slices = sliceSegment(&sliced, sliceSize);
+        passed &= check(processSegmentSlices(session, slices.data(), slices.size(), nullptr) ==
+                        ProcessingStatus::FAILED && sliced == broken,
+                        "failed sliced segment left unmodified");
+    }
+    return passed;
+}
+
+bool checkFileTrace(AlpsSession *session, std::vector<uint8_t> segment) {
+    char path[] = "/tmp/alpsbench-trace-XXXXXX";
+    int fd = mkstemp(path);
+    if (!check(fd >= 0, "trace file creation")) {
+        return false;
+    }
+    close(fd);
+
+    FileTraceSink sink;
+    bool passed = check(sink.open(path), "trace file opening");
+    setTraceSink(&sink);
+    session->processSegment(segment.data(), segment.size());
+    setTraceSink(nullptr);
+    sink.close();
+
+    std::string trace;
+    FILE *file = fopen(path, "r");
+    if (file != nullptr) {
+        char line[256];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            trace += line;
+        }
+        fclose(file);
+    }
+    unlink(path);
+
+    passed &= check(trace.find("\"name\":\"alps_process_isobmff_segment\",\"ph\":\"B\"") !=
+                    std::string::npos && trace.find("\"ph\":\"E\"") != std::string::npos,
+                    "processing traced to file");
+    return passed;
+}
+
+// Calls of a session are recorded in order, with segments as they were before processing
+bool checkCallRecording(const Options &options) {
+    char path[] = "/tmp/alpsbench-recording-XXXXXX";
+    int fd = mkstemp(path);
+    if (!check(fd >= 0, "recording file creation")) {
+        return false;
+    }
+    close(fd);
+
+    CallRecorder recorder;
+    bool passed = check(recorder.start(path, true), "recording start");
+    AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+    std::vector<uint8_t> init = generateInitSegment(options.stream);
+    const std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    std::vector<uint8_t> work = segment;
+    session->processSegment(init.data(), init.size());
+    session->processSegment(work.data(), work.size());
+    session->setActivePresentationId(2);
+    session->processSegment(work.data(), work.size());
+    session->release();
+    recorder.stop();
+
+    std::vector<CallRecord> records;
+    passed &= check(readCallRecording(path, &records), "recording reading");
+    unlink(path);
+    const CallType expectedTypes[] = {CallType::PROCESS, CallType::LIST_CHANGED,
+                                      CallType::PROCESS, CallType::SET_ACTIVE,
+                                      CallType::PROCESS, CallType::SESSION_END};
+    bool inOrder = records.size() == sizeof(expectedTypes) / sizeof(expectedTypes[0]);
+    for (size_t i = 0; inOrder && i < records.size(); i++) {
+        inOrder = records[i].type == expectedTypes[i] &&
+                  records[i].sessionId == records[0].sessionId &&
+                  (i == 0 || records[i].timeNs >= records[i - 1].timeNs);
+    }
+    if (!check(inOrder, "recorded calls in order")) {
+        return false;
+    }
+    passed &= check(records[0].payload == init &&
+                    records[0].hash == recordingHash(init.data(), init.size()) &&
+                    records[1].generation == 1, "init segment recorded");
+    auto skipped = (uint8_t)ProcessingStatus::SKIPPED_NO_ACTIVE_PRESENTATION;
+    passed &= check(records[2].status == skipped &&
+                    records[3].presentationId == 2 && records[3].ret == ALPS_RET_OK,
+                    "skipped segment and presentation switch recorded");
+    passed &= check(records[4].status == (uint8_t)ProcessingStatus::PROCESSED &&
+                    records[4].payload == segment && records[4].size == segment.size(),
+                    "processed segment recorded before processing");
+    return passed;
+}
+
+// Presentation seeded before the init segment is active for the first media segment
+bool checkSeededPresentation(const Options &options) {
+    const int SEEDED_PRESENTATION_ID = 1;
+    const int STALE_PRESENTATION_ID = 99;
+
+    AlpsSession *seeded = AlpsSession::create(countPresentationsChanged, nullptr);
+    AlpsSession *stale = AlpsSession::create(countPresentationsChanged, nullptr);
+    AlpsSession *reference = createActiveSession(options.stream);
+    if (!check(seeded != nullptr && stale != nullptr && reference != nullptr,
+               "session creation")) {
+        return false;
+    }
+    bool passed = check(seeded->seedActivePresentationId(SEEDED_PRESENTATION_ID) == ALPS_RET_OK &&
+                        seeded->pendingPresentationId == SEEDED_PRESENTATION_ID,
+                        "presentation seeded before init segment");
+    stale->seedActivePresentationId(STALE_PRESENTATION_ID);
+
+    std::vector<uint8_t> init = generateInitSegment(options.stream);
+    seeded->processSegment(init.data(), init.size());
+    stale->processSegment(init.data(), init.size());
+    int activePresentationId = ALPS_INVALID_PRES_ID;
+    alps_get_active_presentation_id(seeded->context(), &activePresentationId);
+    passed &= check(activePresentationId == SEEDED_PRESENTATION_ID &&
+                    seeded->pendingPresentationId == ALPS_INVALID_PRES_ID,
+                    "seeded presentation activated by init segment");
+
+    const std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    std::vector<uint8_t> expected = segment;
+    alps_set_active_presentation_id(reference->context(), SEEDED_PRESENTATION_ID);
+    reference->processSegment(expected.data(), expected.size());
+    std::vector<uint8_t> processed = segment;
+    passed &= check(seeded->process(processed.data(), processed.size(), nullptr) ==
+                    ProcessingStatus::PROCESSED && processed == expected,
+                    "first media segment processed for seeded presentation");
+    std::vector<uint8_t> skipped = segment;
+    passed &= check(stale->pendingPresentationId == ALPS_INVALID_PRES_ID &&
+                    stale->process(skipped.data(), skipped.size(), nullptr) ==
+                    ProcessingStatus::SKIPPED_NO_ACTIVE_PRESENTATION,
+                    "stale seeded presentation dropped");
+
+    seeded->release();
+    stale->release();
+    reference->release();
+    return passed;
+}
+
+int activePresentationId(AlpsSession *session) {
+    int presentationId = ALPS_INVALID_PRES_ID;
+    alps_get_active_presentation_id(session->context(), &presentationId);
+    return presentationId;
+}
+
+// Presentation is selected natively when the list changes, without binding layer calls
+bool checkSelectionPolicy(const Options &options) {
+    SelectionPolicy labelPolicy;
+    labelPolicy.preferences = {
+            {SelectionCriterion::LANGUAGE, "pt", 0},
+            {SelectionCriterion::LABEL, "presentation 2", 0},
+            {SelectionCriterion::LANGUAGE, "de", 0},
+    };
+    SelectionPolicy fallbackPolicy;
+    fallbackPolicy.preferences = {{SelectionCriterion::LANGUAGE, "pt", 0}};
+    fallbackPolicy.fallbackPresentationId = 1;
+
+    AlpsSession *labelSession = AlpsSession::create(countPresentationsChanged, nullptr);
+    AlpsSession *fallbackSession = AlpsSession::create(countPresentationsChanged, nullptr);
+    AlpsSession *activeSession = createActiveSession(options.stream);
+    if (!check(labelSession != nullptr && fallbackSession != nullptr && activeSession != nullptr,
+               "session creation")) {
+        return false;
+    }
+    labelSession->setSelectionPolicy(labelPolicy);
+    fallbackSession->setSelectionPolicy(fallbackPolicy);
+    std::vector<uint8_t> init = generateInitSegment(options.stream);
+    labelSession->processSegment(init.data(), init.size());
+    fallbackSession->processSegment(init.data(), init.size());
+    bool passed = check(activePresentationId(labelSession) == 2,
+                        "first matched preference selects presentation");
+    passed &= check(activePresentationId(fallbackSession) == 1,
+                    "fallback presentation selected when no preference matches");
+
+    SelectionPolicy idPolicy;
+    idPolicy.preferences = {{SelectionCriterion::PRESENTATION_ID, "", 2}};
+    passed &= check(activeSession->setSelectionPolicy(idPolicy) == ALPS_RET_OK &&
+                    activePresentationId(activeSession) == 2,
+                    "policy applied to already listed presentations");
+
+    alps_presentation regional[] = {{7, (char*)"Main", (char*)"en-US"}};
+    SelectionPolicy languagePolicy;
+    languagePolicy.preferences = {{SelectionCriterion::LANGUAGE, "EN", 0}};
+    passed &= check(languagePolicy.select(regional, 1) == 7, "language matched by primary subtag");
+
+    labelSession->release();
+    fallbackSession->release();
+    activeSession->release();
+    return passed;
+}
+
+// Getters read the published snapshot, retired snapshots are kept while a reader holds them
+bool checkPresentationSnapshot(const Options &options) {
+    AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+    if (!check(session != nullptr, "session creation")) {
+        return false;
+    }
+    SnapshotPublisher &snapshots = session->presentationSnapshots;
+    bool passed;
+    {
+        SnapshotPublisher::Reader reader(snapshots);
+        passed = check(reader.snapshot().presentations.empty() && reader.snapshot().generation == 0,
+                       "empty snapshot before init segment");
+        std::vector<uint8_t> init = generateInitSegment(options.stream);
+        session->processSegment(init.data(), init.size());
+        passed &= check(reader.snapshot().presentations.empty() && snapshots.retiredCount() == 1,
+                        "pinned snapshot kept while read");
+    }
+    session->setActivePresentationId(1);
+    passed &= check(snapshots.retiredCount() == 0, "retired snapshots reclaimed without readers");
+
+    // Every publish happens while a reader is active, the next reader starts before it ends
+    SnapshotPublisher overlapped;
+    std::unique_ptr<SnapshotPublisher::Reader> previousReader(
+            new SnapshotPublisher::Reader(overlapped));
+    size_t maxRetired = 0;
+    for (int i = 0; i < 100; i++) {
+        std::unique_ptr<SnapshotPublisher::Reader> reader(
+                new SnapshotPublisher::Reader(overlapped));
+        overlapped.publish(new PresentationSnapshot());
+        previousReader = std::move(reader);
+        maxRetired = std::max(maxRetired, overlapped.retiredCount());
+    }
+    previousReader.reset();
+    passed &= check(maxRetired <= 3, "retired snapshots bounded while readers overlap");
+    {
+        SnapshotPublisher::Reader reader(snapshots);
+        const PresentationSnapshot &snapshot = reader.snapshot();
+        passed &= check(snapshot.presentations.size() == options.stream.presentationCount &&
+                        snapshot.generation == 1 && snapshot.activePresentationId == 1 &&
+                        snapshot.presentations[1].label == "Presentation 1" &&
+                        snapshot.presentations[1].language == "de",
+                        "snapshot published after processing");
+    }
+
+    // Reader never sees a partially built snapshot nor a reclaimed one
+    auto count = (int)options.stream.presentationCount;
+    std::atomic<bool> publishing{true};
+    std::atomic<bool> consistent{true};
+    std::thread reader([&] {
+        while (publishing.load()) {
+            SnapshotPublisher::Reader snapshotReader(snapshots);
+            const PresentationSnapshot &snapshot = snapshotReader.snapshot();
+            if ((int)snapshot.presentations.size() != count ||
+                snapshot.activePresentationId < 0 || snapshot.activePresentationId >= count ||
+                snapshot.presentations[snapshot.activePresentationId].presentationId !=
+                snapshot.activePresentationId) {
+                consistent.store(false);
+            }
+        }
+    });
+    std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    for (int i = 0; i < 2000; i++) {
+        std::lock_guard<std::mutex> lock(session->contextMutex);
+        session->setActivePresentationId(i % count);
+        session->processSegment(segment.data(), segment.size());
+    }
+    publishing.store(false);
+    reader.join();
+    passed &= check(consistent.load(), "snapshot consistent while published concurrently");
+
+    session->release();
+    return passed;
+}
+
+bool checkProcessingQueue(const Options &options) {
+    const size_t SESSION_COUNT = 2;
+    const size_t SEGMENTS_PER_SESSION = 8;
+    const size_t MAX_QUEUED_JOBS = 3;
+
+    ProcessingQueue *queue = hostProcessingQueue();
+    if (!check(queue != nullptr, "processing queue start")) {
+        return false;
+    }
+    queue->setLimits(MAX_QUEUED_JOBS, ProcessingQueue::DEFAULT_MAX_QUEUED_BYTES);
+
+    AlpsSession *sessions[SESSION_COUNT];
+    std::vector<int> completed[SESSION_COUNT];
+    for (auto &session : sessions) {
+        session = createActiveSession(options.stream);
+    }
+    const std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    std::vector<uint8_t> expected = segment;
+    sessions[0]->processSegment(expected.data(), expected.size());
+
+    std::vector<std::vector<uint8_t>> segments(SESSION_COUNT * SEGMENTS_PER_SESSION, segment);
+    std::vector<HostRequest> requests(segments.size());
+    uint64_t maxQueuedJobs = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        size_t sessionIndex = i % SESSION_COUNT;
+        requests[i].sequence = (int)i;
+        requests[i].completed = &completed[sessionIndex];
+        queue->waitForCapacity(segments[i].size());
+        queue->submit(sessions[sessionIndex], segments[i].data(), segments[i].size(), &requests[i]);
+        maxQueuedJobs = std::max(maxQueuedJobs, queue->statistics().queuedJobs);
+    }
+    waitForRequests(requests);
+
+    bool passed = check(maxQueuedJobs <= MAX_QUEUED_JOBS, "queued jobs bounded");
+    for (size_t sessionIndex = 0; sessionIndex < SESSION_COUNT; sessionIndex++) {
+        passed &= check(completed[sessionIndex].size() == SEGMENTS_PER_SESSION &&
+                        std::is_sorted(completed[sessionIndex].begin(),
+                                       completed[sessionIndex].end()),
+                        "queued segments of a session processed in order");
+    }
+    passed &= check(std::all_of(segments.begin(), segments.end(),
+                                [&](const std::vector<uint8_t> &processed) {
+                                    return processed == expected;
+                                }),
+                    "queued processing output");
+
+    queue->setLimits(ProcessingQueue::DEFAULT_MAX_QUEUED_JOBS,
+                     ProcessingQueue::DEFAULT_MAX_QUEUED_BYTES);
+    for (auto &session : sessions) {
+        session->release();
+    }
+    return passed;
+}
+
+// Proxied segments are compared with segments processed directly, for concurrent clients with
+// different presentations
+bool checkProxy(const Options &options) {
+    const size_t CLIENT_COUNT = 16;
+    const size_t SEGMENT_COUNT = 3;
+
+    SyntheticStreamConfig config = options.stream;
+    config.chunkCount = 4;
+    SegmentDirectory directory(config, SEGMENT_COUNT);
+    FileOrigin origin(directory.root);
+    // Bodies arrive in parts smaller than a chunk
+    origin.setWriteSize(1000);
+    if (!check(!directory.root.empty() && origin.start(), "origin start")) {
+        return false;
+    }
+    ProxyServer proxy(hostProxyConfig(origin.port(), 2));
+    if (!check(proxy.start(), "proxy start")) {
+        return false;
+    }
+
+    std::vector<std::vector<std::vector<uint8_t>>> expected(config.presentationCount);
+    for (size_t presentation = 0; presentation < config.presentationCount; presentation++) {
+        AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+        std::vector<uint8_t> init = generateInitSegment(config);
+        session->processSegment(init.data(), init.size());
+        alps_set_active_presentation_id(session->context(), (int)presentation);
+        for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+            std::vector<uint8_t> segment = generateMediaSegment(config, (uint32_t)i);
+            session->processSegment(segment.data(), segment.size());
+            expected[presentation].push_back(segment);
+        }
+        session->release();
+    }
+
+    std::atomic<size_t> matchedClients{0};
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < CLIENT_COUNT; c++) {
+        clients.emplace_back([&, c] {
+            int presentation = (int)(c % config.presentationCount);
+            std::string query = proxyQuery(presentation, c);
+            ProxyClient client(proxy.port());
+            std::vector<uint8_t> body;
+            bool matched = client.get("/audio/init.mp4" + query, &body) == 200;
+            for (size_t i = 0; i < SEGMENT_COUNT; i++) {
+                matched &= client.get("/audio/segment-" + std::to_string(i) + ".m4s" + query,
+                                      &body) == 200 && body == expected[presentation][i];
+            }
+            if (matched) {
+                matchedClients.fetch_add(1);
+            }
+        });
+    }
+    for (std::thread &client : clients) {
+        client.join();
+    }
+    bool passed = check(matchedClients.load() == CLIENT_COUNT,
+                        "proxied segments processed with presentation of the session");
+
+    ProxyClient client(proxy.port());
+    std::vector<uint8_t> body;
+    passed &= check(client.get("/audio/missing.m4s?alps_presentation=0", &body) == 404,
+                    "origin errors forwarded");
+    passed &= check(client.get("/audio/init.mp4", &body) == 200 &&
+                    client.get("/audio/segment-0.m4s", &body) == 200 &&
+                    body == generateMediaSegment(config, 0),
+                    "segments without presentation forwarded unmodified");
+
+    std::vector<std::string> requests = origin.requests();
+    passed &= check(requests.size() == CLIENT_COUNT * (SEGMENT_COUNT + 1) + 3 &&
+                    std::none_of(requests.begin(), requests.end(),
+                                 [](const std::string &target) {
+                                     return target.find("alps_") != std::string::npos;
+                                 }),
+                    "proxy parameters stripped from forwarded requests");
+    ProxyStatistics statistics = proxy.statistics();
+    passed &= check(statistics.acceptedConnections == CLIENT_COUNT + 1,
+                    "client connections kept alive");
+    passed &= check(statistics.openSessions == CLIENT_COUNT + 1 &&
+                    statistics.processedResponses == CLIENT_COUNT * (SEGMENT_COUNT + 1) + 2 &&
+                    statistics.passthroughResponses == 1 && statistics.upstreamErrors == 0,
+                    "proxy statistics");
+    return passed;
+}
+
+// Verifies that all processing paths produce the same, processed, output
+bool runSmokeChecks(const Options &options) {
+    bool passed = true;
+    AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+    if (!check(session != nullptr, "session creation")) {
+        return false;
+    }
+
+    std::vector<uint8_t> init = generateInitSegment(options.stream);
+    passed &= check(session->processSegment(init.data(), init.size()) == ALPS_RET_OK,
+                    "init segment processing");
+    passed &= check(session->counters.presentationsChangedCount.load() == 1,
+                    "presentations changed callback");
+    passed &= check(session->presentationsListGeneration.load() == 1,
+                    "presentations list generation");
+
+    std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    std::vector<uint8_t> skipped = segment;
+    passed &= check(session->process(skipped.data(), skipped.size(), nullptr) ==
+                    ProcessingStatus::SKIPPED_NO_ACTIVE_PRESENTATION && skipped == segment,
+                    "media segment skipped without active presentation");
+    uint8_t notIsobmff[16] = {};
+    passed &= check(session->process(notIsobmff, sizeof(notIsobmff), nullptr) ==
+                    ProcessingStatus::SKIPPED_NO_MOVIE_NOR_FRAGMENT,
+                    "segment without moov nor moof skipped");
+    passed &= check(session->counters.processCount.load() == 1, "skipped segments not processed");
+
+    std::vector<HostPresentation> presentations;
+    marshalPresentations(session, &presentations);
+    passed &= check(presentations.size() == options.stream.presentationCount,
+                    "presentations count");
+    passed &= check(alps_set_active_presentation_id(session->context(), 1) == ALPS_RET_OK,
+                    "set active presentation");
+
+    passed &= check(segment.size() == mediaSegmentSize(options.stream), "media segment size");
+    std::vector<uint8_t> processed = segment;
+    passed &= check(session->processSegment(processed.data(), processed.size()) == ALPS_RET_OK,
+                    "media segment processing");
+    passed &= check(processed != segment, "media segment modified");
+    passed &= check(session->presentationsListGeneration.load() == 1,
+                    "presentations list generation unchanged by media segment");
+
+    SegmentStream stream(session);
+    std::vector<uint8_t> chunked(segment.size());
+    size_t written = processChunked(&stream, segment, options.feedSize, &chunked);
+    passed &= check(written == segment.size() && chunked == processed, "chunked processing output");
+
+    std::vector<uint8_t> sliced = segment;
+    std::vector<SegmentSlice> slices = sliceSegment(&sliced, 1000);
+    SliceProcessingStatistics sliceStats = {};
+    passed &= check(processSegmentSlices(session, slices.data(), slices.size(), nullptr,
+                                         &sliceStats) == ProcessingStatus::PROCESSED &&
+                    sliced == processed, "sliced processing output");
+    passed &= check(sliceStats.stagedBytes < segment.size() * 2 &&
+                    sliceStats.inPlaceUnits + sliceStats.stagedUnits == options.stream.chunkCount,
+                    "sliced processing units");
+    std::vector<uint8_t> whole = segment;
+    SegmentSlice wholeSlice = {whole.data(), whole.size()};
+    sliceStats = {};
+    processSegmentSlices(session, &wholeSlice, 1, nullptr, &sliceStats);
+    passed &= check(sliceStats.stagedUnits == 0 && whole == processed,
+                    "single slice processed in place");
+
+    std::vector<uint8_t> original = segment;
+    SegmentPatch patch;
+    passed &= check(processSegmentPatch(session, original.data(), original.size(), &patch,
+                                        nullptr) == ProcessingStatus::PROCESSED &&
+                    original == segment, "patch processing leaves segment unchanged");
+    // Applied piece by piece, the way data sources copy segment out
+    std::vector<uint8_t> patched = segment;
+    for (size_t position = 0; position < patched.size(); position += 1000) {
+        patch.apply(patched.data() + position, position,
+                    std::min<size_t>(1000, patched.size() - position));
+    }
+    passed &= check(patched == processed && patch.values.size() < segment.size() / 10,
+                    "patched segment matches processed output");
+    alps_set_active_presentation_id(session->context(), ALPS_INVALID_PRES_ID);
+    passed &= check(processSegmentPatch(session, original.data(), original.size(), &patch,
+                                        nullptr) ==
+                    ProcessingStatus::SKIPPED_NO_ACTIVE_PRESENTATION && patch.editCount() == 0,
+                    "skipped segment has empty patch");
+    alps_set_active_presentation_id(session->context(), 1);
+
+    // Boxes trailing a fully read segment are returned as they are, without passing them to ALPS
+    stream.reset();
+    stream.feed(segment.data(), segment.size());
+    written = stream.read(chunked.data(), chunked.size());
+    const uint8_t trailing[] = {0, 0, 0, 12, 'f', 'r', 'e', 'e', 1, 2, 3, 4};
+    uint64_t processCount = session->counters.processCount.load() +
+                            session->counters.skipCount.load();
+    stream.feed(trailing, sizeof(trailing));
+    uint8_t trailingRead[sizeof(trailing)] = {};
+    bool trailingProcessed = stream.finish() != ALPS_RET_OK ||
+                             session->counters.processCount.load() +
+                             session->counters.skipCount.load() != processCount;
+    passed &= check(written == segment.size() && !trailingProcessed &&
+                    stream.read(trailingRead, sizeof(trailingRead)) == sizeof(trailing) &&
+                    memcmp(trailingRead, trailing, sizeof(trailing)) == 0,
+                    "boxes trailing drained chunks not processed");
+
+    uint64_t buckets[LatencyHistogram::BUCKET_COUNT];
+    session->counters.processingTime.snapshot(buckets);
+    uint64_t recorded = 0;
+    for (uint64_t bucket : buckets) {
+        recorded += bucket;
+    }
+    passed &= check(recorded == session->counters.processCount.load(),
+                    "processing time recorded for every processing call");
+
+    passed &= checkFailedProcessingRestored(session, options);
+    passed &= checkBufferPool();
+    passed &= checkFileTrace(session, segment);
+    passed &= checkLogger();
+    passed &= checkSeededPresentation(options);
+    passed &= checkSelectionPolicy(options);
+    passed &= checkPresentationSnapshot(options);
+    passed &= checkCallRecording(options);
+    passed &= checkProcessingQueue(options);
+    passed &= checkProxy(options);
+
+    session->release();
+    return passed;
+}
+
+// Fetches through the proxy, timings include the thread per connection origin stand-in
+void runProxyBenchmarks(const Options &options, size_t segmentSize) {
+    const size_t CONNECTION_COUNT = 256;
+
+    SegmentDirectory directory(options.stream, 1);
+    FileOrigin origin(directory.root);
+    if (directory.root.empty() || !origin.start()) {
+        fprintf(stderr, "Failed to start origin\n");
+        return;
+    }
+    // Single event loop thread, so that results are per core
+    ProxyServer proxy(hostProxyConfig(origin.port(), 1));
+    if (!proxy.start()) {
+        fprintf(stderr, "Failed to start proxy\n");
+        return;
+    }
+
+    std::vector<std::unique_ptr<ProxyClient>> clients;
+    std::vector<uint8_t> body;
+    for (size_t i = 0; i < CONNECTION_COUNT; i++) {
+        clients.emplace_back(new ProxyClient(proxy.port()));
+        clients.back()->get("/audio/init.mp4" + proxyQuery(0, i), &body);
+    }
+    std::vector<std::string> targets;
+    for (size_t i = 0; i < CONNECTION_COUNT; i++) {
+        targets.push_back("/audio/segment-0.m4s" + proxyQuery(0, i));
+    }
+
+    runBenchmark("proxy keep-alive fetch", options, segmentSize, [&] {
+        clients[0]->get(targets[0], &body);
+    });
+
+    Options concurrentOptions = options;
+    concurrentOptions.iterations = std::max<size_t>(1, options.iterations / 50);
+    runBenchmark("proxy, 256 connections", concurrentOptions, segmentSize * CONNECTION_COUNT, [&] {
+        // All requests are in flight before the first response is read
+        for (size_t i = 0; i < CONNECTION_COUNT; i++) {
+            clients[i]->sendRequest(targets[i]);
+        }
+        for (size_t i = 0; i < CONNECTION_COUNT; i++) {
+            clients[i]->receiveResponse(&body);
+        }
+    });
+}
+
+void runBenchmarks(const Options &options) {
+    AlpsSession *session = AlpsSession::create(countPresentationsChanged, nullptr);
+    if (session == nullptr) {
+        fprintf(stderr, "Failed to create session\n");
+        exit(EXIT_FAILURE);
+    }
+    std::vector<uint8_t> init = generateInitSegment(options.stream);
+    session->processSegment(init.data(), init.size());
+    alps_set_active_presentation_id(session->context(), 0);
+
+    const std::vector<uint8_t> segment = generateMediaSegment(options.stream, 0);
+    std::vector<uint8_t> work(segment);
+
+    printf("Segment: %zu bytes, %zu chunks x %zu samples x %zu bytes, %zu presentations\n",
+           segment.size(), options.stream.chunkCount, options.stream.samplesPerChunk,
+           options.stream.sampleSize, options.stream.presentationCount);
+    printHeader();
+
+    runBenchmark("process in place", options, segment.size(), [&] {
+        session->processSegment(work.data(), work.size());
+    });
+
+    runBenchmark("pre-scan skip", options, segment.size(), [&] {
+        alps_set_active_presentation_id(session->context(), ALPS_INVALID_PRES_ID);
+        session->processSegment(work.data(), work.size());
+        alps_set_active_presentation_id(session->context(), 0);
+    });
+
+    FileTraceSink::shared().open("/dev/null");
+    setTraceSink(&FileTraceSink::shared());
+    runBenchmark("process in place, file trace", options, segment.size(), [&] {
+        session->processSegment(work.data(), work.size());
+    });
+    setTraceSink(nullptr);
+    FileTraceSink::shared().close();
+
+    runBenchmark("copy + process", options, segment.size(), [&] {
+        memcpy(work.data(), segment.data(), segment.size());
+        session->processSegment(work.data(), work.size());
+    });
+
+    runBenchmark("copy in + process + copy out", options, segment.size(), [&] {
+        // Path of the former JNI array implementation: array -> native buffer -> array
+        std::vector<uint8_t> buffer(segment.begin(), segment.end());
+        session->processSegment(buffer.data(), buffer.size());
+        memcpy(work.data(), buffer.data(), buffer.size());
+    });
+
+    runBenchmark("pool lease + copy + process", options, segment.size(), [&] {
+        auto *block = (uint8_t*)BufferPool::shared().acquire(segment.size());
+        memcpy(block, segment.data(), segment.size());
+        session->processSegment(block, segment.size());
+        BufferPool::shared().release(block);
+    });
+
+    const size_t QUEUE_SESSION_COUNT = 4;
+    AlpsSession *queueSessions[QUEUE_SESSION_COUNT];
+    for (auto &queueSession : queueSessions) {
+        queueSession = createActiveSession(options.stream);
+    }
+    std::vector<std::vector<uint8_t>> queueWork(QUEUE_SESSION_COUNT, segment);
+    runBenchmark("sync, 4 sessions", options, segment.size() * QUEUE_SESSION_COUNT, [&] {
+        for (size_t i = 0; i < QUEUE_SESSION_COUNT; i++) {
+            queueSessions[i]->processSegment(queueWork[i].data(), queueWork[i].size());
+        }
+    });
+
+    ProcessingQueue *queue = hostProcessingQueue();
+    std::vector<HostRequest> queueRequests(QUEUE_SESSION_COUNT);
+    runBenchmark("queue, 4 sessions", options, segment.size() * QUEUE_SESSION_COUNT, [&] {
+        for (size_t i = 0; i < QUEUE_SESSION_COUNT; i++) {
+            queueRequests[i].done.store(false);
+            queue->waitForCapacity(queueWork[i].size());
+            queue->submit(queueSessions[i], queueWork[i].data(), queueWork[i].size(),
+                          &queueRequests[i]);
+        }
+        waitForRequests(queueRequests);
+    });
+    for (auto &queueSession : queueSessions) {
+        queueSession->release();
+    }
+
+    SegmentPatch patch;
+    // Restored by every run, so each one creates the full patch
+    std::vector<uint8_t> unprocessed = segment;
+    runBenchmark("patch, TOC saved + diffed", options, segment.size(), [&] {
+        processSegmentPatch(session, unprocessed.data(), unprocessed.size(), &patch, nullptr);
+    });
+
+    std::vector<SegmentSlice> slices = sliceSegment(&work, 16 * 1024);
+    runBenchmark("16 KiB slices", options, segment.size(), [&] {
+        processSegmentSlices(session, slices.data(), slices.size(), nullptr);
+    });
+
+    SegmentStream stream(session);
+    runBenchmark("segment stream chunked", options, segment.size(), [&] {
+        processChunked(&stream, segment, options.feedSize, &work);
+    });
+
+    runProxyBenchmarks(options, segment.size());
+
+    LogRateLimiter limiter;
+    setNativeLogLevel(ALPS_LOG_LEVEL_ERROR);
+    runBenchmark("log below runtime level", options, 0, [&] {
+        ALOGW("Benchmark message %d", 1);
+    });
+    setNativeLogLevel(ALPS_LOG_LEVEL_INFO);
+    // Measures the suppressed path of a hot call site that already reached its limit
+    limiter.windowStartNs.store(monotonicTimeNs());
+    limiter.windowCount.store(NativeLogger::RATE_LIMIT_PER_SECOND);
+    runBenchmark("log rate limited", options, 0, [&] {
+        NativeLogger::shared().log(&limiter, ALPS_LOG_LEVEL_WARN, "alpsbench", "Benchmark %d", 1);
+    });
+
+    std::vector<HostPresentation> presentations;
+    runBenchmark("presentations marshaling", options, 0, [&] {
+        marshalPresentations(session, &presentations);
+    });
+
+    uint64_t marshaledGeneration = session->presentationsListGeneration.load();
+    runBenchmark("presentations generation", options, 0, [&] {
+        // Path of the cached Java list: marshaling is skipped while generation is unchanged
+        uint64_t generation = session->presentationsListGeneration.load();
+        if (generation != marshaledGeneration) {
+            marshalPresentations(session, &presentations);
+            marshaledGeneration = generation;
+        }
+    });
+
+    // Getter called from the UI thread while another thread keeps processing segments
+    AlpsSession *busySession = createActiveSession(options.stream);
+    std::atomic<bool> busy{true};
+    std::thread processing([&] {
+        std::vector<uint8_t> busyWork(segment);
+        while (busy.load()) {
+            // Stub processing is fast, the context is held for a call as long as a real one
+            std::lock_guard<std::mutex> lock(busySession->contextMutex);
+            for (int i = 0; i < 64; i++) {
+                busySession->processSegment(busyWork.data(), busyWork.size());
+            }
+        }
+    });
+    runBenchmark("active ID, locked, busy", options, 0, [&] {
+        int presentationId;
+        std::lock_guard<std::mutex> lock(busySession->contextMutex);
+        alps_get_active_presentation_id(busySession->context(), &presentationId);
+    });
+    runBenchmark("active ID, snapshot, busy", options, 0, [&] {
+        SnapshotPublisher::Reader reader(busySession->presentationSnapshots);
+        volatile int presentationId = reader.snapshot().activePresentationId;
+        (void)presentationId;
+    });
+    busy.store(false);
+    processing.join();
+    busySession->release();
+
+    runBenchmark("callback sync dispatch", options, 0, [&] {
+        countPresentationsChanged(session);
+    });
+
+    static CallbackDispatcher *dispatcher = CallbackDispatcher::start(deliverToBenchmark);
+    runBenchmark("callback async dispatch", options, 0, [&] {
+        // Measures post to delivery latency
+        countPresentationsChanged(session);
+        uint64_t generation = session->presentationsGeneration.load();
+        dispatcher->post(session);
+        while (deliveredGeneration.load(std::memory_order_acquire) < generation) {
+            std::this_thread::yield();
+        }
+    });
+
+    session->release();
+}
+
+void printUsage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --iterations N     measured iterations per benchmark\n"
+            "  --presentations N  presentations in the init segment\n"
+            "  --chunks N         CMAF chunks per media segment\n"
+            "  --samples N        AC-4 samples per chunk\n"
+            "  --sample-size N    AC-4 sample size in bytes\n"
+            "  --feed-size N      bytes fed to segment stream at once\n"
+            "  --smoke            run checks and a few iterations only\n",
+            name);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--smoke") {
+            options.smoke = true;
+        } else if (argument == "--iterations" && hasValue) {
+            options.iterations = strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--presentations" && hasValue) {
+            options.stream.presentationCount = strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--chunks" && hasValue) {
+            options.stream.chunkCount = strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--samples" && hasValue) {
+            options.stream.samplesPerChunk = strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--sample-size" && hasValue) {
+            options.stream.sampleSize = strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--feed-size" && hasValue) {
+            options.feedSize = strtoul(argv[++i], nullptr, 10);
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.iterations == 0 || options.feedSize == 0 || options.stream.sampleSize <= 4) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options.smoke) {
+        options.iterations = std::min<size_t>(options.iterations, 20);
+        if (!runSmokeChecks(options)) {
+            return EXIT_FAILURE;
+        }
+    }
+    runBenchmarks(options);
+    return EXIT_SUCCESS;
+}
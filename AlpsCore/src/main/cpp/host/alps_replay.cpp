@@ -0,0 +1,338 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+/**
+ * alpsreplay - replays call recordings (see call_recorder.h) against the native wrapper and the
+ * stub ALPS backend.
+ *
+ * Calls of every recorded session are replayed in order on a single thread, sessions are spread
+ * over replay threads. Recorded workload can be multiplied by replaying concurrent copies of it,
+ * each with its own sessions. Segments recorded without payloads are replaced with synthetic
+ * segments of about the same size. Reports segment throughput and latency percentiles of the
+ * replayed calls, including the pre-scan, next to the recorded ALPS processing times.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "alps_session.h"
+#include "call_recorder.h"
+#include "metrics.h"
+#include "native_logger.h"
+#include "segment_generator.h"
+#include "segment_scanner.h"
+
+namespace {
+
+struct Options {
+    // 0 replays as fast as possible, otherwise recorded timing is divided by it
+    double speed = 0;
+    size_t copies = 1;
+    size_t threadCount = 0;
+};
+
+// Call replayed by a thread
+struct ReplayCall {
+    const CallRecord *record;
+    size_t copy;
+};
+
+struct ReplayResults {
+    std::vector<uint64_t> latencies;
+    // delay of calls behind the recorded timing
+    std::vector<uint64_t> lags;
+    uint64_t bytes = 0;
+    uint64_t listChanges = 0;
+    uint64_t statusMismatches = 0;
+};
+
+void printUsage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-s speed] [-c copies] [-j threads] recording\n"
+            "  -s  0 replays as fast as possible (default), 1 with the recorded timing, 2 twice\n"
+            "      as fast, ...\n"
+            "  -c  number of concurrently replayed copies of the recording, 1 by default\n"
+            "  -j  number of replay threads, number of cores by default\n",
+            name);
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(fraction * (double)(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void printLatencies(const char *name, std::vector<uint64_t> *latencies) {
+    std::sort(latencies->begin(), latencies->end());
+    printf("%-12s %10.2f %10.2f %10.2f %10.2f %12.2f\n", name,
+           (double)percentile(*latencies, 0.5) / 1e3,
+           (double)percentile(*latencies, 0.9) / 1e3,
+           (double)percentile(*latencies, 0.99) / 1e3,
+           (double)percentile(*latencies, 0.999) / 1e3,
+           latencies->empty() ? 0.0 : (double)latencies->back() / 1e3);
+}
+
+void ignorePresentationsChanged(void *) {
+}
+
+/**
+ * Segments replacing the ones recorded without payloads. Sessions recorded together share them,
+ * they are only read.
+ */
+class SyntheticSegments {
+public:
+    explicit SyntheticSegments(const std::vector<CallRecord> &records) {
+        // Every presentation the recording switches to has to be listed
+        for (const CallRecord &record : records) {
+            if (record.type == CallType::SET_ACTIVE || record.type == CallType::SEED_ACTIVE) {
+                config.presentationCount = std::max(config.presentationCount,
+                                                    (size_t)record.presentationId + 1);
+            }
+        }
+        init = generateInitSegment(config);
+        config.chunkCount = 1;
+        chunkSize = mediaSegmentSize(config);
+        for (const CallRecord &record : records) {
+            if (record.type == CallType::PROCESS && record.payload.empty() &&
+                (record.flags & SEGMENT_HAS_MOVIE) == 0 && media.count(record.size) == 0) {
+                config.chunkCount = std::max<size_t>(1, (record.size + chunkSize / 2) / chunkSize);
+                media[record.size] = generateMediaSegment(config, 0);
+            }
+        }
+    }
+
+    const std::vector<uint8_t> &segment(const CallRecord &record) const {
+        if (!record.payload.empty()) {
+            return record.payload;
+        }
+        return (record.flags & SEGMENT_HAS_MOVIE) ? init : media.at(record.size);
+    }
+
+private:
+    SyntheticStreamConfig config;
+    size_t chunkSize;
+    std::vector<uint8_t> init;
+    std::map<uint64_t, std::vector<uint8_t>> media;
+};
+
+void replayCalls(const std::vector<ReplayCall> &calls, const SyntheticSegments &segments,
+                 const Options &options, std::chrono::steady_clock::time_point start,
+                 ReplayResults *results) {
+    std::map<std::pair<size_t, uint32_t>, AlpsSession*> sessions;
+    std::vector<uint8_t> work;
+    results->latencies.reserve(calls.size());
+
+    for (const ReplayCall &call : calls) {
+        const CallRecord &record = *call.record;
+        if (options.speed > 0) {
+            auto scheduled = start + std::chrono::nanoseconds(
+                    (uint64_t)((double)record.timeNs / options.speed));
+            std::this_thread::sleep_until(scheduled);
+            results->lags.push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - scheduled).count());
+        }
+
+        auto key = std::make_pair(call.copy, record.sessionId);
+        AlpsSession *&session = sessions[key];
+        if (record.type == CallType::SESSION_END) {
+            if (session != nullptr) {
+                results->listChanges += session->presentationsListGeneration.load();
+                session->release();
+            }
+            sessions.erase(key);
+            continue;
+        }
+        if (session == nullptr) {
+            session = AlpsSession::create(ignorePresentationsChanged, nullptr);
+            if (session == nullptr) {
+                fprintf(stderr, "Failed to create session\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(session->contextMutex);
+        switch (record.type) {
+            case CallType::PROCESS: {
+                const std::vector<uint8_t> &segment = segments.segment(record);
+                // Segment is processed in place, the copy is not measured
+                work.assign(segment.begin(), segment.end());
+                uint64_t startNs = monotonicTimeNs();
+                ProcessingStatus status = session->process(work.data(), work.size(), nullptr);
+                results->latencies.push_back(monotonicTimeNs() - startNs);
+                results->bytes += work.size();
+                results->statusMismatches += (uint8_t)status != record.status;
+                break;
+            }
+            case CallType::SET_ACTIVE:
+                results->statusMismatches +=
+                        session->setActivePresentationId(record.presentationId) != record.ret;
+                break;
+            case CallType::SEED_ACTIVE:
+                results->statusMismatches +=
+                        session->seedActivePresentationId(record.presentationId) != record.ret;
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (auto &entry : sessions) {
+        results->listChanges += entry.second->presentationsListGeneration.load();
+        entry.second->release();
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    int option;
+    while ((option = getopt(argc, argv, "s:c:j:h")) != -1) {
+        switch (option) {
+            case 's':
+                options.speed = atof(optarg);
+                break;
+            case 'c':
+                options.copies = std::max<size_t>(1, (size_t)strtoul(optarg, nullptr, 10));
+                break;
+            case 'j':
+                options.threadCount = (size_t)strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                printUsage(argv[0]);
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options.threadCount == 0) {
+        options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<CallRecord> records;
+    if (!readCallRecording(argv[optind], &records)) {
+        NativeLogger::shared().flush();
+        return EXIT_FAILURE;
+    }
+    // Records are written when calls complete, calls of different threads may be out of order
+    std::stable_sort(records.begin(), records.end(),
+                     [](const CallRecord &a, const CallRecord &b) { return a.timeNs < b.timeNs; });
+
+    std::map<uint32_t, size_t> sessionIndexes;
+    std::vector<uint64_t> recordedLatencies;
+    uint64_t recordedBytes = 0;
+    uint64_t recordedListChanges = 0;
+    uint64_t payloadCount = 0;
+    uint64_t payloadMismatches = 0;
+    for (const CallRecord &record : records) {
+        sessionIndexes.emplace(record.sessionId, sessionIndexes.size());
+        if (record.type == CallType::PROCESS) {
+            recordedLatencies.push_back(record.durationNs);
+            recordedBytes += record.size;
+            if (!record.payload.empty()) {
+                payloadCount++;
+                payloadMismatches += recordingHash(record.payload.data(),
+                                                   record.payload.size()) != record.hash;
+            }
+        } else if (record.type == CallType::LIST_CHANGED) {
+            recordedListChanges++;
+        }
+    }
+    SyntheticSegments segments(records);
+
+    // Calls of a session copy stay on one thread, in recorded order
+    std::vector<std::vector<ReplayCall>> threadCalls(options.threadCount);
+    for (const CallRecord &record : records) {
+        for (size_t copy = 0; copy < options.copies; copy++) {
+            size_t session = copy * sessionIndexes.size() + sessionIndexes[record.sessionId];
+            threadCalls[session % options.threadCount].push_back({&record, copy});
+        }
+    }
+
+    std::vector<ReplayResults> results(options.threadCount);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.threadCount; i++) {
+        threads.emplace_back(replayCalls, std::cref(threadCalls[i]), std::cref(segments),
+                             std::cref(options), start, &results[i]);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    NativeLogger::shared().flush();
+
+    ReplayResults total;
+    for (ReplayResults &threadResults : results) {
+        total.latencies.insert(total.latencies.end(), threadResults.latencies.begin(),
+                               threadResults.latencies.end());
+        total.lags.insert(total.lags.end(), threadResults.lags.begin(), threadResults.lags.end());
+        total.bytes += threadResults.bytes;
+        total.listChanges += threadResults.listChanges;
+        total.statusMismatches += threadResults.statusMismatches;
+    }
+
+    double recordedSeconds = records.empty() ? 0.0 : (double)records.back().timeNs / 1e9;
+    printf("Recording: %zu calls, %zu sessions, %zu segments (%.1f MiB, %llu with payload), "
+           "%.3f s\n",
+           records.size(), sessionIndexes.size(), recordedLatencies.size(),
+           (double)recordedBytes / (1024.0 * 1024.0), (unsigned long long)payloadCount,
+           recordedSeconds);
+    printf("Replay: %zu copies on %zu threads, %s\n", options.copies, options.threadCount,
+           options.speed > 0 ? "recorded timing" : "as fast as possible");
+    if (options.speed > 0) {
+        printf("Speed: %.2fx\n", options.speed);
+    }
+    printf("Segments: %zu in %.3f s, %.0f segments/s, %.1f MiB/s\n",
+           total.latencies.size(), seconds, (double)total.latencies.size() / seconds,
+           (double)total.bytes / (1024.0 * 1024.0) / seconds);
+    printf("%-12s %10s %10s %10s %10s %12s\n", "segment", "p50 us", "p90 us", "p99 us",
+           "p99.9 us", "max us");
+    printLatencies("recorded", &recordedLatencies);
+    printLatencies("replayed", &total.latencies);
+    if (options.speed > 0) {
+        printLatencies("behind time", &total.lags);
+    }
+    printf("Presentations list changes: recorded %llu, replayed %llu\n",
+           (unsigned long long)(recordedListChanges * options.copies),
+           (unsigned long long)total.listChanges);
+    printf("Status mismatches: %llu, payload hash mismatches: %llu\n",
+           (unsigned long long)total.statusMismatches, (unsigned long long)payloadMismatches);
+    return payloadMismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
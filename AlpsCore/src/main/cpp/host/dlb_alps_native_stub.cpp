@@ -0,0 +1,374 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+/**
+ * Stub implementation of the ALPS native library for host builds.
+ *
+ * It understands only the layout produced by the synthetic segment generator:
+ * * presentations are listed by moov/meta/grpl/prsl boxes, prsl box children elng and labl carry
+ *   language and label
+ * * AC-4 samples are located with moof/traf/trun sample sizes and data offset relative to moof
+ * * every sample starts with 0xAC40 sync word, active presentation ID is written to sample byte 4
+ *
+ * Processing cost is proportional to the number of samples, like in the real library.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "isobmff.h"
+
+extern "C"
+{
+    #include "dlb_alps_native.h"
+}
+
+static const size_t FULL_BOX_HEADER_SIZE = 4;
+static const uint32_t TRUN_DATA_OFFSET_PRESENT = 0x000001;
+static const uint32_t TRUN_FIRST_SAMPLE_FLAGS_PRESENT = 0x000004;
+static const uint32_t TRUN_SAMPLE_DURATION_PRESENT = 0x000100;
+static const uint32_t TRUN_SAMPLE_SIZE_PRESENT = 0x000200;
+static const uint32_t TRUN_SAMPLE_FLAGS_PRESENT = 0x000400;
+static const uint32_t TRUN_SAMPLE_COMPOSITION_OFFSET_PRESENT = 0x000800;
+static const uint8_t AC4_SYNC_WORD[] = {0xAC, 0x40};
+static const size_t AC4_PRESENTATION_BYTE = 4;
+
+struct StubPresentation {
+    int id;
+    std::string label;
+    std::string language;
+};
+
+struct alps_ctx_t {
+    presentations_changed_cb callback;
+    callback_ctx callbackCtx;
+    bool hasMovieInfo;
+    int activePresentationId;
+    std::vector<StubPresentation> presentations;
+    // Exposed by alps_get_presentations, points to strings of presentations
+    std::vector<alps_presentation> presentationsView;
+};
+
+struct BoxRange {
+    const uint8_t *data;
+    size_t size;
+};
+
+// Calls visitor for every box in [data, data + size), stops at the first malformed box
+template<typename Visitor>
+static bool forEachBox(const uint8_t *data, size_t size, Visitor visitor) {
+    size_t offset = 0;
+    while (offset < size) {
+        BoxHeader header;
+        BoxHeaderStatus status = parseBoxHeader(data + offset, size - offset, &header);
+        if (status == BoxHeaderStatus::EXTENDS_TO_END) {
+            header.size = size - offset;
+            header.headerSize = 8;
+        } else if (status != BoxHeaderStatus::OK || header.size > size - offset) {
+            return false;
+        }
+        BoxRange payload = {data + offset + header.headerSize,
+                            (size_t)header.size - header.headerSize};
+        if (!visitor(header.type, payload, data + offset)) {
+            return false;
+        }
+        offset += header.size;
+    }
+    return true;
+}
+
+static std::string readString(const uint8_t **data, const uint8_t *end) {
+    const uint8_t *start = *data;
+    while (*data < end && **data != 0) {
+        (*data)++;
+    }
+    std::string value((const char*)start, *data - start);
+    if (*data < end) {
+        (*data)++;
+    }
+    return value;
+}
+
+static bool parsePreselection(BoxRange prsl, StubPresentation *presentation) {
+    // version and flags, group_id, num_entities_in_group
+    if (prsl.size < FULL_BOX_HEADER_SIZE + 8) {
+        return false;
+    }
+    presentation->id = (int)readBigEndian32(prsl.data + FULL_BOX_HEADER_SIZE);
+    uint32_t entityCount = readBigEndian32(prsl.data + FULL_BOX_HEADER_SIZE + 4);
+    size_t childrenOffset = FULL_BOX_HEADER_SIZE + 8 + (size_t)entityCount * 4;
+    if (childrenOffset > prsl.size) {
+        return false;
+    }
+
+    return forEachBox(prsl.data + childrenOffset, prsl.size - childrenOffset,
+                      [presentation](uint32_t type, BoxRange box, const uint8_t*) {
+        const uint8_t *end = box.data + box.size;
+        if (type == ISOBMFF_BOX_ELNG && box.size >= FULL_BOX_HEADER_SIZE) {
+            const uint8_t *cursor = box.data + FULL_BOX_HEADER_SIZE;
+            presentation->language = readString(&cursor, end);
+        } else if (type == ISOBMFF_BOX_LABL && box.size >= FULL_BOX_HEADER_SIZE + 3) {
+            // is_group_label, label_id, language, label
+            const uint8_t *cursor = box.data + FULL_BOX_HEADER_SIZE + 3;
+            readString(&cursor, end);
+            presentation->label = readString(&cursor, end);
+        }
+        return true;
+    });
+}
+
+static bool parseMovie(BoxRange moov, std::vector<StubPresentation> *presentations) {
+    return forEachBox(moov.data, moov.size, [presentations](uint32_t type, BoxRange box, const uint8_t*) {
+        if (type != ISOBMFF_BOX_META || box.size < FULL_BOX_HEADER_SIZE) {
+            return true;
+        }
+        return forEachBox(box.data + FULL_BOX_HEADER_SIZE, box.size - FULL_BOX_HEADER_SIZE,
+                          [presentations](uint32_t type, BoxRange box, const uint8_t*) {
+            if (type != ISOBMFF_BOX_GRPL) {
+                return true;
+            }
+            return forEachBox(box.data, box.size,
+                              [presentations](uint32_t type, BoxRange box, const uint8_t*) {
+                if (type != ISOBMFF_BOX_PRSL) {
+                    return true;
+                }
+                StubPresentation presentation = {ALPS_INVALID_PRES_ID, "", ""};
+                if (!parsePreselection(box, &presentation)) {
+                    return false;
+                }
+                presentations->push_back(presentation);
+                return true;
+            });
+        });
+    });
+}
+
+static bool parseTrackRun(BoxRange trun, const uint8_t *moof, const uint8_t *segmentEnd,
+                          int activePresentationId) {
+    if (trun.size < FULL_BOX_HEADER_SIZE + 4) {
+        return false;
+    }
+    uint32_t flags = readBigEndian32(trun.data) & 0xFFFFFF;
+    uint32_t sampleCount = readBigEndian32(trun.data + FULL_BOX_HEADER_SIZE);
+    const uint8_t *cursor = trun.data + FULL_BOX_HEADER_SIZE + 4;
+    const uint8_t *end = trun.data + trun.size;
+
+    if ((flags & TRUN_DATA_OFFSET_PRESENT) == 0 || (flags & TRUN_SAMPLE_SIZE_PRESENT) == 0 ||
+        cursor + 4 > end) {
+        return false;
+    }
+    const uint8_t *sample = moof + (int32_t)readBigEndian32(cursor);
+    cursor += 4;
+    if (flags & TRUN_FIRST_SAMPLE_FLAGS_PRESENT) {
+        cursor += 4;
+    }
+
+    size_t sampleFieldsSize = 0;
+    size_t sizeFieldOffset = 0;
+    if (flags & TRUN_SAMPLE_DURATION_PRESENT) {
+        sampleFieldsSize += 4;
+        sizeFieldOffset += 4;
+    }
+    sampleFieldsSize += 4;
+    if (flags & TRUN_SAMPLE_FLAGS_PRESENT) sampleFieldsSize += 4;
+    if (flags & TRUN_SAMPLE_COMPOSITION_OFFSET_PRESENT) sampleFieldsSize += 4;
+    if (cursor > end || (size_t)(end - cursor) / sampleFieldsSize < sampleCount) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sampleCount; i++, cursor += sampleFieldsSize) {
+        uint32_t sampleSize = readBigEndian32(cursor + sizeFieldOffset);
+        if (sample < moof || sample > segmentEnd || sampleSize > (size_t)(segmentEnd - sample) ||
+            sampleSize <= AC4_PRESENTATION_BYTE ||
+            memcmp(sample, AC4_SYNC_WORD, sizeof(AC4_SYNC_WORD)) != 0) {
+            return false;
+        }
+        if (activePresentationId != ALPS_INVALID_PRES_ID) {
+            auto *writableSample = const_cast<uint8_t*>(sample);
+            writableSample[AC4_PRESENTATION_BYTE] = (uint8_t)activePresentationId;
+        }
+        sample += sampleSize;
+    }
+    return true;
+}
+
+static bool parseFragment(BoxRange moof, const uint8_t *moofStart, const uint8_t *segmentEnd,
+                          int activePresentationId) {
+    return forEachBox(moof.data, moof.size, [&](uint32_t type, BoxRange box, const uint8_t*) {
+        if (type != ISOBMFF_BOX_TRAF) {
+            return true;
+        }
+        return forEachBox(box.data, box.size, [&](uint32_t type, BoxRange box, const uint8_t*) {
+            return type != ISOBMFF_BOX_TRUN ||
+                   parseTrackRun(box, moofStart, segmentEnd, activePresentationId);
+        });
+    });
+}
+
+static bool samePresentations(const std::vector<StubPresentation> &a,
+                              const std::vector<StubPresentation> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id || a[i].label != b[i].label || a[i].language != b[i].language) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void updatePresentationsView(alps_ctx *ctx) {
+    ctx->presentationsView.clear();
+    for (auto &presentation : ctx->presentations) {
+        ctx->presentationsView.push_back({presentation.id,
+                                          const_cast<char*>(presentation.label.c_str()),
+                                          const_cast<char*>(presentation.language.c_str())});
+    }
+}
+
+extern "C" {
+
+char *alps_version(void) {
+    static char version[] = "host-stub";
+    return version;
+}
+
+alps_ret alps_query_mem(size_t *mem_size) {
+    if (mem_size == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    *mem_size = sizeof(alps_ctx);
+    return ALPS_RET_OK;
+}
+
+alps_ret alps_init(alps_ctx **ctx, void *mem) {
+    if (ctx == nullptr || mem == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    auto *context = new (mem) alps_ctx();
+    context->callback = nullptr;
+    context->callbackCtx = nullptr;
+    context->hasMovieInfo = false;
+    context->activePresentationId = ALPS_INVALID_PRES_ID;
+    *ctx = context;
+    return ALPS_RET_OK;
+}
+
+void alps_destroy(alps_ctx *ctx) {
+    if (ctx != nullptr) {
+        ctx->~alps_ctx();
+    }
+}
+
+void alps_set_presentations_changed_callback(alps_ctx *ctx,
+                                             presentations_changed_cb presentations_cb,
+                                             callback_ctx cb_ctx) {
+    ctx->callback = presentations_cb;
+    ctx->callbackCtx = cb_ctx;
+}
+
+callback_ctx alps_get_presentations_changed_callback_context(alps_ctx *ctx) {
+    return ctx->callbackCtx;
+}
+
+alps_ret alps_process_isobmff_segment(alps_ctx *ctx, unsigned char *buffer, size_t size) {
+    if (ctx == nullptr || buffer == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    const uint8_t *segmentEnd = buffer + size;
+    bool presentationsChanged = false;
+    alps_ret ret = ALPS_RET_OK;
+
+    bool parsed = forEachBox(buffer, size, [&](uint32_t type, BoxRange box, const uint8_t *start) {
+        if (type == ISOBMFF_BOX_MOOV) {
+            std::vector<StubPresentation> presentations;
+            if (!parseMovie(box, &presentations)) {
+                return false;
+            }
+            ctx->hasMovieInfo = true;
+            if (!samePresentations(presentations, ctx->presentations)) {
+                ctx->presentations.swap(presentations);
+                updatePresentationsView(ctx);
+                presentationsChanged = true;
+            }
+        } else if (type == ISOBMFF_BOX_MOOF) {
+            if (!ctx->hasMovieInfo) {
+                ret = ALPS_RET_E_NO_MOVIE_INFO;
+                return false;
+            }
+            return parseFragment(box, start, segmentEnd, ctx->activePresentationId);
+        }
+        return true;
+    });
+
+    if (presentationsChanged && ctx->callback != nullptr) {
+        ctx->callback(ctx->callbackCtx);
+    }
+    if (ret != ALPS_RET_OK) {
+        return ret;
+    }
+    return parsed ? ALPS_RET_OK : ALPS_RET_E_PARSE;
+}
+
+alps_ret alps_get_presentations(alps_ctx *ctx, alps_presentation **presentations, size_t *count) {
+    if (ctx == nullptr || presentations == nullptr || count == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    *presentations = ctx->presentationsView.data();
+    *count = ctx->presentationsView.size();
+    return ALPS_RET_OK;
+}
+
+alps_ret alps_get_active_presentation_id(alps_ctx *ctx, int *presentation_id) {
+    if (ctx == nullptr || presentation_id == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    *presentation_id = ctx->activePresentationId;
+    return ALPS_RET_OK;
+}
+
+alps_ret alps_set_active_presentation_id(alps_ctx *ctx, int presentation_id) {
+    if (ctx == nullptr) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    if (presentation_id != ALPS_INVALID_PRES_ID) {
+        bool found = false;
+        for (const auto &presentation : ctx->presentations) {
+            found = found || presentation.id == presentation_id;
+        }
+        if (!found) {
+            return ALPS_RET_E_PRES_ID_NOT_FOUND;
+        }
+    }
+    ctx->activePresentationId = presentation_id;
+    return ALPS_RET_OK;
+}
+
+} // extern "C"
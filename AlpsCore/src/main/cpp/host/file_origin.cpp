@@ -0,0 +1,193 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "file_origin.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+FileOrigin::FileOrigin(const std::string &rootDir)
+    : rootDir(rootDir), listenFd(-1), boundPort(0), writeSize(SIZE_MAX), stopping(false) {
+}
+
+FileOrigin::~FileOrigin() {
+    stop();
+}
+
+bool FileOrigin::start() {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (listenFd < 0 || bind(listenFd, (const sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0 ||
+        getsockname(listenFd, (sockaddr*)&address, &addressLength) != 0) {
+        return false;
+    }
+    boundPort = ntohs(address.sin_port);
+    acceptThread = std::thread(&FileOrigin::acceptLoop, this);
+    return true;
+}
+
+void FileOrigin::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        for (int fd : connections) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    if (listenFd >= 0) {
+        shutdown(listenFd, SHUT_RDWR);
+    }
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    for (std::thread &thread : connectionThreads) {
+        thread.join();
+    }
+    connectionThreads.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+std::vector<std::string> FileOrigin::requests() {
+    std::lock_guard<std::mutex> guard(lock);
+    return receivedTargets;
+}
+
+void FileOrigin::acceptLoop() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        std::lock_guard<std::mutex> guard(lock);
+        if (fd < 0 || stopping) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        connections.push_back(fd);
+        connectionThreads.emplace_back(&FileOrigin::serve, this, fd);
+    }
+}
+
+void FileOrigin::serve(int fd) {
+    std::string buffered;
+    char data[4096];
+    for (;;) {
+        size_t headerEnd = buffered.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            ssize_t count = recv(fd, data, sizeof(data), 0);
+            if (count <= 0) {
+                break;
+            }
+            buffered.append(data, (size_t)count);
+            continue;
+        }
+        std::string header = buffered.substr(0, headerEnd + 2);
+        buffered.erase(0, headerEnd + 4);
+
+        size_t methodEnd = header.find(' ');
+        size_t targetEnd = header.find(' ', methodEnd + 1);
+        if (methodEnd == std::string::npos || targetEnd == std::string::npos) {
+            break;
+        }
+        std::string method = header.substr(0, methodEnd);
+        std::string target = header.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        bool keepAlive = strcasestr(header.c_str(), "\r\nConnection: keep-alive\r\n") != nullptr;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            receivedTargets.push_back(target);
+        }
+        if (!respond(fd, method, target, keepAlive) || !keepAlive) {
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    connections.erase(std::find(connections.begin(), connections.end(), fd));
+    close(fd);
+}
+
+static bool sendAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+bool FileOrigin::respond(int fd, const std::string &method, const std::string &target,
+                         bool keepAlive) {
+    std::string path = target.substr(0, target.find('?'));
+    int file = -1;
+    struct stat status = {};
+    if (path.find("..") == std::string::npos) {
+        file = open((rootDir + path).c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (file < 0 || fstat(file, &status) != 0 || !S_ISREG(status.st_mode)) {
+        if (file >= 0) {
+            close(file);
+        }
+        const char notFound[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        return sendAll(fd, notFound, sizeof(notFound) - 1);
+    }
+
+    char header[256];
+    int headerLength = snprintf(header, sizeof(header),
+                                "HTTP/1.1 200 OK\r\nContent-Type: video/mp4\r\n"
+                                "Content-Length: %lld\r\nConnection: %s\r\n\r\n",
+                                (long long)status.st_size, keepAlive ? "keep-alive" : "close");
+    bool sent = sendAll(fd, header, (size_t)headerLength);
+    if (sent && method == "GET") {
+        std::vector<char> body((size_t)status.st_size);
+        sent = read(file, body.data(), body.size()) == (ssize_t)body.size();
+        for (size_t offset = 0; sent && offset < body.size();) {
+            size_t count = std::min(writeSize, body.size() - offset);
+            sent = sendAll(fd, body.data() + offset, count);
+            offset += count;
+        }
+    }
+    close(file);
+    return sent;
+}
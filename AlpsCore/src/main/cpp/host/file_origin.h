@@ -0,0 +1,87 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_FILE_ORIGIN_H_
+#define _ALPS_FILE_ORIGIN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Minimal HTTP origin serving files of a directory, stand-in for a CDN in host tests of the proxy.
+ *
+ * Every connection is served by its own blocking thread. GET and HEAD requests are answered with
+ * Content-Length, connections are kept alive if requested.
+ */
+class FileOrigin {
+public:
+    explicit FileOrigin(const std::string &rootDir);
+    ~FileOrigin();
+
+    FileOrigin(const FileOrigin&) = delete;
+    FileOrigin& operator=(const FileOrigin&) = delete;
+
+    /**
+     * Listens on a free loopback port.
+     */
+    bool start();
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+
+    /**
+     * Bodies are written in pieces of at most size bytes, so that clients receive them in parts.
+     */
+    void setWriteSize(size_t size) { writeSize = size; }
+
+    /**
+     * @return request targets received so far, in order
+     */
+    std::vector<std::string> requests();
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+    bool respond(int fd, const std::string &method, const std::string &target, bool keepAlive);
+
+    std::string rootDir;
+    int listenFd;
+    uint16_t boundPort;
+    size_t writeSize;
+    std::thread acceptThread;
+
+    std::mutex lock;
+    bool stopping;
+    std::vector<int> connections;
+    std::vector<std::thread> connectionThreads;
+    std::vector<std::string> receivedTargets;
+};
+
+#endif //_ALPS_FILE_ORIGIN_H_
@@ -0,0 +1,230 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "segment_generator.h"
+
+#include <string.h>
+#include <string>
+
+#include "isobmff.h"
+
+static const uint32_t TRACK_ID = 1;
+static const uint32_t TRUN_FLAGS = 0x000201; // data-offset-present, sample-size-present
+static const uint32_t TFHD_DEFAULT_BASE_IS_MOOF = 0x020000;
+static const char *LANGUAGES[] = {"en", "de", "fr", "es", "it", "pl"};
+
+namespace {
+
+class BoxWriter {
+public:
+    explicit BoxWriter(std::vector<uint8_t> *out) : out(out) {
+    }
+
+    // Returns offset of the box, to be passed to endBox
+    size_t beginBox(uint32_t type) {
+        size_t offset = out->size();
+        write32(0);
+        write32(type);
+        return offset;
+    }
+
+    size_t beginFullBox(uint32_t type, uint8_t version, uint32_t flags) {
+        size_t offset = beginBox(type);
+        write32(((uint32_t)version << 24) | (flags & 0xFFFFFF));
+        return offset;
+    }
+
+    void endBox(size_t offset) {
+        patch32(offset, (uint32_t)(out->size() - offset));
+    }
+
+    void write8(uint8_t value) {
+        out->push_back(value);
+    }
+
+    void write16(uint16_t value) {
+        write8((uint8_t)(value >> 8));
+        write8((uint8_t)value);
+    }
+
+    void write32(uint32_t value) {
+        write16((uint16_t)(value >> 16));
+        write16((uint16_t)value);
+    }
+
+    void writeZeros(size_t count) {
+        out->insert(out->end(), count, 0);
+    }
+
+    void writeString(const std::string &value) {
+        out->insert(out->end(), value.begin(), value.end());
+        write8(0);
+    }
+
+    void patch32(size_t offset, uint32_t value) {
+        (*out)[offset] = (uint8_t)(value >> 24);
+        (*out)[offset + 1] = (uint8_t)(value >> 16);
+        (*out)[offset + 2] = (uint8_t)(value >> 8);
+        (*out)[offset + 3] = (uint8_t)value;
+    }
+
+private:
+    std::vector<uint8_t> *out;
+};
+
+void writeTypeBox(BoxWriter *writer, uint32_t type) {
+    size_t box = writer->beginBox(type);
+    writer->write32(ISOBMFF_FOURCC('i', 's', 'o', '6'));
+    writer->write32(0);
+    writer->write32(ISOBMFF_FOURCC('i', 's', 'o', '6'));
+    writer->write32(ISOBMFF_FOURCC('c', 'm', 'f', 'c'));
+    writer->endBox(box);
+}
+
+void writeSample(std::vector<uint8_t> *out, size_t sampleSize, uint32_t *state) {
+    size_t start = out->size();
+    out->resize(start + sampleSize);
+    uint8_t *sample = out->data() + start;
+    for (size_t i = 0; i < sampleSize; i++) {
+        // xorshift, payload content doesn't matter, it only has to be non-trivial
+        *state ^= *state << 13;
+        *state ^= *state >> 17;
+        *state ^= *state << 5;
+        sample[i] = (uint8_t)*state;
+    }
+    sample[0] = 0xAC;
+    sample[1] = 0x40;
+    sample[2] = (uint8_t)(sampleSize >> 8);
+    sample[3] = (uint8_t)sampleSize;
+    sample[4] = 0xFF;
+}
+
+} // namespace
+
+std::vector<uint8_t> generateInitSegment(const SyntheticStreamConfig &config) {
+    std::vector<uint8_t> segment;
+    BoxWriter writer(&segment);
+    writeTypeBox(&writer, ISOBMFF_BOX_FTYP);
+
+    size_t moov = writer.beginBox(ISOBMFF_BOX_MOOV);
+    size_t mvhd = writer.beginFullBox(ISOBMFF_FOURCC('m', 'v', 'h', 'd'), 0, 0);
+    writer.writeZeros(96);
+    writer.endBox(mvhd);
+
+    size_t trak = writer.beginBox(ISOBMFF_BOX_TRAK);
+    size_t tkhd = writer.beginFullBox(ISOBMFF_FOURCC('t', 'k', 'h', 'd'), 0, 3);
+    writer.writeZeros(8);
+    writer.write32(TRACK_ID);
+    writer.writeZeros(68);
+    writer.endBox(tkhd);
+    size_t mdia = writer.beginBox(ISOBMFF_FOURCC('m', 'd', 'i', 'a'));
+    size_t hdlr = writer.beginFullBox(ISOBMFF_FOURCC('h', 'd', 'l', 'r'), 0, 0);
+    writer.write32(0);
+    writer.write32(ISOBMFF_FOURCC('s', 'o', 'u', 'n'));
+    writer.writeZeros(12);
+    writer.writeString("SoundHandler");
+    writer.endBox(hdlr);
+    size_t stsd = writer.beginFullBox(ISOBMFF_FOURCC('s', 't', 's', 'd'), 0, 0);
+    writer.write32(1);
+    size_t ac4 = writer.beginBox(ISOBMFF_FOURCC('a', 'c', '-', '4'));
+    writer.writeZeros(28);
+    writer.endBox(ac4);
+    writer.endBox(stsd);
+    writer.endBox(mdia);
+    writer.endBox(trak);
+
+    size_t meta = writer.beginFullBox(ISOBMFF_BOX_META, 0, 0);
+    size_t grpl = writer.beginBox(ISOBMFF_BOX_GRPL);
+    for (size_t i = 0; i < config.presentationCount; i++) {
+        size_t prsl = writer.beginFullBox(ISOBMFF_BOX_PRSL, 0, 0);
+        writer.write32((uint32_t)i);
+        writer.write32(1);
+        writer.write32(TRACK_ID);
+
+        const char *language = LANGUAGES[i % (sizeof(LANGUAGES) / sizeof(LANGUAGES[0]))];
+        size_t elng = writer.beginFullBox(ISOBMFF_BOX_ELNG, 0, 0);
+        writer.writeString(language);
+        writer.endBox(elng);
+
+        size_t labl = writer.beginFullBox(ISOBMFF_BOX_LABL, 0, 0);
+        writer.write8(0);
+        writer.write16((uint16_t)i);
+        writer.writeString(language);
+        writer.writeString("Presentation " + std::to_string(i));
+        writer.endBox(labl);
+
+        writer.endBox(prsl);
+    }
+    writer.endBox(grpl);
+    writer.endBox(meta);
+    writer.endBox(moov);
+    return segment;
+}
+
+std::vector<uint8_t> generateMediaSegment(const SyntheticStreamConfig &config,
+                                          uint32_t sequenceNumber) {
+    std::vector<uint8_t> segment;
+    segment.reserve(mediaSegmentSize(config));
+    BoxWriter writer(&segment);
+    writeTypeBox(&writer, ISOBMFF_BOX_STYP);
+
+    uint32_t state = config.seed * 2654435761u + sequenceNumber + 1;
+    for (size_t chunk = 0; chunk < config.chunkCount; chunk++) {
+        size_t moof = writer.beginBox(ISOBMFF_BOX_MOOF);
+        size_t mfhd = writer.beginFullBox(ISOBMFF_BOX_MFHD, 0, 0);
+        writer.write32(sequenceNumber * (uint32_t)config.chunkCount + (uint32_t)chunk + 1);
+        writer.endBox(mfhd);
+        size_t traf = writer.beginBox(ISOBMFF_BOX_TRAF);
+        size_t tfhd = writer.beginFullBox(ISOBMFF_BOX_TFHD, 0, TFHD_DEFAULT_BASE_IS_MOOF);
+        writer.write32(TRACK_ID);
+        writer.endBox(tfhd);
+        size_t trun = writer.beginFullBox(ISOBMFF_BOX_TRUN, 0, TRUN_FLAGS);
+        writer.write32((uint32_t)config.samplesPerChunk);
+        size_t dataOffset = segment.size();
+        writer.write32(0);
+        for (size_t i = 0; i < config.samplesPerChunk; i++) {
+            writer.write32((uint32_t)config.sampleSize);
+        }
+        writer.endBox(trun);
+        writer.endBox(traf);
+        writer.endBox(moof);
+
+        // Samples start right after mdat header
+        writer.patch32(dataOffset, (uint32_t)(segment.size() - moof + 8));
+        size_t mdat = writer.beginBox(ISOBMFF_BOX_MDAT);
+        for (size_t i = 0; i < config.samplesPerChunk; i++) {
+            writeSample(&segment, config.sampleSize, &state);
+        }
+        writer.endBox(mdat);
+    }
+    return segment;
+}
+
+size_t mediaSegmentSize(const SyntheticStreamConfig &config) {
+    // styp, moof with mfhd, traf, tfhd and trun, mdat header
+    size_t chunkOverhead = 8 + 16 + 8 + 16 + 20 + 4 * config.samplesPerChunk + 8;
+    return 24 + config.chunkCount * (chunkOverhead + config.samplesPerChunk * config.sampleSize);
+}
@@ -0,0 +1,64 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SEGMENT_GENERATOR_H_
+#define _ALPS_SEGMENT_GENERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct SyntheticStreamConfig {
+    // number of presentations listed in the init segment, IDs start at 0
+    size_t presentationCount = 3;
+    // number of CMAF chunks (moof + mdat) per media segment
+    size_t chunkCount = 1;
+    // number of AC-4 samples per chunk
+    size_t samplesPerChunk = 48;
+    // size of a single AC-4 sample in bytes
+    size_t sampleSize = 1024;
+    // seed of the sample payload
+    uint32_t seed = 1;
+};
+
+/**
+ * Generates synthetic CMAF init segment: ftyp and moov with an AC-4 track and presentations listed
+ * by meta/grpl/prsl boxes.
+ */
+std::vector<uint8_t> generateInitSegment(const SyntheticStreamConfig &config);
+
+/**
+ * Generates synthetic CMAF media segment: styp followed by chunkCount moof + mdat pairs.
+ */
+std::vector<uint8_t> generateMediaSegment(const SyntheticStreamConfig &config,
+                                          uint32_t sequenceNumber);
+
+/**
+ * Size of the media segment generated for the config.
+ */
+size_t mediaSegmentSize(const SyntheticStreamConfig &config);
+
+#endif //_ALPS_SEGMENT_GENERATOR_H_
@@ -0,0 +1,104 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_ISOBMFF_H_
+#define _ALPS_ISOBMFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ISOBMFF_FOURCC(a, b, c, d) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define ISOBMFF_BOX_FTYP ISOBMFF_FOURCC('f', 't', 'y', 'p')
+#define ISOBMFF_BOX_STYP ISOBMFF_FOURCC('s', 't', 'y', 'p')
+#define ISOBMFF_BOX_MOOV ISOBMFF_FOURCC('m', 'o', 'o', 'v')
+#define ISOBMFF_BOX_MOOF ISOBMFF_FOURCC('m', 'o', 'o', 'f')
+#define ISOBMFF_BOX_MDAT ISOBMFF_FOURCC('m', 'd', 'a', 't')
+#define ISOBMFF_BOX_META ISOBMFF_FOURCC('m', 'e', 't', 'a')
+#define ISOBMFF_BOX_GRPL ISOBMFF_FOURCC('g', 'r', 'p', 'l')
+#define ISOBMFF_BOX_PRSL ISOBMFF_FOURCC('p', 'r', 's', 'l')
+#define ISOBMFF_BOX_ELNG ISOBMFF_FOURCC('e', 'l', 'n', 'g')
+#define ISOBMFF_BOX_LABL ISOBMFF_FOURCC('l', 'a', 'b', 'l')
+#define ISOBMFF_BOX_TRAK ISOBMFF_FOURCC('t', 'r', 'a', 'k')
+#define ISOBMFF_BOX_MFHD ISOBMFF_FOURCC('m', 'f', 'h', 'd')
+#define ISOBMFF_BOX_TRAF ISOBMFF_FOURCC('t', 'r', 'a', 'f')
+#define ISOBMFF_BOX_TFHD ISOBMFF_FOURCC('t', 'f', 'h', 'd')
+#define ISOBMFF_BOX_TRUN ISOBMFF_FOURCC('t', 'r', 'u', 'n')
+
+enum class BoxHeaderStatus {
+    OK,
+    NEED_MORE_DATA,
+    // size field equal to 0 - box extends to the end of the segment
+    EXTENDS_TO_END,
+    INVALID,
+};
+
+struct BoxHeader {
+    uint64_t size;
+    uint32_t type;
+    uint32_t headerSize;
+};
+
+static inline uint32_t readBigEndian32(const uint8_t *data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+           ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static inline uint64_t readBigEndian64(const uint8_t *data) {
+    return ((uint64_t)readBigEndian32(data) << 32) | readBigEndian32(data + 4);
+}
+
+/**
+ * Parses ISO BMFF box header (including 64-bit largesize) from the start of data.
+ */
+static inline BoxHeaderStatus parseBoxHeader(const uint8_t *data, size_t available, BoxHeader *header) {
+    if (available < 8) {
+        return BoxHeaderStatus::NEED_MORE_DATA;
+    }
+    uint64_t size = readBigEndian32(data);
+    header->type = readBigEndian32(data + 4);
+    header->headerSize = 8;
+
+    if (size == 1) {
+        if (available < 16) {
+            return BoxHeaderStatus::NEED_MORE_DATA;
+        }
+        size = readBigEndian64(data + 8);
+        header->headerSize = 16;
+    } else if (size == 0) {
+        header->size = 0;
+        return BoxHeaderStatus::EXTENDS_TO_END;
+    }
+
+    if (size < header->headerSize) {
+        return BoxHeaderStatus::INVALID;
+    }
+    header->size = size;
+    return BoxHeaderStatus::OK;
+}
+
+#endif //_ALPS_ISOBMFF_H_
@@ -0,0 +1,98 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "jni_utils.h"
+
+#include <pthread.h>
+
+#include "log.h"
+
+static JavaVM *globalJavaVM = nullptr;
+static pthread_key_t threadDetachKey;
+
+static void detachThread(void *) {
+    if (globalJavaVM != nullptr) {
+        globalJavaVM->DetachCurrentThread();
+    }
+}
+
+bool initJavaVM(JavaVM *vm) {
+    globalJavaVM = vm;
+    if (pthread_key_create(&threadDetachKey, detachThread) != 0) {
+        ALOGE("Failed to create thread detach key");
+        return false;
+    }
+    return true;
+}
+
+JNIEnv* getJNIEnv() {
+    if (globalJavaVM == nullptr) {
+        return nullptr;
+    }
+
+    JNIEnv* env = nullptr;
+    jint result = globalJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6);
+
+    if (result == JNI_OK) {
+        return env;
+    } else if (result == JNI_EDETACHED) {
+        if (globalJavaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+            return nullptr;
+        }
+        // Thread specific value is needed only to trigger detachThread on thread exit
+        pthread_setspecific(threadDetachKey, env);
+        return env;
+    } else {
+        return nullptr;
+    }
+}
+
+jclass findGlobalClass(JNIEnv *env, const char *name) {
+    jclass localClass = env->FindClass(name);
+    if (localClass == nullptr) {
+        ALOGE("Class %s not found", name);
+        return nullptr;
+    }
+    auto globalClass = (jclass)env->NewGlobalRef(localClass);
+    env->DeleteLocalRef(localClass);
+    return globalClass;
+}
+
+bool registerNativeMethods(JNIEnv *env, const char *className,
+                           const JNINativeMethod *methods, int count) {
+    jclass clazz = env->FindClass(className);
+    if (clazz == nullptr) {
+        ALOGE("Class %s not found", className);
+        return false;
+    }
+    jint result = env->RegisterNatives(clazz, methods, count);
+    env->DeleteLocalRef(clazz);
+    if (result != JNI_OK) {
+        ALOGE("Failed to register native methods of %s", className);
+        return false;
+    }
+    return true;
+}
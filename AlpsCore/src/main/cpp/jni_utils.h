@@ -0,0 +1,62 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_JNI_UTILS_H_
+#define _ALPS_JNI_UTILS_H_
+
+#include <jni.h>
+
+/**
+ * Stores JavaVM, must be called from JNI_OnLoad.
+ *
+ * @return false if thread detaching mechanism couldn't be initialized
+ */
+bool initJavaVM(JavaVM *vm);
+
+/**
+ * Returns JNIEnv of the calling thread. Threads not created by Java are attached once and
+ * detached automatically when they exit.
+ *
+ * @return JNIEnv or nullptr if thread couldn't be attached
+ */
+JNIEnv* getJNIEnv();
+
+/**
+ * Finds class and creates global reference to it.
+ *
+ * @return global class reference or nullptr if class was not found
+ */
+jclass findGlobalClass(JNIEnv *env, const char *name);
+
+/**
+ * Registers native methods of given class.
+ *
+ * @return false if class was not found or registration failed
+ */
+bool registerNativeMethods(JNIEnv *env, const char *className,
+                           const JNINativeMethod *methods, int count);
+
+#endif //_ALPS_JNI_UTILS_H_
@@ -27,24 +27,39 @@
 #ifndef _ALPS_LOG_H_
 #define _ALPS_LOG_H_
 
-#include <android/log.h>
-
 #ifndef LOG_TAG
 #define LOG_TAG "ALPS_NATIVE_WRAPPER"
 #endif// LOG_TAG
 
-#ifndef NDEBUG
-#define ALOGV(...)  __android_log_print(ANDROID_LOG_VERBOSE,LOG_TAG,__VA_ARGS__)
-#define ALOGD(...)  __android_log_print(ANDROID_LOG_DEBUG,LOG_TAG,__VA_ARGS__)
-#define ALOGI(...)  __android_log_print(ANDROID_LOG_INFO,LOG_TAG,__VA_ARGS__)
-#define ALOGW(...)  __android_log_print(ANDROID_LOG_WARN,LOG_TAG,__VA_ARGS__)
-#define ALOGE(...)  __android_log_print(ANDROID_LOG_ERROR,LOG_TAG,__VA_ARGS__)
+#include "native_logger.h"
+
+// Messages below the compile-time minimum level are compiled out. Release builds keep warnings and
+// errors, host builds keep verbose messages only with ALPS_HOST_VERBOSE_LOG, so that per segment
+// logs don't dominate host benchmarks.
+#ifndef ALPS_LOG_MIN_LEVEL
+#if defined(__ANDROID__) && !defined(NDEBUG)
+#define ALPS_LOG_MIN_LEVEL ALPS_LOG_LEVEL_VERBOSE
+#elif !defined(__ANDROID__) && defined(ALPS_HOST_VERBOSE_LOG)
+#define ALPS_LOG_MIN_LEVEL ALPS_LOG_LEVEL_VERBOSE
 #else
-#define ALOGV(...) ((void)0)
-#define ALOGD(...) ((void)0)
-#define ALOGI(...) ((void)0)
-#define ALOGW(...) ((void)0)
-#define ALOGE(...) ((void)0)
+#define ALPS_LOG_MIN_LEVEL ALPS_LOG_LEVEL_WARN
 #endif
+#endif // ALPS_LOG_MIN_LEVEL
+
+// Every call site is rate limited separately, errors are not rate limited
+#define ALOG(level, ...) \
+    do { \
+        if ((level) >= ALPS_LOG_MIN_LEVEL && \
+            (level) >= nativeLogLevel.load(std::memory_order_relaxed)) { \
+            static LogRateLimiter alogRateLimiter; \
+            NativeLogger::shared().log(&alogRateLimiter, (level), LOG_TAG, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ALOGV(...)  ALOG(ALPS_LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#define ALOGD(...)  ALOG(ALPS_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define ALOGI(...)  ALOG(ALPS_LOG_LEVEL_INFO, __VA_ARGS__)
+#define ALOGW(...)  ALOG(ALPS_LOG_LEVEL_WARN, __VA_ARGS__)
+#define ALOGE(...)  ALOG(ALPS_LOG_LEVEL_ERROR, __VA_ARGS__)
 
 #endif //_ALPS_LOG_H_
@@ -0,0 +1,84 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_METRICS_H_
+#define _ALPS_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+
+static inline uint64_t monotonicTimeNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Lock-free latency histogram with fixed power of two buckets. Bucket i counts durations in
+ * [2^i, 2^(i+1)) ns, bucket 0 also counts 0 ns and the last bucket counts everything longer.
+ *
+ * Recording is two relaxed atomic increments, so it is cheap enough to stay enabled.
+ */
+class LatencyHistogram {
+public:
+    static const size_t BUCKET_COUNT = 32;
+
+    void record(uint64_t durationNs) {
+        buckets[bucketIndex(durationNs)].fetch_add(1, std::memory_order_relaxed);
+        totalNs.fetch_add(durationNs, std::memory_order_relaxed);
+    }
+
+    uint64_t total() const { return totalNs.load(std::memory_order_relaxed); }
+
+    /**
+     * Copies BUCKET_COUNT bucket counters to out. Concurrent records may be partially visible.
+     */
+    void snapshot(uint64_t *out) const {
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            out[i] = buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void reset() {
+        for (auto &bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        totalNs.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t bucketIndex(uint64_t durationNs) {
+        size_t index = 63 - (size_t)__builtin_clzll(durationNs | 1);
+        return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+    }
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> totalNs{0};
+};
+
+#endif //_ALPS_METRICS_H_
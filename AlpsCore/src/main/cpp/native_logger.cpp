@@ -0,0 +1,194 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "native_logger.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+#include "metrics.h"
+
+static const uint64_t RATE_LIMIT_WINDOW_NS = 1000000000ULL;
+// Pending records are written at least this often, sooner when the buffer is half full
+static const auto DRAIN_INTERVAL = std::chrono::milliseconds(50);
+
+std::atomic<int> nativeLogLevel{ALPS_LOG_LEVEL_INFO};
+
+void setNativeLogLevel(int level) {
+    nativeLogLevel.store(level, std::memory_order_relaxed);
+}
+
+static void writePlatformLog(int level, const char *tag, const char *message) {
+#ifdef __ANDROID__
+    __android_log_write(level, tag, message);
+#else
+    static const char LEVEL_NAMES[] = "??VDIWEF";
+    char levelName = level >= 0 && level < (int)sizeof(LEVEL_NAMES) - 1 ? LEVEL_NAMES[level] : '?';
+    fprintf(stderr, "%c %s: %s\n", levelName, tag, message);
+#endif
+}
+
+// Returns false if the message should be suppressed, otherwise sets number of messages suppressed
+// since the last logged one
+static bool checkRateLimit(LogRateLimiter *limiter, uint32_t *suppressed) {
+    uint64_t now = monotonicTimeNs();
+    uint64_t windowStart = limiter->windowStartNs.load(std::memory_order_relaxed);
+    if (now - windowStart >= RATE_LIMIT_WINDOW_NS &&
+        limiter->windowStartNs.compare_exchange_strong(windowStart, now,
+                                                       std::memory_order_relaxed)) {
+        limiter->windowCount.store(0, std::memory_order_relaxed);
+    }
+    if (limiter->windowCount.fetch_add(1, std::memory_order_relaxed) >=
+        NativeLogger::RATE_LIMIT_PER_SECOND) {
+        limiter->suppressedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    *suppressed = limiter->suppressedCount.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+// Length of the longest prefix of message not longer than length that doesn't end with an
+// incomplete UTF-8 sequence
+static size_t utf8PrefixLength(const char *message, size_t length) {
+    size_t start = length;
+    while (start > 0 && ((uint8_t)message[start - 1] & 0xc0) == 0x80) {
+        start--;
+    }
+    if (start == 0) {
+        return length;
+    }
+    auto lead = (uint8_t)message[start - 1];
+    size_t sequenceLength = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+    return length - (start - 1) < sequenceLength ? start - 1 : length;
+}
+
+NativeLogger& NativeLogger::shared() {
+    // Not destroyed at exit, the detached logger thread may still use it
+    static NativeLogger *logger = [] {
+        auto *instance = new NativeLogger();
+        std::thread(&NativeLogger::run, instance).detach();
+        return instance;
+    }();
+    return *logger;
+}
+
+NativeLogger::NativeLogger() {
+    for (size_t i = 0; i < CAPACITY; i++) {
+        records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void NativeLogger::log(LogRateLimiter *limiter, int level, const char *tag,
+                       const char *format, ...) {
+    uint32_t suppressed = 0;
+    // Errors are never suppressed, they are rare and each of them may be the one that matters
+    if (limiter != nullptr && level < ALPS_LOG_LEVEL_ERROR &&
+        !checkRateLimit(limiter, &suppressed)) {
+        return;
+    }
+
+    // Bounded multi-producer queue: a slot is free for position p when its sequence equals p and
+    // readable when it equals p + 1
+    Record *record;
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        record = &records[position % CAPACITY];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        auto difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                      std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(record->message, MESSAGE_SIZE, format, arguments);
+    va_end(arguments);
+    if (length >= (int)MESSAGE_SIZE) {
+        // Truncated message is passed to NewStringUTF, which requires complete sequences
+        record->message[utf8PrefixLength(record->message, MESSAGE_SIZE - 1)] = '\0';
+    }
+    if (suppressed > 0 && length >= 0 && (size_t)length < MESSAGE_SIZE) {
+        snprintf(record->message + length, MESSAGE_SIZE - length,
+                 " (%u similar messages suppressed)", suppressed);
+    }
+    record->level = level;
+    record->tag = tag;
+    record->sequence.store(position + 1, std::memory_order_release);
+
+    if (position + 1 - dequeuePosition.load(std::memory_order_relaxed) >= CAPACITY / 2) {
+        wakeCondition.notify_one();
+    }
+}
+
+void NativeLogger::setSink(LogSink newSink) {
+    sink.store(newSink);
+}
+
+void NativeLogger::flush() {
+    drain();
+}
+
+void NativeLogger::drain() {
+    std::lock_guard<std::mutex> lock(drainMutex);
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        Record &record = records[position % CAPACITY];
+        if (record.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+        }
+        writePlatformLog(record.level, record.tag, record.message);
+        LogSink currentSink = sink.load();
+        if (currentSink != nullptr) {
+            currentSink(record.level, record.tag, record.message);
+        }
+        record.sequence.store(position + CAPACITY, std::memory_order_release);
+        position++;
+        dequeuePosition.store(position, std::memory_order_relaxed);
+    }
+}
+
+void NativeLogger::run() {
+    for (;;) {
+        drain();
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait_for(lock, DRAIN_INTERVAL);
+    }
+}
@@ -0,0 +1,127 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_NATIVE_LOGGER_H_
+#define _ALPS_NATIVE_LOGGER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Values match android_LogPriority
+#define ALPS_LOG_LEVEL_VERBOSE 2
+#define ALPS_LOG_LEVEL_DEBUG   3
+#define ALPS_LOG_LEVEL_INFO    4
+#define ALPS_LOG_LEVEL_WARN    5
+#define ALPS_LOG_LEVEL_ERROR   6
+#define ALPS_LOG_LEVEL_NONE    8
+
+/**
+ * Receives drained log records on the logger thread.
+ */
+typedef void (*LogSink)(int level, const char *tag, const char *message);
+
+/**
+ * State of a single logging call site, limits how often a message repeated in a hot path is
+ * logged.
+ */
+struct LogRateLimiter {
+    std::atomic<uint64_t> windowStartNs{0};
+    std::atomic<uint32_t> windowCount{0};
+    std::atomic<uint32_t> suppressedCount{0};
+};
+
+/**
+ * Asynchronous logger. Messages are formatted on the calling thread into a fixed size lock-free
+ * ring buffer and written to the platform log (logcat or stderr) and the optional sink by a
+ * background thread, so logging call doesn't make any system call. Messages logged while the
+ * buffer is full are dropped and counted.
+ */
+class NativeLogger {
+public:
+    static const size_t CAPACITY = 256;
+    // Longer messages are truncated at a UTF-8 sequence boundary
+    static const size_t MESSAGE_SIZE = 240;
+    // Messages logged by a single call site within a second above this limit are suppressed,
+    // except errors
+    static const uint32_t RATE_LIMIT_PER_SECOND = 10;
+
+    /**
+     * Process wide logger, never destroyed. Logger thread is started on first use.
+     */
+    static NativeLogger& shared();
+
+    void log(LogRateLimiter *limiter, int level, const char *tag, const char *format, ...)
+            __attribute__((format(printf, 5, 6)));
+
+    /**
+     * Sets sink receiving all records in addition to the platform log, nullptr removes it.
+     */
+    void setSink(LogSink sink);
+
+    /**
+     * Writes all pending records on the calling thread, e.g. before process exit.
+     */
+    void flush();
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    NativeLogger(const NativeLogger&) = delete;
+    NativeLogger& operator=(const NativeLogger&) = delete;
+
+private:
+    struct Record {
+        std::atomic<size_t> sequence;
+        int level;
+        const char *tag;
+        char message[MESSAGE_SIZE];
+    };
+
+    NativeLogger();
+
+    void run();
+    void drain();
+
+    Record records[CAPACITY];
+    std::atomic<size_t> enqueuePosition{0};
+    std::atomic<size_t> dequeuePosition{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<LogSink> sink{nullptr};
+
+    // Serializes draining by the logger thread and flush
+    std::mutex drainMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+};
+
+// Runtime level threshold, messages below it are discarded before formatting
+extern std::atomic<int> nativeLogLevel;
+
+void setNativeLogLevel(int level);
+
+#endif //_ALPS_NATIVE_LOGGER_H_
@@ -0,0 +1,89 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "presentation_snapshot.h"
+
+// Reader increments the counter of the epoch it has seen before loading the pointer, the writer
+// swaps the pointer before checking counters, all sequentially consistent. Epoch advances only
+// when the counter of the previous epoch is zero, after all swaps of the current epoch. A reader
+// holding a snapshot retired in epoch e incremented either the counter of e, checked before the
+// snapshot is deleted in epoch e + 1, or the counter of e - 1, which keeps the epoch from
+// advancing past e while the reader is active.
+
+SnapshotPublisher::Reader::Reader(const SnapshotPublisher &publisher) : publisher(publisher) {
+    epochSlot = publisher.epoch.load(std::memory_order_seq_cst) & 1;
+    publisher.activeReaders[epochSlot].fetch_add(1, std::memory_order_seq_cst);
+    pinned = publisher.snapshot.load(std::memory_order_seq_cst);
+}
+
+SnapshotPublisher::Reader::~Reader() {
+    publisher.activeReaders[epochSlot].fetch_sub(1, std::memory_order_release);
+}
+
+SnapshotPublisher::SnapshotPublisher() : snapshot(new PresentationSnapshot()) {
+    activeReaders[0].store(0, std::memory_order_relaxed);
+    activeReaders[1].store(0, std::memory_order_relaxed);
+}
+
+SnapshotPublisher::~SnapshotPublisher() {
+    // Binding layer doesn't read the snapshot of a session being destroyed
+    delete snapshot.load(std::memory_order_relaxed);
+    for (auto &retiredSnapshots : retired) {
+        for (PresentationSnapshot *retiredSnapshot : retiredSnapshots) {
+            delete retiredSnapshot;
+        }
+    }
+}
+
+void SnapshotPublisher::publish(PresentationSnapshot *newSnapshot) {
+    uint32_t current = epoch.load(std::memory_order_relaxed);
+    retired[current & 1].push_back(snapshot.exchange(newSnapshot, std::memory_order_seq_cst));
+    reclaim();
+}
+
+const PresentationSnapshot &SnapshotPublisher::current() const {
+    return *snapshot.load(std::memory_order_relaxed);
+}
+
+void SnapshotPublisher::reclaim() {
+    // Without readers both epochs are reclaimed, the second pass deletes the snapshots of the
+    // epoch that just became the previous one
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t current = epoch.load(std::memory_order_relaxed);
+        uint32_t previousSlot = (current + 1) & 1;
+        if (activeReaders[previousSlot].load(std::memory_order_seq_cst) != 0) {
+            return;
+        }
+        for (PresentationSnapshot *retiredSnapshot : retired[previousSlot]) {
+            delete retiredSnapshot;
+        }
+        retired[previousSlot].clear();
+        if (retired[current & 1].empty()) {
+            return;
+        }
+        epoch.store(current + 1, std::memory_order_seq_cst);
+    }
+}
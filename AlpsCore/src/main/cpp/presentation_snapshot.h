@@ -0,0 +1,128 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_PRESENTATION_SNAPSHOT_H_
+#define _ALPS_PRESENTATION_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include "dlb_alps_native.h"
+}
+
+struct SnapshotPresentation {
+    int presentationId;
+    std::string label;
+    std::string language;
+};
+
+/**
+ * Immutable copy of the presentations list and the active presentation ID of a session, taken
+ * after a call that could change them. Results of the ALPS getters are kept, so that readers of
+ * the snapshot report the same errors as the getters would.
+ */
+struct PresentationSnapshot {
+    alps_ret presentationsStatus = ALPS_RET_OK;
+    std::vector<SnapshotPresentation> presentations;
+    alps_ret activePresentationStatus = ALPS_RET_OK;
+    int activePresentationId = ALPS_INVALID_PRES_ID;
+    // Presentations list generation the snapshot was taken at
+    uint64_t generation = 0;
+};
+
+/**
+ * Publishes presentation snapshots to lock-free readers. Writer swaps the snapshot pointer
+ * atomically and retires the previous snapshot, readers never wait for the writer and the writer
+ * never waits for readers.
+ *
+ * Retired snapshots are reclaimed by epochs. Readers are counted per parity of the epoch they
+ * started in and snapshots are retired to the list of the current epoch. Once no reader of the
+ * previous epoch is left, snapshots retired in it are deleted and the epoch is advanced, so new
+ * readers never join the counter that has to drain. At most two epochs of retired snapshots are
+ * kept, even if readers overlap all the time.
+ *
+ * Writer calls (publish, reclaim, current) must be serialized by the caller.
+ */
+class SnapshotPublisher {
+public:
+    /**
+     * Keeps the current snapshot alive for its scope, doesn't block.
+     */
+    class Reader {
+    public:
+        explicit Reader(const SnapshotPublisher &publisher);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const PresentationSnapshot &snapshot() const { return *pinned; }
+
+    private:
+        const SnapshotPublisher &publisher;
+        const PresentationSnapshot *pinned;
+        // Parity of the epoch the reader is counted in
+        uint32_t epochSlot;
+    };
+
+    SnapshotPublisher();
+    ~SnapshotPublisher();
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    /**
+     * Replaces the current snapshot, publisher takes ownership of snapshot.
+     */
+    void publish(PresentationSnapshot *snapshot);
+
+    /**
+     * Writer side view of the current snapshot.
+     */
+    const PresentationSnapshot &current() const;
+
+    /**
+     * Deletes snapshots retired in epochs without active readers.
+     */
+    void reclaim();
+
+    size_t retiredCount() const { return retired[0].size() + retired[1].size(); }
+
+private:
+    std::atomic<PresentationSnapshot*> snapshot;
+    // Advanced by the writer only
+    std::atomic<uint32_t> epoch{0};
+    mutable std::atomic<uint32_t> activeReaders[2];
+    // Snapshots retired in the current and in the previous epoch, indexed by parity, owned by the
+    // writer
+    std::vector<PresentationSnapshot*> retired[2];
+};
+
+#endif //_ALPS_PRESENTATION_SNAPSHOT_H_
@@ -0,0 +1,184 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "processing_queue.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+#include "log.h"
+#include "trace.h"
+
+ProcessingQueue *ProcessingQueue::start(ProcessFunction process,
+                                        CompleteFunction complete,
+                                        size_t threadCount) {
+    if (threadCount == 0) {
+        size_t cpuCount = std::max(std::thread::hardware_concurrency(), 1u);
+        threadCount = cpuCount < MAX_THREAD_COUNT ? cpuCount : MAX_THREAD_COUNT;
+    }
+
+    auto *queue = new (std::nothrow) ProcessingQueue(process, complete);
+    if (queue == nullptr) {
+        ALOGE("Failed to allocate processing queue");
+        return nullptr;
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        std::thread(&ProcessingQueue::run, queue).detach();
+    }
+    ALOGI("Processing queue started, threads: %zu", threadCount);
+    return queue;
+}
+
+ProcessingQueue::ProcessingQueue(ProcessFunction process, CompleteFunction complete)
+    : process(process), complete(complete), readyHead(nullptr), readyTail(nullptr),
+      freeJobs(nullptr), maxQueuedJobs(DEFAULT_MAX_QUEUED_JOBS),
+      maxQueuedBytes(DEFAULT_MAX_QUEUED_BYTES), stats() {
+}
+
+bool ProcessingQueue::isFull(size_t size) const {
+    return stats.queuedJobs >= maxQueuedJobs ||
+           (stats.queuedJobs > 0 && stats.queuedBytes + size > maxQueuedBytes);
+}
+
+void ProcessingQueue::waitForCapacity(size_t size) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (!isFull(size)) {
+        return;
+    }
+    stats.capacityWaits++;
+    ScopedTrace trace("ProcessingQueue::waitForCapacity");
+    capacityAvailable.wait(guard, [this, size] { return !isFull(size); });
+}
+
+bool ProcessingQueue::submit(AlpsSession *session,
+                             uint8_t *segment,
+                             size_t size,
+                             void *completionRef) {
+    std::lock_guard<std::mutex> guard(lock);
+    ProcessingJob *job = freeJobs;
+    if (job != nullptr) {
+        freeJobs = job->next;
+    } else {
+        job = new (std::nothrow) ProcessingJob;
+        if (job == nullptr) {
+            ALOGE("Failed to allocate processing job");
+            return false;
+        }
+    }
+    *job = {session, segment, size, completionRef, ProcessingStatus::FAILED, ALPS_RET_OK, nullptr};
+    session->retain();
+
+    stats.queuedJobs++;
+    stats.queuedBytes += size;
+    if (session->queuedJobsTail != nullptr) {
+        session->queuedJobsTail->next = job;
+    } else {
+        session->queuedJobsHead = job;
+    }
+    session->queuedJobsTail = job;
+
+    // Scheduled session is either in the ready list or being processed, the worker reschedules it
+    if (!session->processingScheduled) {
+        session->processingScheduled = true;
+        session->processingNext = nullptr;
+        if (readyTail != nullptr) {
+            readyTail->processingNext = session;
+        } else {
+            readyHead = session;
+        }
+        readyTail = session;
+        workAvailable.notify_one();
+    }
+    return true;
+}
+
+void ProcessingQueue::setLimits(size_t maxQueuedJobs, size_t maxQueuedBytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->maxQueuedJobs = std::max<size_t>(maxQueuedJobs, 1);
+    this->maxQueuedBytes = maxQueuedBytes;
+    capacityAvailable.notify_all();
+}
+
+ProcessingQueueStatistics ProcessingQueue::statistics() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+void ProcessingQueue::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        workAvailable.wait(guard, [this] { return readyHead != nullptr; });
+
+        AlpsSession *session = readyHead;
+        readyHead = session->processingNext;
+        if (readyHead == nullptr) {
+            readyTail = nullptr;
+        }
+        ProcessingJob *job = session->queuedJobsHead;
+        session->queuedJobsHead = job->next;
+        if (session->queuedJobsHead == nullptr) {
+            session->queuedJobsTail = nullptr;
+        }
+
+        guard.unlock();
+        process(job);
+        guard.lock();
+
+        stats.queuedJobs--;
+        stats.queuedBytes -= job->size;
+        stats.completedJobs++;
+        capacityAvailable.notify_all();
+
+        // Completion may submit again from this thread, so it must not count against the limits.
+        // Session is rescheduled afterwards to keep completions of a session in order.
+        guard.unlock();
+        complete(job);
+        guard.lock();
+
+        if (session->queuedJobsHead != nullptr) {
+            // Back of the ready list, so that other sessions are served in the meantime
+            session->processingNext = nullptr;
+            if (readyTail != nullptr) {
+                readyTail->processingNext = session;
+            } else {
+                readyHead = session;
+            }
+            readyTail = session;
+            workAvailable.notify_one();
+        } else {
+            session->processingScheduled = false;
+        }
+
+        job->next = freeJobs;
+        freeJobs = job;
+
+        // Last reference may recycle the session, which must not happen under the queue lock
+        guard.unlock();
+        session->release();
+        guard.lock();
+    }
+}
@@ -0,0 +1,146 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_PROCESSING_QUEUE_H_
+#define _ALPS_PROCESSING_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+
+#include "alps_session.h"
+
+struct ProcessingJob {
+    // Retained by the queue until the job is completed
+    AlpsSession *session;
+    uint8_t *segment;
+    size_t size;
+    // Completion object of the binding layer (e.g. JNI global reference), owned by the binding
+    // layer
+    void *completionRef;
+    // Result of processing, set by ProcessFunction for CompleteFunction
+    ProcessingStatus status;
+    alps_ret error;
+    // Next job of the same session
+    ProcessingJob *next;
+};
+
+struct ProcessingQueueStatistics {
+    // jobs submitted and not processed yet, including the ones being processed
+    uint64_t queuedJobs;
+    // bytes of queued jobs
+    uint64_t queuedBytes;
+    // number of processed jobs
+    uint64_t completedJobs;
+    // number of waitForCapacity calls that had to wait for queued jobs to complete
+    uint64_t capacityWaits;
+};
+
+/**
+ * Processes segments asynchronously on a pool of worker threads.
+ *
+ * Jobs of a single session are processed and completed one at a time, in submission order.
+ * Sessions with queued jobs are served round robin, so independent sessions (e.g. audio
+ * representations, periods or players) are processed in parallel and a busy session doesn't
+ * starve the others.
+ *
+ * Number of queued jobs and bytes is bounded. Producers call waitForCapacity before submitting,
+ * which blocks while the queue is full. Limits are soft - concurrent producers may exceed them by
+ * one job each, so that submit itself never blocks.
+ */
+class ProcessingQueue {
+public:
+    static const size_t MAX_THREAD_COUNT = 4;
+    static const size_t DEFAULT_MAX_QUEUED_JOBS = 32;
+    static const size_t DEFAULT_MAX_QUEUED_BYTES = 32 * 1024 * 1024;
+
+    /**
+     * Processes the job and stores the result in it. Called on a worker thread, session is
+     * retained.
+     */
+    typedef void (*ProcessFunction)(ProcessingJob *job);
+
+    /**
+     * Completes the processed job. Called on a worker thread after the job is removed from the
+     * queue limits, so the completion may submit further jobs from the same thread.
+     */
+    typedef void (*CompleteFunction)(ProcessingJob *job);
+
+    /**
+     * Starts worker threads. Queue is never destroyed, threads run until the process exits.
+     *
+     * @param threadCount number of worker threads, 0 to use number of CPUs up to MAX_THREAD_COUNT
+     */
+    static ProcessingQueue *start(ProcessFunction process,
+                                  CompleteFunction complete,
+                                  size_t threadCount = 0);
+
+    ProcessingQueue(const ProcessingQueue&) = delete;
+    ProcessingQueue& operator=(const ProcessingQueue&) = delete;
+
+    /**
+     * Blocks while the queue is full. Single job larger than maxQueuedBytes is accepted by an
+     * empty queue.
+     *
+     * @param size size of the job about to be submitted
+     */
+    void waitForCapacity(size_t size);
+
+    /**
+     * Queues processing of the segment, doesn't block. Segment must stay valid until the job is
+     * completed.
+     *
+     * @return false if the job couldn't be allocated
+     */
+    bool submit(AlpsSession *session, uint8_t *segment, size_t size, void *completionRef);
+
+    void setLimits(size_t maxQueuedJobs, size_t maxQueuedBytes);
+
+    ProcessingQueueStatistics statistics();
+
+private:
+    ProcessingQueue(ProcessFunction process, CompleteFunction complete);
+
+    void run();
+    bool isFull(size_t size) const;
+
+    ProcessFunction process;
+    CompleteFunction complete;
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::condition_variable capacityAvailable;
+    // FIFO list of sessions with queued jobs that are not being processed
+    AlpsSession *readyHead;
+    AlpsSession *readyTail;
+    // Completed jobs kept for reuse, there are never more of them than queued jobs at peak
+    ProcessingJob *freeJobs;
+    size_t maxQueuedJobs;
+    size_t maxQueuedBytes;
+    ProcessingQueueStatistics stats;
+};
+
+#endif //_ALPS_PROCESSING_QUEUE_H_
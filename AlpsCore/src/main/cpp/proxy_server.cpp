@@ -0,0 +1,1240 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "proxy_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+
+#include "buffer_pool.h"
+#include "log.h"
+#include "metrics.h"
+#include "segment_stream.h"
+#include "trace.h"
+#include "types.h"
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+namespace {
+
+const size_t MAX_HEADER_SIZE = 16 * 1024;
+const size_t MIN_IO_BUFFER_SIZE = 32 * 1024;
+const size_t REQUEST_READ_SIZE = 4096;
+const int MAX_EVENTS = 256;
+// Connections accepted by a single wake up, so that one thread doesn't take a whole burst
+const int MAX_ACCEPTS_PER_EVENT = 64;
+const size_t MAX_FREE_CONNECTIONS = 1024;
+const int EXPIRY_INTERVAL_MS = 1000;
+
+const char PRESENTATION_PARAMETER[] = "alps_presentation";
+const char SESSION_PARAMETER[] = "alps_session";
+
+void onPresentationsChanged(void *callbackCtx) {
+    auto *session = (AlpsSession*)callbackCtx;
+    session->counters.presentationsChangedCount.fetch_add(1, std::memory_order_relaxed);
+    session->presentationsGeneration.fetch_add(1);
+}
+
+enum class ExchangeState {
+    READING_REQUEST,
+    CONNECTING,
+    SENDING_REQUEST,
+    READING_RESPONSE_HEADER,
+    FORWARDING_BODY,
+};
+
+enum class Progress {
+    CONTINUE,
+    WAIT,
+    CLOSE,
+};
+
+struct Connection;
+
+// Registered with epoll, so that events identify both the connection and its socket
+struct Endpoint {
+    Connection *connection;
+    int fd;
+    uint32_t events;
+    // Removed from epoll after the peer hung up, reads never block then
+    bool detached;
+};
+
+/**
+ * Client connection and its origin connection. Connections are owned by a single worker and
+ * recycled by it, buffers and the stream keep their capacity between connections.
+ */
+struct Connection {
+    Connection() : stream(nullptr) {
+        client.connection = this;
+        origin.connection = this;
+        client.fd = -1;
+        origin.fd = -1;
+        clear();
+    }
+
+    void clear() {
+        client.events = 0;
+        client.detached = false;
+        origin.events = 0;
+        origin.detached = false;
+        closed = false;
+        peer.clear();
+        request.clear();
+        state = ExchangeState::READING_REQUEST;
+        session = nullptr;
+        upBuffer = nullptr;
+        outBuffer = nullptr;
+        originReused = false;
+        retried = false;
+    }
+
+    Endpoint client;
+    Endpoint origin;
+    bool closed;
+    // Client address, part of session keys
+    std::string peer;
+    // Client bytes not consumed yet, the request header and anything pipelined after it
+    std::string request;
+    // Request forwarded to the origin
+    std::string forward;
+    size_t forwardSent;
+    // Origin connection was used by a previous exchange and may have been closed by the origin
+    bool originReused;
+    bool retried;
+
+    ExchangeState state;
+    ProxySession *session;
+    bool hasPresentation;
+    int presentationId;
+    bool head;
+    bool clientKeepAlive;
+    bool originKeepAlive;
+
+    // Leased from BufferPool for the duration of an exchange
+    uint8_t *upBuffer;
+    uint8_t *outBuffer;
+    size_t bufferSize;
+    size_t upStart;
+    size_t upEnd;
+    size_t outStart;
+    size_t outEnd;
+
+    bool processing;
+    bool streamFinished;
+    // Body ends when the origin closes the connection
+    bool closeDelimited;
+    uint64_t bodyRemaining;
+    SegmentStream stream;
+};
+
+bool setNoDelay(int fd) {
+    int enable = 1;
+    return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) == 0;
+}
+
+// Returns offset following the empty line ending the header, 0 if not buffered yet
+size_t findHeaderEnd(const char *data, size_t size) {
+    for (size_t i = 3; i < size; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool nextLine(const char *data, size_t end, size_t *pos, const char **line, size_t *length) {
+    if (*pos >= end) {
+        return false;
+    }
+    const char *start = data + *pos;
+    const char *lineEnd = (const char*)memchr(start, '\r', end - *pos);
+    size_t lineLength = lineEnd == nullptr ? end - *pos : (size_t)(lineEnd - start);
+    *line = start;
+    *length = lineLength;
+    *pos += lineLength + 2;
+    return lineLength > 0;
+}
+
+bool isHeader(const char *line, size_t length, const char *name) {
+    size_t nameLength = strlen(name);
+    return length > nameLength && line[nameLength] == ':' &&
+           strncasecmp(line, name, nameLength) == 0;
+}
+
+void headerValue(const char *line, size_t length, const char **value, size_t *valueLength) {
+    const char *colon = (const char*)memchr(line, ':', length);
+    const char *start = colon + 1;
+    const char *end = line + length;
+    while (start < end && (*start == ' ' || *start == '\t')) start++;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *value = start;
+    *valueLength = (size_t)(end - start);
+}
+
+bool containsToken(const char *value, size_t length, const char *token) {
+    size_t tokenLength = strlen(token);
+    for (size_t i = 0; i + tokenLength <= length; i++) {
+        if (strncasecmp(value + i, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isHopByHopHeader(const char *line, size_t length) {
+    return isHeader(line, length, "Connection") || isHeader(line, length, "Keep-Alive") ||
+           isHeader(line, length, "Proxy-Connection") || isHeader(line, length, "TE") ||
+           isHeader(line, length, "Trailer") || isHeader(line, length, "Upgrade") ||
+           isHeader(line, length, "Proxy-Authorization");
+}
+
+struct ParsedRequest {
+    bool head;
+    bool keepAlive;
+    bool hasPresentation;
+    int presentationId;
+    std::string sessionKey;
+};
+
+/**
+ * Parses client request header and builds the request forwarded to the origin.
+ *
+ * @return 0 or HTTP status of the error response
+ */
+int parseRequest(const char *data, size_t size, const std::string &host, ParsedRequest *request,
+                 std::string *forward) {
+    size_t pos = 0;
+    const char *line;
+    size_t length;
+    if (!nextLine(data, size, &pos, &line, &length)) {
+        return 400;
+    }
+    const char *lineEnd = line + length;
+    const char *methodEnd = (const char*)memchr(line, ' ', length);
+    if (methodEnd == nullptr) {
+        return 400;
+    }
+    const char *target = methodEnd + 1;
+    const char *targetEnd = (const char*)memchr(target, ' ', (size_t)(lineEnd - target));
+    if (targetEnd == nullptr) {
+        return 400;
+    }
+    size_t methodLength = (size_t)(methodEnd - line);
+    request->head = methodLength == 4 && memcmp(line, "HEAD", 4) == 0;
+    if (!request->head && !(methodLength == 3 && memcmp(line, "GET", 3) == 0)) {
+        return 501;
+    }
+    request->keepAlive = (size_t)(lineEnd - targetEnd) == 9 &&
+                         memcmp(targetEnd + 1, "HTTP/1.1", 8) == 0;
+
+    // Absolute form is sent to proxies configured as such, only the path is forwarded
+    if ((size_t)(targetEnd - target) > 7 && strncasecmp(target, "http://", 7) == 0) {
+        const char *path = (const char*)memchr(target + 7, '/', (size_t)(targetEnd - target - 7));
+        target = path == nullptr ? targetEnd : path;
+    }
+    const char *query = (const char*)memchr(target, '?', (size_t)(targetEnd - target));
+    const char *pathEnd = query == nullptr ? targetEnd : query;
+
+    forward->clear();
+    forward->append(line, methodLength);
+    forward->push_back(' ');
+    if (target == pathEnd) {
+        forward->push_back('/');
+    }
+    forward->append(target, (size_t)(pathEnd - target));
+
+    request->hasPresentation = false;
+    request->presentationId = ALPS_INVALID_PRES_ID;
+    std::string sessionName;
+    bool firstParameter = true;
+    for (const char *parameter = pathEnd; parameter < targetEnd;) {
+        parameter++;
+        const char *parameterEnd = (const char*)memchr(parameter, '&',
+                                                       (size_t)(targetEnd - parameter));
+        if (parameterEnd == nullptr) {
+            parameterEnd = targetEnd;
+        }
+        const char *equals = (const char*)memchr(parameter, '=',
+                                                 (size_t)(parameterEnd - parameter));
+        const char *nameEnd = equals == nullptr ? parameterEnd : equals;
+        const char *value = equals == nullptr ? parameterEnd : equals + 1;
+        size_t nameLength = (size_t)(nameEnd - parameter);
+        if (nameLength == sizeof(PRESENTATION_PARAMETER) - 1 &&
+            memcmp(parameter, PRESENTATION_PARAMETER, nameLength) == 0) {
+            request->hasPresentation = true;
+            request->presentationId = (int)strtol(std::string(value, parameterEnd).c_str(),
+                                                  nullptr, 10);
+        } else if (nameLength == sizeof(SESSION_PARAMETER) - 1 &&
+                   memcmp(parameter, SESSION_PARAMETER, nameLength) == 0) {
+            sessionName.assign(value, parameterEnd);
+        } else if (parameterEnd > parameter) {
+            forward->push_back(firstParameter ? '?' : '&');
+            forward->append(parameter, (size_t)(parameterEnd - parameter));
+            firstParameter = false;
+        }
+        parameter = parameterEnd;
+    }
+
+    // Sessions are named by the client or by the directory of the requested segment
+    if (sessionName.empty()) {
+        const char *directoryEnd = pathEnd;
+        while (directoryEnd > target && directoryEnd[-1] != '/') directoryEnd--;
+        request->sessionKey.assign("d:");
+        request->sessionKey.append(target, (size_t)(directoryEnd - target));
+    } else {
+        request->sessionKey.assign("n:");
+        request->sessionKey.append(sessionName);
+    }
+
+    forward->append(" HTTP/1.0\r\nHost: ");
+    forward->append(host);
+    forward->append("\r\nConnection: keep-alive\r\nAccept-Encoding: identity\r\n");
+    while (nextLine(data, size, &pos, &line, &length)) {
+        const char *value;
+        size_t valueLength;
+        if (isHeader(line, length, "Connection") || isHeader(line, length, "Proxy-Connection")) {
+            headerValue(line, length, &value, &valueLength);
+            if (containsToken(value, valueLength, "close")) {
+                request->keepAlive = false;
+            } else if (containsToken(value, valueLength, "keep-alive")) {
+                request->keepAlive = true;
+            }
+            continue;
+        }
+        if (isHeader(line, length, "Content-Length")) {
+            headerValue(line, length, &value, &valueLength);
+            if (valueLength != 1 || value[0] != '0') {
+                // Request bodies are not supported
+                return 501;
+            }
+            continue;
+        }
+        if (isHeader(line, length, "Transfer-Encoding")) {
+            return 501;
+        }
+        if (isHopByHopHeader(line, length) || isHeader(line, length, "Host") ||
+            isHeader(line, length, "Accept-Encoding")) {
+            continue;
+        }
+        forward->append(line, length);
+        forward->append("\r\n");
+    }
+    forward->append("\r\n");
+    return 0;
+}
+
+struct ParsedResponse {
+    int status;
+    bool keepAlive;
+    bool hasBody;
+    bool hasLength;
+    bool chunked;
+    uint64_t contentLength;
+};
+
+/**
+ * Parses origin response header and builds the response header forwarded to the client.
+ *
+ * @return false if the header is malformed
+ */
+bool parseResponse(const char *data, size_t size, bool head, ParsedResponse *response,
+                   std::string *header) {
+    size_t pos = 0;
+    const char *line;
+    size_t length;
+    if (!nextLine(data, size, &pos, &line, &length) || length < 12 ||
+        memcmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ') {
+        return false;
+    }
+    response->status = atoi(line + 9);
+    response->keepAlive = line[7] == '1';
+    response->hasLength = false;
+    response->chunked = false;
+    response->contentLength = 0;
+    response->hasBody = !head && response->status >= 200 && response->status != 204 &&
+                        response->status != 304;
+
+    header->assign("HTTP/1.1");
+    header->append(line + 8, length - 8);
+    header->append("\r\n");
+    while (nextLine(data, size, &pos, &line, &length)) {
+        const char *value;
+        size_t valueLength;
+        if (isHeader(line, length, "Connection")) {
+            headerValue(line, length, &value, &valueLength);
+            if (containsToken(value, valueLength, "close")) {
+                response->keepAlive = false;
+            } else if (containsToken(value, valueLength, "keep-alive")) {
+                response->keepAlive = true;
+            }
+            continue;
+        }
+        if (isHeader(line, length, "Content-Length")) {
+            headerValue(line, length, &value, &valueLength);
+            char *end;
+            std::string text(value, valueLength);
+            response->contentLength = strtoull(text.c_str(), &end, 10);
+            if (text.empty() || *end != '\0') {
+                return false;
+            }
+            response->hasLength = true;
+        } else if (isHeader(line, length, "Transfer-Encoding")) {
+            // Not expected in a response to HTTP/1.0 request, forwarded as is until the origin
+            // closes the connection
+            response->chunked = true;
+        } else if (isHopByHopHeader(line, length)) {
+            continue;
+        }
+        header->append(line, length);
+        header->append("\r\n");
+    }
+    if (response->chunked) {
+        response->hasLength = false;
+    }
+    return true;
+}
+
+const char *statusText(int status) {
+    switch (status) {
+        case 400: return "Bad Request";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+} // namespace
+
+/**
+ * Event loop thread. Connections accepted by the worker are served by it until they are closed.
+ */
+class ProxyServer::Worker {
+public:
+    Worker(ProxyServer *server, int listenFd)
+        : server(server), listenFd(listenFd), epollFd(-1), wakeFd(-1), stopping(false) {
+    }
+
+    ~Worker() {
+        for (Connection *connection : connections) {
+            if (!connection->closed) {
+                closeConnection(connection);
+            }
+            delete connection;
+        }
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+    }
+
+    bool init() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) {
+            return false;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &wakeFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) != 0) {
+            return false;
+        }
+        // Exclusive wake up, so that a new connection wakes a single worker
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.ptr = &this->listenFd;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+    }
+
+    void stop() {
+        stopping.store(true);
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void run() {
+        epoll_event events[MAX_EVENTS];
+        while (!stopping.load()) {
+            int count = epoll_wait(epollFd, events, MAX_EVENTS, EXPIRY_INTERVAL_MS);
+            for (int i = 0; i < count; i++) {
+                void *target = events[i].data.ptr;
+                if (target == &listenFd) {
+                    acceptConnections();
+                } else if (target != &wakeFd) {
+                    onEvent((Endpoint*)target, events[i].events);
+                }
+            }
+            // Closed connections are recycled only after the whole batch, later events of the
+            // batch may still refer to them
+            for (Connection *connection : closedConnections) {
+                recycle(connection);
+            }
+            closedConnections.clear();
+            server->expireSessions();
+        }
+    }
+
+private:
+    void acceptConnections() {
+        for (int i = 0; i < MAX_ACCEPTS_PER_EVENT; i++) {
+            sockaddr_in address;
+            socklen_t addressLength = sizeof(address);
+            int fd = accept4(listenFd, (sockaddr*)&address, &addressLength,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    ALOGW("Accepting connection failed: %s", strerror(errno));
+                }
+                return;
+            }
+            setNoDelay(fd);
+
+            Connection *connection = obtainConnection();
+            if (connection == nullptr) {
+                close(fd);
+                continue;
+            }
+            char peer[INET_ADDRSTRLEN] = {};
+            inet_ntop(AF_INET, &address.sin_addr, peer, sizeof(peer));
+            connection->peer.assign(peer);
+            connection->client.fd = fd;
+            if (!setInterest(&connection->client, EPOLLIN)) {
+                closeConnection(connection);
+                continue;
+            }
+            server->stats.acceptedConnections.fetch_add(1, std::memory_order_relaxed);
+            server->stats.openConnections.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Connection *obtainConnection() {
+        if (!freeConnections.empty()) {
+            Connection *connection = freeConnections.back();
+            freeConnections.pop_back();
+            return connection;
+        }
+        auto *connection = new (std::nothrow) Connection();
+        if (connection != nullptr) {
+            connections.push_back(connection);
+        }
+        return connection;
+    }
+
+    void recycle(Connection *connection) {
+        if (freeConnections.size() < MAX_FREE_CONNECTIONS) {
+            connection->clear();
+            freeConnections.push_back(connection);
+            return;
+        }
+        connections.erase(std::find(connections.begin(), connections.end(), connection));
+        delete connection;
+    }
+
+    /**
+     * Registers the endpoint with epoll on first use, updates its events afterwards.
+     */
+    bool setInterest(Endpoint *endpoint, uint32_t events) {
+        if (endpoint->fd < 0 || endpoint->detached) {
+            return true;
+        }
+        // Registered sockets without interest still report errors and hang ups
+        if (events == 0) {
+            events = EPOLLERR;
+        }
+        if (endpoint->events == events) {
+            return true;
+        }
+        epoll_event event = {};
+        event.events = events;
+        event.data.ptr = endpoint;
+        int operation = endpoint->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(epollFd, operation, endpoint->fd, &event) != 0) {
+            return false;
+        }
+        endpoint->events = events;
+        return true;
+    }
+
+    void detach(Endpoint *endpoint) {
+        if (endpoint->fd >= 0 && !endpoint->detached) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, endpoint->fd, nullptr);
+            endpoint->detached = true;
+        }
+    }
+
+    void onEvent(Endpoint *endpoint, uint32_t events) {
+        Connection *connection = endpoint->connection;
+        if (connection->closed || endpoint->fd < 0) {
+            return;
+        }
+        if (endpoint == &connection->client && (events & (EPOLLERR | EPOLLHUP))) {
+            closeConnection(connection);
+            return;
+        }
+        if (endpoint == &connection->origin) {
+            if (connection->state == ExchangeState::READING_REQUEST) {
+                // Idle origin connection was closed by the origin
+                closeOrigin(connection);
+                return;
+            }
+            if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN) &&
+                connection->state == ExchangeState::FORWARDING_BODY) {
+                // Remaining body is read without waiting once the client accepts more data
+                detach(endpoint);
+            }
+        }
+        advance(connection);
+    }
+
+    void closeOrigin(Connection *connection) {
+        if (connection->origin.fd >= 0) {
+            close(connection->origin.fd);
+        }
+        connection->origin.fd = -1;
+        connection->origin.events = 0;
+        connection->origin.detached = false;
+        connection->originReused = false;
+    }
+
+    void closeConnection(Connection *connection) {
+        finishExchange(connection);
+        closeOrigin(connection);
+        if (connection->client.fd >= 0) {
+            close(connection->client.fd);
+            server->stats.openConnections.fetch_sub(1, std::memory_order_relaxed);
+        }
+        connection->client.fd = -1;
+        connection->closed = true;
+        closedConnections.push_back(connection);
+    }
+
+    /**
+     * Releases session and buffers of the exchange.
+     */
+    void finishExchange(Connection *connection) {
+        if (connection->session != nullptr) {
+            server->releaseSession(connection->session);
+            connection->session = nullptr;
+        }
+        if (connection->upBuffer != nullptr) {
+            BufferPool::shared().release(connection->upBuffer);
+            connection->upBuffer = nullptr;
+        }
+        if (connection->outBuffer != nullptr) {
+            BufferPool::shared().release(connection->outBuffer);
+            connection->outBuffer = nullptr;
+        }
+    }
+
+    bool leaseBuffers(Connection *connection) {
+        size_t size = std::max(server->config.ioBufferSize, MIN_IO_BUFFER_SIZE);
+        connection->upBuffer = (uint8_t*)BufferPool::shared().acquire(size);
+        connection->outBuffer = (uint8_t*)BufferPool::shared().acquire(size);
+        connection->bufferSize = size;
+        connection->upStart = connection->upEnd = 0;
+        connection->outStart = connection->outEnd = 0;
+        return connection->upBuffer != nullptr && connection->outBuffer != nullptr;
+    }
+
+    /**
+     * Drives the connection until it has to wait for a socket, then updates its epoll interest.
+     */
+    void advance(Connection *connection) {
+        Progress progress;
+        do {
+            switch (connection->state) {
+                case ExchangeState::READING_REQUEST:
+                    progress = readRequest(connection);
+                    break;
+                case ExchangeState::CONNECTING:
+                    progress = connectOrigin(connection);
+                    break;
+                case ExchangeState::SENDING_REQUEST:
+                    progress = sendRequest(connection);
+                    break;
+                case ExchangeState::READING_RESPONSE_HEADER:
+                    progress = readResponseHeader(connection);
+                    break;
+                case ExchangeState::FORWARDING_BODY:
+                default:
+                    progress = forwardBody(connection);
+                    break;
+            }
+        } while (progress == Progress::CONTINUE);
+
+        if (progress == Progress::CLOSE) {
+            closeConnection(connection);
+            return;
+        }
+
+        uint32_t clientEvents = 0;
+        uint32_t originEvents = 0;
+        switch (connection->state) {
+            case ExchangeState::READING_REQUEST:
+                clientEvents = EPOLLIN;
+                break;
+            case ExchangeState::CONNECTING:
+            case ExchangeState::SENDING_REQUEST:
+                originEvents = EPOLLOUT;
+                break;
+            case ExchangeState::READING_RESPONSE_HEADER:
+                originEvents = EPOLLIN;
+                break;
+            case ExchangeState::FORWARDING_BODY:
+                if (connection->outStart < connection->outEnd) {
+                    clientEvents = EPOLLOUT;
+                } else {
+                    originEvents = EPOLLIN;
+                }
+                break;
+        }
+        if (!setInterest(&connection->client, clientEvents) ||
+            !setInterest(&connection->origin, originEvents)) {
+            closeConnection(connection);
+        }
+    }
+
+    Progress readRequest(Connection *connection) {
+        std::string &buffered = connection->request;
+        size_t headerEnd = findHeaderEnd(buffered.data(), buffered.size());
+        if (headerEnd == 0) {
+            if (buffered.size() >= MAX_HEADER_SIZE) {
+                return respondWithError(connection, 431);
+            }
+            size_t size = buffered.size();
+            buffered.resize(size + REQUEST_READ_SIZE);
+            ssize_t count = recv(connection->client.fd, &buffered[size], REQUEST_READ_SIZE, 0);
+            buffered.resize(size + (count > 0 ? (size_t)count : 0));
+            if (count > 0) {
+                return Progress::CONTINUE;
+            }
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return Progress::WAIT;
+            }
+            return Progress::CLOSE;
+        }
+
+        ParsedRequest request;
+        int error = parseRequest(buffered.data(), headerEnd, server->config.upstreamHost,
+                                 &request, &connection->forward);
+        buffered.erase(0, headerEnd);
+        if (error != 0) {
+            return respondWithError(connection, error);
+        }
+        connection->head = request.head;
+        connection->clientKeepAlive = request.keepAlive;
+        connection->hasPresentation = request.hasPresentation;
+        connection->presentationId = request.presentationId;
+        connection->forwardSent = 0;
+        connection->retried = false;
+
+        connection->session = server->acquireSession(connection->peer + "|" +
+                                                     request.sessionKey);
+        if (connection->session == nullptr) {
+            return respondWithError(connection, 503);
+        }
+        if (!leaseBuffers(connection)) {
+            return Progress::CLOSE;
+        }
+        server->stats.requests.fetch_add(1, std::memory_order_relaxed);
+        connection->state = connection->origin.fd < 0
+                ? ExchangeState::CONNECTING : ExchangeState::SENDING_REQUEST;
+        return Progress::CONTINUE;
+    }
+
+    /**
+     * Sends error response and closes the client connection afterwards.
+     */
+    Progress respondWithError(Connection *connection, int status) {
+        if (connection->outBuffer == nullptr && !leaseBuffers(connection)) {
+            return Progress::CLOSE;
+        }
+        closeOrigin(connection);
+        int length = snprintf((char*)connection->outBuffer, connection->bufferSize,
+                              "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                              status, statusText(status));
+        connection->outStart = 0;
+        connection->outEnd = (size_t)length;
+        connection->upStart = connection->upEnd = 0;
+        connection->clientKeepAlive = false;
+        connection->originKeepAlive = false;
+        connection->processing = false;
+        connection->closeDelimited = false;
+        connection->bodyRemaining = 0;
+        connection->state = ExchangeState::FORWARDING_BODY;
+        return Progress::CONTINUE;
+    }
+
+    Progress upstreamFailed(Connection *connection) {
+        server->stats.upstreamErrors.fetch_add(1, std::memory_order_relaxed);
+        return respondWithError(connection, 502);
+    }
+
+    /**
+     * Retries the exchange on a new origin connection if the reused one turned out to be closed.
+     */
+    Progress retryOrFail(Connection *connection) {
+        if (connection->originReused && !connection->retried) {
+            closeOrigin(connection);
+            connection->retried = true;
+            connection->forwardSent = 0;
+            connection->state = ExchangeState::CONNECTING;
+            return Progress::CONTINUE;
+        }
+        return upstreamFailed(connection);
+    }
+
+    Progress connectOrigin(Connection *connection) {
+        if (connection->origin.fd >= 0) {
+            // Woken up by the pending connect
+            int error = 0;
+            socklen_t errorLength = sizeof(error);
+            if (getsockopt(connection->origin.fd, SOL_SOCKET, SO_ERROR, &error,
+                           &errorLength) != 0 || error != 0) {
+                ALOGW("Connecting to origin failed: %s", strerror(error));
+                return upstreamFailed(connection);
+            }
+            connection->state = ExchangeState::SENDING_REQUEST;
+            return Progress::CONTINUE;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return upstreamFailed(connection);
+        }
+        setNoDelay(fd);
+        connection->origin.fd = fd;
+        connection->origin.events = 0;
+        connection->origin.detached = false;
+        connection->originReused = false;
+        const sockaddr_in &address = server->upstream;
+        if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0) {
+            connection->state = ExchangeState::SENDING_REQUEST;
+            return Progress::CONTINUE;
+        }
+        if (errno == EINPROGRESS) {
+            return Progress::WAIT;
+        }
+        ALOGW("Connecting to origin failed: %s", strerror(errno));
+        return upstreamFailed(connection);
+    }
+
+    Progress sendRequest(Connection *connection) {
+        const std::string &forward = connection->forward;
+        while (connection->forwardSent < forward.size()) {
+            ssize_t count = send(connection->origin.fd, forward.data() + connection->forwardSent,
+                                 forward.size() - connection->forwardSent, MSG_NOSIGNAL);
+            if (count < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return Progress::WAIT;
+                }
+                return retryOrFail(connection);
+            }
+            connection->forwardSent += (size_t)count;
+        }
+        connection->upStart = connection->upEnd = 0;
+        connection->state = ExchangeState::READING_RESPONSE_HEADER;
+        return Progress::CONTINUE;
+    }
+
+    Progress readResponseHeader(Connection *connection) {
+        size_t free = connection->bufferSize - connection->upEnd;
+        ssize_t count = recv(connection->origin.fd, connection->upBuffer + connection->upEnd,
+                             free, 0);
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return Progress::WAIT;
+        }
+        if (count <= 0) {
+            return connection->upEnd == 0 ? retryOrFail(connection) : upstreamFailed(connection);
+        }
+        connection->upEnd += (size_t)count;
+
+        size_t headerEnd = findHeaderEnd((const char*)connection->upBuffer, connection->upEnd);
+        if (headerEnd == 0) {
+            if (connection->upEnd >= MAX_HEADER_SIZE) {
+                return upstreamFailed(connection);
+            }
+            return Progress::CONTINUE;
+        }
+
+        ParsedResponse response;
+        if (!parseResponse((const char*)connection->upBuffer, headerEnd, connection->head,
+                           &response, &responseHeader)) {
+            return upstreamFailed(connection);
+        }
+        connection->closeDelimited = response.hasBody && !response.hasLength;
+        if (!response.hasBody) {
+            connection->bodyRemaining = 0;
+        } else {
+            connection->bodyRemaining = connection->closeDelimited ? UINT64_MAX
+                                                                   : response.contentLength;
+        }
+        connection->originKeepAlive = response.keepAlive && !connection->closeDelimited;
+        if (connection->closeDelimited) {
+            // Client can tell the end of the body only by the connection being closed
+            connection->clientKeepAlive = false;
+        }
+        responseHeader.append(connection->clientKeepAlive ? "Connection: keep-alive\r\n\r\n"
+                                                          : "Connection: close\r\n\r\n");
+        if (responseHeader.size() > connection->bufferSize) {
+            return upstreamFailed(connection);
+        }
+        memcpy(connection->outBuffer, responseHeader.data(), responseHeader.size());
+        connection->outStart = 0;
+        connection->outEnd = responseHeader.size();
+        connection->upStart = headerEnd;
+
+        // Only complete segments can be processed, partial content is forwarded as is
+        connection->processing = response.status == 200 && response.hasBody &&
+                                 !response.chunked;
+        connection->streamFinished = false;
+        if (connection->processing) {
+            server->stats.processedResponses.fetch_add(1, std::memory_order_relaxed);
+            connection->stream.reset(connection->session->alps);
+            selectPresentation(connection);
+        } else {
+            server->stats.passthroughResponses.fetch_add(1, std::memory_order_relaxed);
+        }
+        connection->state = ExchangeState::FORWARDING_BODY;
+        return Progress::CONTINUE;
+    }
+
+    /**
+     * Seeds presentation requested by the client, the session activates it once its init segment
+     * lists it.
+     */
+    static void selectPresentation(Connection *connection) {
+        ProxySession *session = connection->session;
+        std::lock_guard<std::mutex> lock(session->alps->contextMutex);
+        if (connection->hasPresentation &&
+            connection->presentationId != session->requestedPresentationId) {
+            session->requestedPresentationId = connection->presentationId;
+            session->alps->seedActivePresentationId(connection->presentationId);
+        }
+    }
+
+    Progress forwardBody(Connection *connection) {
+        for (;;) {
+            while (connection->outStart < connection->outEnd) {
+                ssize_t count = send(connection->client.fd,
+                                     connection->outBuffer + connection->outStart,
+                                     connection->outEnd - connection->outStart, MSG_NOSIGNAL);
+                if (count < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                        return Progress::WAIT;
+                    }
+                    return Progress::CLOSE;
+                }
+                connection->outStart += (size_t)count;
+                server->stats.responseBytes.fetch_add((uint64_t)count,
+                                                      std::memory_order_relaxed);
+            }
+            connection->outStart = connection->outEnd = 0;
+
+            if (connection->processing) {
+                connection->outEnd = connection->stream.read(connection->outBuffer,
+                                                             connection->bufferSize);
+                if (connection->outEnd > 0) {
+                    continue;
+                }
+            }
+
+            if (connection->upStart < connection->upEnd && connection->bodyRemaining > 0) {
+                size_t count = connection->upEnd - connection->upStart;
+                if (count > connection->bodyRemaining) {
+                    count = (size_t)connection->bodyRemaining;
+                }
+                const uint8_t *data = connection->upBuffer + connection->upStart;
+                if (connection->processing) {
+                    std::lock_guard<std::mutex> lock(connection->session->alps->contextMutex);
+                    connection->stream.feed(data, count);
+                } else {
+                    if (count > connection->bufferSize) {
+                        count = connection->bufferSize;
+                    }
+                    memcpy(connection->outBuffer, data, count);
+                    connection->outEnd = count;
+                }
+                connection->upStart += count;
+                if (!connection->closeDelimited) {
+                    connection->bodyRemaining -= count;
+                }
+                continue;
+            }
+
+            if (connection->bodyRemaining == 0) {
+                if (connection->processing && !connection->streamFinished) {
+                    {
+                        std::lock_guard<std::mutex> lock(
+                                connection->session->alps->contextMutex);
+                        connection->stream.finish();
+                    }
+                    connection->streamFinished = true;
+                    continue;
+                }
+                return completeExchange(connection);
+            }
+
+            ssize_t count = recv(connection->origin.fd, connection->upBuffer,
+                                 connection->bufferSize, 0);
+            if (count > 0) {
+                connection->upStart = 0;
+                connection->upEnd = (size_t)count;
+                continue;
+            }
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return Progress::WAIT;
+            }
+            if (count == 0 && connection->closeDelimited) {
+                connection->bodyRemaining = 0;
+                closeOrigin(connection);
+                continue;
+            }
+            // Response was partially forwarded already, the client sees a truncated body
+            ALOGW("Origin connection closed before the end of the body");
+            server->stats.upstreamErrors.fetch_add(1, std::memory_order_relaxed);
+            return Progress::CLOSE;
+        }
+    }
+
+    Progress completeExchange(Connection *connection) {
+        if (connection->upStart < connection->upEnd || !connection->originKeepAlive) {
+            // Anything following the body is not a valid response
+            closeOrigin(connection);
+        } else {
+            connection->originReused = true;
+        }
+        finishExchange(connection);
+        if (!connection->clientKeepAlive) {
+            return Progress::CLOSE;
+        }
+        connection->state = ExchangeState::READING_REQUEST;
+        return Progress::CONTINUE;
+    }
+
+    ProxyServer *server;
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> stopping;
+    // All connections owned by the worker, including free ones
+    std::vector<Connection*> connections;
+    std::vector<Connection*> freeConnections;
+    std::vector<Connection*> closedConnections;
+    // Response header being forwarded, kept to reuse its capacity
+    std::string responseHeader;
+};
+
+ProxyServer::ProxyServer(const ProxyConfig &config)
+    : config(config), upstream(), listenFd(-1), boundPort(0),
+      contextPool(onPresentationsChanged, config.maxIdleContexts) {
+}
+
+ProxyServer::~ProxyServer() {
+    stop();
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    for (auto &entry : sessions) {
+        entry.second->alps->release();
+        delete entry.second;
+    }
+    sessions.clear();
+}
+
+bool ProxyServer::start() {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    int error = getaddrinfo(config.upstreamHost.c_str(), nullptr, &hints, &result);
+    if (error != 0 || result == nullptr) {
+        ALOGE("Failed to resolve %s: %s", config.upstreamHost.c_str(), gai_strerror(error));
+        return false;
+    }
+    upstream = *(const sockaddr_in*)result->ai_addr;
+    upstream.sin_port = htons(config.upstreamPort);
+    freeaddrinfo(result);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.listenPort);
+    if (inet_pton(AF_INET, config.listenAddress.c_str(), &address.sin_addr) != 1) {
+        ALOGE("Invalid listen address %s", config.listenAddress.c_str());
+        return false;
+    }
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int enable = 1;
+    if (listenFd < 0 ||
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0 ||
+        bind(listenFd, (const sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        ALOGE("Failed to listen on %s:%u: %s", config.listenAddress.c_str(),
+              (unsigned)config.listenPort, strerror(errno));
+        stop();
+        return false;
+    }
+    socklen_t addressLength = sizeof(address);
+    getsockname(listenFd, (sockaddr*)&address, &addressLength);
+    boundPort = ntohs(address.sin_port);
+
+    size_t threadCount = config.threadCount;
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        auto *worker = new Worker(this, listenFd);
+        workers.push_back(worker);
+        if (!worker->init()) {
+            ALOGE("Failed to initialize event loop: %s", strerror(errno));
+            stop();
+            return false;
+        }
+    }
+    for (Worker *worker : workers) {
+        threads.emplace_back(&Worker::run, worker);
+    }
+    ALOGI("Proxy listening on port %u, threads: %zu", (unsigned)boundPort, threadCount);
+    return true;
+}
+
+void ProxyServer::stop() {
+    for (Worker *worker : workers) {
+        worker->stop();
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    for (Worker *worker : workers) {
+        delete worker;
+    }
+    workers.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+ProxyStatistics ProxyServer::statistics() const {
+    ProxyStatistics statistics;
+    statistics.acceptedConnections = stats.acceptedConnections.load();
+    statistics.openConnections = stats.openConnections.load();
+    statistics.requests = stats.requests.load();
+    statistics.processedResponses = stats.processedResponses.load();
+    statistics.passthroughResponses = stats.passthroughResponses.load();
+    statistics.upstreamErrors = stats.upstreamErrors.load();
+    statistics.responseBytes = stats.responseBytes.load();
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    statistics.openSessions = sessions.size();
+    return statistics;
+}
+
+ProxySession *ProxyServer::acquireSession(const std::string &key) {
+    {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        auto found = sessions.find(key);
+        if (found != sessions.end()) {
+            found->second->users++;
+            return found->second;
+        }
+    }
+
+    // Context is initialized outside of the lock, sessions of other clients are not blocked
+    alps_ret error = ALPS_RET_OK;
+    AlpsSession *alps = contextPool.acquire(&error);
+    if (alps == nullptr) {
+        ALOGE("Failed to create session, error: %d", error);
+        return nullptr;
+    }
+    auto *session = new (std::nothrow) ProxySession();
+    if (session == nullptr) {
+        alps->release();
+        return nullptr;
+    }
+    session->alps = alps;
+    session->requestedPresentationId = ALPS_INVALID_PRES_ID;
+    session->users = 1;
+    session->lastUsedNs = monotonicTimeNs();
+
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    auto inserted = sessions.emplace(key, session);
+    if (!inserted.second) {
+        // Created concurrently by another exchange
+        alps->release();
+        delete session;
+        session = inserted.first->second;
+        session->users++;
+    }
+    return session;
+}
+
+void ProxyServer::releaseSession(ProxySession *session) {
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    session->users--;
+    session->lastUsedNs = monotonicTimeNs();
+}
+
+void ProxyServer::expireSessions() {
+    uint64_t now = monotonicTimeNs();
+    uint64_t next = nextExpiryNs.load(std::memory_order_relaxed);
+    if (now < next ||
+        !nextExpiryNs.compare_exchange_strong(next, now + EXPIRY_INTERVAL_MS * 1000000ULL)) {
+        return;
+    }
+    uint64_t timeoutNs = config.sessionIdleTimeoutMs * 1000000ULL;
+    std::vector<ProxySession*> expired;
+    {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            ProxySession *session = it->second;
+            if (session->users == 0 && now - session->lastUsedNs > timeoutNs) {
+                expired.push_back(session);
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    // Contexts are reinitialized by the pool outside of the lock
+    for (ProxySession *session : expired) {
+        session->alps->release();
+        delete session;
+    }
+}
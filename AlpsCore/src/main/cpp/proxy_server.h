@@ -0,0 +1,180 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_PROXY_SERVER_H_
+#define _ALPS_PROXY_SERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "alps_session.h"
+#include "context_pool.h"
+
+struct ProxyConfig {
+    // IPv4 address and port the proxy listens on, port 0 picks a free one
+    std::string listenAddress = "127.0.0.1";
+    uint16_t listenPort = 8080;
+    // Origin all requests are forwarded to
+    std::string upstreamHost = "127.0.0.1";
+    uint16_t upstreamPort = 80;
+    // Number of event loop threads, 0 for number of cores
+    size_t threadCount = 0;
+    // Size of the upstream read and client write buffers of a single exchange
+    size_t ioBufferSize = 64 * 1024;
+    // Sessions not used by any request for this long are closed
+    uint32_t sessionIdleTimeoutMs = 60 * 1000;
+    // Initialized contexts kept for new sessions
+    size_t maxIdleContexts = 16;
+};
+
+struct ProxyStatistics {
+    // number of accepted client connections
+    uint64_t acceptedConnections;
+    // number of client connections currently open
+    uint64_t openConnections;
+    // number of requests forwarded upstream
+    uint64_t requests;
+    // number of responses rewritten by ALPS
+    uint64_t processedResponses;
+    // number of responses forwarded as is (errors, partial content, HEAD)
+    uint64_t passthroughResponses;
+    // number of requests that failed because the origin couldn't be reached or closed the
+    // connection prematurely
+    uint64_t upstreamErrors;
+    // bytes written to clients, including response headers
+    uint64_t responseBytes;
+    // number of sessions currently open
+    uint64_t openSessions;
+};
+
+/**
+ * ALPS session of the proxy, shared by all requests of a single client stream.
+ */
+struct ProxySession {
+    AlpsSession *alps;
+    // Presentation last requested by the client, seeded to the session
+    int requestedPresentationId;
+    // Number of exchanges using the session, guarded by the session table lock
+    uint32_t users;
+    // monotonicTimeNs of the last exchange that released the session, guarded by the table lock
+    uint64_t lastUsedNs;
+};
+
+/**
+ * HTTP proxy rewriting AC-4 segments with ALPS, for clients that can't use the library directly.
+ *
+ * Every request is forwarded to a single origin. Query parameter alps_presentation selects the
+ * presentation of the session, alps_session names the session. Both are stripped from the
+ * forwarded request. Requests of a client (by address) with the same session name share a single
+ * ALPS context, so the init segment and media segments of a representation must be requested with
+ * the same name. Requests without a name share the session of their URL directory.
+ *
+ * Successful (200) response bodies are rewritten on the fly by SegmentStream: every CMAF chunk is
+ * forwarded as soon as it is downloaded and processed, so memory held by an exchange is bounded by
+ * the largest chunk plus two I/O buffers. Other responses are forwarded as is. Upstream reads stop
+ * while the client doesn't accept forwarded data.
+ *
+ * Each event loop thread multiplexes its client and origin connections with epoll and never
+ * blocks, so a thread serves hundreds of concurrent exchanges. I/O buffers are leased from
+ * BufferPool only for the duration of an exchange, connection state is recycled per thread and
+ * contexts of closed sessions are recycled through a ContextPool.
+ *
+ * Origin is requested with HTTP/1.0 and keep-alive, so response bodies are never chunked.
+ */
+class ProxyServer {
+public:
+    explicit ProxyServer(const ProxyConfig &config);
+    ~ProxyServer();
+
+    ProxyServer(const ProxyServer&) = delete;
+    ProxyServer& operator=(const ProxyServer&) = delete;
+
+    /**
+     * Binds the listening socket and starts event loop threads.
+     *
+     * @return false if the origin address couldn't be resolved or the socket couldn't be bound
+     */
+    bool start();
+
+    /**
+     * Stops event loop threads and closes all connections. Called by the destructor.
+     */
+    void stop();
+
+    /**
+     * @return port the proxy listens on, valid after start
+     */
+    uint16_t port() const { return boundPort; }
+
+    ProxyStatistics statistics() const;
+
+private:
+    class Worker;
+
+    struct Counters {
+        std::atomic<uint64_t> acceptedConnections{0};
+        std::atomic<uint64_t> openConnections{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> processedResponses{0};
+        std::atomic<uint64_t> passthroughResponses{0};
+        std::atomic<uint64_t> upstreamErrors{0};
+        std::atomic<uint64_t> responseBytes{0};
+    };
+
+    /**
+     * Finds or creates the session of the key and marks it used.
+     *
+     * @return session or nullptr if the ALPS context couldn't be created
+     */
+    ProxySession *acquireSession(const std::string &key);
+    void releaseSession(ProxySession *session);
+    /**
+     * Closes sessions idle for longer than the timeout, at most once per second.
+     */
+    void expireSessions();
+
+    ProxyConfig config;
+    sockaddr_in upstream;
+    int listenFd;
+    uint16_t boundPort;
+    std::vector<Worker*> workers;
+    std::vector<std::thread> threads;
+    Counters stats;
+
+    ContextPool contextPool;
+    mutable std::mutex sessionsLock;
+    std::unordered_map<std::string, ProxySession*> sessions;
+    std::atomic<uint64_t> nextExpiryNs{0};
+};
+
+#endif //_ALPS_PROXY_SERVER_H_
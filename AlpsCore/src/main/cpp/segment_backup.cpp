@@ -0,0 +1,272 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+
+#include "segment_backup.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "isobmff.h"
+
+namespace {
+
+// Version and flags following the header of a full box
+const size_t FULL_BOX_HEADER_SIZE = 4;
+
+const uint32_t TFHD_BASE_DATA_OFFSET_PRESENT = 0x000001;
+const uint32_t TFHD_SAMPLE_DESCRIPTION_INDEX_PRESENT = 0x000002;
+const uint32_t TFHD_DEFAULT_SAMPLE_DURATION_PRESENT = 0x000008;
+const uint32_t TFHD_DEFAULT_SAMPLE_SIZE_PRESENT = 0x000010;
+const uint32_t TFHD_DEFAULT_BASE_IS_MOOF = 0x020000;
+
+const uint32_t TRUN_DATA_OFFSET_PRESENT = 0x000001;
+const uint32_t TRUN_FIRST_SAMPLE_FLAGS_PRESENT = 0x000004;
+const uint32_t TRUN_SAMPLE_DURATION_PRESENT = 0x000100;
+const uint32_t TRUN_SAMPLE_SIZE_PRESENT = 0x000200;
+const uint32_t TRUN_SAMPLE_FLAGS_PRESENT = 0x000400;
+const uint32_t TRUN_SAMPLE_COMPOSITION_OFFSET_PRESENT = 0x000800;
+
+// Boxes within [begin, end) of data, iteration ends at the first box that doesn't fit
+class BoxIterator {
+public:
+    BoxIterator(const uint8_t *data, size_t begin, size_t end)
+        : data(data), offset(begin), end(end) {}
+
+    bool next(BoxHeader *header, size_t *boxOffset) {
+        if (parseBoxHeader(data + offset, end - offset, header) != BoxHeaderStatus::OK ||
+            header->size > end - offset) {
+            return false;
+        }
+        *boxOffset = offset;
+        offset += (size_t)header->size;
+        return true;
+    }
+
+private:
+    const uint8_t *data;
+    size_t offset;
+    size_t end;
+};
+
+} // namespace
+
+void SegmentBackup::clear() {
+    positions.clear();
+    sizes.clear();
+    valueOffsets.clear();
+    values.clear();
+}
+
+void SegmentBackup::save(const uint8_t *data, size_t size, uint64_t position) {
+    ranges.clear();
+    bool samplesLocated = true;
+    size_t offset = 0;
+    while (offset < size) {
+        BoxHeader header;
+        BoxHeaderStatus status = parseBoxHeader(data + offset, size - offset, &header);
+        if (status == BoxHeaderStatus::NEED_MORE_DATA || status == BoxHeaderStatus::INVALID) {
+            addRange(offset, size, size);
+            break;
+        }
+        // Box may be cut off by the end of the part
+        size_t boxSize = status == BoxHeaderStatus::EXTENDS_TO_END || header.size > size - offset
+                ? size - offset
+                : (size_t)header.size;
+
+        if (header.type == ISOBMFF_BOX_MDAT) {
+            addRange(offset, offset + header.headerSize, size);
+        } else {
+            addRange(offset, offset + boxSize, size);
+            if (header.type == ISOBMFF_BOX_MOOF && boxSize == header.size) {
+                samplesLocated &= addSampleRanges(data, size, offset, header.headerSize, boxSize);
+            }
+        }
+        offset += boxSize;
+    }
+    if (!samplesLocated) {
+        ranges.clear();
+        addRange(0, size, size);
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) {
+        return a.begin < b.begin;
+    });
+    size_t index = 0;
+    while (index < ranges.size()) {
+        Range merged = ranges[index++];
+        while (index < ranges.size() && ranges[index].begin <= merged.end) {
+            merged.end = std::max(merged.end, ranges[index++].end);
+        }
+        positions.push_back(position + merged.begin);
+        sizes.push_back(merged.end - merged.begin);
+        valueOffsets.push_back(values.size());
+        values.insert(values.end(), data + merged.begin, data + merged.end);
+    }
+}
+
+void SegmentBackup::restore(uint8_t *data, uint64_t position, size_t size) const {
+    uint64_t end = position + size;
+    // First region ending after position
+    size_t index = std::upper_bound(positions.begin(), positions.end(), position) -
+                   positions.begin();
+    if (index > 0 && positions[index - 1] + sizes[index - 1] > position) {
+        index--;
+    }
+    for (; index < positions.size() && positions[index] < end; index++) {
+        uint64_t regionStart = std::max<uint64_t>(positions[index], position);
+        uint64_t regionEnd = std::min<uint64_t>(positions[index] + sizes[index], end);
+        if (regionEnd > regionStart) {
+            memcpy(data + (regionStart - position),
+                   values.data() + valueOffsets[index] + (regionStart - positions[index]),
+                   (size_t)(regionEnd - regionStart));
+        }
+    }
+}
+
+void SegmentBackup::addRange(int64_t begin, int64_t end, size_t size) {
+    // Samples of a chunk may lie outside of the part being saved
+    begin = std::max<int64_t>(begin, 0);
+    end = std::min<int64_t>(end, (int64_t)size);
+    if (begin < end) {
+        ranges.push_back({(size_t)begin, (size_t)end});
+    }
+}
+
+bool SegmentBackup::addSampleRanges(const uint8_t *data, size_t size, size_t moofOffset,
+                                    uint32_t moofHeaderSize, size_t moofSize) {
+    // Data of a track fragment follows data of the previous one, unless its base is the moof
+    int64_t previousTrackEnd = (int64_t)moofOffset;
+    bool firstTrack = true;
+    BoxIterator fragment(data, moofOffset + moofHeaderSize, moofOffset + moofSize);
+    BoxHeader trackHeader;
+    size_t trackOffset;
+    while (fragment.next(&trackHeader, &trackOffset)) {
+        if (trackHeader.type != ISOBMFF_BOX_TRAF) {
+            continue;
+        }
+        bool hasHeader = false;
+        SampleDefaults defaults = {};
+        int64_t base = 0;
+        int64_t next = previousTrackEnd;
+        BoxIterator track(data, trackOffset + trackHeader.headerSize,
+                          trackOffset + (size_t)trackHeader.size);
+        BoxHeader header;
+        size_t boxOffset;
+        while (track.next(&header, &boxOffset)) {
+            const uint8_t *box = data + boxOffset + header.headerSize;
+            size_t boxSize = (size_t)header.size - header.headerSize;
+            if (header.type == ISOBMFF_BOX_TFHD) {
+                if (boxSize < FULL_BOX_HEADER_SIZE + 4) {
+                    return false;
+                }
+                uint32_t flags = readBigEndian32(box) & 0xFFFFFF;
+                if (flags & TFHD_BASE_DATA_OFFSET_PRESENT) {
+                    return false;
+                }
+                // Fields following track_ID
+                size_t fieldOffset = FULL_BOX_HEADER_SIZE + 4;
+                if (flags & TFHD_SAMPLE_DESCRIPTION_INDEX_PRESENT) fieldOffset += 4;
+                if (flags & TFHD_DEFAULT_SAMPLE_DURATION_PRESENT) fieldOffset += 4;
+                if (flags & TFHD_DEFAULT_SAMPLE_SIZE_PRESENT) {
+                    if (fieldOffset + 4 > boxSize) {
+                        return false;
+                    }
+                    defaults = {true, readBigEndian32(box + fieldOffset)};
+                }
+                base = firstTrack || (flags & TFHD_DEFAULT_BASE_IS_MOOF)
+                        ? (int64_t)moofOffset
+                        : previousTrackEnd;
+                next = base;
+                hasHeader = true;
+            } else if (header.type == ISOBMFF_BOX_TRUN) {
+                if (!hasHeader || !addTrackRunRanges(box, boxSize, defaults, base, &next, size)) {
+                    return false;
+                }
+            }
+        }
+        previousTrackEnd = next;
+        firstTrack = false;
+    }
+    return true;
+}
+
+bool SegmentBackup::addTrackRunRanges(const uint8_t *trun, size_t trunSize,
+                                      const SampleDefaults &defaults, int64_t base,
+                                      int64_t *next, size_t size) {
+    if (trunSize < FULL_BOX_HEADER_SIZE + 4) {
+        return false;
+    }
+    uint32_t flags = readBigEndian32(trun) & 0xFFFFFF;
+    uint32_t sampleCount = readBigEndian32(trun + FULL_BOX_HEADER_SIZE);
+    size_t cursor = FULL_BOX_HEADER_SIZE + 4;
+
+    // Without data offset samples follow the previous run
+    int64_t sample = *next;
+    if (flags & TRUN_DATA_OFFSET_PRESENT) {
+        if (cursor + 4 > trunSize) {
+            return false;
+        }
+        sample = base + (int32_t)readBigEndian32(trun + cursor);
+        cursor += 4;
+    }
+    if (flags & TRUN_FIRST_SAMPLE_FLAGS_PRESENT) {
+        cursor += 4;
+    }
+
+    size_t sampleFieldsSize = 0;
+    size_t sizeFieldOffset = 0;
+    if (flags & TRUN_SAMPLE_DURATION_PRESENT) {
+        sampleFieldsSize += 4;
+        sizeFieldOffset += 4;
+    }
+    bool hasSampleSizes = (flags & TRUN_SAMPLE_SIZE_PRESENT) != 0;
+    if (hasSampleSizes) sampleFieldsSize += 4;
+    if (flags & TRUN_SAMPLE_FLAGS_PRESENT) sampleFieldsSize += 4;
+    if (flags & TRUN_SAMPLE_COMPOSITION_OFFSET_PRESENT) sampleFieldsSize += 4;
+    if (!hasSampleSizes && !defaults.hasSize) {
+        return false;
+    }
+    if (cursor > trunSize ||
+        (sampleFieldsSize > 0 && (trunSize - cursor) / sampleFieldsSize < sampleCount)) {
+        return false;
+    }
+
+    // Samples past the end of the part can't be changed by its processing
+    for (uint32_t i = 0; i < sampleCount && sample < (int64_t)size; i++) {
+        uint32_t sampleSize = hasSampleSizes
+                ? readBigEndian32(trun + cursor + sizeFieldOffset)
+                : defaults.size;
+        if (sampleSize == 0 && sampleFieldsSize == 0) {
+            break;
+        }
+        addRange(sample, sample + std::min<int64_t>(sampleSize, AC4_TOC_BACKUP_SIZE), size);
+        sample += sampleSize;
+        cursor += sampleFieldsSize;
+    }
+    *next = sample;
+    return true;
+}
@@ -0,0 +1,102 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+
+#ifndef _ALPS_SEGMENT_BACKUP_H_
+#define _ALPS_SEGMENT_BACKUP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Copy of the segment bytes that processing may change, so that they can be written back if
+ * processing fails, or compared with the processed segment.
+ *
+ * ALPS rewrites the AC-4 TOC at the start of a sample, so only the first AC4_TOC_BACKUP_SIZE bytes
+ * of every sample are saved, together with all boxes except for mdat payload. Samples are located
+ * through moof/traf/trun boxes. Payload of mdat boxes is saved as a whole if samples can't be
+ * located, e.g. when tfhd sets explicit base data offset.
+ *
+ * Saved bytes are kept as regions sorted by position, which is relative to the start of the whole
+ * segment.
+ */
+class SegmentBackup {
+public:
+    // Longer than the TOC of streams with a few presentations
+    static const size_t AC4_TOC_BACKUP_SIZE = 128;
+
+    /**
+     * Removes all saved regions, capacity is kept for reuse.
+     */
+    void clear();
+
+    /**
+     * Saves bytes of a part of the segment starting at position. Parts have to be saved in order,
+     * regions of the part are appended to the already saved ones.
+     */
+    void save(const uint8_t *data, size_t size, uint64_t position = 0);
+
+    /**
+     * Writes saved bytes overlapping bytes [position, position + size) of the segment back to
+     * data holding these bytes.
+     */
+    void restore(uint8_t *data, uint64_t position, size_t size) const;
+
+    size_t regionCount() const { return positions.size(); }
+    uint64_t regionPosition(size_t index) const { return positions[index]; }
+    size_t regionSize(size_t index) const { return sizes[index]; }
+    // Saved bytes of the region, regions are stored back to back
+    const uint8_t *regionValues(size_t index) const { return values.data() + valueOffsets[index]; }
+    size_t savedBytes() const { return values.size(); }
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    // Sample size set by tfhd
+    struct SampleDefaults {
+        bool hasSize;
+        uint32_t size;
+    };
+
+    void addRange(int64_t begin, int64_t end, size_t size);
+    bool addSampleRanges(const uint8_t *data, size_t size, size_t moofOffset,
+                         uint32_t moofHeaderSize, size_t moofSize);
+    bool addTrackRunRanges(const uint8_t *trun, size_t trunSize, const SampleDefaults &defaults,
+                           int64_t base, int64_t *next, size_t size);
+
+    std::vector<uint64_t> positions;
+    std::vector<size_t> sizes;
+    std::vector<size_t> valueOffsets;
+    std::vector<uint8_t> values;
+    // Scratch list of ranges of the part being saved
+    std::vector<Range> ranges;
+};
+
+#endif //_ALPS_SEGMENT_BACKUP_H_
@@ -0,0 +1,142 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "segment_patch.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "log.h"
+#include "segment_backup.h"
+#include "trace.h"
+
+void SegmentPatch::clear() {
+    offsets.clear();
+    lengths.clear();
+    values.clear();
+}
+
+void SegmentPatch::apply(uint8_t *data, uint64_t position, size_t size) const {
+    uint64_t end = position + size;
+    // First edit ending after position
+    size_t index = std::upper_bound(offsets.begin(), offsets.end(), position) - offsets.begin();
+    if (index > 0 && offsets[index - 1] + (uint64_t)lengths[index - 1] > position) {
+        index--;
+    }
+    size_t valueOffset = 0;
+    for (size_t i = 0; i < index; i++) {
+        valueOffset += lengths[i];
+    }
+
+    for (; index < offsets.size() && offsets[index] < end; index++) {
+        uint64_t editStart = std::max<uint64_t>(offsets[index], position);
+        uint64_t editEnd = std::min<uint64_t>(offsets[index] + (uint64_t)lengths[index], end);
+        memcpy(data + (editStart - position),
+               values.data() + valueOffset + (editStart - offsets[index]),
+               (size_t)(editEnd - editStart));
+        valueOffset += lengths[index];
+    }
+}
+
+static const size_t DIFF_BLOCK_SIZE = 256;
+
+static inline uint64_t loadWord(const uint8_t *data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+void diffSegment(const uint8_t *original, const uint8_t *processed, size_t size,
+                 SegmentPatch *patch, uint32_t segmentPosition) {
+    size_t position = 0;
+    while (position < size) {
+        // Processing changes a few bytes per sample, equal runs are skipped block by block
+        // (memcmp is vectorized) and then word by word
+        while (position + DIFF_BLOCK_SIZE <= size &&
+               memcmp(original + position, processed + position, DIFF_BLOCK_SIZE) == 0) {
+            position += DIFF_BLOCK_SIZE;
+        }
+        while (position + sizeof(uint64_t) <= size &&
+               loadWord(original + position) == loadWord(processed + position)) {
+            position += sizeof(uint64_t);
+        }
+        while (position < size && original[position] == processed[position]) {
+            position++;
+        }
+        if (position == size) {
+            break;
+        }
+
+        size_t editStart = position;
+        size_t editEnd = position + 1;
+        for (position = editEnd; position < size && position - editEnd < PATCH_MERGE_GAP;
+             position++) {
+            if (original[position] != processed[position]) {
+                editEnd = position + 1;
+            }
+        }
+        patch->offsets.push_back(segmentPosition + (uint32_t)editStart);
+        patch->lengths.push_back((uint32_t)(editEnd - editStart));
+        patch->values.insert(patch->values.end(), processed + editStart, processed + editEnd);
+    }
+}
+
+// Bytes saved before processing, compared with the processed ones and written back
+static thread_local SegmentBackup segmentBackup;
+
+ProcessingStatus processSegmentPatch(AlpsSession *session,
+                                     uint8_t *segment,
+                                     size_t size,
+                                     SegmentPatch *patch,
+                                     alps_ret *error) {
+    patch->clear();
+    if (size > UINT32_MAX) {
+        ALOGE("Patch of segment of size: %zu can't be created", size);
+        if (error != nullptr) *error = ALPS_RET_E_BUFF_TOO_SMALL;
+        return ProcessingStatus::FAILED;
+    }
+
+    uint32_t flags = 0;
+    ProcessingStatus status = session->prepare(segment, size, &flags);
+    if (status != ProcessingStatus::PROCESSED) {
+        return status;
+    }
+
+    ScopedTrace trace("processSegmentPatch");
+    segmentBackup.clear();
+    segmentBackup.save(segment, size);
+    status = session->processPrepared(segment, size, flags, error);
+    if (status == ProcessingStatus::PROCESSED) {
+        // Only saved bytes can be changed by processing
+        for (size_t i = 0; i < segmentBackup.regionCount(); i++) {
+            auto position = (uint32_t)segmentBackup.regionPosition(i);
+            diffSegment(segmentBackup.regionValues(i), segment + position,
+                        segmentBackup.regionSize(i), patch, position);
+        }
+    }
+    segmentBackup.restore(segment, 0, size);
+    return status;
+}
@@ -0,0 +1,87 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SEGMENT_PATCH_H_
+#define _ALPS_SEGMENT_PATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "alps_session.h"
+
+/**
+ * Edits turning a segment into its processed version. Edit i replaces lengths[i] bytes at
+ * offsets[i] with the next lengths[i] bytes of values. Edits are sorted by offset and don't
+ * overlap.
+ */
+struct SegmentPatch {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint8_t> values;
+
+    size_t editCount() const { return offsets.size(); }
+
+    /**
+     * Removes all edits, capacity is kept for reuse.
+     */
+    void clear();
+
+    /**
+     * Applies edits overlapping bytes [position, position + size) of the segment to data holding
+     * these bytes.
+     */
+    void apply(uint8_t *data, uint64_t position, size_t size) const;
+};
+
+/**
+ * Appends edits replacing bytes of original that differ from processed. Differences separated by
+ * fewer than PATCH_MERGE_GAP equal bytes are merged into a single edit. Compared bytes start at
+ * segmentPosition of the segment.
+ */
+void diffSegment(const uint8_t *original, const uint8_t *processed, size_t size,
+                 SegmentPatch *patch, uint32_t segmentPosition = 0);
+
+// Larger gaps are cheaper as a separate edit than as copied equal bytes
+const size_t PATCH_MERGE_GAP = 8;
+
+/**
+ * Processes segment, leaving it unmodified. Bytes that processing may change (AC-4 TOC of every
+ * sample, see SegmentBackup) are saved, segment is processed in place and only the saved bytes are
+ * compared with the processed ones and written back, so memory traffic is proportional to the
+ * number of samples rather than the segment size. Segments skipped by pre-scan are not touched.
+ *
+ * @param segment processed in place, restored before returning
+ * @param patch cleared, then filled with edits of processed segment
+ * @param error set to the ALPS error if processing failed, may be nullptr
+ */
+ProcessingStatus processSegmentPatch(AlpsSession *session,
+                                     uint8_t *segment,
+                                     size_t size,
+                                     SegmentPatch *patch,
+                                     alps_ret *error);
+
+#endif //_ALPS_SEGMENT_PATCH_H_
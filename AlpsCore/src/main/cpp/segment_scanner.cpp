@@ -0,0 +1,105 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "segment_scanner.h"
+
+#include <string.h>
+
+#include "isobmff.h"
+
+static const uint32_t ISOBMFF_SAMPLE_ENTRY_AC4 = ISOBMFF_FOURCC('a', 'c', '-', '4');
+static const uint64_t SWAR_ONES = 0x0101010101010101ULL;
+static const uint64_t SWAR_HIGH_BITS = 0x8080808080808080ULL;
+
+bool containsFourcc(const uint8_t *data, size_t size, uint32_t fourcc) {
+    if (size < 4) {
+        return false;
+    }
+    // Candidates are positions of the last fourcc byte, the first one ('a' of 'ac-4') is common
+    const uint8_t last = (uint8_t)fourcc;
+    const uint64_t pattern = SWAR_ONES * last;
+    size_t offset = 3;
+
+    for (; offset + 8 <= size; offset += 8) {
+        uint64_t word;
+        memcpy(&word, data + offset, sizeof(word));
+        uint64_t matches = word ^ pattern;
+        // Non-zero if any byte of matches is zero
+        if (((matches - SWAR_ONES) & ~matches & SWAR_HIGH_BITS) == 0) {
+            continue;
+        }
+        for (size_t i = offset; i < offset + 8; i++) {
+            if (data[i] == last && readBigEndian32(data + i - 3) == fourcc) {
+                return true;
+            }
+        }
+    }
+    for (; offset < size; offset++) {
+        if (data[offset] == last && readBigEndian32(data + offset - 3) == fourcc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t scanSegment(const uint8_t *segment, size_t size) {
+    uint32_t flags = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        BoxHeader header;
+        BoxHeaderStatus status = parseBoxHeader(segment + offset, size - offset, &header);
+        if (status == BoxHeaderStatus::EXTENDS_TO_END) {
+            header.size = size - offset;
+        } else if (status != BoxHeaderStatus::OK) {
+            return flags | SEGMENT_MALFORMED;
+        }
+
+        if (header.type == ISOBMFF_BOX_MOOV) {
+            if (header.size > size - offset) {
+                return flags | SEGMENT_MALFORMED;
+            }
+            const uint8_t *payload = segment + offset + header.headerSize;
+            size_t payloadSize = (size_t)header.size - header.headerSize;
+            flags |= SEGMENT_HAS_MOVIE;
+            if (containsFourcc(payload, payloadSize, ISOBMFF_SAMPLE_ENTRY_AC4)) {
+                flags |= SEGMENT_HAS_AC4_TRACK;
+            }
+            if (containsFourcc(payload, payloadSize, ISOBMFF_BOX_PRSL) &&
+                containsFourcc(payload, payloadSize, ISOBMFF_BOX_GRPL)) {
+                flags |= SEGMENT_HAS_PRESELECTIONS;
+            }
+        } else if (header.type == ISOBMFF_BOX_MOOF) {
+            flags |= SEGMENT_HAS_FRAGMENT;
+        }
+
+        if (header.size > size - offset) {
+            // Truncated last box, e.g. mdat of a partially received chunk
+            break;
+        }
+        offset += header.size;
+    }
+    return flags;
+}
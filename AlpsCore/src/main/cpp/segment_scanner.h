@@ -0,0 +1,57 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SEGMENT_SCANNER_H_
+#define _ALPS_SEGMENT_SCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// moov box present - init segment
+#define SEGMENT_HAS_MOVIE         0x01
+// moof box present - media segment or chunk
+#define SEGMENT_HAS_FRAGMENT      0x02
+// AC-4 sample entry found in moov
+#define SEGMENT_HAS_AC4_TRACK     0x04
+// meta/grpl/prsl presentations found in moov
+#define SEGMENT_HAS_PRESELECTIONS 0x08
+// top-level box structure couldn't be parsed, other flags are not reliable
+#define SEGMENT_MALFORMED         0x10
+
+/**
+ * Classifies segment by walking its top-level boxes and searching moov payload for AC-4 sample
+ * entry and preselection boxes. Doesn't modify nor copy the segment.
+ *
+ * @return SEGMENT_* flags
+ */
+uint32_t scanSegment(const uint8_t *segment, size_t size);
+
+/**
+ * Searches for four character code anywhere in data, 8 bytes at a time.
+ */
+bool containsFourcc(const uint8_t *data, size_t size, uint32_t fourcc);
+
+#endif //_ALPS_SEGMENT_SCANNER_H_
@@ -0,0 +1,230 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "segment_slices.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "buffer_pool.h"
+#include "isobmff.h"
+#include "log.h"
+#include "segment_backup.h"
+#include "trace.h"
+
+namespace {
+
+// Position in a list of slices, empty slices are skipped
+class SliceCursor {
+public:
+    SliceCursor(const SegmentSlice *slices, size_t sliceCount)
+        : slices(slices), sliceCount(sliceCount), index(0), offset(0), position(0) {
+        skipExhaustedSlices();
+    }
+
+    uint64_t absolutePosition() const { return position; }
+
+    // Bytes available in the current slice
+    size_t contiguousBytes() const {
+        return index < sliceCount ? slices[index].size - offset : 0;
+    }
+
+    uint8_t *pointer() const { return slices[index].data + offset; }
+
+    /**
+     * Copies up to size bytes from the current position without moving it.
+     *
+     * @return number of bytes copied
+     */
+    size_t peek(uint8_t *out, size_t size) const {
+        SliceCursor cursor = *this;
+        return cursor.copyOut(out, size);
+    }
+
+    size_t copyOut(uint8_t *out, size_t size) {
+        size_t copied = 0;
+        while (copied < size && index < sliceCount) {
+            size_t chunk = std::min(size - copied, contiguousBytes());
+            memcpy(out + copied, pointer(), chunk);
+            copied += chunk;
+            advanceInSlice(chunk);
+        }
+        return copied;
+    }
+
+    void copyIn(const uint8_t *in, size_t size) {
+        size_t copied = 0;
+        while (copied < size && index < sliceCount) {
+            size_t chunk = std::min(size - copied, contiguousBytes());
+            memcpy(pointer(), in + copied, chunk);
+            copied += chunk;
+            advanceInSlice(chunk);
+        }
+    }
+
+    void advance(uint64_t bytes) {
+        while (bytes > 0 && index < sliceCount) {
+            size_t chunk = (size_t)std::min<uint64_t>(bytes, contiguousBytes());
+            bytes -= chunk;
+            advanceInSlice(chunk);
+        }
+    }
+
+private:
+    void advanceInSlice(size_t bytes) {
+        offset += bytes;
+        position += bytes;
+        skipExhaustedSlices();
+    }
+
+    void skipExhaustedSlices() {
+        while (index < sliceCount && offset == slices[index].size) {
+            index++;
+            offset = 0;
+        }
+    }
+
+    const SegmentSlice *slices;
+    size_t sliceCount;
+    size_t index;
+    size_t offset;
+    uint64_t position;
+};
+
+// Bytes of the units processed so far, written back if a unit fails
+thread_local SegmentBackup unitsBackup;
+
+ProcessingStatus processUnit(AlpsSession *session,
+                             SliceCursor start,
+                             uint64_t size,
+                             alps_ret *error,
+                             SliceProcessingStatistics *stats) {
+    if (size <= start.contiguousBytes()) {
+        if (stats != nullptr) stats->inPlaceUnits++;
+        unitsBackup.save(start.pointer(), (size_t)size, start.absolutePosition());
+        return session->process(start.pointer(), (size_t)size, error);
+    }
+    if (size > SIZE_MAX) {
+        ALOGE("Processing unit of size: %llu can't be staged", (unsigned long long)size);
+        if (error != nullptr) *error = ALPS_RET_E_BUFF_TOO_SMALL;
+        return ProcessingStatus::FAILED;
+    }
+
+    auto *staging = (uint8_t*)BufferPool::shared().acquire((size_t)size);
+    if (staging == nullptr) {
+        ALOGE("Failed to allocate staging block of size: %llu", (unsigned long long)size);
+        if (error != nullptr) *error = ALPS_RET_E_UNDEFINED;
+        return ProcessingStatus::FAILED;
+    }
+    if (stats != nullptr) {
+        stats->stagedUnits++;
+        stats->stagedBytes += size;
+    }
+
+    ProcessingStatus status;
+    {
+        ScopedTrace trace("processUnit staged");
+        start.peek(staging, (size_t)size);
+        unitsBackup.save(staging, (size_t)size, start.absolutePosition());
+        status = session->process(staging, (size_t)size, error);
+        if (status == ProcessingStatus::PROCESSED) {
+            start.copyIn(staging, (size_t)size);
+        }
+    }
+    BufferPool::shared().release(staging);
+    return status;
+}
+
+// Undoes processing of all units, so that the segment is left unmodified
+ProcessingStatus restoreSlices(const SegmentSlice *slices, size_t sliceCount) {
+    uint64_t position = 0;
+    for (size_t i = 0; i < sliceCount; i++) {
+        unitsBackup.restore(slices[i].data, position, slices[i].size);
+        position += slices[i].size;
+    }
+    return ProcessingStatus::FAILED;
+}
+
+} // namespace
+
+ProcessingStatus processSegmentSlices(AlpsSession *session,
+                                      const SegmentSlice *slices,
+                                      size_t sliceCount,
+                                      alps_ret *error,
+                                      SliceProcessingStatistics *stats) {
+    ScopedTrace trace("processSegmentSlices");
+    uint64_t totalSize = 0;
+    for (size_t i = 0; i < sliceCount; i++) {
+        totalSize += slices[i].size;
+    }
+
+    // Empty segment has no boxes
+    ProcessingStatus result = ProcessingStatus::SKIPPED_NO_MOVIE_NOR_FRAGMENT;
+    bool anyProcessed = false;
+    bool anyUnit = false;
+    auto accumulate = [&](ProcessingStatus status) {
+        if (!anyUnit) {
+            result = status;
+            anyUnit = true;
+        }
+        anyProcessed |= status == ProcessingStatus::PROCESSED;
+    };
+
+    unitsBackup.clear();
+    SliceCursor unitStart(slices, sliceCount);
+    SliceCursor cursor = unitStart;
+    while (cursor.absolutePosition() < totalSize) {
+        uint8_t headerBytes[16];
+        size_t available = cursor.peek(headerBytes, sizeof(headerBytes));
+        BoxHeader header;
+        // Boxes that can't be walked end the last unit, ALPS reports malformed ones
+        if (parseBoxHeader(headerBytes, available, &header) != BoxHeaderStatus::OK ||
+            header.size > totalSize - cursor.absolutePosition()) {
+            break;
+        }
+        cursor.advance(header.size);
+
+        if (header.type == ISOBMFF_BOX_MDAT) {
+            uint64_t unitSize = cursor.absolutePosition() - unitStart.absolutePosition();
+            ProcessingStatus status = processUnit(session, unitStart, unitSize, error, stats);
+            if (status == ProcessingStatus::FAILED) {
+                return restoreSlices(slices, sliceCount);
+            }
+            accumulate(status);
+            unitStart = cursor;
+        }
+    }
+
+    if (unitStart.absolutePosition() < totalSize) {
+        uint64_t unitSize = totalSize - unitStart.absolutePosition();
+        ProcessingStatus status = processUnit(session, unitStart, unitSize, error, stats);
+        if (status == ProcessingStatus::FAILED) {
+            return restoreSlices(slices, sliceCount);
+        }
+        accumulate(status);
+    }
+    return anyProcessed ? ProcessingStatus::PROCESSED : result;
+}
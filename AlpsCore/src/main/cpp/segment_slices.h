@@ -0,0 +1,73 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SEGMENT_SLICES_H_
+#define _ALPS_SEGMENT_SLICES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alps_session.h"
+
+/**
+ * Part of a segment held in a separate buffer.
+ */
+struct SegmentSlice {
+    uint8_t *data;
+    size_t size;
+};
+
+struct SliceProcessingStatistics {
+    // processing units passed to ALPS directly from a slice
+    uint64_t inPlaceUnits;
+    // processing units spanning slices, copied to a staging block
+    uint64_t stagedUnits;
+    // bytes copied to staging blocks
+    uint64_t stagedBytes;
+};
+
+/**
+ * Processes segment split into slices (e.g. chain of network buffers), without copying it into a
+ * single contiguous buffer. Total segment size is 64-bit.
+ *
+ * Segment is split into processing units the same way as SegmentStream splits chunks: every unit
+ * ends with mdat box, bytes after the last mdat box form the last unit. Units that lie within a
+ * single slice are processed in place. Units spanning slices are gathered into a block leased from
+ * BufferPool, processed there and scattered back. Processing stops at the first failed unit and
+ * changes of all units are undone, see SegmentBackup, so failed segment is left unmodified.
+ *
+ * @param error set to the ALPS error if processing failed, may be nullptr
+ * @param stats incremented by processing, may be nullptr
+ * @return PROCESSED if any unit was processed, FAILED if any unit failed, skip status of the first
+ * unit otherwise
+ */
+ProcessingStatus processSegmentSlices(AlpsSession *session,
+                                      const SegmentSlice *slices,
+                                      size_t sliceCount,
+                                      alps_ret *error,
+                                      SliceProcessingStatistics *stats = nullptr);
+
+#endif //_ALPS_SEGMENT_SLICES_H_
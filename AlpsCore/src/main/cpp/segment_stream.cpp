@@ -0,0 +1,151 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "segment_stream.h"
+
+#include <string.h>
+
+#include "isobmff.h"
+#include "log.h"
+#include "trace.h"
+
+SegmentStream::SegmentStream(AlpsSession *session)
+    : session(session), readOffset(0), processedEnd(0), scanOffset(0), finished(false),
+      chunkProcessed(false) {
+}
+
+void SegmentStream::reset() {
+    buffer.clear();
+    readOffset = 0;
+    processedEnd = 0;
+    scanOffset = 0;
+    finished = false;
+    chunkProcessed = false;
+}
+
+void SegmentStream::reset(AlpsSession *session) {
+    this->session = session;
+    reset();
+}
+
+bool SegmentStream::append(const uint8_t *data, size_t size) {
+    if (finished) {
+        return false;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+    return true;
+}
+
+alps_ret SegmentStream::processCompleteChunks() {
+    alps_ret result = ALPS_RET_OK;
+    while (scanOffset < buffer.size()) {
+        BoxHeader header;
+        BoxHeaderStatus status = parseBoxHeader(buffer.data() + scanOffset,
+                                                buffer.size() - scanOffset,
+                                                &header);
+        if (status != BoxHeaderStatus::OK || header.size > buffer.size() - scanOffset) {
+            // Incomplete box, box extending to the end of the segment or malformed data - wait
+            // for the rest of the segment
+            break;
+        }
+        scanOffset += header.size;
+
+        if (header.type == ISOBMFF_BOX_MDAT) {
+            alps_ret ret = processChunk(scanOffset);
+            if (result == ALPS_RET_OK) {
+                result = ret;
+            }
+        }
+    }
+    return result;
+}
+
+alps_ret SegmentStream::feed(const uint8_t *data, size_t size) {
+    ScopedTrace trace("SegmentStream::feed");
+    if (!append(data, size)) {
+        return ALPS_RET_E_INVALID_ARG;
+    }
+    return processCompleteChunks();
+}
+
+alps_ret SegmentStream::finish() {
+    if (finished) {
+        return ALPS_RET_OK;
+    }
+    finished = true;
+
+    if (processedEnd == buffer.size()) {
+        return ALPS_RET_OK;
+    }
+    if (chunkProcessed && scanOffset == buffer.size()) {
+        // Complete boxes trailing the last chunk (e.g. free, emsg) don't carry AC-4 samples
+        processedEnd = buffer.size();
+        return ALPS_RET_OK;
+    }
+    return processChunk(buffer.size());
+}
+
+size_t SegmentStream::readyBytes() const {
+    return processedEnd - readOffset;
+}
+
+size_t SegmentStream::read(uint8_t *out, size_t size) {
+    size_t count = readyBytes() < size ? readyBytes() : size;
+    if (count == 0) {
+        return 0;
+    }
+    ScopedTrace trace("SegmentStream::read");
+    memcpy(out, buffer.data() + readOffset, count);
+    readOffset += count;
+
+    if (readOffset == buffer.size()) {
+        buffer.clear();
+        readOffset = 0;
+        processedEnd = 0;
+        scanOffset = 0;
+    } else if (readOffset > buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + readOffset);
+        processedEnd -= readOffset;
+        scanOffset -= readOffset;
+        readOffset = 0;
+    }
+    return count;
+}
+
+alps_ret SegmentStream::processChunk(size_t end) {
+    chunkBackup.clear();
+    chunkBackup.save(buffer.data() + processedEnd, end - processedEnd);
+    alps_ret ret = session->processSegment(buffer.data() + processedEnd, end - processedEnd);
+    if (ret == ALPS_RET_OK) {
+        ALOGI("Chunk of size %zu processed", end - processedEnd);
+    } else {
+        ALOGE("Chunk of size %zu processing failed, error: %d", end - processedEnd, ret);
+        chunkBackup.restore(buffer.data() + processedEnd, 0, end - processedEnd);
+    }
+    processedEnd = end;
+    chunkProcessed = true;
+    return ret;
+}
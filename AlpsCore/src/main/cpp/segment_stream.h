@@ -0,0 +1,123 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SEGMENT_STREAM_H_
+#define _ALPS_SEGMENT_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "alps_session.h"
+#include "segment_backup.h"
+
+/**
+ * Incremental processing of a single ISO BMFF segment.
+ *
+ * Bytes are fed as they arrive from the network. Every complete CMAF chunk (all top-level boxes up
+ * to and including an mdat box, typically [styp] moof mdat) is processed by ALPS as soon as it is
+ * buffered and becomes available for reading. Bytes that do not form a complete chunk (e.g. init
+ * segment) are processed when the segment is finished.
+ *
+ * Processing state between chunks is kept by the ALPS context of the session itself.
+ */
+class SegmentStream {
+public:
+    explicit SegmentStream(AlpsSession *session);
+
+    /**
+     * Drops all buffered data. Must be called before feeding a new segment.
+     */
+    void reset();
+
+    /**
+     * Drops all buffered data and binds the stream to another session, keeping the allocated
+     * buffer for reuse.
+     */
+    void reset(AlpsSession *session);
+
+    /**
+     * Appends segment bytes without processing them.
+     *
+     * @return false if the segment was already finished
+     */
+    bool append(const uint8_t *data, size_t size);
+
+    /**
+     * Processes every complete chunk that was appended so far.
+     * Chunks are released for reading even if their processing failed, unmodified.
+     *
+     * @return first error returned by ALPS or ALPS_RET_OK
+     */
+    alps_ret processCompleteChunks();
+
+    /**
+     * Appends segment bytes and processes every chunk completed by them.
+     */
+    alps_ret feed(const uint8_t *data, size_t size);
+
+    /**
+     * Marks end of the segment and processes remaining buffered bytes.
+     *
+     * @return error returned by ALPS or ALPS_RET_OK
+     */
+    alps_ret finish();
+
+    /**
+     * @return number of processed bytes that can be read
+     */
+    size_t readyBytes() const;
+
+    /**
+     * Copies up to size processed bytes into out.
+     *
+     * @return number of bytes copied
+     */
+    size_t read(uint8_t *out, size_t size);
+
+    /**
+     * @return session used for processing
+     */
+    AlpsSession *owner() const { return session; }
+
+private:
+    alps_ret processChunk(size_t end);
+
+    AlpsSession *session;
+    std::vector<uint8_t> buffer;
+    // bytes in [readOffset, processedEnd) are processed and can be read
+    size_t readOffset;
+    size_t processedEnd;
+    // offset of the next top-level box header that was not parsed yet
+    size_t scanOffset;
+    bool finished;
+    // a chunk of the segment was processed, processedEnd is reset when all bytes are read
+    bool chunkProcessed;
+    // bytes of the chunk being processed, written back if processing fails
+    SegmentBackup chunkBackup;
+};
+
+#endif //_ALPS_SEGMENT_STREAM_H_
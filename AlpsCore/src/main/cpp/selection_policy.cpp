@@ -0,0 +1,68 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "selection_policy.h"
+
+#include <string.h>
+#include <strings.h>
+
+static bool languageMatches(const char *language, const std::string &preferred) {
+    if (language == nullptr || preferred.empty() ||
+        strncasecmp(language, preferred.c_str(), preferred.size()) != 0) {
+        return false;
+    }
+    char next = language[preferred.size()];
+    return next == '\0' || next == '-' || next == '_';
+}
+
+static bool matches(const alps_presentation &presentation, const SelectionPreference &preference) {
+    switch (preference.criterion) {
+        case SelectionCriterion::LANGUAGE:
+            return languageMatches(presentation.language, preference.value);
+        case SelectionCriterion::LABEL:
+            return presentation.label != nullptr &&
+                   strcasecmp(presentation.label, preference.value.c_str()) == 0;
+        case SelectionCriterion::PRESENTATION_ID:
+            return presentation.presentation_id == preference.presentationId;
+    }
+    return false;
+}
+
+int SelectionPolicy::select(const alps_presentation *presentations, size_t count) const {
+    for (const SelectionPreference &preference : preferences) {
+        for (size_t i = 0; i < count; i++) {
+            if (matches(presentations[i], preference)) {
+                return presentations[i].presentation_id;
+            }
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (presentations[i].presentation_id == fallbackPresentationId) {
+            return fallbackPresentationId;
+        }
+    }
+    return ALPS_INVALID_PRES_ID;
+}
@@ -0,0 +1,74 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_SELECTION_POLICY_H_
+#define _ALPS_SELECTION_POLICY_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include "dlb_alps_native.h"
+}
+
+enum class SelectionCriterion {
+    // presentation language matches value: equal, ignoring case, or value followed by a subtag
+    // ("en" matches "en-US")
+    LANGUAGE = 0,
+    // presentation label equals value, ignoring case
+    LABEL = 1,
+    // presentation ID equals presentationId
+    PRESENTATION_ID = 2,
+};
+
+struct SelectionPreference {
+    SelectionCriterion criterion;
+    std::string value;
+    int presentationId;
+};
+
+/**
+ * Declarative presentation auto-selection, evaluated natively whenever the presentations list
+ * changes, so that a rule like "prefer language X, else label Y" doesn't need a round trip
+ * through the binding layer while the segment is being processed.
+ *
+ * Preferences are checked in order, the first preference matched by any presentation selects the
+ * first matching presentation. If none is matched, fallbackPresentationId is selected when it's
+ * listed, otherwise processing is disabled (ALPS_INVALID_PRES_ID, device default presentation).
+ */
+struct SelectionPolicy {
+    std::vector<SelectionPreference> preferences;
+    int fallbackPresentationId = ALPS_INVALID_PRES_ID;
+
+    /**
+     * @return ID of the selected presentation, ALPS_INVALID_PRES_ID if none
+     */
+    int select(const alps_presentation *presentations, size_t count) const;
+};
+
+#endif //_ALPS_SELECTION_POLICY_H_
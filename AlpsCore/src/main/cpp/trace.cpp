@@ -0,0 +1,124 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#include "trace.h"
+
+#include <unistd.h>
+#include <atomic>
+
+#ifdef __ANDROID__
+#include <android/trace.h>
+#endif
+
+#include "log.h"
+#include "metrics.h"
+
+static std::atomic<TraceSink*> traceSink{nullptr};
+
+void setTraceSink(TraceSink *sink) {
+    traceSink.store(sink, std::memory_order_release);
+}
+
+TraceSink *currentTraceSink() {
+    return traceSink.load(std::memory_order_relaxed);
+}
+
+#ifdef __ANDROID__
+class SystemTraceSink : public TraceSink {
+public:
+    void beginSection(const char *name) override {
+        ATrace_beginSection(name);
+    }
+
+    void endSection(const char *name) override {
+        ATrace_endSection();
+    }
+};
+
+TraceSink *systemTraceSink() {
+    static SystemTraceSink sink;
+    return &sink;
+}
+#else
+TraceSink *systemTraceSink() {
+    return nullptr;
+}
+#endif
+
+FileTraceSink::~FileTraceSink() {
+    close();
+}
+
+bool FileTraceSink::open(const char *path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file != nullptr) {
+        fclose(file);
+    }
+    file = fopen(path, "w");
+    if (file == nullptr) {
+        ALOGE("Failed to open trace file %s", path);
+        return false;
+    }
+    // Closing bracket is optional in the trace event format, so the file stays valid when the
+    // process is killed
+    fputs("[\n", file);
+    return true;
+}
+
+void FileTraceSink::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void FileTraceSink::beginSection(const char *name) {
+    writeEvent(name, 'B');
+}
+
+void FileTraceSink::endSection(const char *name) {
+    writeEvent(name, 'E');
+}
+
+void FileTraceSink::writeEvent(const char *name, char phase) {
+    static thread_local long threadId = (long)gettid();
+    uint64_t timestampNs = monotonicTimeNs();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return;
+    }
+    fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%ld},\n",
+            name, phase,
+            (unsigned long long)(timestampNs / 1000), (unsigned long long)(timestampNs % 1000),
+            (int)getpid(), threadId);
+}
+
+FileTraceSink& FileTraceSink::shared() {
+    static FileTraceSink sink;
+    return sink;
+}
@@ -0,0 +1,118 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+#ifndef _ALPS_TRACE_H_
+#define _ALPS_TRACE_H_
+
+#include <stdio.h>
+#include <mutex>
+
+/**
+ * Consumer of trace sections. Sections are strictly nested per thread, name is a string literal.
+ */
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+    virtual void beginSection(const char *name) = 0;
+    virtual void endSection(const char *name) = 0;
+};
+
+/**
+ * Sets sink receiving trace sections of all threads, nullptr disables tracing. Sinks are not
+ * owned and must never be destroyed, sections started before the change end in the previous sink.
+ */
+void setTraceSink(TraceSink *sink);
+
+TraceSink *currentTraceSink();
+
+/**
+ * Platform system trace sink (ATrace on Android), nullptr if not available.
+ */
+TraceSink *systemTraceSink();
+
+/**
+ * Writes sections as Chrome trace event format JSON, loadable in chrome://tracing or Perfetto UI.
+ */
+class FileTraceSink : public TraceSink {
+public:
+    FileTraceSink() = default;
+    ~FileTraceSink() override;
+
+    FileTraceSink(const FileTraceSink&) = delete;
+    FileTraceSink& operator=(const FileTraceSink&) = delete;
+
+    /**
+     * Opens a new trace file, closing the previous one.
+     *
+     * @return false if file couldn't be created
+     */
+    bool open(const char *path);
+    /**
+     * Flushes and closes the trace file, following sections are dropped.
+     */
+    void close();
+
+    void beginSection(const char *name) override;
+    void endSection(const char *name) override;
+
+    /**
+     * Process wide instance used by the binding layer.
+     */
+    static FileTraceSink& shared();
+
+private:
+    void writeEvent(const char *name, char phase);
+
+    std::mutex mutex;
+    FILE *file = nullptr;
+};
+
+/**
+ * Traces the enclosing scope. When no sink is set the cost is a single relaxed atomic load.
+ */
+class ScopedTrace {
+public:
+    explicit ScopedTrace(const char *name) : sink(currentTraceSink()), name(name) {
+        if (sink != nullptr) {
+            sink->beginSection(name);
+        }
+    }
+
+    ~ScopedTrace() {
+        if (sink != nullptr) {
+            sink->endSection(name);
+        }
+    }
+
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+    TraceSink *sink;
+    const char *name;
+};
+
+#endif //_ALPS_TRACE_H_
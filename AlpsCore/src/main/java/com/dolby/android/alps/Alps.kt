@@ -30,9 +30,12 @@ import com.dolby.android.alps.alpsnative.AlpsNative
 import com.dolby.android.alps.alpsnative.DefaultAlpsNative
 import com.dolby.android.alps.alpsnative.AlpsNativeInfo
 import com.dolby.android.alps.logger.AlpsLoggerProvider
+import com.dolby.android.alps.models.AlpsMetrics
+import com.dolby.android.alps.models.AlpsSelectionPolicy
 import com.dolby.android.alps.models.Presentation
 import com.dolby.android.alps.utils.AlpsException
 import java.nio.ByteBuffer
+import java.util.concurrent.CompletableFuture
 
 /**
  * Main ALPS library class - API of the library.
@@ -40,15 +43,18 @@ import java.nio.ByteBuffer
  * Use it to:
  * * get library version
  * * initialize ALPS library
- * * set presentations list changed callback
+ * * set presentations list changed callback and thread on which it is invoked
  * * process MP4 segments buffers
+ * * process MP4 segments incrementally, chunk by chunk
+ * * process MP4 segments asynchronously, on native threads
  * * get available presentations list
  * * get active presentation ID
  * * set active presentation
  * * close ALPS library
  *
  * @param alpsNative object implementing [AlpsNative] interface.
- * Recommended to **use default value** [DefaultAlpsNative].
+ * Recommended to **use default value** [DefaultAlpsNative]. Use [AlpsContextPool.createAlps] to
+ * create object with a pre-initialized native context.
  *
  * @constructor Tries to initialize alpsNative object.
  * @throws AlpsException if querying memory, allocating it or initializing native library failed.
@@ -98,8 +104,9 @@ class Alps(
      * Without any reaction, active presentation ID will stay unchanged, which may lead to unwanted
      * presentation playback.
      *
-     * **Warning!** Callback processing is blocking processIsobmffSegment call, so it should be
-     * limited to light operations!
+     * **Warning!** By default callback processing is blocking processIsobmffSegment call, so it
+     * should be limited to light operations! Use [setPresentationsChangedDispatchMode] to invoke it
+     * on a dedicated thread instead.
      *
      * @param callback callback function that will be invoked whenever presentations list change
      * @throws AlpsException.NotInitialized if Alps object is not initialized
@@ -110,6 +117,24 @@ class Alps(
         }
     }
 
+    /**
+     * Sets thread on which presentations list changed callback is invoked. Default mode is
+     * [PresentationsChangedDispatchMode.SYNCHRONOUS].
+     *
+     * In [PresentationsChangedDispatchMode.ASYNCHRONOUS] mode segment processing latency doesn't
+     * depend on the callback, but segment in which the change was detected may be processed
+     * before the callback sets new active presentation.
+     *
+     * @param mode callback dispatch mode
+     * @throws AlpsException.JNI if dispatcher thread couldn't be started
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     */
+    fun setPresentationsChangedDispatchMode(mode: PresentationsChangedDispatchMode) {
+        ifInitialized {
+            alpsNative.setPresentationsChangedDispatchMode(mode)
+        }
+    }
+
     /**
      * Processes buffer of fragmented MP4 segment. This method should be called for all audio
      * segments.
@@ -119,8 +144,13 @@ class Alps(
      * Active presentation can be set using [setActivePresentationId]. Before selecting any
      * presentation, stream will not be modified.
      *
-     * @param segmentBuf fragmented MP4 segment bytes. **Must be direct.**
+     * Buffer is processed in place. Bytes between buffer's position and limit are processed,
+     * position and limit are not changed.
+     *
+     * @param segmentBuf fragmented MP4 segment bytes. **Must be direct or backed by accessible
+     * array.**
      * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffer is neither direct nor backed by accessible array
      * @throws AlpsException.NotInitialized if Alps object is not initialized
      */
     fun processIsobmffSegment(segmentBuf: ByteBuffer) {
@@ -129,12 +159,166 @@ class Alps(
         }
     }
 
+    /**
+     * Processes fragmented MP4 segment held in an array. Works the same way as
+     * [processIsobmffSegment] for ByteBuffer, but segment is processed in place, without copying it
+     * to a direct buffer.
+     *
+     * Array is modified only if the segment was processed. Bytes changed before processing failed
+     * are restored, so the segment range is left unmodified when [AlpsException.Native] is thrown.
+     *
+     * @param segment array with fragmented MP4 segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     */
+    fun processIsobmffSegment(segment: ByteArray, offset: Int = 0, length: Int = segment.size) {
+        ifInitialized {
+            alpsNative.processIsobmffSegment(segment, offset, length)
+        }
+    }
+
+    /**
+     * Works the same way as [processIsobmffSegment], but reports whether the segment was processed
+     * or skipped. Segments are pre-scanned natively and not passed to the library when processing
+     * would be a no-op, e.g. for non AC-4 streams or before any presentation is set active.
+     *
+     * @param segmentBuf fragmented MP4 segment bytes. **Must be direct or backed by accessible
+     * array.**
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffer is neither direct nor backed by accessible array
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(segmentBuf: ByteBuffer): AlpsProcessingStatus {
+        return ifInitialized {
+            alpsNative.tryProcessIsobmffSegment(segmentBuf)
+        }
+    }
+
+    /**
+     * Array variant of [tryProcessIsobmffSegment], segment is processed in place. Segment range is
+     * left unmodified when [AlpsException.Native] is thrown, same as for the
+     * [processIsobmffSegment] array variant.
+     *
+     * @param segment array with fragmented MP4 segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(
+        segment: ByteArray,
+        offset: Int = 0,
+        length: Int = segment.size,
+    ): AlpsProcessingStatus {
+        return ifInitialized {
+            alpsNative.tryProcessIsobmffSegment(segment, offset, length)
+        }
+    }
+
+    /**
+     * Works the same way as [tryProcessIsobmffSegment], but segment may be split into multiple
+     * buffers, e.g. a chain of network buffers. Total segment size is not limited to
+     * [Int.MAX_VALUE].
+     *
+     * Segment is not copied into a single contiguous buffer. Only movie fragments (moof + mdat)
+     * spanning buffer boundaries are copied to a pooled native staging block, processed there and
+     * copied back. Buffers are left unmodified when [AlpsException.Native] is thrown.
+     *
+     * @param segmentBufs consecutive parts of fragmented MP4 segment, bytes between position and
+     * limit of every buffer are processed. **Must be either all direct or all backed by accessible
+     * arrays.**
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffers are neither all direct nor all backed by accessible
+     * arrays
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(segmentBufs: List<ByteBuffer>): AlpsProcessingStatus {
+        return ifInitialized {
+            alpsNative.tryProcessIsobmffSegment(segmentBufs)
+        }
+    }
+
+    /**
+     * Works the same way as [tryProcessIsobmffSegment], but the segment is left unmodified. Bytes
+     * ALPS may rewrite (AC-4 TOC of every sample) are saved, the segment is processed in place and
+     * the saved bytes are compared with the processed ones and written back. Only the changed bytes
+     * are returned, as a compact list of edits to apply while the segment is copied out of the
+     * caller's buffers (see [AlpsSegmentPatch.apply]).
+     *
+     * Patch is applicable only to the segment bytes it was created for.
+     *
+     * @param segment array with fragmented MP4 segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return edits of the processed segment
+     */
+    fun processIsobmffSegmentPatch(
+        segment: ByteArray,
+        offset: Int = 0,
+        length: Int = segment.size,
+    ): AlpsSegmentPatch {
+        return ifInitialized {
+            alpsNative.processIsobmffSegmentPatch(segment, offset, length)
+        }
+    }
+
+    /**
+     * Submits segment for asynchronous processing on native threads, see [AlpsProcessingQueue].
+     * Segments submitted to this object are processed in submission order, while segments of
+     * other [Alps] objects may be processed in parallel. Blocks while the queue is full.
+     *
+     * Segment is processed with the active presentation set at the time of processing.
+     * Presentations changed callback is invoked on a processing thread, unless
+     * [PresentationsChangedDispatchMode.ASYNCHRONOUS] is set, before the future completes.
+     *
+     * @param segmentBuf fragmented MP4 segment bytes. **Must be direct** (see [AlpsBufferPool])
+     * and must not be accessed until the returned future completes.
+     * @throws AlpsException.JNI if buffer is not direct or segment couldn't be submitted
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return future completed with processing status, or exceptionally with
+     * [AlpsException.Native] if processing failed
+     */
+    fun processIsobmffSegmentAsync(segmentBuf: ByteBuffer): CompletableFuture<AlpsProcessingStatus> {
+        return ifInitialized {
+            alpsNative.processIsobmffSegmentAsync(segmentBuf)
+        }
+    }
+
+    /**
+     * Creates [AlpsSegmentStream] that processes fragmented MP4 segments incrementally - every
+     * complete CMAF chunk is processed and can be read as soon as it is downloaded. Recommended for
+     * low latency streams.
+     *
+     * Stream is released together with this object.
+     *
+     * @throws AlpsException.JNI if stream creation failed
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return new [AlpsSegmentStream]
+     */
+    fun createSegmentStream(): AlpsSegmentStream {
+        return ifInitialized {
+            AlpsSegmentStream(alpsNative.createSegmentStream())
+        }
+    }
+
     /**
      * Fetches presentations list.
      *
      * To detect which of these presentations is active, use [getActivePresentationId] and find
      * matching presentation.
      *
+     * The same unmodifiable list object is returned until [getPresentationsListGeneration] changes.
+     *
      * @throws AlpsException.Native if getting presentations failed
      * @throws AlpsException.NotInitialized if Alps object is not initialized
      * @return list of [Presentation] if at least one was detected, [emptyList] otherwise
@@ -145,6 +329,37 @@ class Alps(
         }
     }
 
+    /**
+     * Returns generation of the presentations list. Generation starts at 0 with an empty list and
+     * is incremented whenever processing changes the list content, so callers polling the list can
+     * skip [getPresentations] while it stays the same.
+     *
+     * This is not the generation passed to [PresentationsChangedCallback.onPresentationsChanged],
+     * which counts changes reported by the native library, including reports that leave the list
+     * content unchanged.
+     *
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return presentations list generation
+     */
+    fun getPresentationsListGeneration(): Long {
+        return ifInitialized {
+            alpsNative.getPresentationsListGeneration()
+        }
+    }
+
+    /**
+     * Takes snapshot of processing counters and latency histograms of this object. Counters are
+     * updated with relaxed atomic operations, so they can be collected in production.
+     *
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     * @return current [AlpsMetrics]
+     */
+    fun getMetrics(): AlpsMetrics {
+        return ifInitialized {
+            alpsNative.getMetrics()
+        }
+    }
+
     /**
      * Fetches active presentation ID.
      *
@@ -175,6 +390,45 @@ class Alps(
         }
     }
 
+    /**
+     * Sets active presentation before the presentations list is known, e.g. from metadata cached
+     * by a previous playback of the same content.
+     *
+     * If the current presentations list contains the presentation, it is activated immediately.
+     * Otherwise it is activated as soon as the next init segment is processed, before any media
+     * segment following it, so the first media segments don't have to wait for
+     * [PresentationsChangedCallback]. Seeded ID not listed by the init segment is dropped.
+     * [setActivePresentationId] overrides the seeded ID.
+     *
+     * @param presentationId ID of desired active presentation
+     * @throws AlpsException.Native if setting failed
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     */
+    fun seedActivePresentationId(presentationId: Int) {
+        return ifInitialized {
+            alpsNative.seedActivePresentationId(presentationId)
+        }
+    }
+
+    /**
+     * Registers presentation selection policy evaluated by the native library each time
+     * presentations list changes. Matching presentation is activated before
+     * [PresentationsChangedCallback] is called, so the callback becomes informational and
+     * doesn't need to call [setActivePresentationId]. Seeded presentation, see
+     * [seedActivePresentationId], takes precedence over the policy. If presentations list is
+     * already known, policy is applied immediately.
+     *
+     * @param policy selection policy, null removes registered policy
+     * @throws AlpsException.JNI if policy couldn't be passed to native library
+     * @throws AlpsException.Native if setting active presentation failed
+     * @throws AlpsException.NotInitialized if Alps object is not initialized
+     */
+    fun setSelectionPolicy(policy: AlpsSelectionPolicy?) {
+        return ifInitialized {
+            alpsNative.setSelectionPolicy(policy)
+        }
+    }
+
     private fun <T>ifInitialized(
         block: () -> T
     ): T {
@@ -0,0 +1,70 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeBatchProcessor
+import com.dolby.android.alps.models.AlpsBatchJob
+import com.dolby.android.alps.models.AlpsBatchStatistics
+import com.dolby.android.alps.utils.AlpsException
+
+/**
+ * Native processor of segment files, for bulk processing of whole streams.
+ *
+ * Every job is processed by its own ALPS context, independent jobs are processed in parallel.
+ * Files are memory mapped and processed without copying them through Java heap. Files with output
+ * same as input are patched in place.
+ *
+ * Files that ALPS failed to process are written as is.
+ */
+object AlpsBatchProcessor {
+    /**
+     * Processes all jobs. Blocking, must not be called from the main thread.
+     *
+     * @param jobs streams to process
+     * @param threadCount number of jobs processed in parallel, 0 for number of CPU cores
+     * @throws AlpsException.JNI if jobs couldn't be passed to native processor
+     * @return processing statistics
+     */
+    fun process(jobs: List<AlpsBatchJob>, threadCount: Int = 0): AlpsBatchStatistics {
+        val files = jobs.flatMap { it.files }
+        return AlpsNativeBatchProcessor.process(
+            inputPaths = files.map { it.input.path }.toTypedArray(),
+            outputPaths = files.map { it.output.path }.toTypedArray(),
+            jobFileCounts = jobs.map { it.files.size }.toIntArray(),
+            presentationIds = jobs.map { it.presentationId }.toIntArray(),
+            threadCount = threadCount,
+        ).let {
+            AlpsBatchStatistics(
+                fileCount = it[0],
+                failedFileCount = it[1],
+                unprocessedFileCount = it[2],
+                bytes = it[3],
+                elapsedNs = it[4],
+            )
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeBufferPool
+import com.dolby.android.alps.models.AlpsBufferPoolStatistics
+import com.dolby.android.alps.utils.AlpsException
+import java.io.Closeable
+import java.nio.ByteBuffer
+
+/**
+ * Process wide pool of direct buffers for segments I/O.
+ *
+ * Buffers are leased from size-classed native memory blocks that are reused after release, so in
+ * steady state playback no memory is allocated per segment. Leased buffers can be passed directly
+ * to [Alps.processIsobmffSegment].
+ *
+ * Pool keeps at most [setMaxPooledBytes] of unused memory. Call [trim] periodically (e.g. on
+ * playback end or memory pressure) to return memory exceeding recent usage high-water mark.
+ */
+object AlpsBufferPool {
+    /**
+     * Leases direct buffer with capacity of [size] bytes. Must be closed when no longer needed,
+     * buffer must not be accessed afterwards.
+     *
+     * @param size required buffer size in bytes
+     * @throws AlpsException.JNI if memory allocation failed
+     * @return lease holding the buffer
+     */
+    fun lease(size: Int): AlpsBufferLease {
+        return AlpsBufferLease(AlpsNativeBufferPool.acquire(size))
+    }
+
+    /**
+     * Returns to the system unused memory exceeding leased bytes high-water mark observed since the
+     * previous trim.
+     */
+    fun trim() {
+        AlpsNativeBufferPool.trim()
+    }
+
+    /**
+     * Sets limit of unused memory kept in the pool. Default limit is 64 MiB.
+     *
+     * @param maxPooledBytes limit in bytes
+     */
+    fun setMaxPooledBytes(maxPooledBytes: Long) {
+        AlpsNativeBufferPool.setMaxPooledBytes(maxPooledBytes)
+    }
+
+    /**
+     * Returns pool usage statistics.
+     *
+     * @return current [AlpsBufferPoolStatistics]
+     */
+    fun getStatistics(): AlpsBufferPoolStatistics {
+        return AlpsNativeBufferPool.getStatistics().let {
+            AlpsBufferPoolStatistics(
+                leaseCount = it[0],
+                reuseCount = it[1],
+                allocationCount = it[2],
+                freeCount = it[3],
+                leasedBytes = it[4],
+                pooledBytes = it[5],
+                peakLeasedBytes = it[6],
+            )
+        }
+    }
+}
+
+/**
+ * Direct buffer leased from [AlpsBufferPool]. Closing the lease returns buffer memory to the pool.
+ *
+ * @property buffer leased direct buffer
+ */
+class AlpsBufferLease internal constructor(
+    val buffer: ByteBuffer
+): Closeable {
+    private var isReleased = false
+
+    /**
+     * Returns buffer to the pool. Calling it more than once has no effect.
+     */
+    @Synchronized
+    override fun close() {
+        if (isReleased.not()) {
+            isReleased = true
+            AlpsNativeBufferPool.release(buffer)
+        }
+    }
+}
\ No newline at end of file
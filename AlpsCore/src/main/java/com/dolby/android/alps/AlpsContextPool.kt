@@ -0,0 +1,90 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeContextPool
+import com.dolby.android.alps.alpsnative.DefaultAlpsNative
+import com.dolby.android.alps.utils.AlpsException
+
+/**
+ * Process wide pool of initialized native ALPS contexts.
+ *
+ * Creating [Alps] object allocates and initializes native context, which may take noticeable time
+ * on period boundaries of multi-period streams. [Alps] objects created with [createAlps] take
+ * contexts initialized ahead of time with [prewarm]. When such object is released, its context
+ * memory is reinitialized and kept in the pool instead of being returned to the system.
+ *
+ * Pool keeps at most [setMaxIdleContexts] idle contexts, 2 by default.
+ */
+object AlpsContextPool {
+    /**
+     * Creates [Alps] object using a pooled context. New context is created if pool is empty.
+     *
+     * @throws AlpsException if querying memory, allocating it or initializing native library
+     * failed.
+     * @return new [Alps] object
+     */
+    fun createAlps(): Alps {
+        return Alps(DefaultAlpsNative(pooled = true))
+    }
+
+    /**
+     * Initializes contexts until at least [count] contexts are idle. Blocking, should not be
+     * called from time critical threads.
+     *
+     * @param count required number of idle contexts, limited by [setMaxIdleContexts]
+     * @return number of idle contexts
+     */
+    fun prewarm(count: Int = 1): Int {
+        return AlpsNativeContextPool.prewarm(count)
+    }
+
+    /**
+     * Sets limit of idle contexts kept in the pool. Idle contexts above the limit are released.
+     *
+     * @param maxIdleContexts limit of idle contexts
+     */
+    fun setMaxIdleContexts(maxIdleContexts: Int) {
+        AlpsNativeContextPool.setMaxIdleContexts(maxIdleContexts)
+    }
+
+    /**
+     * Releases all idle contexts.
+     */
+    fun trim() {
+        AlpsNativeContextPool.trim()
+    }
+
+    /**
+     * Returns number of idle contexts.
+     *
+     * @return number of contexts ready to be used by [createAlps]
+     */
+    fun getIdleContextCount(): Int {
+        return AlpsNativeContextPool.getIdleContextCount()
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeProcessingQueue
+import com.dolby.android.alps.models.AlpsProcessingQueueStatistics
+
+/**
+ * Process wide native queue of segments submitted with [Alps.processIsobmffSegmentAsync].
+ *
+ * Segments are processed on a pool of native threads (one per CPU, at most 4). Segments of a
+ * single [Alps] object are processed one at a time in submission order, segments of different
+ * objects (e.g. audio representations, periods or players) are processed in parallel.
+ *
+ * Queue is bounded, by default to 32 segments and 32 MiB. Submitting a segment blocks while the
+ * queue is full, so producers can't run ahead of processing.
+ */
+object AlpsProcessingQueue {
+    /**
+     * Sets limits of queued segments. Limits are soft - concurrent producers may exceed them by
+     * one segment each. Single segment larger than [maxQueuedBytes] is accepted by an empty queue.
+     *
+     * @param maxQueuedSegments limit of segments waiting for or being processed
+     * @param maxQueuedBytes limit of bytes of these segments
+     */
+    fun setLimits(maxQueuedSegments: Int, maxQueuedBytes: Long) {
+        AlpsNativeProcessingQueue.setLimits(maxQueuedSegments, maxQueuedBytes)
+    }
+
+    /**
+     * Returns queue usage statistics.
+     *
+     * @return current [AlpsProcessingQueueStatistics]
+     */
+    fun getStatistics(): AlpsProcessingQueueStatistics {
+        return AlpsNativeProcessingQueue.getStatistics().let {
+            AlpsProcessingQueueStatistics(
+                queuedSegments = it[0],
+                queuedBytes = it[1],
+                processedSegments = it[2],
+                producerWaits = it[3],
+            )
+        }
+    }
+}
\ No newline at end of file
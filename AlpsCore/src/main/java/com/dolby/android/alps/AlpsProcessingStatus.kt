@@ -0,0 +1,58 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+/**
+ * Result of [Alps.tryProcessIsobmffSegment]. Segments are pre-scanned natively and native
+ * processing is skipped when it would not modify the segment nor detect new presentations.
+ * Skipped segments are left unchanged.
+ */
+enum class AlpsProcessingStatus {
+    /**
+     * Segment was processed by native library.
+     */
+    PROCESSED,
+
+    /**
+     * Segment contains neither movie (moov) nor movie fragment (moof) box.
+     */
+    SKIPPED_NO_MOVIE_NOR_FRAGMENT,
+
+    /**
+     * Last init segment doesn't contain AC-4 track.
+     */
+    SKIPPED_NO_AC4_TRACK,
+
+    /**
+     * Media segment processed before any presentation was set active.
+     */
+    SKIPPED_NO_ACTIVE_PRESENTATION;
+
+    internal companion object {
+        fun fromNative(status: Int): AlpsProcessingStatus = values()[status]
+    }
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+package com.dolby.android.alps
+
+import kotlin.math.max
+import kotlin.math.min
+
+/**
+ * Edits turning a fragmented MP4 segment into its processed version, result of
+ * [Alps.processIsobmffSegmentPatch].
+ *
+ * Processing changes only a few bytes of every AC-4 sample, so the patch is much smaller than the
+ * segment. Instead of rewriting the whole segment, edits can be applied lazily to the parts of the
+ * segment being copied out, see [apply].
+ *
+ * @property status processing status, patch of a skipped segment has no edits
+ */
+class AlpsSegmentPatch internal constructor(
+    status: Int,
+    private val offsets: IntArray,
+    private val lengths: IntArray,
+    private val values: ByteArray,
+) {
+    val status: AlpsProcessingStatus = AlpsProcessingStatus.fromNative(status)
+
+    // Offset in values of the first byte of every edit
+    private val valueOffsets = IntArray(offsets.size).also {
+        for (index in 1 until offsets.size) {
+            it[index] = it[index - 1] + lengths[index - 1]
+        }
+    }
+
+    /**
+     * Number of edits, edits are sorted by offset and don't overlap.
+     */
+    val editCount: Int
+        get() = offsets.size
+
+    /**
+     * Total number of bytes replaced by the edits.
+     */
+    val editedBytes: Int
+        get() = values.size
+
+    /**
+     * Applies edits overlapping given part of the segment.
+     *
+     * @param buffer array holding segment bytes from [segmentPosition]
+     * @param offset offset in [buffer] of the byte at [segmentPosition]
+     * @param segmentPosition position in the segment of the first byte to patch
+     * @param length number of bytes to patch
+     */
+    fun apply(buffer: ByteArray, offset: Int, segmentPosition: Long, length: Int) {
+        val end = segmentPosition + length
+        var index = firstEditEndingAfter(segmentPosition)
+        while (index < offsets.size && offsets[index] < end) {
+            val editStart = max(offsets[index].toLong(), segmentPosition)
+            val editEnd = min(offsets[index].toLong() + lengths[index], end)
+            System.arraycopy(
+                values,
+                valueOffsets[index] + (editStart - offsets[index]).toInt(),
+                buffer,
+                offset + (editStart - segmentPosition).toInt(),
+                (editEnd - editStart).toInt(),
+            )
+            index++
+        }
+    }
+
+    /**
+     * Applies all edits to the whole segment.
+     *
+     * @param segment array holding the segment
+     * @param offset offset of the first segment byte in [segment]
+     */
+    fun apply(segment: ByteArray, offset: Int = 0) {
+        apply(segment, offset, 0, Int.MAX_VALUE)
+    }
+
+    private fun firstEditEndingAfter(segmentPosition: Long): Int {
+        var low = 0
+        var high = offsets.size
+        while (low < high) {
+            val middle = (low + high) ushr 1
+            if (offsets[middle].toLong() + lengths[middle] <= segmentPosition) {
+                low = middle + 1
+            } else {
+                high = middle
+            }
+        }
+        return low
+    }
+}
\ No newline at end of file
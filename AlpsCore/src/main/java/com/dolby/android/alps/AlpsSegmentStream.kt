@@ -0,0 +1,112 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeSegmentStream
+import com.dolby.android.alps.utils.AlpsException
+
+/**
+ * Incremental processing of fragmented MP4 segments - designed for low latency (CMAF chunked)
+ * streams.
+ *
+ * Segment bytes are fed as they are downloaded. Every complete CMAF chunk (moof + mdat boxes) is
+ * processed as soon as it is fed and becomes available for [read] right away, so the first
+ * processed bytes are available after downloading the first chunk instead of the whole segment.
+ * Remaining bytes (e.g. init segment) are processed by [finish].
+ *
+ * Usage for each segment:
+ * 1. [reset]
+ * 2. [feed] downloaded bytes, [read] processed bytes whenever available
+ * 3. [finish] when whole segment was fed and [read] remaining bytes
+ *
+ * Stream shares ALPS context with [Alps] object that created it, so presentations list, active
+ * presentation and presentations changed callback apply the same way as for
+ * [Alps.processIsobmffSegment]. Released automatically together with its [Alps] object.
+ *
+ * Created by [Alps.createSegmentStream].
+ */
+class AlpsSegmentStream internal constructor(
+    private val nativeStream: AlpsNativeSegmentStream
+) {
+    /**
+     * Drops all buffered data. Must be called before feeding a new segment.
+     *
+     * @throws AlpsException.NotInitialized if stream or its Alps object was released
+     */
+    fun reset() {
+        nativeStream.reset()
+    }
+
+    /**
+     * Feeds segment bytes and processes every CMAF chunk completed by them.
+     *
+     * If processing of a chunk fails, the chunk is made available for reading as left by the
+     * library and exception is thrown.
+     *
+     * @param data array holding segment bytes
+     * @param offset offset of the first byte in [data]
+     * @param length number of bytes to feed
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.NotInitialized if stream or its Alps object was released
+     * @return number of processed bytes available for reading
+     */
+    fun feed(data: ByteArray, offset: Int = 0, length: Int = data.size): Int {
+        return nativeStream.feed(data, offset, length)
+    }
+
+    /**
+     * Marks end of the segment and processes remaining bytes. All fed bytes are available for
+     * reading afterwards.
+     *
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.NotInitialized if stream or its Alps object was released
+     * @return number of processed bytes available for reading
+     */
+    fun finish(): Int {
+        return nativeStream.finish()
+    }
+
+    /**
+     * Reads processed bytes.
+     *
+     * @param buffer target array
+     * @param offset offset in [buffer] at which to write
+     * @param length maximum number of bytes to read
+     * @throws AlpsException.NotInitialized if stream or its Alps object was released
+     * @return number of bytes read, 0 if no processed bytes are available at the moment
+     */
+    fun read(buffer: ByteArray, offset: Int, length: Int): Int {
+        return nativeStream.read(buffer, offset, length)
+    }
+
+    /**
+     * Release resources. Stream can't be used afterwards.
+     */
+    fun release() {
+        nativeStream.release()
+    }
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps
+
+import com.dolby.android.alps.alpsnative.AlpsNativeTrace
+
+/**
+ * Process wide control of native trace sections.
+ *
+ * Native library marks segment processing, presentations changed callbacks, chunked stream copies
+ * and batch file I/O with trace sections. Tracing is disabled by default, then the overhead is a
+ * single atomic load per section.
+ */
+object AlpsTrace {
+    /**
+     * Stops tracing and closes trace file, if any.
+     */
+    fun disable() {
+        AlpsNativeTrace.disable()
+    }
+
+    /**
+     * Sends trace sections to the system trace (ATrace), visible in Perfetto and systrace captures.
+     *
+     * @return false if system trace is not available
+     */
+    fun enableSystemTrace(): Boolean {
+        return AlpsNativeTrace.enableSystemTrace()
+    }
+
+    /**
+     * Writes trace sections to a file in Chrome trace event JSON format, which can be opened in
+     * Perfetto UI. Previous trace file is closed.
+     *
+     * @param path trace file path, file is overwritten
+     * @return false if file couldn't be created
+     */
+    fun enableFileTrace(path: String): Boolean {
+        return AlpsNativeTrace.enableFileTrace(path)
+    }
+
+    /**
+     * Records calls of all Alps objects to a compact binary file: processed segments with their
+     * sizes, hashes and processing times, presentation switches and presentations list changes.
+     * Recording can be replayed on a Linux host with alpsreplay tool to reproduce production
+     * workloads. Previous recording is stopped. Recording should start before playback, so that
+     * init segments are recorded.
+     *
+     * @param path recording file path, file is overwritten
+     * @param recordPayloads record segment bytes too, otherwise replay uses synthetic segments of
+     * the recorded sizes
+     * @return false if file couldn't be created
+     */
+    fun startCallRecording(path: String, recordPayloads: Boolean = false): Boolean {
+        return AlpsNativeTrace.startCallRecording(path, recordPayloads)
+    }
+
+    /**
+     * Stops call recording and closes its file.
+     */
+    fun stopCallRecording() {
+        AlpsNativeTrace.stopCallRecording()
+    }
+}
\ No newline at end of file
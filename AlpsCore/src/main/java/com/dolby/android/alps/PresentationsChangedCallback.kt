@@ -35,4 +35,14 @@ interface PresentationsChangedCallback {
      * Called whenever presentations list change is detected
      */
     fun onPresentationsChanged()
+
+    /**
+     * Called in [PresentationsChangedDispatchMode.ASYNCHRONOUS] mode when presentations list
+     * change is detected. Calls [onPresentationsChanged] by default.
+     *
+     * @param generation number of presentations list changes reported by native library so far.
+     * Generations of coalesced changes are skipped. Reports don't always change the list content, so
+     * this differs from [Alps.getPresentationsListGeneration].
+     */
+    fun onPresentationsChanged(generation: Long) = onPresentationsChanged()
 }
\ No newline at end of file
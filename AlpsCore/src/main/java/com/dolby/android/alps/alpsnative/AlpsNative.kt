@@ -26,10 +26,16 @@
 
 package com.dolby.android.alps.alpsnative
 
+import com.dolby.android.alps.AlpsProcessingStatus
+import com.dolby.android.alps.AlpsSegmentPatch
 import com.dolby.android.alps.PresentationsChangedCallback
+import com.dolby.android.alps.PresentationsChangedDispatchMode
+import com.dolby.android.alps.models.AlpsMetrics
+import com.dolby.android.alps.models.AlpsSelectionPolicy
 import com.dolby.android.alps.models.Presentation
 import com.dolby.android.alps.utils.AlpsException
 import java.nio.ByteBuffer
+import java.util.concurrent.CompletableFuture
 
 /**
  * AlpsNative interface - defines usage of Native ALPS library.
@@ -69,15 +75,103 @@ interface AlpsNative {
     fun setPresentationsChangedCallback(callback: PresentationsChangedCallback)
 
     /**
-     * Processes buffer of fragmented MP4 segment.
+     * Sets thread on which presentations list changed callback is invoked.
      *
-     * @param segmentBuf **direct** ByteBuffer with segment bytes
+     * @param mode callback dispatch mode
+     * @throws AlpsException.JNI if dispatcher thread couldn't be started
+     */
+    fun setPresentationsChangedDispatchMode(mode: PresentationsChangedDispatchMode)
+
+    /**
+     * Processes buffer of fragmented MP4 segment in place. Bytes between buffer's position and
+     * limit are processed, position and limit are not changed.
+     *
+     * @param segmentBuf direct ByteBuffer or ByteBuffer backed by accessible array, with segment
+     * bytes
      * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffer is neither direct nor backed by accessible array
      */
     fun processIsobmffSegment(segmentBuf: ByteBuffer)
 
     /**
-     * Fetches presentations list.
+     * Processes fragmented MP4 segment in place, without copying it.
+     *
+     * @param segment array with segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     */
+    fun processIsobmffSegment(segment: ByteArray, offset: Int, length: Int)
+
+    /**
+     * Same as [processIsobmffSegment], but reports segments skipped by the native pre-scanner.
+     *
+     * @param segmentBuf direct ByteBuffer or ByteBuffer backed by accessible array, with segment
+     * bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffer is neither direct nor backed by accessible array
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(segmentBuf: ByteBuffer): AlpsProcessingStatus
+
+    /**
+     * Same as [processIsobmffSegment], but reports segments skipped by the native pre-scanner.
+     *
+     * @param segment array with segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(segment: ByteArray, offset: Int, length: Int): AlpsProcessingStatus
+
+    /**
+     * Same as [tryProcessIsobmffSegment], but segment is split into multiple buffers. Bytes
+     * between position and limit of every buffer are processed in place, positions and limits are
+     * not changed.
+     *
+     * @param segmentBufs consecutive parts of the segment, either all direct or all backed by
+     * accessible arrays
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if buffers are neither all direct nor all backed by accessible
+     * arrays
+     * @return processing status
+     */
+    fun tryProcessIsobmffSegment(segmentBufs: List<ByteBuffer>): AlpsProcessingStatus
+
+    /**
+     * Processes a native copy of fragmented MP4 segment held in an array and returns the bytes
+     * changed by processing. Segment array is not modified.
+     *
+     * @param segment array with fragmented MP4 segment bytes
+     * @param offset offset of the first segment byte in [segment]
+     * @param length segment size in bytes
+     * @throws AlpsException.Native if processing failed
+     * @throws AlpsException.JNI if given range is out of [segment] bounds
+     * @return edits of the processed segment
+     */
+    fun processIsobmffSegmentPatch(segment: ByteArray, offset: Int, length: Int): AlpsSegmentPatch
+
+    /**
+     * Submits direct buffer of fragmented MP4 segment to native processing queue. Bytes between
+     * buffer's position and limit are processed in place, after the returned future completes.
+     * Blocks while the queue is full.
+     *
+     * @param segmentBuf direct ByteBuffer with segment bytes, must not be accessed until the
+     * returned future completes
+     * @throws AlpsException.JNI if buffer is not direct or segment couldn't be submitted
+     * @throws AlpsException.NotInitialized if object was released
+     * @return future completed with processing status, or exceptionally with
+     * [AlpsException.Native] if processing failed
+     */
+    fun processIsobmffSegmentAsync(segmentBuf: ByteBuffer): CompletableFuture<AlpsProcessingStatus>
+
+    /**
+     * Fetches presentations list. Presentation getters don't wait for processing running on
+     * another thread, they return the list and active presentation published after the last
+     * processed segment.
      *
      * @throws AlpsException.Native if getting presentations list failed
      * @return list of [Presentation] objects returned by native library (might be empty),
@@ -86,7 +180,21 @@ interface AlpsNative {
     fun getPresentations(): List<Presentation>?
 
     /**
-     * Fetches ID of active Presentation.
+     * Fetches presentations list generation, incremented whenever list content changes.
+     *
+     * @return presentations list generation, 0 before any presentation is detected
+     */
+    fun getPresentationsListGeneration(): Long
+
+    /**
+     * Takes snapshot of native processing counters and latency histograms.
+     *
+     * @return current [AlpsMetrics]
+     */
+    fun getMetrics(): AlpsMetrics
+
+    /**
+     * Fetches ID of active Presentation, doesn't wait for processing running on another thread.
      *
      * @throws AlpsException.Native if getting active presentation ID failed
      * @return ID of active Presentation if native call was successful, -1 otherwise
@@ -100,4 +208,32 @@ interface AlpsNative {
      * @throws AlpsException.Native if setting active presentation ID failed
      */
     fun setActivePresentationId(id: Int)
+
+    /**
+     * Sets active presentation if presentations list contains it, otherwise activates it right
+     * after the next init segment listing it is processed.
+     *
+     * @param id ID of desired active presentation
+     * @throws AlpsException.Native if setting active presentation ID failed
+     */
+    fun seedActivePresentationId(id: Int)
+
+    /**
+     * Registers policy selecting active presentation natively each time presentations list
+     * changes. Policy is applied immediately if presentations list is already known.
+     *
+     * @param policy selection policy, null removes registered policy
+     * @throws AlpsException.JNI if policy couldn't be passed to native library
+     * @throws AlpsException.Native if setting active presentation ID failed
+     */
+    fun setSelectionPolicy(policy: AlpsSelectionPolicy?)
+
+    /**
+     * Creates stream for incremental, chunk by chunk, processing of segments. Stream uses the same
+     * native context and is released together with this object.
+     *
+     * @throws AlpsException.JNI if native stream creation failed
+     * @return new [AlpsNativeSegmentStream]
+     */
+    fun createSegmentStream(): AlpsNativeSegmentStream
 }
\ No newline at end of file
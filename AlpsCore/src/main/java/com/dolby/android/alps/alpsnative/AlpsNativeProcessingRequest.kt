@@ -0,0 +1,61 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps.alpsnative
+
+import com.dolby.android.alps.AlpsProcessingStatus
+import com.dolby.android.alps.utils.AlpsException
+import java.nio.ByteBuffer
+import java.util.concurrent.CompletableFuture
+
+/**
+ * Segment submitted to native processing queue. Completed by a processing queue thread.
+ *
+ * @param segmentBuf processed buffer, referenced until the request is completed
+ */
+internal class AlpsNativeProcessingRequest(
+    @Suppress("unused") private val segmentBuf: ByteBuffer,
+) {
+    companion object {
+        private const val NATIVE_STATUS_FAILED = 4
+    }
+
+    val future = CompletableFuture<AlpsProcessingStatus>()
+
+    /**
+     * Called by native processing queue after the segment is processed.
+     *
+     * @param status native processing status
+     * @param error exception matching native error if processing failed
+     */
+    fun onProcessed(status: Int, error: Throwable?) {
+        if (status == NATIVE_STATUS_FAILED) {
+            future.completeExceptionally(error ?: AlpsException.Native.Undefined())
+        } else {
+            future.complete(AlpsProcessingStatus.fromNative(status))
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps.alpsnative
+
+import com.dolby.android.alps.utils.AlpsException
+
+/**
+ * AlpsNativeSegmentStream interface - defines incremental processing of a single segment using
+ * Native ALPS library.
+ *
+ * The default implementation is created by [DefaultAlpsNative.createSegmentStream].
+ */
+interface AlpsNativeSegmentStream {
+    /**
+     * Drops all buffered data. Must be called before feeding a new segment.
+     */
+    fun reset()
+
+    /**
+     * Appends segment bytes and processes every chunk completed by them.
+     *
+     * @param data array holding segment bytes
+     * @param offset offset of the first byte in [data]
+     * @param length number of bytes to feed
+     * @throws AlpsException.Native if processing failed, processed bytes are available anyway
+     * @return number of processed bytes available for reading
+     */
+    fun feed(data: ByteArray, offset: Int, length: Int): Int
+
+    /**
+     * Marks end of the segment and processes remaining bytes.
+     *
+     * @throws AlpsException.Native if processing failed, processed bytes are available anyway
+     * @return number of processed bytes available for reading
+     */
+    fun finish(): Int
+
+    /**
+     * Reads processed bytes.
+     *
+     * @param buffer target array
+     * @param offset offset in [buffer] at which to write
+     * @param length maximum number of bytes to read
+     * @return number of bytes read, 0 if no processed bytes are available
+     */
+    fun read(buffer: ByteArray, offset: Int, length: Int): Int
+
+    /**
+     * Release resources. Must be called when object is no longer needed.
+     */
+    fun release()
+}
\ No newline at end of file
@@ -26,31 +26,56 @@
 
 package com.dolby.android.alps.alpsnative;
 
+import com.dolby.android.alps.AlpsProcessingStatus
+import com.dolby.android.alps.AlpsSegmentPatch
 import com.dolby.android.alps.PresentationsChangedCallback
+import com.dolby.android.alps.PresentationsChangedDispatchMode
+import com.dolby.android.alps.models.AlpsMetrics
+import com.dolby.android.alps.models.AlpsSelectionPolicy
 import com.dolby.android.alps.models.Presentation
 import com.dolby.android.alps.utils.AlpsException
 import java.nio.ByteBuffer
+import java.util.Collections
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.locks.ReentrantReadWriteLock
+import kotlin.concurrent.read
+import kotlin.concurrent.write
 
 /**
  * Default implementation of AlpsNative interface. Uses native C library wrapper.
+ *
+ * @param pooled take native context from [AlpsNativeContextPool] and return it there on release
  */
-internal class DefaultAlpsNative: AlpsNative {
+internal class DefaultAlpsNative(
+    private val pooled: Boolean = false
+): AlpsNative {
     companion object {
         init {
             System.loadLibrary("alpsnative")
         }
 
         private const val ALPS_NATIVE_NOT_INITIALIZED = 0L
-        private const val NATIVE_ALPS_CREATE_FAILED = -1L
+        private const val SEGMENT_STREAM_RELEASED = 0L
     }
 
+    @Volatile
     private var alpsNativeHandle: Long = ALPS_NATIVE_NOT_INITIALIZED
     private val lock = Any()
+    private val segmentStreams = mutableSetOf<SegmentStream>()
+    // Presentation getters share read lock, release takes write lock before destroying the handle
+    private val snapshotLock = ReentrantReadWriteLock()
+    @Volatile
+    private var cachedPresentations: CachedPresentations? = null
+
+    private class CachedPresentations(
+        val generation: Long,
+        val presentations: List<Presentation>,
+    )
 
     override fun initialize() = synchronized(lock) {
         try {
-            alpsNativeHandle = create()
-            if (alpsNativeHandle == NATIVE_ALPS_CREATE_FAILED) {
+            alpsNativeHandle = if (pooled) createPooled() else create()
+            if (alpsNativeHandle == ALPS_NATIVE_NOT_INITIALIZED) {
                 throw AlpsException.JNI("Native object creation failed")
             }
         } catch(e: AlpsException) {
@@ -60,8 +85,16 @@ internal class DefaultAlpsNative: AlpsNative {
     }
 
     override fun release() = synchronized(lock) {
-        destroy(alpsNativeHandle)
-        alpsNativeHandle = ALPS_NATIVE_NOT_INITIALIZED
+        segmentStreams.forEach { it.destroy() }
+        segmentStreams.clear()
+        val handle = alpsNativeHandle
+        if (handle != ALPS_NATIVE_NOT_INITIALIZED) {
+            snapshotLock.write {
+                alpsNativeHandle = ALPS_NATIVE_NOT_INITIALIZED
+            }
+            destroy(handle)
+        }
+        cachedPresentations = null
     }
 
     override fun isInitialized() = alpsNativeHandle != ALPS_NATIVE_NOT_INITIALIZED
@@ -70,23 +103,227 @@ internal class DefaultAlpsNative: AlpsNative {
         setPresentationsChangedCallback(alpsNativeHandle, callback)
     }
 
+    override fun setPresentationsChangedDispatchMode(
+        mode: PresentationsChangedDispatchMode
+    ) = synchronized(lock) {
+        setAsyncPresentationsChangedDispatch(
+            alpsNativeHandle,
+            mode == PresentationsChangedDispatchMode.ASYNCHRONOUS,
+        )
+    }
+
     override fun processIsobmffSegment(segmentBuf: ByteBuffer) = synchronized(lock) {
-        processIsobmffSegment(alpsNativeHandle, segmentBuf)
+        when {
+            segmentBuf.isDirect -> processIsobmffSegment(
+                alpsNativeHandle,
+                segmentBuf,
+                segmentBuf.position(),
+                segmentBuf.remaining(),
+            )
+            segmentBuf.hasArray() -> processIsobmffSegmentArray(
+                alpsNativeHandle,
+                segmentBuf.array(),
+                segmentBuf.arrayOffset() + segmentBuf.position(),
+                segmentBuf.remaining(),
+            )
+            else -> throw AlpsException.JNI("Segment buffer is neither direct nor array backed")
+        }
+    }
+
+    override fun processIsobmffSegment(segment: ByteArray, offset: Int, length: Int) = synchronized(lock) {
+        processIsobmffSegmentArray(alpsNativeHandle, segment, offset, length)
+    }
+
+    override fun tryProcessIsobmffSegment(
+        segmentBuf: ByteBuffer
+    ): AlpsProcessingStatus = synchronized(lock) {
+        val status = when {
+            segmentBuf.isDirect -> tryProcessIsobmffSegment(
+                alpsNativeHandle,
+                segmentBuf,
+                segmentBuf.position(),
+                segmentBuf.remaining(),
+            )
+            segmentBuf.hasArray() -> tryProcessIsobmffSegmentArray(
+                alpsNativeHandle,
+                segmentBuf.array(),
+                segmentBuf.arrayOffset() + segmentBuf.position(),
+                segmentBuf.remaining(),
+            )
+            else -> throw AlpsException.JNI("Segment buffer is neither direct nor array backed")
+        }
+        AlpsProcessingStatus.fromNative(status)
+    }
+
+    override fun tryProcessIsobmffSegment(
+        segment: ByteArray,
+        offset: Int,
+        length: Int,
+    ): AlpsProcessingStatus = synchronized(lock) {
+        AlpsProcessingStatus.fromNative(
+            tryProcessIsobmffSegmentArray(alpsNativeHandle, segment, offset, length)
+        )
     }
 
-    override fun getPresentations(): List<Presentation>? = synchronized(lock) {
-        getPresentations(alpsNativeHandle)
+    override fun tryProcessIsobmffSegment(
+        segmentBufs: List<ByteBuffer>
+    ): AlpsProcessingStatus = synchronized(lock) {
+        val lengths = IntArray(segmentBufs.size) { segmentBufs[it].remaining() }
+        val status = when {
+            segmentBufs.all { it.isDirect } -> tryProcessIsobmffSegmentSlices(
+                alpsNativeHandle,
+                segmentBufs.toTypedArray(),
+                IntArray(segmentBufs.size) { segmentBufs[it].position() },
+                lengths,
+            )
+            segmentBufs.all { it.hasArray() } -> tryProcessIsobmffSegmentArraySlices(
+                alpsNativeHandle,
+                Array(segmentBufs.size) { segmentBufs[it].array() },
+                IntArray(segmentBufs.size) {
+                    segmentBufs[it].arrayOffset() + segmentBufs[it].position()
+                },
+                lengths,
+            )
+            else -> throw AlpsException.JNI(
+                "Segment buffers are neither all direct nor all array backed"
+            )
+        }
+        AlpsProcessingStatus.fromNative(status)
     }
 
-    override fun getActivePresentationId(): Int = synchronized(lock) {
-        getActivePresentationId(alpsNativeHandle)
+    override fun processIsobmffSegmentPatch(
+        segment: ByteArray,
+        offset: Int,
+        length: Int,
+    ): AlpsSegmentPatch = synchronized(lock) {
+        processIsobmffSegmentPatch(alpsNativeHandle, segment, offset, length)
+    }
+
+    override fun processIsobmffSegmentAsync(
+        segmentBuf: ByteBuffer
+    ): CompletableFuture<AlpsProcessingStatus> {
+        if (segmentBuf.isDirect.not()) {
+            throw AlpsException.JNI("Asynchronously processed segment buffer must be direct")
+        }
+        val request = AlpsNativeProcessingRequest(segmentBuf)
+        // Waits without holding the lock, completions calling back into this object could not
+        // make progress otherwise
+        AlpsNativeProcessingQueue.waitForCapacity(segmentBuf.remaining())
+        synchronized(lock) {
+            if (isInitialized().not()) {
+                throw AlpsException.NotInitialized()
+            }
+            submitIsobmffSegment(
+                alpsNativeHandle,
+                segmentBuf,
+                segmentBuf.position(),
+                segmentBuf.remaining(),
+                request,
+            )
+        }
+        return request.future
+    }
+
+    override fun getPresentations(): List<Presentation>? = readSnapshot { handle ->
+        // Generation is read first, a list published in between is only cached as older
+        val generation = getPresentationsListGeneration(handle)
+        cachedPresentations?.takeIf { it.generation == generation }?.presentations
+            ?: getPresentations(handle)?.let { Collections.unmodifiableList(it) }?.also {
+                cachedPresentations = CachedPresentations(generation, it)
+            }
+    }
+
+    override fun getPresentationsListGeneration(): Long = readSnapshot { handle ->
+        getPresentationsListGeneration(handle)
+    }
+
+    override fun getMetrics(): AlpsMetrics = synchronized(lock) {
+        AlpsMetrics.fromNative(getMetrics(alpsNativeHandle))
+    }
+
+    override fun getActivePresentationId(): Int = readSnapshot { handle ->
+        getActivePresentationId(handle)
     }
 
     override fun setActivePresentationId(id: Int) = synchronized(lock) {
         setActivePresentationId(alpsNativeHandle, id)
     }
 
+    override fun seedActivePresentationId(id: Int) = synchronized(lock) {
+        seedActivePresentationId(alpsNativeHandle, id)
+    }
+
+    override fun setSelectionPolicy(policy: AlpsSelectionPolicy?) = synchronized(lock) {
+        setSelectionPolicy(
+            alpsNativeHandle,
+            policy?.criteria(),
+            policy?.values(),
+            policy?.presentationIds(),
+            policy?.fallbackPresentationId ?: -1,
+        )
+    }
+
+    override fun createSegmentStream(): AlpsNativeSegmentStream = synchronized(lock) {
+        SegmentStream(createSegmentStream(alpsNativeHandle)).also {
+            segmentStreams.add(it)
+        }
+    }
+
+    /**
+     * Runs presentation getter without taking the processing lock, native session publishes
+     * presentations after every processed segment, so getters don't wait for processing running on
+     * another thread. Only [release] blocks them, until the handle is cleared.
+     */
+    private inline fun <T> readSnapshot(block: (handle: Long) -> T): T = snapshotLock.read {
+        val handle = alpsNativeHandle
+        if (handle == ALPS_NATIVE_NOT_INITIALIZED) {
+            throw AlpsException.NotInitialized()
+        }
+        block(handle)
+    }
+
+    private inner class SegmentStream(
+        private var streamHandle: Long
+    ): AlpsNativeSegmentStream {
+        override fun reset() = synchronized(lock) {
+            resetSegmentStream(requireStreamHandle())
+        }
+
+        override fun feed(data: ByteArray, offset: Int, length: Int): Int = synchronized(lock) {
+            feedSegmentStream(requireStreamHandle(), data, offset, length)
+        }
+
+        override fun finish(): Int = synchronized(lock) {
+            finishSegmentStream(requireStreamHandle())
+        }
+
+        override fun read(buffer: ByteArray, offset: Int, length: Int): Int = synchronized(lock) {
+            readSegmentStream(requireStreamHandle(), buffer, offset, length)
+        }
+
+        override fun release() = synchronized(lock) {
+            destroy()
+            segmentStreams.remove(this)
+            Unit
+        }
+
+        fun destroy() {
+            if (streamHandle != SEGMENT_STREAM_RELEASED) {
+                destroySegmentStream(streamHandle)
+                streamHandle = SEGMENT_STREAM_RELEASED
+            }
+        }
+
+        private fun requireStreamHandle(): Long {
+            if (streamHandle == SEGMENT_STREAM_RELEASED || isInitialized().not()) {
+                throw AlpsException.NotInitialized()
+            }
+            return streamHandle
+        }
+    }
+
     private external fun create(): Long
+    private external fun createPooled(): Long
     private external fun destroy(
         alpsHandle: Long,
     )
@@ -94,13 +331,68 @@ internal class DefaultAlpsNative: AlpsNative {
         alpsHandle: Long,
         callback: PresentationsChangedCallback,
     )
+    private external fun setAsyncPresentationsChangedDispatch(
+        alpsHandle: Long,
+        async: Boolean,
+    )
     private external fun processIsobmffSegment(
         alpsHandle: Long,
         segmentBuf: ByteBuffer,
+        offset: Int,
+        length: Int,
+    )
+    private external fun processIsobmffSegmentArray(
+        alpsHandle: Long,
+        segment: ByteArray,
+        offset: Int,
+        length: Int,
+    )
+    private external fun tryProcessIsobmffSegment(
+        alpsHandle: Long,
+        segmentBuf: ByteBuffer,
+        offset: Int,
+        length: Int,
+    ): Int
+    private external fun tryProcessIsobmffSegmentArray(
+        alpsHandle: Long,
+        segment: ByteArray,
+        offset: Int,
+        length: Int,
+    ): Int
+    private external fun tryProcessIsobmffSegmentSlices(
+        alpsHandle: Long,
+        segmentBufs: Array<ByteBuffer>,
+        offsets: IntArray,
+        lengths: IntArray,
+    ): Int
+    private external fun tryProcessIsobmffSegmentArraySlices(
+        alpsHandle: Long,
+        segments: Array<ByteArray>,
+        offsets: IntArray,
+        lengths: IntArray,
+    ): Int
+    private external fun processIsobmffSegmentPatch(
+        alpsHandle: Long,
+        segment: ByteArray,
+        offset: Int,
+        length: Int,
+    ): AlpsSegmentPatch
+    private external fun submitIsobmffSegment(
+        alpsHandle: Long,
+        segmentBuf: ByteBuffer,
+        offset: Int,
+        length: Int,
+        request: AlpsNativeProcessingRequest,
     )
     private external fun getPresentations(
         alpsHandle: Long,
     ): List<Presentation>?
+    private external fun getPresentationsListGeneration(
+        alpsHandle: Long,
+    ): Long
+    private external fun getMetrics(
+        alpsHandle: Long,
+    ): LongArray
     private external fun getActivePresentationId(
         alpsHandle: Long,
     ): Int
@@ -108,4 +400,39 @@ internal class DefaultAlpsNative: AlpsNative {
         alpsHandle: Long,
         id: Int,
     )
+    private external fun seedActivePresentationId(
+        alpsHandle: Long,
+        id: Int,
+    )
+    private external fun setSelectionPolicy(
+        alpsHandle: Long,
+        criteria: IntArray?,
+        values: Array<String>?,
+        presentationIds: IntArray?,
+        fallbackPresentationId: Int,
+    )
+    private external fun createSegmentStream(
+        alpsHandle: Long,
+    ): Long
+    private external fun destroySegmentStream(
+        streamHandle: Long,
+    )
+    private external fun resetSegmentStream(
+        streamHandle: Long,
+    )
+    private external fun feedSegmentStream(
+        streamHandle: Long,
+        data: ByteArray,
+        offset: Int,
+        length: Int,
+    ): Int
+    private external fun finishSegmentStream(
+        streamHandle: Long,
+    ): Int
+    private external fun readSegmentStream(
+        streamHandle: Long,
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    ): Int
 }
@@ -0,0 +1,80 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps.logger
+
+import com.dolby.android.alps.alpsnative.AlpsNativeLogger
+
+/**
+ * Native library log levels.
+ *
+ * @property nativeLevel matching Android log priority
+ */
+enum class AlpsNativeLogLevel(internal val nativeLevel: Int) {
+    VERBOSE(2),
+    DEBUG(3),
+    INFO(4),
+    WARN(5),
+    ERROR(6),
+    NONE(8),
+}
+
+/**
+ * Control of native library logging.
+ *
+ * Native messages are formatted into a lock-free ring buffer and written to logcat and
+ * [AlpsLoggerProvider] by a background thread, so logging doesn't block processing. Messages
+ * repeated by a single call site more than 10 times per second are suppressed and counted, except
+ * errors.
+ *
+ * Release builds of the native library don't contain messages below [AlpsNativeLogLevel.WARN].
+ */
+object AlpsNativeLog {
+    /**
+     * Sets minimum level of logged native messages, [AlpsNativeLogLevel.INFO] by default.
+     *
+     * @param level minimum logged level
+     */
+    fun setLevel(level: AlpsNativeLogLevel) {
+        AlpsNativeLogger.setLevel(level.nativeLevel)
+    }
+
+    /**
+     * Writes all pending native messages on the calling thread.
+     */
+    fun flush() {
+        AlpsNativeLogger.flush()
+    }
+
+    /**
+     * Returns number of native messages dropped, because the ring buffer was full.
+     *
+     * @return number of dropped messages
+     */
+    fun getDroppedMessageCount(): Long {
+        return AlpsNativeLogger.getDroppedCount()
+    }
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps.models
+
+/**
+ * ALPS native library error codes, see alps_ret enum and
+ * [com.dolby.android.alps.utils.AlpsException.Native].
+ */
+enum class AlpsNativeError {
+    UNDEFINED,
+    INVALID_ARG,
+    BUFF_TOO_SMALL,
+    PARSE_FAILED,
+    NEXT_SEGMENT,
+    NO_MOVIE_INFO,
+    PRES_ID_NOT_FOUND,
+}
+
+/**
+ * Latency histogram with power of two buckets. Bucket i counts durations in [2^i, 2^(i+1)) ns,
+ * the last bucket counts all longer durations.
+ *
+ * @param totalNs sum of all recorded durations
+ * @param buckets number of durations recorded in each bucket
+ */
+data class AlpsLatencyHistogram(
+    val totalNs: Long,
+    val buckets: List<Long>,
+) {
+    /**
+     * Number of recorded durations.
+     */
+    val count: Long
+        get() = buckets.sum()
+
+    /**
+     * Mean duration in nanoseconds, 0 if nothing was recorded.
+     */
+    val meanNs: Long
+        get() = if (count > 0) totalNs / count else 0
+
+    /**
+     * Estimates percentile as the upper bound of the bucket containing it.
+     *
+     * @param percentile percentile in range 0 - 100
+     * @return duration in nanoseconds, 0 if nothing was recorded
+     */
+    fun percentileNs(percentile: Double): Long {
+        val rank = Math.ceil(count * percentile / 100).toLong().coerceAtLeast(1)
+        var cumulative = 0L
+        buckets.forEachIndexed { index, bucket ->
+            cumulative += bucket
+            if (cumulative >= rank) {
+                return (1L shl (index + 1)) - 1
+            }
+        }
+        return 0
+    }
+}
+
+/**
+ * Snapshot of counters of a single [com.dolby.android.alps.Alps] object.
+ *
+ * @param processedSegmentCount number of segments processed by native library
+ * @param skippedSegmentCount number of segments skipped, because processing would not change them
+ * @param errorCount number of failed processing calls
+ * @param processedBytes bytes of processed segments
+ * @param presentationsChangedCount number of presentations list changes reported by native library
+ * @param presentationsListGeneration presentations list generation, see
+ * [com.dolby.android.alps.Alps.getPresentationsListGeneration]
+ * @param errorCounts number of failed processing calls by error, errors that didn't occur are
+ * omitted
+ * @param processingTime durations of native processing calls
+ * @param callbackLatency time from presentations list change detection until
+ * [com.dolby.android.alps.PresentationsChangedCallback] returned
+ */
+data class AlpsMetrics(
+    val processedSegmentCount: Long,
+    val skippedSegmentCount: Long,
+    val errorCount: Long,
+    val processedBytes: Long,
+    val presentationsChangedCount: Long,
+    val presentationsListGeneration: Long,
+    val errorCounts: Map<AlpsNativeError, Long>,
+    val processingTime: AlpsLatencyHistogram,
+    val callbackLatency: AlpsLatencyHistogram,
+) {
+    internal companion object {
+        private const val COUNTER_COUNT = 6
+        private const val ALPS_RET_COUNT = 8
+        private const val HISTOGRAM_BUCKET_COUNT = 32
+
+        /**
+         * Parses array returned by the native getMetrics call.
+         */
+        fun fromNative(values: LongArray): AlpsMetrics {
+            val errorCounts = AlpsNativeError.values().associateWith {
+                // alps_ret 0 is success, errors start at 1
+                values[COUNTER_COUNT + it.ordinal + 1]
+            }.filterValues { it > 0 }
+
+            val processingTimeOffset = COUNTER_COUNT + ALPS_RET_COUNT
+            val callbackLatencyOffset = processingTimeOffset + 1 + HISTOGRAM_BUCKET_COUNT
+            return AlpsMetrics(
+                processedSegmentCount = values[0],
+                skippedSegmentCount = values[1],
+                errorCount = values[2],
+                processedBytes = values[3],
+                presentationsChangedCount = values[4],
+                presentationsListGeneration = values[5],
+                errorCounts = errorCounts,
+                processingTime = histogramAt(values, processingTimeOffset),
+                callbackLatency = histogramAt(values, callbackLatencyOffset),
+            )
+        }
+
+        private fun histogramAt(values: LongArray, offset: Int) = AlpsLatencyHistogram(
+            totalNs = values[offset],
+            buckets = values.copyOfRange(offset + 1, offset + 1 + HISTOGRAM_BUCKET_COUNT).toList(),
+        )
+    }
+}
\ No newline at end of file
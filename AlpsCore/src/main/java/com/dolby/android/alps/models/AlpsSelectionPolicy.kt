@@ -0,0 +1,84 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+package com.dolby.android.alps.models
+
+/**
+ * Declarative presentation selection policy evaluated by the native library each time the
+ * presentations list changes, see [com.dolby.android.alps.Alps.setSelectionPolicy].
+ *
+ * Preferences are checked in order, the first presentation matching a preference is activated.
+ * If none matches, [fallbackPresentationId] is activated when the list contains it, otherwise
+ * active presentation ID is set to -1 and the decoder chooses presentation based on device settings.
+ *
+ * @param preferences ordered preferences, the first one has the highest priority
+ * @param fallbackPresentationId ID activated when no preference matches, -1 for none
+ */
+data class AlpsSelectionPolicy(
+    val preferences: List<Preference>,
+    val fallbackPresentationId: Int = -1,
+) {
+    /**
+     * Single selection preference.
+     */
+    sealed class Preference(internal val criterion: Int) {
+        /**
+         * Matches presentation with the given language tag, case-insensitive. Primary language
+         * subtag also matches regional tags, "en" matches "en-US".
+         */
+        data class Language(val language: String) : Preference(CRITERION_LANGUAGE)
+
+        /**
+         * Matches presentation with the given label, case-insensitive.
+         */
+        data class Label(val label: String) : Preference(CRITERION_LABEL)
+
+        /**
+         * Matches presentation with the given ID.
+         */
+        data class PresentationId(val id: Int) : Preference(CRITERION_PRESENTATION_ID)
+    }
+
+    internal fun criteria(): IntArray = preferences.map { it.criterion }.toIntArray()
+
+    internal fun values(): Array<String> = preferences.map {
+        when (it) {
+            is Preference.Language -> it.language
+            is Preference.Label -> it.label
+            is Preference.PresentationId -> ""
+        }
+    }.toTypedArray()
+
+    internal fun presentationIds(): IntArray = preferences.map {
+        (it as? Preference.PresentationId)?.id ?: -1
+    }.toIntArray()
+
+    internal companion object {
+        // Values of SelectionCriterion native enum
+        internal const val CRITERION_LANGUAGE = 0
+        internal const val CRITERION_LABEL = 1
+        internal const val CRITERION_PRESENTATION_ID = 2
+    }
+}
\ No newline at end of file
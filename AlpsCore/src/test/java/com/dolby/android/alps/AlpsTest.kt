@@ -30,6 +30,10 @@ import assertk.assertThat
 import assertk.assertions.isEqualTo
 import assertk.assertions.isNotEmpty
 import com.dolby.android.alps.alpsnative.AlpsNative
+import com.dolby.android.alps.alpsnative.AlpsNativeSegmentStream
+import com.dolby.android.alps.models.AlpsMetrics
+import com.dolby.android.alps.models.AlpsNativeError
+import com.dolby.android.alps.models.AlpsSelectionPolicy
 import com.dolby.android.alps.models.Presentation
 import com.dolby.android.alps.utils.AlpsException
 import io.mockk.every
@@ -43,6 +47,7 @@ import org.junit.jupiter.params.provider.ArgumentsSource
 import org.junit.jupiter.params.provider.CsvSource
 import org.junit.jupiter.params.provider.ValueSource
 import java.nio.ByteBuffer
+import java.util.concurrent.CompletableFuture
 
 class AlpsTest {
     private lateinit var alps: Alps
@@ -110,6 +115,162 @@ class AlpsTest {
             }
             assertThat(exception).isEqualTo(nativeException)
         }
+
+        @Test
+        fun `array segment is passed to native processing without copying`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            alps = Alps(mockedAlpsNative)
+            val segment = ByteArray(100)
+
+            alps.processIsobmffSegment(segment)
+            alps.processIsobmffSegment(segment, 10, 50)
+
+            verify(exactly = 1) {
+                mockedAlpsNative.processIsobmffSegment(segment, 0, segment.size)
+                mockedAlpsNative.processIsobmffSegment(segment, 10, 50)
+            }
+        }
+
+        @Test
+        fun `tryProcess returns native processing status`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            every {
+                mockedAlpsNative.tryProcessIsobmffSegment(any<ByteArray>(), any(), any())
+            } returns AlpsProcessingStatus.SKIPPED_NO_ACTIVE_PRESENTATION
+            alps = Alps(mockedAlpsNative)
+            val segment = ByteArray(100)
+
+            val status = alps.tryProcessIsobmffSegment(segment)
+
+            assertThat(status).isEqualTo(AlpsProcessingStatus.SKIPPED_NO_ACTIVE_PRESENTATION)
+            verify(exactly = 1) {
+                mockedAlpsNative.tryProcessIsobmffSegment(segment, 0, segment.size)
+            }
+        }
+
+        @Test
+        fun `segment slices are passed to native processing`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            every {
+                mockedAlpsNative.tryProcessIsobmffSegment(any<List<ByteBuffer>>())
+            } returns AlpsProcessingStatus.PROCESSED
+            alps = Alps(mockedAlpsNative)
+            val slices = listOf(ByteBuffer.allocate(100), ByteBuffer.allocate(50))
+
+            val status = alps.tryProcessIsobmffSegment(slices)
+
+            assertThat(status).isEqualTo(AlpsProcessingStatus.PROCESSED)
+            verify(exactly = 1) {
+                mockedAlpsNative.tryProcessIsobmffSegment(slices)
+            }
+        }
+
+        @Test
+        fun `async processing returns native future`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            val future = CompletableFuture<AlpsProcessingStatus>()
+            every { mockedAlpsNative.processIsobmffSegmentAsync(any()) } returns future
+            alps = Alps(mockedAlpsNative)
+            val segmentBuf = ByteBuffer.allocateDirect(100)
+
+            val returnedFuture = alps.processIsobmffSegmentAsync(segmentBuf)
+            future.complete(AlpsProcessingStatus.PROCESSED)
+
+            assertThat(returnedFuture.get()).isEqualTo(AlpsProcessingStatus.PROCESSED)
+            verify(exactly = 1) {
+                mockedAlpsNative.processIsobmffSegmentAsync(segmentBuf)
+            }
+        }
+
+        @Test
+        fun `segment patch is applied to the copied out part of the segment only`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            val patch = AlpsSegmentPatch(
+                AlpsProcessingStatus.PROCESSED.ordinal,
+                intArrayOf(2, 10),
+                intArrayOf(3, 2),
+                byteArrayOf(1, 2, 3, 4, 5),
+            )
+            every { mockedAlpsNative.processIsobmffSegmentPatch(any(), any(), any()) } returns patch
+            alps = Alps(mockedAlpsNative)
+            val segment = ByteArray(16)
+
+            val returnedPatch = alps.processIsobmffSegmentPatch(segment)
+            val copiedOut = ByteArray(8)
+            returnedPatch.apply(copiedOut, 0, 3, 8)
+            returnedPatch.apply(segment)
+
+            assertThat(returnedPatch.editedBytes).isEqualTo(5)
+            assertThat(copiedOut.toList()).isEqualTo(listOf<Byte>(2, 3, 0, 0, 0, 0, 0, 4))
+            assertThat(segment.toList()).isEqualTo(
+                listOf<Byte>(0, 0, 1, 2, 3, 0, 0, 0, 0, 0, 4, 5, 0, 0, 0, 0)
+            )
+            verify(exactly = 1) {
+                mockedAlpsNative.processIsobmffSegmentPatch(segment, 0, segment.size)
+            }
+        }
+    }
+
+    @Nested
+    inner class Metrics {
+        @Test
+        fun `native metrics layout is parsed`() {
+            val processingBuckets = LongArray(32).also { it[10] = 3; it[12] = 1 }
+            val values = longArrayOf(4, 2, 1, 4096, 1, 1) +
+                longArrayOf(0, 0, 0, 0, 1, 0, 0, 0) +
+                longArrayOf(7000) + processingBuckets +
+                longArrayOf(0) + LongArray(32)
+
+            val metrics = AlpsMetrics.fromNative(values)
+
+            assertThat(metrics.processedSegmentCount).isEqualTo(4L)
+            assertThat(metrics.processedBytes).isEqualTo(4096L)
+            assertThat(metrics.errorCounts).isEqualTo(mapOf(AlpsNativeError.PARSE_FAILED to 1L))
+            assertThat(metrics.processingTime.count).isEqualTo(4L)
+            assertThat(metrics.processingTime.percentileNs(50.0)).isEqualTo(2047L)
+            assertThat(metrics.processingTime.percentileNs(99.0)).isEqualTo(8191L)
+            assertThat(metrics.callbackLatency.count).isEqualTo(0L)
+        }
+    }
+
+    @Nested
+    inner class SegmentStream {
+        @Test
+        fun `createSegmentStream throws exception if not initialized`() {
+            val mockedAlpsNative = getMockedAlpsNative(
+                isInitializedResponse = false
+            )
+            alps = Alps(mockedAlpsNative)
+
+            assertThrows<AlpsException.NotInitialized> {
+                alps.createSegmentStream()
+            }
+        }
+
+        @Test
+        fun `segment stream calls native stream functions`() {
+            val mockedNativeStream = mockk<AlpsNativeSegmentStream>(relaxed = true) {
+                every { feed(any(), any(), any()) } returns 10
+            }
+            val mockedAlpsNative = getMockedAlpsNative()
+            every { mockedAlpsNative.createSegmentStream() } returns mockedNativeStream
+            alps = Alps(mockedAlpsNative)
+            val data = ByteArray(10)
+
+            val stream = alps.createSegmentStream()
+            stream.reset()
+            val readyBytes = stream.feed(data)
+            stream.finish()
+            stream.read(data, 0, data.size)
+
+            assertThat(readyBytes).isEqualTo(10)
+            verify(exactly = 1) {
+                mockedNativeStream.reset()
+                mockedNativeStream.feed(data, 0, data.size)
+                mockedNativeStream.finish()
+                mockedNativeStream.read(data, 0, data.size)
+            }
+        }
     }
 
     @Nested
@@ -141,6 +302,15 @@ class AlpsTest {
             assertThat(returnedPresentations).isEqualTo(expectedPresentations)
         }
 
+        @Test
+        fun `getPresentationsListGeneration returns native generation`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            every { mockedAlpsNative.getPresentationsListGeneration() } returns 3L
+            alps = Alps(mockedAlpsNative)
+
+            assertThat(alps.getPresentationsListGeneration()).isEqualTo(3L)
+        }
+
         @ParameterizedTest(name = "{0} when native method returned {1}")
         @CsvSource("-1, -1", "0, 0", "2, 2", "15, 15")
         fun `getActivePresentationId returns`(
@@ -184,6 +354,44 @@ class AlpsTest {
                 mockedAlpsNative.setActivePresentationId(presentationId)
             }
         }
+
+        @Test
+        fun `seedActivePresentationId calls native function with proper id`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            alps = Alps(mockedAlpsNative)
+
+            alps.seedActivePresentationId(2)
+
+            verify(exactly = 1) {
+                mockedAlpsNative.seedActivePresentationId(2)
+            }
+            verify(exactly = 0) {
+                mockedAlpsNative.setActivePresentationId(any())
+            }
+        }
+
+        @Test
+        fun `setSelectionPolicy passes policy to native and marshals preferences in order`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            alps = Alps(mockedAlpsNative)
+            val policy = AlpsSelectionPolicy(
+                preferences = listOf(
+                    AlpsSelectionPolicy.Preference.Language("de"),
+                    AlpsSelectionPolicy.Preference.Label("Commentary"),
+                    AlpsSelectionPolicy.Preference.PresentationId(3),
+                ),
+                fallbackPresentationId = 1,
+            )
+
+            alps.setSelectionPolicy(policy)
+
+            verify(exactly = 1) {
+                mockedAlpsNative.setSelectionPolicy(policy)
+            }
+            assertThat(policy.criteria().toList()).isEqualTo(listOf(0, 1, 2))
+            assertThat(policy.values().toList()).isEqualTo(listOf("de", "Commentary", ""))
+            assertThat(policy.presentationIds().toList()).isEqualTo(listOf(-1, -1, 3))
+        }
     }
 
     @Nested
@@ -202,6 +410,34 @@ class AlpsTest {
                 mockedAlpsNative.setPresentationsChangedCallback(callback)
             }
         }
+
+        @Test
+        fun `setPresentationsChangedDispatchMode calls native function with proper mode`() {
+            val mockedAlpsNative = getMockedAlpsNative()
+            alps = Alps(mockedAlpsNative)
+
+            alps.setPresentationsChangedDispatchMode(PresentationsChangedDispatchMode.ASYNCHRONOUS)
+
+            verify(exactly = 1) {
+                mockedAlpsNative.setPresentationsChangedDispatchMode(
+                    PresentationsChangedDispatchMode.ASYNCHRONOUS
+                )
+            }
+        }
+
+        @Test
+        fun `onPresentationsChanged with generation calls onPresentationsChanged by default`() {
+            var callCount = 0
+            val callback = object: PresentationsChangedCallback {
+                override fun onPresentationsChanged() {
+                    callCount++
+                }
+            }
+
+            callback.onPresentationsChanged(generation = 1L)
+
+            assertThat(callCount).isEqualTo(1)
+        }
     }
 }
 
@@ -38,12 +38,14 @@ import androidx.media3.exoplayer.dash.DashChunkSource
 import androidx.media3.exoplayer.dash.DefaultDashChunkSource
 import androidx.media3.exoplayer.dash.PlayerEmsgHandler
 import androidx.media3.exoplayer.dash.manifest.DashManifest
+import androidx.media3.exoplayer.dash.manifest.Representation
 import androidx.media3.exoplayer.source.chunk.BundledChunkExtractor
 import androidx.media3.exoplayer.trackselection.ExoTrackSelection
 import androidx.media3.exoplayer.upstream.CmcdConfiguration
 import androidx.media3.exoplayer.upstream.LoaderErrorThrower
 import com.dolby.android.alps.logger.AlpsLoggerProvider
 import com.dolby.android.alps.Alps
+import com.dolby.android.alps.samples.models.PeriodWithPreselections
 
 /**
  * [AlpsDashChunkSourceFactory] is a helper class that allows using ALPS for proper DASH chunks.
@@ -54,17 +56,30 @@ import com.dolby.android.alps.Alps
  * assigned to proper DASH period and uses [AlpsHttpDataSource.Factory] to create [AlpsHttpDataSource]
  * and inject it into [DefaultDashChunkSource] object returned by [createDashChunkSource] method.
  *
+ * Before the data source is created, presentations of the period are seeded with
+ * [AlpsManager.seedPresentations], using init segment URI of the selected representation and
+ * Preselections parsed by [AlpsManifestParser].
+ *
  * For non-ALPS chunks [defaultHttpDataSourceFactory] will be used to create data source that will
  * be injected into [DefaultDashChunkSource].
  *
  * @param alpsManager needed to fetch [Alps] object assigned to specific period
  * @param defaultHttpDataSourceFactory used to create data source for non-ALPS chunks and injected
  * into [AlpsHttpDataSource.Factory] for ALPS chunks
+ * @param chunkedProcessingEnabled if `true`, AC-4 segments are processed chunk by chunk while being
+ * downloaded, see [AlpsHttpDataSource]
+ * @param segmentCache if set, AC-4 segments are retained in it, so that they don't have to be
+ * downloaded again when player buffers are flushed after presentation change
+ * @param patchOutputEnabled if `true`, only the bytes changed by ALPS are written to AC-4
+ * segments, see [AlpsHttpDataSource]
  */
 @UnstableApi
 class AlpsDashChunkSourceFactory(
     private val alpsManager: AlpsManager,
     private val defaultHttpDataSourceFactory: HttpDataSource.Factory,
+    private val chunkedProcessingEnabled: Boolean = false,
+    private val segmentCache: AlpsSegmentCache? = null,
+    private val patchOutputEnabled: Boolean = false,
 ): DashChunkSource.Factory {
     companion object {
         /**
@@ -92,6 +107,8 @@ class AlpsDashChunkSourceFactory(
         cmcdConfiguration: CmcdConfiguration?
     ): DashChunkSource {
         val dataSource = createDataSource(
+            manifest = manifest,
+            adaptationSetIndices = adaptationSetIndices,
             trackSelection = trackSelection,
             periodIndex = periodIndex,
         )
@@ -120,6 +137,8 @@ class AlpsDashChunkSourceFactory(
     }
 
     private fun createDataSource(
+        manifest: DashManifest,
+        adaptationSetIndices: IntArray,
         trackSelection: ExoTrackSelection,
         periodIndex: Int,
     ): DataSource {
@@ -130,9 +149,14 @@ class AlpsDashChunkSourceFactory(
 
             if (mimeType.contains(MediaFormat.MIMETYPE_AUDIO_AC4)) {
                 alpsManager.getAlps(periodIndex)?.let { alps ->
+                    seedPresentations(manifest, adaptationSetIndices, trackSelection, periodIndex)
                     return AlpsHttpDataSource.Factory(
                         alps,
                         defaultHttpDataSourceFactory,
+                        chunkedProcessingEnabled,
+                        segmentCache,
+                        alpsManager.presentationCache,
+                        patchOutputEnabled,
                     ).createDataSource()
                 } ?: AlpsLoggerProvider.e("$TAG-createDataSource AC-4 track detected but failed to" +
                         "get Alps object. AlpsProcessing will not be applied to this track.")
@@ -144,4 +168,27 @@ class AlpsDashChunkSourceFactory(
 
         return defaultHttpDataSourceFactory.createDataSource()
     }
+
+    private fun seedPresentations(
+        manifest: DashManifest,
+        adaptationSetIndices: IntArray,
+        trackSelection: ExoTrackSelection,
+        periodIndex: Int,
+    ) {
+        val period = manifest.getPeriod(periodIndex)
+        val representation = adaptationSetIndices
+            .mapNotNull { period.adaptationSets.getOrNull(it) }
+            .flatMap { it.representations }
+            .firstOrNull { it.format.id == trackSelection.selectedFormat.id }
+        alpsManager.seedPresentations(
+            periodIndex = periodIndex,
+            initSegmentUri = representation?.initSegmentUri(),
+            preselections = (period as? PeriodWithPreselections)?.preselections ?: emptyList(),
+        )
+    }
+
+    private fun Representation.initSegmentUri(): String? {
+        val baseUrl = baseUrls.firstOrNull()?.url ?: return null
+        return initializationUri?.resolveUriString(baseUrl)
+    }
 }
\ No newline at end of file
@@ -50,11 +50,25 @@ import com.dolby.android.alps.Alps
  * @param alps [Alps] object that will be used for ALPS processing of AC-4 sources
  * @param defaultHttpDataSource [HttpDataSource] implementation, can be Default or some custom if
  * needed. Used for data downloading.
+ * @param chunkedProcessingEnabled if `true`, segments are processed and returned chunk by chunk
+ * while being downloaded instead of waiting for the whole segment. Recommended for low latency
+ * (CMAF chunked) streams.
+ * @param segmentCache if set, segments found in it are processed without downloading them, see
+ * [AlpsSegmentCache]
+ * @param presentationCache if set, presentations listed by processed init segments are stored in
+ * it, see [AlpsPresentationCache]
+ * @param patchOutputEnabled if `true`, downloaded segment is not rewritten by processing. Only the
+ * bytes changed by ALPS are written while segment is read, see [Alps.processIsobmffSegmentPatch].
+ * Not used in chunked processing mode.
  */
 @UnstableApi
 class AlpsHttpDataSource(
     alps: Alps,
     private val defaultHttpDataSource: HttpDataSource,
+    chunkedProcessingEnabled: Boolean = false,
+    segmentCache: AlpsSegmentCache? = null,
+    presentationCache: AlpsPresentationCache? = null,
+    patchOutputEnabled: Boolean = false,
 ): BaseDataSource(true), HttpDataSource {
     /**
      * Factory class for [AlpsHttpDataSource].
@@ -64,19 +78,38 @@ class AlpsHttpDataSource(
      * @param alps [Alps] object that will be passed to [AlpsHttpDataSource]
      * @param defaultHttpDataSourceFactory used to create [HttpDataSource] implementation objects
      * that will be used in [AlpsHttpDataSource]
+     * @param chunkedProcessingEnabled passed to [AlpsHttpDataSource]
+     * @param segmentCache passed to [AlpsHttpDataSource], shared by all created data sources
+     * @param presentationCache passed to [AlpsHttpDataSource], shared by all created data sources
+     * @param patchOutputEnabled passed to [AlpsHttpDataSource]
      */
     class Factory(
         private val alps: Alps,
         private val defaultHttpDataSourceFactory: HttpDataSource.Factory,
+        private val chunkedProcessingEnabled: Boolean = false,
+        private val segmentCache: AlpsSegmentCache? = null,
+        private val presentationCache: AlpsPresentationCache? = null,
+        private val patchOutputEnabled: Boolean = false,
     ): DataSource.Factory {
         override fun createDataSource(): DataSource {
             return AlpsHttpDataSource(
                 alps,
                 defaultHttpDataSourceFactory.createDataSource(),
+                chunkedProcessingEnabled,
+                segmentCache,
+                presentationCache,
+                patchOutputEnabled,
             )
         }
     }
-    private val alpsProcessing = AlpsProcessing(alps, defaultHttpDataSource)
+    private val alpsProcessing = AlpsProcessing(
+        alps,
+        defaultHttpDataSource,
+        chunkedProcessingEnabled,
+        segmentCache,
+        presentationCache,
+        patchOutputEnabled,
+    )
 
     override fun open(dataSpec: DataSpec): Long {
         return alpsProcessing.open(dataSpec)
@@ -87,18 +120,23 @@ class AlpsHttpDataSource(
         return alpsProcessing.read(buffer, offset, length)
     }
 
-    // Below methods don't need custom implementation
+    override fun getUri(): Uri? = alpsProcessing.uri
 
-    override fun getUri(): Uri? = defaultHttpDataSource.uri
+    override fun getResponseHeaders(): MutableMap<String, MutableList<String>> {
+        // Segments served from cache are not requested, so there are no response headers
+        return if (alpsProcessing.isServedFromCache) {
+            mutableMapOf()
+        } else {
+            defaultHttpDataSource.responseHeaders
+        }
+    }
+
+    // Below methods don't need custom implementation
 
     override fun close() {
         defaultHttpDataSource.close()
     }
 
-    override fun getResponseHeaders(): MutableMap<String, MutableList<String>> {
-        return defaultHttpDataSource.responseHeaders
-    }
-
     override fun setRequestProperty(name: String, value: String) {
         defaultHttpDataSource.setRequestProperty(name, value)
     }
@@ -30,11 +30,15 @@ import androidx.media3.common.Player
 import androidx.media3.common.util.UnstableApi
 import androidx.media3.exoplayer.analytics.AnalyticsListener
 import com.dolby.android.alps.Alps
+import com.dolby.android.alps.AlpsContextPool
 import com.dolby.android.alps.PresentationsChangedCallback
 import com.dolby.android.alps.logger.AlpsLoggerProvider
+import com.dolby.android.alps.models.AlpsSelectionPolicy
 import com.dolby.android.alps.models.Presentation
 import com.dolby.android.alps.samples.models.AlpsPresentationWrapper
+import com.dolby.android.alps.samples.models.Preselection
 import com.dolby.android.alps.utils.AlpsException
+import java.util.concurrent.ConcurrentHashMap
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.update
@@ -61,13 +65,26 @@ import kotlinx.coroutines.flow.update
  *  using [setCurrentPeriodIndex] method.
  *
  *
+ *  Presentations of a period can be known before its init segment is processed, see
+ *  [seedPresentations]. Preferred presentation set with [setActivePresentationId] before the
+ *  playback starts is then applied to the first processed media segment.
+ *
+ *
  *  @property presentationSelectionPersistanceEnabled If `true`, the [AlpsManager] will try to
  *  keep the same presentation selected after a period change. On by default
+ *  @property presentationCache if set, presentations cached in it are used by [seedPresentations].
+ *  It should also be passed to [AlpsHttpDataSource], which stores presentations of processed init
+ *  segments in it
+ *  @property selectionPolicy if set, it is registered in every [Alps] object (see
+ *  [Alps.setSelectionPolicy]), so presentations of new periods are selected natively until the user
+ *  selects one with [setActivePresentationId]
  *
  */
 @UnstableApi
 class AlpsManager(
-    val presentationSelectionPersistanceEnabled: Boolean = true
+    val presentationSelectionPersistanceEnabled: Boolean = true,
+    val presentationCache: AlpsPresentationCache? = null,
+    val selectionPolicy: AlpsSelectionPolicy? = null,
 ): AnalyticsListener {
     companion object {
         /**
@@ -104,6 +121,12 @@ class AlpsManager(
      */
     private val alpsPeriodMap = mutableMapOf<Int, Alps>()
 
+    /**
+     * Map of presentations seeded for specific period, used until its init segment is processed.
+     * Accessed by the player, loader and presentations changed callback threads.
+     */
+    private val seededPresentationsPeriodMap = ConcurrentHashMap<Int, List<Presentation>>()
+
     /**
      * Helper for getting Alps object assigned for currently playing period
      */
@@ -112,14 +135,20 @@ class AlpsManager(
 
     /**
      * Provides [Alps] object assigned to given [periodIndex] or creates new [Alps] object if missing.
+     * New objects use contexts from [AlpsContextPool], so period transitions don't initialize
+     * native context when the pool was prewarmed.
      */
     fun getAlps(periodIndex: Int): Alps? {
         return alpsPeriodMap.getOrElse(periodIndex) {
             try {
-                Alps().apply {
+                AlpsContextPool.createAlps().apply {
+                    selectionPolicy?.let { setSelectionPolicy(it) }
                     setPresentationsChangedCallback(object : PresentationsChangedCallback {
                         override fun onPresentationsChanged() {
-                            if (presentationSelectionPersistanceEnabled){
+                            seededPresentationsPeriodMap.remove(periodIndex)
+                            // Without user's choice the policy already selected the presentation
+                            if (presentationSelectionPersistanceEnabled &&
+                                (userPreferredPresentationId != null || selectionPolicy == null)) {
                                 setActivePresentationId(userPreferredPresentationId ?: -1)
                             }
                             updatePresentationsState()
@@ -135,9 +164,53 @@ class AlpsManager(
         }
     }
 
+    /**
+     * Seeds presentations of the period whose init segment was not processed yet. Presentations
+     * are taken from [presentationCache] entry of [initSegmentUri] or, if not cached, from DASH
+     * [preselections] (Preselection tag is the presentation ID). Seeded presentations are published
+     * in [presentations] until the init segment is processed and preferred presentation is seeded
+     * as active (see [Alps.seedActivePresentationId]), so that the first media segments are
+     * processed for it.
+     *
+     * Does nothing if presentations of the period are already known.
+     *
+     * @param periodIndex index of the period
+     * @param initSegmentUri URI of the init segment of the period's AC-4 representation
+     * @param preselections DASH Preselections of the period, see [AlpsManifestParser]
+     */
+    fun seedPresentations(
+        periodIndex: Int,
+        initSegmentUri: String?,
+        preselections: List<Preselection> = emptyList(),
+    ) {
+        val alps = getAlps(periodIndex) ?: return
+        try {
+            if (alps.getPresentationsListGeneration() != 0L) {
+                return
+            }
+            val seededPresentations = initSegmentUri?.let { presentationCache?.get(it) }
+                ?.presentations
+                ?: preselections.mapNotNull { it.toPresentation() }
+            if (seededPresentations.isEmpty()) {
+                return
+            }
+            seededPresentationsPeriodMap[periodIndex] = seededPresentations
+
+            val preferredId = userPreferredPresentationId
+            if (presentationSelectionPersistanceEnabled && preferredId != null &&
+                seededPresentations.any { it.id == preferredId }) {
+                alps.seedActivePresentationId(preferredId)
+            }
+        } catch (e: AlpsException) {
+            AlpsLoggerProvider.e("AlpsManager failed to seed presentations. Error: ${e.message}")
+        }
+        updatePresentationsState()
+    }
+
     /**
      * Sets active presentation ID in Alps assigned to currently playing period and other periods if
-     * they include a presentation with the same id
+     * they include a presentation with the same id. For periods whose presentations are not known
+     * yet the ID is seeded and applied once they include it.
      *
      * @param presentationId  ID of desired active presentation, set to [TV_DEFAULT_PRESENTATION] ID
      * to skip processing and use device default
@@ -149,11 +222,11 @@ class AlpsManager(
             userPreferredPresentationId = presentationId
             alpsPeriodMap.values
                 .forEach { alps ->
-                    alps.setActivePresentationId(presentationId)
+                    alps.selectPresentation(presentationId)
                 }
         }
         else {
-            currentAlps?.setActivePresentationId(presentationId)
+            currentAlps?.selectPresentation(presentationId)
         }
         updatePresentationsState()
     }
@@ -178,6 +251,7 @@ class AlpsManager(
         alpsPeriodMap.forEach {
             it.value.release()
         }
+        seededPresentationsPeriodMap.clear()
         userPreferredPresentationId = null
     }
 
@@ -194,7 +268,7 @@ class AlpsManager(
     private fun updatePresentationsState() {
         _presentations.update {
             try {
-                currentAlps?.getPresentations()?.let { presentations ->
+                currentAlps?.getPresentations()?.takeIf { it.isNotEmpty() }?.let { presentations ->
                     val activePresentationId = currentAlps?.getActivePresentationId()
                         ?: TV_DEFAULT_PRESENTATION.id
 
@@ -204,6 +278,11 @@ class AlpsManager(
                             it.id == activePresentationId
                         )
                     }
+                } ?: seededPresentationsPeriodMap[currentPlayingPeriodIndex]?.map {
+                    AlpsPresentationWrapper.from(
+                        it,
+                        it.id == userPreferredPresentationId
+                    )
                 } ?: emptyList()
             } catch (e: AlpsException) {
                 AlpsLoggerProvider.e("AlpsManager failed to update presentation list state. " +
@@ -220,8 +299,25 @@ class AlpsManager(
                 if (it.key < currentPlayingPeriodIndex) {
                     it.value.release()
                     mapIterator.remove()
+                    seededPresentationsPeriodMap.remove(it.key)
                 }
             }
         }
     }
+
+    private fun Alps.selectPresentation(presentationId: Int) {
+        if (getPresentationsListGeneration() == 0L) {
+            seedActivePresentationId(presentationId)
+        } else {
+            setActivePresentationId(presentationId)
+        }
+    }
+
+    private fun Preselection.toPresentation(): Presentation? = tag?.let {
+        Presentation(
+            id = it,
+            label = labels.firstOrNull()?.value ?: "",
+            extendedLanguage = lang ?: "unknown",
+        )
+    }
 }
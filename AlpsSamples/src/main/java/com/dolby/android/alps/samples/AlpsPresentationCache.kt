@@ -0,0 +1,242 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+package com.dolby.android.alps.samples
+
+import androidx.media3.common.util.UnstableApi
+import com.dolby.android.alps.Alps
+import com.dolby.android.alps.logger.AlpsLoggerProvider
+import com.dolby.android.alps.models.Presentation
+import java.io.BufferedInputStream
+import java.io.BufferedOutputStream
+import java.io.DataInputStream
+import java.io.DataOutputStream
+import java.io.File
+import java.io.FileInputStream
+import java.io.FileOutputStream
+import java.io.IOException
+
+/**
+ * [AlpsPresentationCache] persists presentations listed by init segments, so that a new [Alps]
+ * object knows them before its init segment is downloaded and processed.
+ *
+ * [AlpsProcessing] stores an entry every time it processes an init segment. When the same content
+ * is played again, [AlpsManager.seedPresentations] reads the entry, publishes cached presentations
+ * and seeds preferred presentation as active (see [Alps.seedActivePresentationId]), so that the
+ * first media segments are already processed for it.
+ *
+ * Entries are keyed by init segment URI without query, because query of signed URLs changes
+ * between playbacks, and hold a hash of the init segment content. Entry with a different hash is
+ * replaced when the init segment is processed, or removed if the processed init segment lists no
+ * presentations. At most [maxEntries] least recently stored entries
+ * are kept.
+ *
+ * Entries are kept in a compact binary [file], loaded on first use and rewritten (through a
+ * temporary file, so it is never left partially written) when an entry is added or changed. Cache is
+ * thread safe and can be shared by data sources of all periods.
+ *
+ * @param file file keeping cache entries, created if missing
+ * @param maxEntries maximum number of cached init segments
+ */
+@UnstableApi
+class AlpsPresentationCache(
+    private val file: File,
+    val maxEntries: Int = DEFAULT_MAX_ENTRIES,
+) {
+    companion object {
+        const val DEFAULT_MAX_ENTRIES = 64
+
+        private const val FILE_MAGIC = 0x414c5053 // "ALPS"
+        private const val FILE_VERSION = 1
+
+        // 64-bit FNV-1a
+        private const val HASH_OFFSET_BASIS = -0x340d631b7bdddcdbL
+        private const val HASH_PRIME = 0x100000001b3L
+
+        /**
+         * Initial value of [contentHash]
+         */
+        const val EMPTY_CONTENT_HASH = HASH_OFFSET_BASIS
+
+        /**
+         * Computes hash of init segment content. Hash of content received in parts can be computed
+         * by passing the previous result as [hash].
+         *
+         * @param data array with init segment bytes
+         * @param offset offset of the first byte to hash
+         * @param length number of bytes to hash
+         * @param hash hash of the preceding bytes
+         * @return hash of the preceding bytes and given bytes
+         */
+        fun contentHash(
+            data: ByteArray,
+            offset: Int = 0,
+            length: Int = data.size,
+            hash: Long = EMPTY_CONTENT_HASH,
+        ): Long {
+            var result = hash
+            for (index in offset until offset + length) {
+                result = (result xor (data[index].toLong() and 0xff)) * HASH_PRIME
+            }
+            return result
+        }
+
+        private fun keyOf(initSegmentUri: String) =
+            initSegmentUri.substringBefore('#').substringBefore('?')
+    }
+
+    /**
+     * Cached metadata of an init segment.
+     *
+     * @property contentHash hash of the init segment content, see [contentHash]
+     * @property presentations presentations listed by the init segment
+     */
+    data class Entry(
+        val contentHash: Long,
+        val presentations: List<Presentation>,
+    )
+
+    private val entries = LinkedHashMap<String, Entry>(16, 0.75f, true)
+    private var isLoaded = false
+
+    /**
+     * Returns cached metadata of the init segment.
+     *
+     * @param initSegmentUri init segment URI
+     * @return cached entry, null if init segment is not cached
+     */
+    fun get(initSegmentUri: String): Entry? = synchronized(this) {
+        load()
+        entries[keyOf(initSegmentUri)]
+    }
+
+    /**
+     * Stores metadata of processed init segment. Entry of init segment with a different
+     * [contentHash] is replaced, or removed if [presentations] is empty. The cache file is
+     * rewritten only if the entry was added, changed or removed.
+     *
+     * @param initSegmentUri init segment URI
+     * @param contentHash hash of the init segment content, see [contentHash]
+     * @param presentations presentations listed by the init segment
+     */
+    fun put(initSegmentUri: String, contentHash: Long, presentations: List<Presentation>) {
+        val entry = Entry(contentHash, presentations.toList())
+        synchronized(this) {
+            load()
+            val key = keyOf(initSegmentUri)
+            val cachedEntry = entries[key]
+            if (cachedEntry == entry) {
+                return
+            }
+            val isStale = cachedEntry != null && cachedEntry.contentHash != contentHash
+            if (isStale) {
+                AlpsLoggerProvider.i("Init segment $key changed, cached presentations are stale")
+            }
+            if (presentations.isEmpty()) {
+                if (isStale) {
+                    entries.remove(key)
+                    save()
+                }
+                return
+            }
+            entries[key] = entry
+            val iterator = entries.values.iterator()
+            while (entries.size > maxEntries && iterator.hasNext()) {
+                iterator.next()
+                iterator.remove()
+            }
+            save()
+        }
+    }
+
+    /**
+     * Removes all cached entries and the cache file.
+     */
+    fun clear() = synchronized(this) {
+        entries.clear()
+        isLoaded = true
+        file.delete()
+    }
+
+    private fun load() {
+        if (isLoaded) {
+            return
+        }
+        isLoaded = true
+        if (file.exists().not()) {
+            return
+        }
+        try {
+            DataInputStream(BufferedInputStream(FileInputStream(file))).use { input ->
+                if (input.readInt() != FILE_MAGIC || input.readInt() != FILE_VERSION) {
+                    AlpsLoggerProvider.w("Presentation cache ${file.path} has unknown format")
+                    return
+                }
+                repeat(input.readInt()) {
+                    val key = input.readUTF()
+                    val contentHash = input.readLong()
+                    val presentations = List(input.readInt()) {
+                        Presentation(
+                            id = input.readInt(),
+                            label = input.readUTF(),
+                            extendedLanguage = input.readUTF(),
+                        )
+                    }
+                    entries[key] = Entry(contentHash, presentations)
+                }
+            }
+        } catch (e: IOException) {
+            AlpsLoggerProvider.w("Presentation cache ${file.path} could not be read: ${e.message}")
+            entries.clear()
+        }
+    }
+
+    private fun save() {
+        val tempFile = File(file.path + ".tmp")
+        try {
+            DataOutputStream(BufferedOutputStream(FileOutputStream(tempFile))).use { output ->
+                output.writeInt(FILE_MAGIC)
+                output.writeInt(FILE_VERSION)
+                output.writeInt(entries.size)
+                entries.forEach { (key, entry) ->
+                    output.writeUTF(key)
+                    output.writeLong(entry.contentHash)
+                    output.writeInt(entry.presentations.size)
+                    entry.presentations.forEach { presentation ->
+                        output.writeInt(presentation.id)
+                        output.writeUTF(presentation.label)
+                        output.writeUTF(presentation.extendedLanguage)
+                    }
+                }
+            }
+            if (tempFile.renameTo(file).not()) {
+                throw IOException("renaming ${tempFile.path} failed")
+            }
+        } catch (e: IOException) {
+            AlpsLoggerProvider.w("Presentation cache ${file.path} could not be written: ${e.message}")
+            tempFile.delete()
+        }
+    }
+}
\ No newline at end of file
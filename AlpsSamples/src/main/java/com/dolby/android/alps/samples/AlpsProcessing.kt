@@ -26,11 +26,15 @@
 
 package com.dolby.android.alps.samples
 
+import android.net.Uri
 import androidx.media3.common.C
+import androidx.media3.common.util.TraceUtil
 import androidx.media3.common.util.UnstableApi
 import androidx.media3.datasource.DataSpec
 import androidx.media3.datasource.HttpDataSource
 import com.dolby.android.alps.Alps
+import com.dolby.android.alps.AlpsSegmentPatch
+import com.dolby.android.alps.AlpsSegmentStream
 import com.dolby.android.alps.logger.AlpsLoggerProvider
 import java.io.ByteArrayInputStream
 import java.nio.ByteBuffer
@@ -40,18 +44,80 @@ import kotlin.math.min
  * [AlpsProcessing] object opens http data source, downloads the whole segment and processes it
  * using ALPS library. After that it returns requested data portions of already processed segment.
  *
+ * In chunked processing mode segment is not downloaded as a whole. Downloaded bytes are fed to
+ * [AlpsSegmentStream] and every processed CMAF chunk is returned as soon as it is available, so
+ * time to first byte depends on chunk size instead of segment size.
+ *
+ * In patch output mode segment buffer is not modified. Processing returns [AlpsSegmentPatch] with
+ * the bytes changed by ALPS and only these bytes are written, while segment is copied out by
+ * [read]. Chunked processing mode and segments loaded into slices are processed in place.
+ *
+ * Segments larger than 32 MiB or of unknown length are downloaded into a list of 1 MiB slices
+ * instead of a single array and processed with [Alps.tryProcessIsobmffSegment] taking a list of
+ * buffers, so their size is not limited to [Int.MAX_VALUE].
+ *
+ * Segments and chunks that ALPS failed to process are provided as is, failed processing leaves
+ * them unmodified.
+ *
  * Usage of this class is similar to [HttpDataSource] implementations usage. For each segment [open]
  * method should be called first and then [read] method can be called until end of input will be
  * returned.
  *
  * @param alps ALPS core library object used for segments processing
  * @param defaultHttpDataSource [HttpDataSource] implementation, used for segments downloading
+ * @param chunkedProcessingEnabled if `true`, segments are processed chunk by chunk while being
+ * downloaded
+ * @param segmentCache if set, unmodified bytes of downloaded segments are stored in it and
+ * segments found in it are processed without downloading them
+ * @param patchOutputEnabled if `true`, segments are not processed in place, edits returned by
+ * processing are applied while reading
+ * @param presentationCache if set, presentations listed by processed init segments are stored in
+ * it
  */
 @UnstableApi
 internal class AlpsProcessing(
     private val alps: Alps,
     private val defaultHttpDataSource: HttpDataSource,
+    private val chunkedProcessingEnabled: Boolean = false,
+    private val segmentCache: AlpsSegmentCache? = null,
+    private val presentationCache: AlpsPresentationCache? = null,
+    private val patchOutputEnabled: Boolean = false,
 ) {
+    companion object {
+        private const val CHUNKED_READ_BUFFER_SIZE = 32 * 1024
+
+        /**
+         * Segment buffer is reused for following segments unless it is this many times bigger than
+         * the segment
+         */
+        private const val MAX_SEGMENT_BUFFER_OVERSIZE_FACTOR = 4
+
+        /**
+         * Larger segments, and segments of unknown length, are downloaded into slices
+         */
+        private const val MAX_CONTIGUOUS_SEGMENT_SIZE = 32L * 1024 * 1024
+        private const val SEGMENT_SLICE_SIZE = 1024 * 1024
+
+        /**
+         * Slices kept for following segments, memory of the others is dropped
+         */
+        private const val MAX_RETAINED_SLICES =
+            (MAX_CONTIGUOUS_SEGMENT_SIZE / SEGMENT_SLICE_SIZE).toInt()
+
+        private const val BOX_HEADER_SIZE = 8
+        private val INIT_SEGMENT_BOX_TYPES = listOf("ftyp", "moov").map { it.toByteArray() }
+
+        /**
+         * Init segments start with 'ftyp' or 'moov' box, media segments with 'styp', 'sidx' or
+         * 'moof' box.
+         */
+        private fun isInitSegmentStart(data: ByteArray, length: Int): Boolean {
+            return length >= BOX_HEADER_SIZE && INIT_SEGMENT_BOX_TYPES.any { type ->
+                type.indices.all { data[4 + it] == type[it] }
+            }
+        }
+    }
+
     private var segmentSize = 0L
     private var loadedBytes = 0L
     private var isSegmentLoaded = false
@@ -59,6 +125,37 @@ internal class AlpsProcessing(
 
     private var inputStream: ByteArrayInputStream? = null
     private var inputStreamRead = 0L
+    private var segmentPatch: AlpsSegmentPatch? = null
+
+    private var isSegmentSliced = false
+    private val segmentSlices = mutableListOf<ByteArray>()
+    private var sliceReadIndex = 0
+    private var sliceReadOffset = 0
+
+    private var segmentStream: AlpsSegmentStream? = null
+    private var chunkedReadBuffer: ByteArray? = null
+
+    private var dataSpec: DataSpec? = null
+    private var cachedSegment: ByteArray? = null
+    private var cachedSegmentRead = 0
+    // Unmodified bytes of the segment processed chunk by chunk, stored in segmentCache when loaded
+    private var rawSegmentBuffer: ByteArray? = null
+    private var rawSegmentLength = 0
+    private var isRawSegmentRetained = false
+    // Hash of the init segment content, null if the current segment is not an init segment
+    private var initSegmentHash: Long? = null
+
+    /**
+     * `true` if the current segment was found in segmentCache and is not downloaded.
+     */
+    val isServedFromCache: Boolean
+        get() = cachedSegment != null
+
+    /**
+     * URI of the current segment.
+     */
+    val uri: Uri?
+        get() = if (isServedFromCache) dataSpec?.uri else defaultHttpDataSource.uri
 
     /**
      * Opens the source to read the specified data. Should called first for each segment.
@@ -66,9 +163,25 @@ internal class AlpsProcessing(
      * @param dataSpec Defines the data to be read
      */
     fun open(dataSpec: DataSpec): Long {
-        return defaultHttpDataSource.open(dataSpec).also {
+        this.dataSpec = dataSpec
+        cachedSegment = segmentCache?.get(dataSpec)
+        cachedSegmentRead = 0
+        rawSegmentLength = 0
+        isRawSegmentRetained = segmentCache != null && cachedSegment == null
+        initSegmentHash = null
+
+        val openedLength = cachedSegment?.let {
+            AlpsLoggerProvider.i("Segment of size: ${it.size} found in cache")
+            it.size.toLong()
+        } ?: defaultHttpDataSource.open(dataSpec)
+
+        return openedLength.also {
             segmentSize = it
-            prepareSegmentBuffer()
+            if (chunkedProcessingEnabled) {
+                prepareSegmentStream()
+            } else {
+                prepareSegmentBuffer()
+            }
         }
     }
 
@@ -76,36 +189,154 @@ internal class AlpsProcessing(
      * Works exactly as DataReader read method, but during first call for a segment, it downloads
      * the whole segment and processes it using ALPS library.
      *
+     * In chunked processing mode it downloads only as much data as needed to return next processed
+     * chunk bytes.
+     *
      * @param buffer A target array into which data should be written
      * @param offset The offset into the target array at which to write
      * @param length The maximum number of bytes to read from the input
      * @return The number of bytes read, or [C.RESULT_END_OF_INPUT] if the input has ended
      */
     fun read(buffer: ByteArray, offset: Int, length: Int): Int {
+        if (chunkedProcessingEnabled) {
+            return readChunked(buffer, offset, length)
+        }
         if (isSegmentLoaded.not()) {
-            readSegment()
-            processSegment()
+            trace("AlpsProcessing.readSegment") { readSegment() }
+            trace("AlpsProcessing.processSegment") { processSegment() }
+        }
+        return trace("AlpsProcessing.readInternal") { readInternal(buffer, offset, length) }
+    }
+
+    /**
+     * Marks [block] as a system trace section, so that download and copy time can be compared with
+     * native processing sections (see [com.dolby.android.alps.AlpsTrace]).
+     */
+    private inline fun <T> trace(sectionName: String, block: () -> T): T {
+        TraceUtil.beginSection(sectionName)
+        try {
+            return block()
+        } finally {
+            TraceUtil.endSection()
+        }
+    }
+
+    private fun prepareSegmentStream() {
+        isSegmentLoaded = false
+        loadedBytes = 0
+        val stream = segmentStream ?: alps.createSegmentStream().also {
+            segmentStream = it
+        }
+        stream.reset()
+    }
+
+    private fun readChunked(buffer: ByteArray, offset: Int, length: Int): Int {
+        if (length == 0) {
+            return 0
+        }
+        val stream = segmentStream ?: return C.RESULT_END_OF_INPUT
+
+        while (true) {
+            val read = stream.read(buffer, offset, length)
+            if (read > 0) {
+                return read
+            }
+            if (isSegmentLoaded) {
+                return C.RESULT_END_OF_INPUT
+            }
+            feedNextBytes(stream)
+        }
+    }
+
+    private fun feedNextBytes(stream: AlpsSegmentStream) {
+        val readBuffer = chunkedReadBuffer ?: ByteArray(CHUNKED_READ_BUFFER_SIZE).also {
+            chunkedReadBuffer = it
+        }
+        val maxReadLength = if (segmentSize != C.LENGTH_UNSET.toLong()) {
+            min(readBuffer.size.toLong(), segmentSize - loadedBytes).toInt()
+        } else {
+            readBuffer.size
+        }
+
+        val read = if (maxReadLength > 0) {
+            readSource(readBuffer, 0, maxReadLength)
+        } else {
+            C.RESULT_END_OF_INPUT
+        }
+        if (read == C.RESULT_END_OF_INPUT) {
+            finishSegmentStream(stream)
+            return
+        }
+        if (presentationCache != null && loadedBytes == 0L && isInitSegmentStart(readBuffer, read)) {
+            initSegmentHash = AlpsPresentationCache.EMPTY_CONTENT_HASH
+        }
+        initSegmentHash = initSegmentHash?.let {
+            AlpsPresentationCache.contentHash(readBuffer, 0, read, it)
+        }
+        loadedBytes += read
+        retainRawBytes(readBuffer, read)
+
+        try {
+            stream.feed(readBuffer, 0, read)
+        } catch (e: Exception) {
+            AlpsLoggerProvider.e(e.message ?: "Exception without message")
+            AlpsLoggerProvider.w(
+                "Exception thrown during ALPS chunk processing. Chunk will be provided as is."
+            )
+        }
+        if (segmentSize != C.LENGTH_UNSET.toLong() && loadedBytes >= segmentSize) {
+            finishSegmentStream(stream)
+        }
+    }
+
+    private fun finishSegmentStream(stream: AlpsSegmentStream) {
+        isSegmentLoaded = true
+        rawSegmentBuffer?.let { rawSegment ->
+            if (isRawSegmentRetained && rawSegmentLength > 0) {
+                dataSpec?.let { segmentCache?.put(it, rawSegment, rawSegmentLength) }
+            }
+        }
+        try {
+            stream.finish()
+            AlpsLoggerProvider.i("Segment of size: $loadedBytes processed chunk by chunk")
+            storePresentations()
+        } catch (e: Exception) {
+            AlpsLoggerProvider.e(e.message ?: "Exception without message")
+            AlpsLoggerProvider.w(
+                "Exception thrown during ALPS segment processing. Remaining bytes will be provided as is."
+            )
         }
-        return readInternal(buffer, offset, length)
     }
 
     private fun prepareSegmentBuffer() {
-        if (segmentSize in 0 .. Int.MAX_VALUE) {
-            segmentBuffer = ByteArray(segmentSize.toInt())
-            isSegmentLoaded = false
-            loadedBytes = 0
-            inputStreamRead = 0
+        isSegmentLoaded = false
+        loadedBytes = 0
+        inputStreamRead = 0
+        segmentPatch = null
+        isSegmentSliced = segmentSize !in 0 .. MAX_CONTIGUOUS_SEGMENT_SIZE
+        if (isSegmentSliced) {
+            AlpsLoggerProvider.i("Segment of size: $segmentSize will be loaded into slices")
+            while (segmentSlices.size > MAX_RETAINED_SLICES) {
+                segmentSlices.removeAt(segmentSlices.lastIndex)
+            }
+            sliceReadIndex = 0
+            sliceReadOffset = 0
         } else {
-            //TODO handle segment with size larger then > Int.MAX_VALUE
-            AlpsLoggerProvider.e("Segment with size > Int.MAX_VALUE detected.")
+            segmentBuffer = segmentBuffer?.takeIf {
+                it.size >= segmentSize && it.size <= segmentSize * MAX_SEGMENT_BUFFER_OVERSIZE_FACTOR
+            } ?: ByteArray(segmentSize.toInt())
         }
     }
 
     private fun readSegment() {
+        if (isSegmentSliced) {
+            readSegmentSlices()
+            return
+        }
         segmentBuffer?.let { segmentBuffer ->
             AlpsLoggerProvider.i("Loading segment of size: $segmentSize")
             while (loadedBytes < segmentSize) {
-                loadedBytes += defaultHttpDataSource.read(
+                loadedBytes += readSource(
                     segmentBuffer,
                     loadedBytes.toInt(),
                     (segmentSize - loadedBytes).toInt()
@@ -114,34 +345,144 @@ internal class AlpsProcessing(
 
             AlpsLoggerProvider.i("Segment loaded")
             isSegmentLoaded = true
+            if (presentationCache != null && isInitSegmentStart(segmentBuffer, loadedBytes.toInt())) {
+                initSegmentHash =
+                    AlpsPresentationCache.contentHash(segmentBuffer, 0, loadedBytes.toInt())
+            }
+            if (isServedFromCache.not()) {
+                dataSpec?.let { segmentCache?.put(it, segmentBuffer, segmentSize.toInt()) }
+            }
+        }
+    }
+
+    private fun readSegmentSlices() {
+        AlpsLoggerProvider.i("Loading segment into slices")
+        var sliceIndex = 0
+        var sliceOffset = 0
+        while (segmentSize == C.LENGTH_UNSET.toLong() || loadedBytes < segmentSize) {
+            if (sliceIndex == segmentSlices.size) {
+                segmentSlices.add(ByteArray(SEGMENT_SLICE_SIZE))
+            }
+            val slice = segmentSlices[sliceIndex]
+            val read = readSource(slice, sliceOffset, SEGMENT_SLICE_SIZE - sliceOffset)
+            if (read == C.RESULT_END_OF_INPUT) {
+                break
+            }
+            loadedBytes += read
+            sliceOffset += read
+            if (sliceOffset == SEGMENT_SLICE_SIZE) {
+                sliceIndex++
+                sliceOffset = 0
+            }
+        }
+
+        AlpsLoggerProvider.i("Segment of size: $loadedBytes loaded into slices")
+        isSegmentLoaded = true
+    }
+
+    /**
+     * Loaded part of every slice, as buffers for native processing.
+     */
+    private fun loadedSlices(): List<ByteBuffer> {
+        val sliceCount = ((loadedBytes + SEGMENT_SLICE_SIZE - 1) / SEGMENT_SLICE_SIZE).toInt()
+        return List(sliceCount) { index ->
+            val sliceStart = index * SEGMENT_SLICE_SIZE.toLong()
+            val length = min(SEGMENT_SLICE_SIZE.toLong(), loadedBytes - sliceStart).toInt()
+            ByteBuffer.wrap(segmentSlices[index], 0, length)
+        }
+    }
+
+    /**
+     * Reads the current segment from segmentCache if it was found there, downloads it otherwise.
+     */
+    private fun readSource(buffer: ByteArray, offset: Int, length: Int): Int {
+        val segment = cachedSegment ?: return defaultHttpDataSource.read(buffer, offset, length)
+        val read = min(length, segment.size - cachedSegmentRead)
+        if (read <= 0) {
+            return C.RESULT_END_OF_INPUT
+        }
+        System.arraycopy(segment, cachedSegmentRead, buffer, offset, read)
+        cachedSegmentRead += read
+        return read
+    }
+
+    private fun retainRawBytes(data: ByteArray, length: Int) {
+        val cache = segmentCache ?: return
+        if (isRawSegmentRetained.not()) {
+            return
         }
+        val required = rawSegmentLength.toLong() + length
+        if (required > cache.maxBytes) {
+            // Segment will not fit in the cache anyway
+            isRawSegmentRetained = false
+            return
+        }
+        val rawSegment = rawSegmentBuffer?.takeIf { it.size >= required }
+            ?: ByteArray(
+                minOf(maxOf(required, (rawSegmentBuffer?.size ?: 0) * 2L), cache.maxBytes).toInt()
+            ).also { newBuffer ->
+                rawSegmentBuffer?.copyInto(newBuffer, 0, 0, rawSegmentLength)
+                rawSegmentBuffer = newBuffer
+            }
+        data.copyInto(rawSegment, rawSegmentLength, 0, length)
+        rawSegmentLength = required.toInt()
     }
 
     private fun processSegment() {
+        if (isSegmentSliced) {
+            try {
+                val status = alps.tryProcessIsobmffSegment(loadedSlices())
+                AlpsLoggerProvider.i("Segment slices processed by ALPS, status: $status")
+            } catch (e: Exception) {
+                AlpsLoggerProvider.e(e.message ?: "Exception without message")
+                AlpsLoggerProvider.w(
+                    "Exception thrown during ALPS segment processing. Segment will be provided as is."
+                )
+            }
+            return
+        }
         segmentBuffer?.let { segmentBuffer ->
             try {
-                val directByteBuffer = ByteBuffer.allocateDirect(segmentBuffer.size)
-                directByteBuffer.put(segmentBuffer)
-                alps.processIsobmffSegment(directByteBuffer)
-                directByteBuffer.position(0)
-                directByteBuffer.get(segmentBuffer)
-                inputStream = ByteArrayInputStream(segmentBuffer)
+                if (patchOutputEnabled) {
+                    segmentPatch = alps.processIsobmffSegmentPatch(
+                        segmentBuffer, 0, segmentSize.toInt()
+                    ).also {
+                        AlpsLoggerProvider.i("Segment patch with ${it.editCount} edits created")
+                    }
+                } else {
+                    alps.processIsobmffSegment(segmentBuffer, 0, segmentSize.toInt())
+                }
                 AlpsLoggerProvider.i("Segment processed successfully by ALPS")
+                storePresentations()
             } catch (e: Exception) {
                 AlpsLoggerProvider.e(e.message ?: "Exception without message")
                 AlpsLoggerProvider.w(
-                    "Exception thrown during ALPS segment processing. Unmodified segment will be provided."
+                    "Exception thrown during ALPS segment processing. Segment will be provided as is."
                 )
-                inputStream = ByteArrayInputStream(segmentBuffer)
             }
+            inputStream = ByteArrayInputStream(segmentBuffer, 0, segmentSize.toInt())
         }
     }
 
+    /**
+     * Stores presentations listed by the processed init segment in presentationCache. Cached entry
+     * of a changed init segment is replaced or removed.
+     */
+    private fun storePresentations() {
+        val cache = presentationCache ?: return
+        val contentHash = initSegmentHash ?: return
+        val initSegmentUri = dataSpec?.uri?.toString() ?: return
+        cache.put(initSegmentUri, contentHash, alps.getPresentations())
+    }
+
     private fun readInternal(buffer: ByteArray, offset: Int, requestedReadLength: Int): Int {
         var readLength = requestedReadLength
         if (readLength == 0) {
             return 0
         }
+        if (isSegmentSliced) {
+            return readSlices(buffer, offset, readLength)
+        }
 
         if (segmentSize != C.LENGTH_UNSET.toLong()) {
             val bytesRemaining = segmentSize - inputStreamRead
@@ -154,9 +495,27 @@ internal class AlpsProcessing(
         if (read == -1) {
             return C.RESULT_END_OF_INPUT
         }
+        segmentPatch?.apply(buffer, offset, inputStreamRead, read)
 
         inputStreamRead += read.toLong()
 
         return read
     }
+
+    private fun readSlices(buffer: ByteArray, offset: Int, length: Int): Int {
+        val bytesRemaining = loadedBytes - inputStreamRead
+        if (bytesRemaining == 0L) {
+            return C.RESULT_END_OF_INPUT
+        }
+        val sliceRemaining = (SEGMENT_SLICE_SIZE - sliceReadOffset).toLong()
+        val read = minOf(length.toLong(), bytesRemaining, sliceRemaining).toInt()
+        System.arraycopy(segmentSlices[sliceReadIndex], sliceReadOffset, buffer, offset, read)
+        sliceReadOffset += read
+        if (sliceReadOffset == SEGMENT_SLICE_SIZE) {
+            sliceReadIndex++
+            sliceReadOffset = 0
+        }
+        inputStreamRead += read
+        return read
+    }
 }
\ No newline at end of file
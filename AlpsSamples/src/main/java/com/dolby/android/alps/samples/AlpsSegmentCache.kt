@@ -0,0 +1,120 @@
+/***************************************************************************************************
+ *                Copyright (C) 2024 by Dolby International AB.
+ *                All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************************************/
+
+package com.dolby.android.alps.samples
+
+import androidx.media3.common.util.UnstableApi
+import androidx.media3.datasource.DataSpec
+
+/**
+ * [AlpsSegmentCache] keeps unmodified bytes of recently downloaded segments, so that they can be
+ * processed again after active presentation change without downloading them.
+ *
+ * Changing active presentation requires flushing player buffers, because buffered segments were
+ * processed for the previous presentation. When the player requests the same segments again,
+ * [AlpsHttpDataSource] serves them from this cache and only processes them with the new active
+ * presentation, so presentation switch costs CPU time instead of network refill.
+ *
+ * Segments are identified by [DataSpec] key (or URI), position and length. Least recently used
+ * segments are evicted when total size exceeds [maxBytes]. Segments larger than [maxBytes] are not
+ * cached. Cache is thread safe and can be shared by data sources of all periods.
+ *
+ * @param maxBytes memory limit of cached segments
+ */
+@UnstableApi
+class AlpsSegmentCache(
+    val maxBytes: Long = DEFAULT_MAX_BYTES,
+) {
+    companion object {
+        /**
+         * Enough for about a minute of high bitrate AC-4 audio
+         */
+        const val DEFAULT_MAX_BYTES = 16L * 1024 * 1024
+    }
+
+    private data class Key(
+        val id: String,
+        val position: Long,
+        val length: Long,
+    )
+
+    private val segments = LinkedHashMap<Key, ByteArray>(16, 0.75f, true)
+    private var cachedBytes = 0L
+
+    /**
+     * Total size of cached segments in bytes.
+     */
+    val sizeBytes: Long
+        get() = synchronized(this) { cachedBytes }
+
+    /**
+     * Returns unmodified bytes of the segment described by [dataSpec]. Returned array must not be
+     * modified.
+     *
+     * @param dataSpec segment request
+     * @return cached segment bytes, null if segment is not cached
+     */
+    fun get(dataSpec: DataSpec): ByteArray? = synchronized(this) {
+        segments[dataSpec.toKey()]
+    }
+
+    /**
+     * Stores copy of downloaded, not yet processed, segment bytes.
+     *
+     * @param dataSpec segment request
+     * @param segment array with segment bytes
+     * @param length segment size in bytes
+     */
+    fun put(dataSpec: DataSpec, segment: ByteArray, length: Int) {
+        if (length > maxBytes) {
+            return
+        }
+        val copy = segment.copyOf(length)
+        synchronized(this) {
+            segments.put(dataSpec.toKey(), copy)?.let { cachedBytes -= it.size }
+            cachedBytes += copy.size
+            evict()
+        }
+    }
+
+    /**
+     * Removes all cached segments.
+     */
+    fun clear() = synchronized(this) {
+        segments.clear()
+        cachedBytes = 0
+    }
+
+    private fun evict() {
+        val iterator = segments.values.iterator()
+        while (cachedBytes > maxBytes && iterator.hasNext()) {
+            cachedBytes -= iterator.next().size
+            iterator.remove()
+        }
+    }
+
+    private fun DataSpec.toKey() = Key(key ?: uri.toString(), position, length)
+}
\ No newline at end of file
@@ -27,17 +27,27 @@
 package com.dolby.android.alps.samples
 
 import android.net.Uri
+import androidx.media3.common.C
 import androidx.media3.datasource.DataSpec
 import androidx.media3.datasource.DefaultHttpDataSource
 import assertk.assertThat
 import assertk.assertions.isEqualTo
+import assertk.assertions.isNotNull
+import assertk.assertions.isNull
+import assertk.assertions.prop
 import com.dolby.android.alps.Alps
+import com.dolby.android.alps.AlpsSegmentPatch
+import com.dolby.android.alps.AlpsSegmentStream
+import com.dolby.android.alps.models.Presentation
 import io.mockk.clearMocks
 import io.mockk.every
 import io.mockk.mockk
 import io.mockk.verify
 import org.junit.jupiter.api.Nested
 import org.junit.jupiter.api.Test
+import org.junit.jupiter.api.io.TempDir
+import java.io.File
+import java.nio.ByteBuffer
 
 class AlpsHttpDataSourceTest {
     companion object {
@@ -114,7 +124,7 @@ class AlpsHttpDataSourceTest {
                 mockedDefaultHttpDataSource.read(any(), any(), any())
             }
             verify(exactly = AMOUNT_OF_PROCESS_ISOBMFF_SEGMENT_CALLS_PER_SEGMENT) {
-                mockedAlps.processIsobmffSegment(any())
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
             }
 
             clearMocks(mockedDefaultHttpDataSource, mockedAlps)
@@ -123,7 +133,7 @@ class AlpsHttpDataSourceTest {
 
             verify(exactly = 0) {
                 mockedDefaultHttpDataSource.read(any(), any(), any())
-                mockedAlps.processIsobmffSegment(any())
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
             }
         }
 
@@ -151,7 +161,7 @@ class AlpsHttpDataSourceTest {
                 mockedDefaultHttpDataSource.read(any(), any(), any())
             }
             verify(exactly = AMOUNT_OF_PROCESS_ISOBMFF_SEGMENT_CALLS_PER_SEGMENT) {
-                mockedAlps.processIsobmffSegment(any())
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
             }
 
             alpsHttpDataSource.open(getMockedDataSpec())
@@ -161,7 +171,277 @@ class AlpsHttpDataSourceTest {
                 mockedDefaultHttpDataSource.read(any(), any(), any())
             }
             verify(exactly = AMOUNT_OF_PROCESS_ISOBMFF_SEGMENT_CALLS_PER_SEGMENT * 2) {
-                mockedAlps.processIsobmffSegment(any())
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
+            }
+        }
+
+        @Test
+        fun `segment of unknown length is loaded into slices and processed as a whole`() {
+            val mockedAlps = getMockedAlps()
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = C.LENGTH_UNSET.toLong(),
+            )
+            every {
+                mockedDefaultHttpDataSource.read(any(), any(), any())
+            } returnsMany listOf(
+                EXAMPLE_SINGLE_READ_LENGTH, EXAMPLE_SINGLE_READ_LENGTH, C.RESULT_END_OF_INPUT
+            )
+            val fakeBuffer = ByteArray(EXAMPLE_SEGMENT_SIZE.toInt())
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                )
+            )
+
+            alpsHttpDataSource.open(getMockedDataSpec())
+            val read = alpsHttpDataSource.read(fakeBuffer, 0, fakeBuffer.size)
+
+            assertThat(read).isEqualTo(EXAMPLE_SEGMENT_SIZE.toInt())
+            assertThat(alpsHttpDataSource.read(fakeBuffer, 0, fakeBuffer.size))
+                .isEqualTo(C.RESULT_END_OF_INPUT)
+            verify(exactly = AMOUNT_OF_PROCESS_ISOBMFF_SEGMENT_CALLS_PER_SEGMENT) {
+                mockedAlps.tryProcessIsobmffSegment(any<List<ByteBuffer>>())
+            }
+            verify(exactly = 0) {
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
+            }
+        }
+
+        @Test
+        fun `cached segment is processed again without downloading it`() {
+            val mockedAlps = getMockedAlps()
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+                readReturnValue = EXAMPLE_SINGLE_READ_LENGTH
+            )
+            val segmentCache = AlpsSegmentCache()
+            val dataSpec = getMockedDataSpec()
+            val fakeBuffer = ByteArray(EXAMPLE_SEGMENT_SIZE.toInt())
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                segmentCache = segmentCache,
+            )
+
+            alpsHttpDataSource.open(dataSpec)
+            alpsHttpDataSource.read(fakeBuffer, 0, EXAMPLE_SINGLE_READ_LENGTH)
+
+            assertThat(segmentCache.sizeBytes).isEqualTo(EXAMPLE_SEGMENT_SIZE)
+
+            clearMocks(mockedDefaultHttpDataSource, mockedAlps)
+
+            val openedLength = alpsHttpDataSource.open(dataSpec)
+            alpsHttpDataSource.read(fakeBuffer, 0, EXAMPLE_SINGLE_READ_LENGTH)
+
+            assertThat(openedLength).isEqualTo(EXAMPLE_SEGMENT_SIZE)
+            verify(exactly = 0) {
+                mockedDefaultHttpDataSource.open(any())
+                mockedDefaultHttpDataSource.read(any(), any(), any())
+            }
+            verify(exactly = AMOUNT_OF_PROCESS_ISOBMFF_SEGMENT_CALLS_PER_SEGMENT) {
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
+            }
+        }
+
+        @Test
+        fun `segment patch is applied while reading instead of processing segment in place`() {
+            val segmentPatch = mockk<AlpsSegmentPatch>(relaxed = true)
+            val mockedAlps = getMockedAlps().apply {
+                every { processIsobmffSegmentPatch(any(), any(), any()) } returns segmentPatch
+            }
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+                readReturnValue = EXAMPLE_SINGLE_READ_LENGTH
+            )
+            val fakeBuffer = ByteArray(EXAMPLE_SEGMENT_SIZE.toInt())
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                patchOutputEnabled = true,
+            )
+
+            alpsHttpDataSource.open(getMockedDataSpec())
+            alpsHttpDataSource.read(fakeBuffer, 0, EXAMPLE_SINGLE_READ_LENGTH)
+            alpsHttpDataSource.read(
+                fakeBuffer,
+                EXAMPLE_SINGLE_READ_LENGTH,
+                EXAMPLE_SINGLE_READ_LENGTH
+            )
+
+            verify(exactly = 0) {
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
+            }
+            verify(exactly = 1) {
+                segmentPatch.apply(fakeBuffer, 0, 0L, EXAMPLE_SINGLE_READ_LENGTH)
+                segmentPatch.apply(
+                    fakeBuffer,
+                    EXAMPLE_SINGLE_READ_LENGTH,
+                    EXAMPLE_SINGLE_READ_LENGTH.toLong(),
+                    EXAMPLE_SINGLE_READ_LENGTH
+                )
+            }
+        }
+
+        @Test
+        fun `presentations of processed init segment are stored in presentation cache`(
+            @TempDir cacheDir: File
+        ) {
+            val presentations = listOf(Presentation(1, "English", "eng"))
+            val mockedAlps = getMockedAlps().apply {
+                every { getPresentations() } returns presentations
+            }
+            val initSegment = ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()).apply {
+                "ftyp".toByteArray().copyInto(this, 4)
+            }
+            var initSegmentRead = 0
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+            ).apply {
+                every { read(any(), any(), any()) } answers {
+                    val length = minOf(thirdArg<Int>(), initSegment.size - initSegmentRead)
+                    initSegment.copyInto(
+                        firstArg(), secondArg(), initSegmentRead, initSegmentRead + length
+                    )
+                    initSegmentRead += length
+                    length
+                }
+            }
+            val cacheFile = File(cacheDir, "presentations.bin")
+            val dataSpec = getMockedDataSpec()
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                presentationCache = AlpsPresentationCache(cacheFile),
+            )
+
+            alpsHttpDataSource.open(dataSpec)
+            alpsHttpDataSource.read(ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()), 0, 1)
+
+            val entry = AlpsPresentationCache(cacheFile).get(dataSpec.uri.toString())
+            assertThat(entry).isNotNull().prop(AlpsPresentationCache.Entry::presentations)
+                .isEqualTo(presentations)
+            assertThat(entry?.contentHash).isEqualTo(AlpsPresentationCache.contentHash(initSegment))
+        }
+
+        @Test
+        fun `cached entry of changed init segment without presentations is removed`(
+            @TempDir cacheDir: File
+        ) {
+            val mockedAlps = getMockedAlps().apply {
+                every { getPresentations() } returns emptyList()
+            }
+            val initSegment = ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()).apply {
+                "ftyp".toByteArray().copyInto(this, 4)
+            }
+            var initSegmentRead = 0
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+            ).apply {
+                every { read(any(), any(), any()) } answers {
+                    val length = minOf(thirdArg<Int>(), initSegment.size - initSegmentRead)
+                    initSegment.copyInto(
+                        firstArg(), secondArg(), initSegmentRead, initSegmentRead + length
+                    )
+                    initSegmentRead += length
+                    length
+                }
+            }
+            val cacheFile = File(cacheDir, "presentations.bin")
+            val dataSpec = getMockedDataSpec()
+            AlpsPresentationCache(cacheFile).put(
+                dataSpec.uri.toString(),
+                AlpsPresentationCache.contentHash(initSegment) + 1,
+                listOf(Presentation(1, "English", "eng")),
+            )
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                presentationCache = AlpsPresentationCache(cacheFile),
+            )
+
+            alpsHttpDataSource.open(dataSpec)
+            alpsHttpDataSource.read(ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()), 0, 1)
+
+            assertThat(AlpsPresentationCache(cacheFile).get(dataSpec.uri.toString())).isNull()
+        }
+    }
+
+    @Nested
+    inner class ChunkedReadMethod {
+        @Test
+        fun `segment is fed to segment stream instead of processing it as a whole`() {
+            val mockedSegmentStream = mockk<AlpsSegmentStream>(relaxed = true)
+            val mockedAlps = getMockedAlps()
+            every { mockedAlps.createSegmentStream() } returns mockedSegmentStream
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+                readReturnValue = EXAMPLE_SINGLE_READ_LENGTH
+            )
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                chunkedProcessingEnabled = true,
+            )
+
+            alpsHttpDataSource.open(getMockedDataSpec())
+            val read = alpsHttpDataSource.read(
+                ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()), 0, EXAMPLE_SINGLE_READ_LENGTH
+            )
+
+            assertThat(read).isEqualTo(C.RESULT_END_OF_INPUT)
+            verify(exactly = AMOUNT_OF_HTTP_READ_CALLS_FOR_EXAMPLE_SEGMENT) {
+                mockedSegmentStream.feed(any(), 0, EXAMPLE_SINGLE_READ_LENGTH)
+            }
+            verify(exactly = 1) {
+                mockedSegmentStream.reset()
+                mockedSegmentStream.finish()
+            }
+            verify(exactly = 0) {
+                mockedAlps.processIsobmffSegment(any<ByteArray>(), any(), any())
+            }
+        }
+
+        @Test
+        fun `processed chunk is returned before whole segment is downloaded`() {
+            val mockedSegmentStream = mockk<AlpsSegmentStream>(relaxed = true) {
+                every { read(any(), any(), any()) } returnsMany listOf(0, EXAMPLE_SINGLE_READ_LENGTH)
+            }
+            val mockedAlps = getMockedAlps()
+            every { mockedAlps.createSegmentStream() } returns mockedSegmentStream
+            val mockedDefaultHttpDataSource = getMockedDefaultHttpDataSource(
+                openReturnValue = EXAMPLE_SEGMENT_SIZE,
+                readReturnValue = EXAMPLE_SINGLE_READ_LENGTH
+            )
+            alpsHttpDataSource = createAlpsHttpDataSource(
+                mockedAlps,
+                getMockedDefaultHttpDataSourceFactory(
+                    mockedDefaultHttpDataSource
+                ),
+                chunkedProcessingEnabled = true,
+            )
+
+            alpsHttpDataSource.open(getMockedDataSpec())
+            val read = alpsHttpDataSource.read(
+                ByteArray(EXAMPLE_SEGMENT_SIZE.toInt()), 0, EXAMPLE_SINGLE_READ_LENGTH
+            )
+
+            assertThat(read).isEqualTo(EXAMPLE_SINGLE_READ_LENGTH)
+            verify(exactly = 1) {
+                mockedDefaultHttpDataSource.read(any(), any(), any())
+            }
+            verify(exactly = 0) {
+                mockedSegmentStream.finish()
             }
         }
     }
@@ -306,10 +586,18 @@ class AlpsHttpDataSourceTest {
     private fun createAlpsHttpDataSource(
         alps: Alps,
         defaultHttpDataSourceFactory: DefaultHttpDataSource.Factory,
+        chunkedProcessingEnabled: Boolean = false,
+        segmentCache: AlpsSegmentCache? = null,
+        presentationCache: AlpsPresentationCache? = null,
+        patchOutputEnabled: Boolean = false,
     ): AlpsHttpDataSource {
         return AlpsHttpDataSource.Factory(
             alps,
             defaultHttpDataSourceFactory,
+            chunkedProcessingEnabled,
+            segmentCache,
+            presentationCache,
+            patchOutputEnabled,
         ).createDataSource() as? AlpsHttpDataSource
             ?: throw Exception("AlpsHttpDataSource creation failed")
     }
@@ -29,12 +29,11 @@ package com.dolby.android.alps.cli
 import android.content.Context
 import androidx.work.Worker
 import androidx.work.WorkerParameters
-import com.dolby.android.alps.Alps
+import com.dolby.android.alps.AlpsBatchProcessor
+import com.dolby.android.alps.models.AlpsBatchFile
+import com.dolby.android.alps.models.AlpsBatchJob
 import io.github.aakira.napier.Napier
 import java.io.File
-import java.io.FileInputStream
-import java.io.FileOutputStream
-import java.nio.ByteBuffer
 
 class AlpsCliWorker(
     private val context: Context,
@@ -48,31 +47,26 @@ class AlpsCliWorker(
 
             val outputFilesDir = prepareOutputFilesDir(processingParams.output)
 
-            val inputFiles = inputFilesDir.listFiles()?.toList()
-            if(inputFiles.isNullOrEmpty())
-                throw Exception("No files found in input directory")
-
-            val initFile = inputFiles.find { it.name.contains("init") }
-                ?: throw Exception("Input directory must contain init file")
-
-            val alps = Alps()
-
-            processSegment(initFile, alps).also {
-                saveSegmentToFile(it, File(outputFilesDir, initFile.name))
+            // Input directory and each of its subdirectories containing init file is a stream
+            val streamDirs = listOf(inputFilesDir) +
+                    (inputFilesDir.listFiles()?.filter { it.isDirectory } ?: emptyList())
+            val jobs = streamDirs.mapNotNull { streamDir ->
+                val outputDir = File(outputFilesDir, streamDir.relativeTo(inputFilesDir).path)
+                prepareJob(streamDir, outputDir, processingParams.pres)
             }
-
-            Napier.i("Detected presentations: ${alps.getPresentations()}")
-
-            Napier.d("Setting active presentation ID to ${processingParams.pres}")
-            alps.setActivePresentationId(processingParams.pres)
-
-            inputFiles.filter { it.extension == "m4s" }.forEach { segmentFile ->
-                processSegment(segmentFile, alps).also {
-                    saveSegmentToFile(it, File(outputFilesDir, segmentFile.name))
-                }
+            if (jobs.isEmpty())
+                throw Exception("Input directory must contain init file")
+
+            val statistics = AlpsBatchProcessor.process(jobs)
+            Napier.i("Processed ${statistics.fileCount} files of ${jobs.size} streams, " +
+                    "${statistics.bytes} bytes in ${statistics.elapsedNs / 1_000_000} ms")
+            if (statistics.unprocessedFileCount > 0) {
+                Napier.w("${statistics.unprocessedFileCount} files failed ALPS processing and " +
+                        "were provided as is.")
             }
+            if (statistics.failedFileCount > 0)
+                throw Exception("Failed to read or write ${statistics.failedFileCount} files")
 
-            alps.release()
             Napier.i("ALPS CLI processing success. Output files saved in ${outputFilesDir.path}")
             return Result.success()
         } catch (e: Exception) {
@@ -81,29 +75,23 @@ class AlpsCliWorker(
         }
     }
 
-    private fun processSegment(segment: File, alps: Alps): ByteArray {
-        val segmentBytes = FileInputStream(segment).use {
-            it.readBytes()
-        }
-
-        try {
-            val directByteBuffer = ByteBuffer.allocateDirect(segmentBytes.size)
-            directByteBuffer.put(segmentBytes)
-            alps.processIsobmffSegment(directByteBuffer)
-            directByteBuffer.position(0)
-            directByteBuffer.get(segmentBytes)
-        } catch (e: Exception) {
-            Napier.e(e.message ?: "Exception without message")
-            Napier.w("Exception thrown during ALPS segment processing. Unmodified segment will be provided.")
-        }
-
-        return segmentBytes
-    }
+    private fun prepareJob(streamDir: File, outputDir: File, presentationId: Int): AlpsBatchJob? {
+        val inputFiles = streamDir.listFiles()?.filter { it.isFile } ?: return null
+        val initFile = inputFiles.find { it.name.contains("init") } ?: return null
+        val segmentFiles = inputFiles
+            .filter { it.extension == "m4s" && it != initFile }
+            .sortedWith(compareBy({ it.name.length }, { it.name }))
 
-    private fun saveSegmentToFile(segmentBytes: ByteArray, outputFile: File) {
-        FileOutputStream(outputFile).use {
-            it.write(segmentBytes)
+        if (outputDir.exists().not() && outputDir.mkdirs().not()) {
+            throw Exception("Failed to create output directory ${outputDir.path}")
         }
+        Napier.d("Stream ${streamDir.path}: ${segmentFiles.size} segments")
+        return AlpsBatchJob(
+            files = (listOf(initFile) + segmentFiles).map {
+                AlpsBatchFile(input = it, output = File(outputDir, it.name))
+            },
+            presentationId = presentationId,
+        )
     }
 
     private fun prepareInputFilesDir(inputDir: String): File {
@@ -69,12 +69,15 @@ import com.dolby.android.alps.samples.AlpsDashChunkSourceFactory
 import com.dolby.android.alps.samples.AlpsManager
 import com.dolby.android.alps.samples.AlpsManager.Companion.TV_DEFAULT_PRESENTATION
 import com.dolby.android.alps.samples.AlpsMediaSourceFactory
+import com.dolby.android.alps.samples.AlpsPresentationCache
+import com.dolby.android.alps.samples.AlpsSegmentCache
 import com.dolby.android.alps.samples.AlpsManifestParser
 import com.dolby.android.alps.samples.models.PeriodWithPreselections
 import com.dolby.android.alps.samples.models.AlpsPresentationWrapper
 import io.github.aakira.napier.Napier
 import kotlinx.coroutines.launch
 import org.koin.android.ext.android.get
+import java.io.File
 import kotlin.math.max
 
 @UnstableApi
@@ -84,6 +87,7 @@ class PlayerActivity : AppCompatActivity() {
         private const val KEY_ITEM_INDEX: String = "item_index"
         private const val KEY_POSITION: String = "position"
         private const val KEY_AUTO_PLAY: String = "auto_play"
+        private const val PRESENTATION_CACHE_FILE_NAME = "alps_presentations.bin"
     }
 
     private lateinit var binding: ActivityPlayerBinding
@@ -99,7 +103,12 @@ class PlayerActivity : AppCompatActivity() {
     private var mediaItems = emptyList<MediaItem>()
 
     private var isAlpsEnabled = false
-    private val alpsManager = AlpsManager()
+    private val alpsManager by lazy {
+        AlpsManager(
+            presentationCache = AlpsPresentationCache(File(cacheDir, PRESENTATION_CACHE_FILE_NAME))
+        )
+    }
+    private val segmentCache = AlpsSegmentCache()
 
     private var latestPresentationsList: List<AlpsPresentationWrapper> = emptyList()
     private val latestPresentationsWithTvDefault
@@ -213,6 +222,7 @@ class PlayerActivity : AppCompatActivity() {
     override fun onDestroy() {
         super.onDestroy()
         alpsManager.release()
+        segmentCache.clear()
     }
 
     override fun onRequestPermissionsResult(
@@ -297,6 +307,7 @@ class PlayerActivity : AppCompatActivity() {
             val alpsChunkSourceFactory = AlpsDashChunkSourceFactory(
                 alpsManager,
                 DefaultHttpDataSource.Factory(),
+                segmentCache = segmentCache,
             )
 
             val dashMediaSourceFactory = DashMediaSource.Factory(